@@ -15,6 +15,8 @@
 #include "xalloc.h"
 #include <stdio.h>
 #include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
 
 #define USER_DEBUG                                     (0)
 // #define USE_MALLOC
@@ -99,6 +101,18 @@ void fb_free(void *ptr) {
 void fb_free_all() {
     // do nothing
 }
+
+void fb_alloc_get_stats(fb_alloc_stats_t *stats) {
+    memset(stats, 0, sizeof(fb_alloc_stats_t));
+}
+
+void fb_alloc_reset_peak() {
+    // do nothing
+}
+
+void fb_alloc_trim() {
+    // do nothing
+}
 #else
 #ifndef __DCACHE_PRESENT
 #define FB_ALLOC_ALIGNMENT 32 // Use 32-byte alignment on MCUs with no cache for DMA buffer alignment.
@@ -106,32 +120,187 @@ void fb_free_all() {
 #define FB_ALLOC_ALIGNMENT __SCB_DCACHE_LINE_SIZE
 #endif
 
-static char* _fballoc_start = NULL;
-static char* _fballoc = NULL;
-static char* pointer = NULL;
-
-#if USER_DEBUG
-static int alloc_num = 0;
-#endif
-
-#if defined(FB_ALLOC_STATS)
-static uint32_t alloc_bytes;
-static uint32_t alloc_bytes_peak;
-#endif
-
-// #if defined(OMV_FB_OVERLAY_MEMORY)
-// #define FB_OVERLAY_MEMORY_FLAG 0x1
-// extern char _fballoc_overlay_end, _fballoc_overlay_start;
-// static char *pointer_overlay = &_fballoc_overlay_end;
-// #endif
+// Each thread has its own arena, so imlib functions can run in multiple threads at the same time.
+//
+// An arena is a stack of chunks, each chunk is a stack growing downwards like the original single
+// fb_alloc stack: every alloc is preceded by a uint32_t size header, so fb_free() can pop it.
+// When an alloc doesn't fit in the current chunk, the arena moves to the next chunk, allocating
+// one if needed, so large frames no longer run out of stack memory. Chunks above the current one
+// are kept for reuse until fb_alloc_trim() or thread exit.
+//
+// Marks are kept in a separate stack recording (chunk, pointer, used bytes), so
+// fb_alloc_free_till_mark() restores the position in O(1) instead of walking the allocs.
 
 // fb_alloc_free_till_mark() will not free past this.
 // Use fb_alloc_free_till_mark_permanent() instead.
 #define FB_PERMANENT_FLAG 0x2
+#define FB_MARKS_INIT_NUM 16
+
+typedef struct {
+    char *start;
+    char *end;
+    char *pointer;      // stack top, grows down from end
+} fb_chunk_t;
+
+typedef struct {
+    uint32_t chunk;
+    char *pointer;
+    uint32_t used;
+    char *permanent;    // position after last permanent alloc inside this mark, NULL if none
+    uint32_t permanent_chunk;
+    uint32_t permanent_used;
+} fb_mark_t;
+
+typedef struct {
+    fb_chunk_t *chunks;
+    uint32_t chunks_num;    // chunks allocated
+    uint32_t chunks_cap;
+    uint32_t cur;           // current chunk index
+    fb_mark_t *marks;
+    uint32_t marks_num;     // marks[0] is the bottom of arena and never popped
+    uint32_t marks_cap;
+    uint32_t chunk_size;    // default chunk size
+    uint32_t used;
+    uint32_t peak;
+    uint32_t reserved;
+} fb_arena_t;
+
+static pthread_key_t fb_arena_key;
+static pthread_once_t fb_arena_key_once = PTHREAD_ONCE_INIT;
+static __thread fb_arena_t *fb_arena = NULL;
+static uint32_t fb_default_chunk_size = OMV_FB_ALLOC_SIZE;
+
+static void fb_arena_free(fb_arena_t *arena)
+{
+    if (!arena)
+        return;
+    for (uint32_t i = 0; i < arena->chunks_num; ++i) {
+        xfree(arena->chunks[i].start);
+    }
+    xfree(arena->chunks);
+    xfree(arena->marks);
+    xfree(arena);
+}
+
+static void fb_arena_destructor(void *arena)
+{
+    fb_arena_free((fb_arena_t *) arena);
+}
+
+static void fb_arena_key_create()
+{
+    pthread_key_create(&fb_arena_key, fb_arena_destructor);
+}
+
+// make chunks[idx] able to hold size bytes, reuse cached chunk if it's large enough
+static bool fb_arena_chunk(fb_arena_t *arena, uint32_t idx, uint32_t size)
+{
+    if (idx < arena->chunks_num) {
+        fb_chunk_t *chunk = &arena->chunks[idx];
+        if ((uint32_t) (chunk->end - chunk->start) >= size) {
+            chunk->pointer = chunk->end;
+            return true;
+        }
+        // too small, replace it
+        arena->reserved -= chunk->end - chunk->start;
+        xfree(chunk->start);
+        chunk->start = chunk->end = chunk->pointer = NULL;
+    } else {
+        if (arena->chunks_num == arena->chunks_cap) {
+            uint32_t cap = arena->chunks_cap ? arena->chunks_cap * 2 : 4;
+            fb_chunk_t *chunks = (fb_chunk_t *) xrealloc(arena->chunks, cap * sizeof(fb_chunk_t));
+            if (!chunks)
+                return false;
+            arena->chunks = chunks;
+            arena->chunks_cap = cap;
+        }
+        idx = arena->chunks_num;
+    }
+    if (size < arena->chunk_size)
+        size = arena->chunk_size;
+    char *mem = (char *) xalloc_try_alloc(size);
+    if (!mem) {
+        if (idx == arena->chunks_num) {
+            return false;
+        }
+        // keep the empty slot consistent, it will be retried next time
+        arena->chunks[idx].start = arena->chunks[idx].end = arena->chunks[idx].pointer = NULL;
+        return false;
+    }
+    fb_chunk_t *chunk = &arena->chunks[idx];
+    chunk->start = mem;
+    chunk->end = mem + size;
+    chunk->pointer = chunk->end;
+    arena->reserved += size;
+    if (idx == arena->chunks_num)
+        arena->chunks_num++;
+    return true;
+}
+
+static fb_arena_t *fb_arena_create(uint32_t chunk_size)
+{
+    fb_arena_t *arena = (fb_arena_t *) xalloc_try_alloc(sizeof(fb_arena_t));
+    if (!arena)
+        return NULL;
+    memset(arena, 0, sizeof(fb_arena_t));
+    arena->chunk_size = chunk_size;
+    arena->marks = (fb_mark_t *) xalloc_try_alloc(FB_MARKS_INIT_NUM * sizeof(fb_mark_t));
+    if (!arena->marks || !fb_arena_chunk(arena, 0, chunk_size)) {
+        fb_arena_free(arena);
+        return NULL;
+    }
+    arena->marks_cap = FB_MARKS_INIT_NUM;
+    arena->marks_num = 1;
+    memset(&arena->marks[0], 0, sizeof(fb_mark_t));
+    arena->marks[0].pointer = arena->chunks[0].end;
+    return arena;
+}
+
+static inline fb_arena_t *fb_get_arena()
+{
+    if (fb_arena)
+        return fb_arena;
+    pthread_once(&fb_arena_key_once, fb_arena_key_create);
+    fb_arena = fb_arena_create(fb_default_chunk_size);
+    if (fb_arena)
+        pthread_setspecific(fb_arena_key, fb_arena);
+    return fb_arena;
+}
+
+static inline fb_mark_t *fb_top_mark(fb_arena_t *arena)
+{
+    return &arena->marks[arena->marks_num - 1];
+}
+
+// pop the top alloc of current chunk, move to previous chunk when current one is empty
+static void fb_arena_pop(fb_arena_t *arena)
+{
+    fb_chunk_t *chunk = &arena->chunks[arena->cur];
+    if (chunk->pointer >= chunk->end) {
+        if (arena->cur == 0)
+            return;
+        chunk = &arena->chunks[--arena->cur];
+        if (chunk->pointer >= chunk->end)
+            return;
+    }
+    uint32_t size = *((uint32_t *) chunk->pointer) & ~FB_PERMANENT_FLAG;
+    chunk->pointer += size;
+    arena->used -= size;
+    if (chunk->pointer >= chunk->end && arena->cur > 0)
+        arena->cur--;
+}
+
+static void fb_arena_restore(fb_arena_t *arena, uint32_t chunk, char *pointer, uint32_t used)
+{
+    arena->cur = chunk;
+    arena->chunks[chunk].pointer = pointer;
+    arena->used = used;
+}
 
 char *fb_alloc_stack_pointer()
 {
-    return pointer;
+    fb_arena_t *arena = fb_get_arena();
+    return arena ? arena->chunks[arena->cur].pointer : NULL;
 }
 
 void fb_alloc_fail()
@@ -140,107 +309,107 @@ void fb_alloc_fail()
                                 the image you are running this algorithm on to bypass this issue!");
 }
 
-__attribute__((constructor)) void fb_alloc_init0()
+void fb_alloc_init0()
 {
-    if (_fballoc_start)
-        return;
-    DEBUG_PRINT("[omv] fb alloc init\r\n");
-    _fballoc_start = (char*)xalloc(OMV_FB_ALLOC_SIZE);
-    _fballoc = _fballoc_start + OMV_FB_ALLOC_SIZE - sizeof(uint32_t);
-    pointer = _fballoc;
+    fb_get_arena();
 }
+
 /**
  * @brief fb_realloc_init1
  * Functional description:
- *  Reprogram the memory used by the fb_alloc module .
- *  Previously used data is not saved !
+ *  Set the default chunk size of arenas and reprogram the memory used by current thread's arena.
+ *  Previously used data of current thread is not saved !
  * @param size
  *  will be alloc memory!
  */
 void fb_realloc_init1(uint32_t size)
 {
-    if(NULL == _fballoc_start)
-    {
-        _fballoc_start = (char*)xalloc(size);
-        _fballoc = _fballoc_start + size - sizeof(uint32_t);
-        pointer = _fballoc;
-    }
-    else
-    {
-        xfree(_fballoc_start);
-        _fballoc_start = (char*)xalloc(size);
-        _fballoc = _fballoc_start + size - sizeof(uint32_t);
-        pointer = _fballoc;
+    fb_default_chunk_size = size;
+    if (fb_arena) {
+        pthread_setspecific(fb_arena_key, NULL);
+        fb_arena_free(fb_arena);
+        fb_arena = NULL;
     }
+    fb_get_arena();
 }
 
 __attribute__((destructor)) void fb_alloc_close0()
 {
-    if (!_fballoc_start)
+    // thread exit destructor doesn't run for main thread
+    if (!fb_arena)
         return;
     DEBUG_PRINT("[omv] fb alloc deinit\r\n");
-    xfree(_fballoc_start);
-    _fballoc_start = NULL;
-    _fballoc = NULL;
-    pointer = NULL;
+    pthread_setspecific(fb_arena_key, NULL);
+    fb_arena_free(fb_arena);
+    fb_arena = NULL;
 }
 
+// space fb_alloc_all() can get, the rest of current chunk, or a new chunk if the rest is small
+static uint32_t fb_avail_chunk(fb_arena_t *arena, bool *new_chunk)
+{
+    fb_chunk_t *chunk = &arena->chunks[arena->cur];
+    uint32_t temp = chunk->pointer - chunk->start;
+    temp = (temp < sizeof(uint32_t) * 2) ? 0 : temp - sizeof(uint32_t);
+    *new_chunk = temp < arena->chunk_size / 2;
+    if (*new_chunk) {
+        uint32_t next = arena->cur + 1;
+        uint32_t size = arena->chunk_size;
+        if (next < arena->chunks_num && (uint32_t) (arena->chunks[next].end - arena->chunks[next].start) > size)
+            size = arena->chunks[next].end - arena->chunks[next].start;
+        return size - sizeof(uint32_t);
+    }
+    return temp;
+}
 
 uint32_t fb_avail()
 {
-    uint32_t temp = pointer - _fballoc_start - sizeof(uint32_t);
-    return (temp < sizeof(uint32_t)) ? 0 : temp;
+    fb_arena_t *arena = fb_get_arena();
+    if (!arena)
+        return 0;
+    bool new_chunk;
+    return fb_avail_chunk(arena, &new_chunk);
 }
 
 void fb_alloc_mark()
 {
-    char *new_pointer = pointer - sizeof(uint32_t);
-
-    // Check if allocation overwrites the framebuffer pixels
-    if (new_pointer < _fballoc_start) {
+    fb_arena_t *arena = fb_get_arena();
+    if (!arena) {
         fb_alloc_fail();
-        // nlr_raise_for_fb_alloc_mark(mp_obj_new_exception_msg(&mp_type_MemoryError,
-        //     MP_ERROR_TEXT("Out of fast Frame Buffer Stack Memory!"
-        //     " Please reduce the resolution of the image you are running this algorithm on to bypass this issue!")));
+        return;
     }
-
-    // fb_alloc does not allow regions which are a size of 0 to be alloced,
-    // meaning that the value below is always 8 or more but never 4. So,
-    // we will use a size value of 4 as a marker in the alloc stack.
-    *((uint32_t *) new_pointer) = sizeof(uint32_t); // Save size.
-    pointer = new_pointer;
-    #if defined(FB_ALLOC_STATS)
-    alloc_bytes = 0;
-    alloc_bytes_peak = 0;
-    #endif
+    if (arena->marks_num == arena->marks_cap) {
+        fb_mark_t *marks = (fb_mark_t *) xrealloc(arena->marks, arena->marks_cap * 2 * sizeof(fb_mark_t));
+        if (!marks) {
+            fb_alloc_fail();
+            return;
+        }
+        arena->marks = marks;
+        arena->marks_cap *= 2;
+    }
+    fb_mark_t *mark = &arena->marks[arena->marks_num++];
+    mark->chunk = arena->cur;
+    mark->pointer = arena->chunks[arena->cur].pointer;
+    mark->used = arena->used;
+    mark->permanent = NULL;
     DEBUG_PRINT("start a flage!");
 }
 
 static void int_fb_alloc_free_till_mark(bool free_permanent)
 {
-    // Previously there was a marks counting method used to provide a semaphore lock for this code:
-    //
-    // https://github.com/openmv/openmv/commit/c982617523766018fda70c15818f643ee8b1fd33
-    //
-    // This does not really help you in complex memory allocation operations where you want to be
-    // able to unwind things until after a certain point. It also did not handle preventing
-    // fb_alloc_free_till_mark() from running in recursive call situations (see find_blobs()).
-    while (pointer < _fballoc) {
-        uint32_t size = *((uint32_t *) pointer);
-        if ((!free_permanent) && (size & FB_PERMANENT_FLAG)) return;
-        size &= ~FB_PERMANENT_FLAG;
-        // #if defined(OMV_FB_OVERLAY_MEMORY)
-        // if (size & FB_OVERLAY_MEMORY_FLAG) { // Check for fast flag.
-        //     size &= ~FB_OVERLAY_MEMORY_FLAG; // Remove it.
-        //     pointer_overlay += size - sizeof(uint32_t);
-        // }
-        // #endif
-        pointer += size; // Get size and pop.
-        if (size == sizeof(uint32_t)) break; // Break on first marker.
+    fb_arena_t *arena = fb_get_arena();
+    if (!arena)
+        return;
+    fb_mark_t *mark = fb_top_mark(arena);
+    if ((!free_permanent) && mark->permanent) {
+        // free allocs after the permanent one, keep the mark
+        fb_arena_restore(arena, mark->permanent_chunk, mark->permanent, mark->permanent_used);
+        return;
     }
-    #if defined(FB_ALLOC_STATS)
-    printf("fb_alloc peak memory: %lu\n", alloc_bytes_peak);
-    #endif
+    fb_arena_restore(arena, mark->chunk, mark->pointer, mark->used);
+    if (arena->marks_num > 1)
+        arena->marks_num--;
+    else
+        mark->permanent = NULL;
     DEBUG_PRINT("free a flage!");
 }
 
@@ -251,7 +420,17 @@ void fb_alloc_free_till_mark()
 
 void fb_alloc_mark_permanent()
 {
-    if (pointer < _fballoc) *((uint32_t *) pointer) |= FB_PERMANENT_FLAG;
+    fb_arena_t *arena = fb_get_arena();
+    if (!arena)
+        return;
+    fb_mark_t *mark = fb_top_mark(arena);
+    fb_chunk_t *chunk = &arena->chunks[arena->cur];
+    // only valid if there is an alloc after the mark
+    if (chunk->pointer == mark->pointer && arena->cur == mark->chunk)
+        return;
+    mark->permanent = chunk->pointer;
+    mark->permanent_chunk = arena->cur;
+    mark->permanent_used = arena->used;
 }
 
 void fb_alloc_free_till_mark_past_mark_permanent()
@@ -265,6 +444,11 @@ void *fb_alloc(uint32_t size, int hints)
     if (!size) {
         return NULL;
     }
+    fb_arena_t *arena = fb_get_arena();
+    if (!arena) {
+        fb_alloc_fail();
+        return NULL;
+    }
 
     size = ((size + sizeof(uint32_t) - 1) / sizeof(uint32_t)) * sizeof(uint32_t); // Round Up
 
@@ -273,35 +457,27 @@ void *fb_alloc(uint32_t size, int hints)
         size += FB_ALLOC_ALIGNMENT - sizeof(uint32_t);
     }
 
-    char *result = pointer - size;
-    char *new_pointer = result - sizeof(uint32_t);
-
-    // Check if allocation overwrites the framebuffer pixels
-    if (new_pointer < _fballoc_start) {
-        fb_alloc_fail();
+    fb_chunk_t *chunk = &arena->chunks[arena->cur];
+    if ((uint32_t) (chunk->pointer - chunk->start) < size + sizeof(uint32_t)) {
+        // not enough, move to next chunk
+        if (!fb_arena_chunk(arena, arena->cur + 1, size + sizeof(uint32_t))) {
+            fb_alloc_fail();
+            return NULL;
+        }
+        chunk = &arena->chunks[++arena->cur];
     }
 
+    char *result = chunk->pointer - size;
+    char *new_pointer = result - sizeof(uint32_t);
+
     // size is always 4/8/12/etc. so the value below must be 8 or more.
     *((uint32_t *) new_pointer) = size + sizeof(uint32_t); // Save size.
-    pointer = new_pointer;
+    chunk->pointer = new_pointer;
 
-    #if defined(FB_ALLOC_STATS)
-    alloc_bytes += size;
-    if (alloc_bytes > alloc_bytes_peak) {
-        alloc_bytes_peak = alloc_bytes;
+    arena->used += size + sizeof(uint32_t);
+    if (arena->used > arena->peak) {
+        arena->peak = arena->used;
     }
-    printf("fb_alloc %lu bytes\n", size);
-    #endif
-
-    // #if defined(OMV_FB_OVERLAY_MEMORY)
-    // if ((!(hints & FB_ALLOC_PREFER_SIZE))
-    // && (((uint32_t) (pointer_overlay - &_fballoc_overlay_start)) >= size)) {
-    //     // Return overlay memory instead.
-    //     pointer_overlay -= size;
-    //     result = pointer_overlay;
-    //     *new_pointer |= FB_OVERLAY_MEMORY_FLAG; // Add flag.
-    // }
-    // #endif
 
     if (hints & FB_ALLOC_CACHE_ALIGN) {
         int offset = ((size_t) result) % FB_ALLOC_ALIGNMENT;
@@ -309,9 +485,7 @@ void *fb_alloc(uint32_t size, int hints)
             result += FB_ALLOC_ALIGNMENT - offset;
         }
     }
-#if USER_DEBUG
-    DEBUG_PRINT("mem num:%d pointer:%p size:%d\r\n", ++ alloc_num, pointer, size);
-#endif
+    DEBUG_PRINT("fb_alloc pointer:%p size:%d\r\n", new_pointer, size);
     return result;
 }
 
@@ -319,51 +493,47 @@ void *fb_alloc(uint32_t size, int hints)
 void *fb_alloc0(uint32_t size, int hints)
 {
     void *mem = fb_alloc(size, hints);
-    memset(mem, 0, size); // does nothing if size is zero.
+    if (mem)
+        memset(mem, 0, size); // does nothing if size is zero.
     return mem;
 }
 
 void *fb_alloc_all(uint32_t *size, int hints)
 {
-    uint32_t temp = pointer - _fballoc_start - sizeof(uint32_t);
+    fb_arena_t *arena = fb_get_arena();
+    if (!arena) {
+        *size = 0;
+        return NULL;
+    }
+    bool new_chunk;
+    uint32_t temp = fb_avail_chunk(arena, &new_chunk);
 
     if (temp < sizeof(uint32_t)) {
         *size = 0;
         return NULL;
     }
-
-    // #if defined(OMV_FB_OVERLAY_MEMORY)
-    // if (!(hints & FB_ALLOC_PREFER_SIZE)) {
-    //     *size = (uint32_t) (pointer_overlay - &_fballoc_overlay_start);
-    //     temp = IM_MIN(temp, *size);
-    // }
-    // #endif
+    if (new_chunk) {
+        if (!fb_arena_chunk(arena, arena->cur + 1, temp + sizeof(uint32_t))) {
+            *size = 0;
+            return NULL;
+        }
+        arena->cur++;
+    }
+    fb_chunk_t *chunk = &arena->chunks[arena->cur];
 
     *size = (temp / sizeof(uint32_t)) * sizeof(uint32_t); // Round Down
 
-    char *result = pointer - *size;
+    char *result = chunk->pointer - *size;
     char *new_pointer = result - sizeof(uint32_t);
 
     // size is always 4/8/12/etc. so the value below must be 8 or more.
     *((uint32_t *) new_pointer) = *size + sizeof(uint32_t); // Save size.
-    pointer = new_pointer;
+    chunk->pointer = new_pointer;
 
-    #if defined(FB_ALLOC_STATS)
-    alloc_bytes += *size;
-    if (alloc_bytes > alloc_bytes_peak) {
-        alloc_bytes_peak = alloc_bytes;
+    arena->used += *size + sizeof(uint32_t);
+    if (arena->used > arena->peak) {
+        arena->peak = arena->used;
     }
-    printf("fb_alloc_all %lu bytes\n", *size);
-    #endif
-
-    // #if defined(OMV_FB_OVERLAY_MEMORY)
-    // if (!(hints & FB_ALLOC_PREFER_SIZE)) {
-    //     // Return overlay memory instead.
-    //     pointer_overlay -= *size;
-    //     result = pointer_overlay;
-    //     *new_pointer |= FB_OVERLAY_MEMORY_FLAG; // Add flag.
-    // }
-    // #endif
 
     if (hints & FB_ALLOC_CACHE_ALIGN) {
         int offset = ((size_t) result) % FB_ALLOC_ALIGNMENT;
@@ -374,7 +544,7 @@ void *fb_alloc_all(uint32_t *size, int hints)
         }
         *size = (*size / FB_ALLOC_ALIGNMENT) * FB_ALLOC_ALIGNMENT;
     }
-    DEBUG_PRINT("alloc all mem,num:%d\r\n", ++ alloc_num);
+    DEBUG_PRINT("alloc all mem, size:%d\r\n", *size);
     return result;
 }
 
@@ -382,46 +552,70 @@ void *fb_alloc_all(uint32_t *size, int hints)
 void *fb_alloc0_all(uint32_t *size, int hints)
 {
     void *mem = fb_alloc_all(size, hints);
-    memset(mem, 0, *size); // does nothing if size is zero.
+    if (mem)
+        memset(mem, 0, *size); // does nothing if size is zero.
     return mem;
 }
 
 void fb_free(void *ptr)
 {
-    if (pointer < _fballoc) {
-        uint32_t size = *((uint32_t *) pointer);
-        size &= ~FB_PERMANENT_FLAG;
-        // #if defined(OMV_FB_OVERLAY_MEMORY)
-        // if (size & FB_OVERLAY_MEMORY_FLAG) { // Check for fast flag.
-        //     size &= ~FB_OVERLAY_MEMORY_FLAG; // Remove it.
-        //     pointer_overlay += size - sizeof(uint32_t);
-        // }
-        // #endif
-        #if defined(FB_ALLOC_STATS)
-        alloc_bytes -= size;
-        #endif
-        pointer += size; // Get size and pop.
-        DEBUG_PRINT("free num:%d pointer:%p size:%d\r\n", -- alloc_num, pointer, size);
+    fb_arena_t *arena = fb_get_arena();
+    if (!arena)
+        return;
+    // a mark on the top is popped like an alloc, the same as marks in the old single stack
+    fb_mark_t *mark = fb_top_mark(arena);
+    if (arena->marks_num > 1 && mark->chunk == arena->cur && mark->pointer == arena->chunks[arena->cur].pointer) {
+        arena->marks_num--;
+        return;
     }
+    fb_arena_pop(arena);
+    // permanent alloc freed
+    mark = fb_top_mark(arena);
+    if (mark->permanent && arena->used < mark->permanent_used)
+        mark->permanent = NULL;
 }
 
 void fb_free_all()
 {
-    while (pointer < _fballoc) {
-        uint32_t size = *((uint32_t *) pointer);
-        size &= ~FB_PERMANENT_FLAG;
-        // #if defined(OMV_FB_OVERLAY_MEMORY)
-        // if (size & FB_OVERLAY_MEMORY_FLAG) { // Check for fast flag.
-        //     size &= ~FB_OVERLAY_MEMORY_FLAG; // Remove it.
-        //     pointer_overlay += size - sizeof(uint32_t);
-        // }
-        // #endif
-        #if defined(FB_ALLOC_STATS)
-        alloc_bytes -= size;
-        #endif
-        pointer += size; // Get size and pop.
-    }
+    fb_arena_t *arena = fb_get_arena();
+    if (!arena)
+        return;
+    fb_arena_restore(arena, 0, arena->chunks[0].end, 0);
+    arena->marks_num = 1;
+    arena->marks[0].permanent = NULL;
     DEBUG_PRINT("free all mem!");
 }
 
-#endif
\ No newline at end of file
+void fb_alloc_get_stats(fb_alloc_stats_t *stats)
+{
+    fb_arena_t *arena = fb_get_arena();
+    memset(stats, 0, sizeof(fb_alloc_stats_t));
+    if (!arena)
+        return;
+    stats->used = arena->used;
+    stats->peak = arena->peak;
+    stats->reserved = arena->reserved;
+    stats->chunks = arena->chunks_num;
+    stats->marks = arena->marks_num - 1;
+}
+
+void fb_alloc_reset_peak()
+{
+    fb_arena_t *arena = fb_get_arena();
+    if (arena)
+        arena->peak = arena->used;
+}
+
+void fb_alloc_trim()
+{
+    fb_arena_t *arena = fb_get_arena();
+    if (!arena)
+        return;
+    while (arena->chunks_num > arena->cur + 1) {
+        fb_chunk_t *chunk = &arena->chunks[--arena->chunks_num];
+        arena->reserved -= chunk->end - chunk->start;
+        xfree(chunk->start);
+    }
+}
+
+#endif
@@ -36,6 +36,12 @@
  *
  * Note that fb_free() and fb_free_all() do not respect any marks and permanent regions.
  *
+ * Each thread has its own frame buffer stack, so different threads can run imlib functions at the
+ * same time, but memory fb_alloc()ed in one thread must be freed in the same thread. The stack
+ * grows by chunks of OMV_FB_ALLOC_SIZE (or larger for a larger alloc) when it runs out of space,
+ * fb_alloc_all() returns the rest of the current chunk, or a fresh chunk if the rest is small.
+ * fb_alloc_get_stats() reports usage and high-water mark of the calling thread's stack.
+ *
  * Regardings the flags below:
  * - FB_ALLOC_NO_HINT - fb_alloc doesn't do anything special.
  * - FB_ALLOC_PREFER_SPEED - fb_alloc will make sure the allocated region is in the fatest possible
@@ -60,6 +66,13 @@ extern "C" {
 #define FB_ALLOC_PREFER_SPEED    1
 #define FB_ALLOC_PREFER_SIZE     2
 #define FB_ALLOC_CACHE_ALIGN     4
+typedef struct {
+    uint32_t used;      // bytes in use, including headers
+    uint32_t peak;      // high-water mark of used since thread start or fb_alloc_reset_peak()
+    uint32_t reserved;  // bytes of all chunks
+    uint32_t chunks;    // chunks number
+    uint32_t marks;     // marks not freed
+} fb_alloc_stats_t;
 char *fb_alloc_stack_pointer();
 void fb_alloc_fail();
 void fb_alloc_init0();
@@ -74,6 +87,10 @@ void *fb_alloc_all(uint32_t *size, int hints); // returns pointer and sets size
 void *fb_alloc0_all(uint32_t *size, int hints); // returns pointer and sets size
 void fb_free(void *ptr);
 void fb_free_all();
+void fb_realloc_init1(uint32_t size); // set default chunk size, and reset current thread's stack
+void fb_alloc_get_stats(fb_alloc_stats_t *stats); // stats of current thread's stack
+void fb_alloc_reset_peak();
+void fb_alloc_trim(); // free cached chunks not in use
 
 #if __cplusplus
 }
@@ -59,14 +59,11 @@ void imlib_binary(image_t *out, image_t *img, list_t *thresholds, bool invert, b
                 break;
             }
             case PIXFORMAT_RGB888: {
+                const uint32_t *lut = imlib_compile_color_threshold(&lnk_data, invert);
                 for (int y = 0, yy = img->h; y < yy; y++) {
                     pixel_rgb_t *old_row_ptr = IMAGE_COMPUTE_RGB888_PIXEL_ROW_PTR(img, y);
                     uint32_t *bmp_row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(&bmp, y);
-                    for (int x = 0, xx = img->w; x < xx; x++) {
-                        if (COLOR_THRESHOLD_RGB888(IMAGE_GET_RGB888_PIXEL_FAST(old_row_ptr, x), &lnk_data, invert)) {
-                            IMAGE_SET_BINARY_PIXEL_FAST(bmp_row_ptr, x);
-                        }
-                    }
+                    imlib_color_threshold_row_rgb888(lut, &lnk_data, invert, old_row_ptr, img->w, bmp_row_ptr);
                 }
                 break;
             }
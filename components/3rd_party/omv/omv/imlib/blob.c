@@ -1076,12 +1076,13 @@ void imlib_find_blobs(list_t *out, image_t *ptr, rectangle_t *roi, unsigned int
                 break;
             }
             case PIXFORMAT_RGB888: {
+                const uint32_t *lut = imlib_compile_color_threshold(&lnk_data, invert);
                 for (int y = roi->y, yy = roi->y + roi->h, y_max = yy - 1; y < yy; y += y_stride) {
                     pixel_rgb_t *row_ptr = IMAGE_COMPUTE_RGB888_PIXEL_ROW_PTR(ptr, y);
                     uint32_t *bmp_row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(&bmp, y);
                     for (int x = roi->x + (y % x_stride), xx = roi->x + roi->w, x_max = xx - 1; x < xx; x += x_stride) {
                         if ((!IMAGE_GET_BINARY_PIXEL_FAST(bmp_row_ptr, x))
-                        && COLOR_THRESHOLD_RGB888(IMAGE_GET_RGB888_PIXEL_FAST(row_ptr, x), &lnk_data, invert)) {
+                        && COLOR_THRESHOLD_LUT_RGB888(lut, IMAGE_GET_RGB888_PIXEL_FAST(row_ptr, x), &lnk_data, invert)) {
                             int old_x = x;
                             int old_y = y;
 
@@ -1117,13 +1118,13 @@ void imlib_find_blobs(list_t *out, image_t *ptr, rectangle_t *roi, unsigned int
 
                                 while ((left > roi->x)
                                 && (!IMAGE_GET_BINARY_PIXEL_FAST(bmp_row, left - 1))
-                                && COLOR_THRESHOLD_RGB888(IMAGE_GET_RGB888_PIXEL_FAST(row, left - 1), &lnk_data, invert)) {
+                                && COLOR_THRESHOLD_LUT_RGB888(lut, IMAGE_GET_RGB888_PIXEL_FAST(row, left - 1), &lnk_data, invert)) {
                                     left--;
                                 }
 
                                 while ((right < (roi->x + roi->w - 1))
                                 && (!IMAGE_GET_BINARY_PIXEL_FAST(bmp_row, right + 1))
-                                && COLOR_THRESHOLD_RGB888(IMAGE_GET_RGB888_PIXEL_FAST(row, right + 1), &lnk_data, invert)) {
+                                && COLOR_THRESHOLD_LUT_RGB888(lut, IMAGE_GET_RGB888_PIXEL_FAST(row, right + 1), &lnk_data, invert)) {
                                     right++;
                                 }
 
@@ -1180,7 +1181,7 @@ void imlib_find_blobs(list_t *out, image_t *ptr, rectangle_t *roi, unsigned int
                                                 bool ok = true; // Does nothing if thresholding is skipped.
 
                                                 if ((!IMAGE_GET_BINARY_PIXEL_FAST(bmp_row, i))
-                                                && (ok = COLOR_THRESHOLD_RGB888(IMAGE_GET_RGB888_PIXEL_FAST(row, i), &lnk_data, invert))) {
+                                                && (ok = COLOR_THRESHOLD_LUT_RGB888(lut, IMAGE_GET_RGB888_PIXEL_FAST(row, i), &lnk_data, invert))) {
                                                     xylr_t context;
                                                     context.x = x;
                                                     context.y = y;
@@ -1213,7 +1214,7 @@ void imlib_find_blobs(list_t *out, image_t *ptr, rectangle_t *roi, unsigned int
                                                 bool ok = true; // Does nothing if thresholding is skipped.
 
                                                 if ((!IMAGE_GET_BINARY_PIXEL_FAST(bmp_row, i))
-                                                && (ok = COLOR_THRESHOLD_RGB888(IMAGE_GET_RGB888_PIXEL_FAST(row, i), &lnk_data, invert))) {
+                                                && (ok = COLOR_THRESHOLD_LUT_RGB888(lut, IMAGE_GET_RGB888_PIXEL_FAST(row, i), &lnk_data, invert))) {
                                                     xylr_t context;
                                                     context.x = x;
                                                     context.y = y;
@@ -9,6 +9,8 @@
  * Image library.
  */
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 #include "py/obj.h"
 #include "py/runtime.h"
 
@@ -595,6 +597,106 @@ pixel_rgb_t imlib_yuv_to_rgb888(uint8_t y, int8_t u, int8_t v) {
 
     return COLOR_R8_G8_B8_TO_RGB888(r, g, b);
 }
+
+///////////////////////////////
+// Compiled Color Thresholds //
+///////////////////////////////
+
+// Compiling a threshold costs about as much as thresholding a 256x256 image, so the
+// compiled tables are kept per thread and reused across frames while thresholds are unchanged.
+typedef struct color_threshold_lut_entry {
+    color_thresholds_list_lnk_data_t threshold;
+    bool invert;
+    bool valid;
+    uint32_t last_used;
+    uint32_t bits[COLOR_THRESHOLD_LUT_WORDS];
+} color_threshold_lut_entry_t;
+
+typedef struct color_threshold_lut_cache {
+    uint32_t tick;
+    color_threshold_lut_entry_t entries[COLOR_THRESHOLD_LUT_CACHE_SIZE];
+} color_threshold_lut_cache_t;
+
+static pthread_key_t color_threshold_lut_key;
+static pthread_once_t color_threshold_lut_once = PTHREAD_ONCE_INIT;
+
+static void color_threshold_lut_key_init() {
+    pthread_key_create(&color_threshold_lut_key, xfree);
+}
+
+static bool color_threshold_equal(const color_thresholds_list_lnk_data_t *a, const color_thresholds_list_lnk_data_t *b) {
+    return (a->LMin == b->LMin) && (a->LMax == b->LMax)
+        && (a->AMin == b->AMin) && (a->AMax == b->AMax)
+        && (a->BMin == b->BMin) && (a->BMax == b->BMax);
+}
+
+// Returned table stays valid until COLOR_THRESHOLD_LUT_CACHE_SIZE other thresholds are compiled on the same thread.
+// Returns NULL without IMLIB_ENABLE_LAB_LUT, COLOR_THRESHOLD_LUT_RGB888 then uses the per-pixel path.
+const uint32_t *imlib_compile_color_threshold(const color_thresholds_list_lnk_data_t *threshold, bool invert) {
+#ifndef IMLIB_ENABLE_LAB_LUT
+    (void) threshold;
+    (void) invert;
+    return NULL;
+#else
+    pthread_once(&color_threshold_lut_once, color_threshold_lut_key_init);
+    color_threshold_lut_cache_t *cache = pthread_getspecific(color_threshold_lut_key);
+    if (!cache) {
+        cache = xalloc0(sizeof(color_threshold_lut_cache_t));
+        pthread_setspecific(color_threshold_lut_key, cache);
+    }
+
+    cache->tick += 1;
+    color_threshold_lut_entry_t *victim = &cache->entries[0];
+    for (int i = 0; i < COLOR_THRESHOLD_LUT_CACHE_SIZE; i++) {
+        color_threshold_lut_entry_t *e = &cache->entries[i];
+        if (e->valid && (e->invert == invert) && color_threshold_equal(&e->threshold, threshold)) {
+            e->last_used = cache->tick;
+            return e->bits;
+        }
+        if ((!e->valid) || (victim->valid && (e->last_used < victim->last_used))) {
+            victim = e;
+        }
+    }
+
+    // Every RGB565 color maps back to itself through COLOR_R8_G8_B8_TO_RGB565,
+    // so evaluating the original macro on it gives the reference result.
+    for (int i = 0; i < 65536; i += 32) {
+        uint32_t word = 0;
+        for (int j = 0; j < 32; j++) {
+            int c = i + j;
+            pixel_rgb_t pixel = COLOR_R8_G8_B8_TO_RGB888((c >> 8) & 0xF8, (c >> 3) & 0xFC, (c << 3) & 0xF8);
+            word |= ((uint32_t) COLOR_THRESHOLD_RGB888(pixel, threshold, invert)) << j;
+        }
+        victim->bits[i >> 5] = word;
+    }
+    victim->threshold = *threshold;
+    victim->invert = invert;
+    victim->valid = true;
+    victim->last_used = cache->tick;
+    return victim->bits;
+#endif
+}
+
+// ORs the threshold result of n pixels into a binary image row starting at bit 0.
+// Bits are gathered into a register and stored a word at a time.
+void imlib_color_threshold_row_rgb888(const uint32_t *lut, const color_thresholds_list_lnk_data_t *threshold, bool invert,
+                                      const pixel_rgb_t *row, int n, uint32_t *bits) {
+    int x = 0;
+    for (; (x + 32) <= n; x += 32) {
+        uint32_t word = 0;
+        for (int i = 0; i < 32; i++) {
+            word |= COLOR_THRESHOLD_LUT_RGB888(lut, row[x + i], threshold, invert) << i;
+        }
+        bits[x >> 5] |= word;
+    }
+    if (x < n) {
+        uint32_t word = 0;
+        for (int i = 0; x + i < n; i++) {
+            word |= COLOR_THRESHOLD_LUT_RGB888(lut, row[x + i], threshold, invert) << i;
+        }
+        bits[x >> 5] |= word;
+    }
+}
 ////////////////////////////////////////////////////////////////////////////////
 
 #if defined(IMLIB_ENABLE_IMAGE_FILE_IO)
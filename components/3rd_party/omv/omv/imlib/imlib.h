@@ -198,6 +198,36 @@ color_thresholds_list_lnk_data_t;
     (_threshold->AMin <= _a) && (_a <= _threshold->AMax) &&             \
     (_threshold->BMin <= _b) && (_b <= _threshold->BMax)) ^ _invert;    \
 })
+
+// Compiled color threshold, one bit per RGB565 color, see imlib_compile_color_threshold().
+// With IMLIB_ENABLE_LAB_LUT, RGB888 pixels are quantized to RGB565 before the LAB lookup anyway,
+// so a probe gives exactly the same result as COLOR_THRESHOLD_RGB888 with the threshold and invert
+// compiled in. Without it LAB is computed from all 8 bits of each channel, which a RGB565 table
+// can't reproduce at boundary values, so COLOR_THRESHOLD_LUT_RGB888 falls back to the per-pixel path.
+#define COLOR_THRESHOLD_LUT_WORDS   (65536 / 32)
+#define COLOR_THRESHOLD_LUT_CACHE_SIZE  8
+
+#define COLOR_THRESHOLD_LUT_RGB565(lut, pixel)                         \
+    ({                                                                  \
+        uint32_t _i = (pixel);                                          \
+        ((lut)[_i >> 5] >> (_i & 0x1F)) & 1;                            \
+    })
+
+#ifdef IMLIB_ENABLE_LAB_LUT
+#define COLOR_THRESHOLD_LUT_RGB888(lut, pixel, threshold, invert)      \
+    ({                                                                  \
+        __typeof__ (pixel) _p = (pixel);                                \
+        (void) (threshold);                                             \
+        (void) (invert);                                                \
+        COLOR_THRESHOLD_LUT_RGB565(lut, COLOR_R8_G8_B8_TO_RGB565(COLOR_RGB888_TO_R8(_p), COLOR_RGB888_TO_G8(_p), COLOR_RGB888_TO_B8(_p))); \
+    })
+#else
+#define COLOR_THRESHOLD_LUT_RGB888(lut, pixel, threshold, invert)      \
+    ({                                                                  \
+        (void) (lut);                                                   \
+        COLOR_THRESHOLD_RGB888(pixel, threshold, invert);               \
+    })
+#endif
 #define COLOR_BOUND_BINARY(pixel0, pixel1, threshold)    \
     ({                                                   \
         __typeof__ (pixel0) _pixel0 = (pixel0);          \
@@ -1275,6 +1305,9 @@ uint16_t imlib_lab_to_rgb(uint8_t l, int8_t a, int8_t b);
 uint16_t imlib_yuv_to_rgb(uint8_t y, int8_t u, int8_t v);
 pixel_rgb_t imlib_yuv_to_rgb888(uint8_t y, int8_t u, int8_t v);
 pixel_rgb_t imlib_lab_to_rgb888(uint8_t l, int8_t a, int8_t b);
+const uint32_t *imlib_compile_color_threshold(const color_thresholds_list_lnk_data_t *threshold, bool invert);
+void imlib_color_threshold_row_rgb888(const uint32_t *lut, const color_thresholds_list_lnk_data_t *threshold, bool invert,
+                                      const pixel_rgb_t *row, int n, uint32_t *bits);
 
 /* Image file functions */
 // void ppm_read_geometry(FIL *fp, image_t *img, const char *path, ppm_read_settings_t *rs);
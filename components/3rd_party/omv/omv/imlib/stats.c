@@ -455,12 +455,13 @@ void imlib_get_histogram(histogram_t *out, image_t *ptr, rectangle_t *roi, list_
                     for (list_lnk_t *it = iterator_start_from_head(thresholds); it; it = iterator_next(it)) {
                         color_thresholds_list_lnk_data_t lnk_data;
                         iterator_get(thresholds, it, &lnk_data);
+                        const uint32_t *lut = imlib_compile_color_threshold(&lnk_data, invert);
 
                         for (int y = roi->y, yy = roi->y + roi->h; y < yy; y++) {
                             pixel_rgb_t *row_ptr = IMAGE_COMPUTE_RGB888_PIXEL_ROW_PTR(ptr, y);
                             for (int x = roi->x, xx = roi->x + roi->w; x < xx; x++) {
                                 pixel_rgb_t pixel = IMAGE_GET_RGB888_PIXEL_FAST(row_ptr, x);
-                                if (COLOR_THRESHOLD_RGB888(pixel, &lnk_data, invert)) {
+                                if (COLOR_THRESHOLD_LUT_RGB888(lut, pixel, &lnk_data, invert)) {
                                     ((uint32_t *) out->LBins)[fast_roundf((COLOR_RGB888_TO_L(pixel) - COLOR_L_MIN) * l_mult)]++; // needs to be roundf
                                     ((uint32_t *) out->ABins)[fast_roundf((COLOR_RGB888_TO_A(pixel) - COLOR_A_MIN) * a_mult)]++; // needs to be roundf
                                     ((uint32_t *) out->BBins)[fast_roundf((COLOR_RGB888_TO_B(pixel) - COLOR_B_MIN) * b_mult)]++; // needs to be roundf
@@ -473,6 +474,7 @@ void imlib_get_histogram(histogram_t *out, image_t *ptr, rectangle_t *roi, list_
                     for (list_lnk_t *it = iterator_start_from_head(thresholds); it; it = iterator_next(it)) {
                         color_thresholds_list_lnk_data_t lnk_data;
                         iterator_get(thresholds, it, &lnk_data);
+                        const uint32_t *lut = imlib_compile_color_threshold(&lnk_data, invert);
 
                         for (int y = roi->y, yy = roi->y + roi->h; y < yy; y++) {
                             pixel_rgb_t *row_ptr = IMAGE_COMPUTE_RGB888_PIXEL_ROW_PTR(ptr, y), *other_row_ptr = IMAGE_COMPUTE_RGB888_PIXEL_ROW_PTR(other, y);
@@ -482,7 +484,7 @@ void imlib_get_histogram(histogram_t *out, image_t *ptr, rectangle_t *roi, list_
                                 int g = abs(COLOR_RGB888_TO_G8(pixel) - COLOR_RGB888_TO_G8(other_pixel));
                                 int b = abs(COLOR_RGB888_TO_B8(pixel) - COLOR_RGB888_TO_B8(other_pixel));
                                 pixel = COLOR_R8_G8_B8_TO_RGB888(r, g, b);
-                                if (COLOR_THRESHOLD_RGB888(pixel, &lnk_data, invert)) {
+                                if (COLOR_THRESHOLD_LUT_RGB888(lut, pixel, &lnk_data, invert)) {
                                     ((uint32_t *) out->LBins)[fast_roundf((COLOR_RGB888_TO_L(pixel) - COLOR_L_MIN) * l_mult)]++; // needs to be roundf
                                     ((uint32_t *) out->ABins)[fast_roundf((COLOR_RGB888_TO_A(pixel) - COLOR_A_MIN) * a_mult)]++; // needs to be roundf
                                     ((uint32_t *) out->BBins)[fast_roundf((COLOR_RGB888_TO_B(pixel) - COLOR_B_MIN) * b_mult)]++; // needs to be roundf
@@ -1173,10 +1175,11 @@ bool imlib_get_regression(find_lines_list_lnk_data_t *out,
                     break;
                 }
                 case PIXFORMAT_RGB888: {
+                    const uint32_t *lut = imlib_compile_color_threshold(&lnk_data, invert);
                     for (int y = roi->y, yy = roi->y + roi->h; y < yy; y += y_stride) {
                         pixel_rgb_t *row_ptr = IMAGE_COMPUTE_RGB888_PIXEL_ROW_PTR(ptr, y);
                         for (int x = roi->x + (y % x_stride), xx = roi->x + roi->w; x < xx; x += x_stride) {
-                            if (COLOR_THRESHOLD_RGB888(IMAGE_GET_RGB888_PIXEL_FAST(row_ptr, x), &lnk_data, invert)) {
+                            if (COLOR_THRESHOLD_LUT_RGB888(lut, IMAGE_GET_RGB888_PIXEL_FAST(row_ptr, x), &lnk_data, invert)) {
                                 blob_x1 = IM_MIN(blob_x1, x);
                                 blob_y1 = IM_MIN(blob_y1, y);
                                 blob_x2 = IM_MAX(blob_x2, x);
@@ -1358,10 +1361,11 @@ bool imlib_get_regression(find_lines_list_lnk_data_t *out,
                         break;
                     }
                     case PIXFORMAT_RGB888: {
+                        const uint32_t *lut = imlib_compile_color_threshold(&lnk_data, invert);
                         for (int y = roi->y, yy = roi->y + roi->h; y < yy; y += y_stride) {
                             pixel_rgb_t *row_ptr = IMAGE_COMPUTE_RGB888_PIXEL_ROW_PTR(ptr, y);
                             for (int x = roi->x + (y % x_stride), xx = roi->x + roi->w; x < xx; x += x_stride) {
-                                if (COLOR_THRESHOLD_RGB888(IMAGE_GET_RGB888_PIXEL_FAST(row_ptr, x), &lnk_data, invert)) {
+                                if (COLOR_THRESHOLD_LUT_RGB888(lut, IMAGE_GET_RGB888_PIXEL_FAST(row_ptr, x), &lnk_data, invert)) {
                                     blob_x1 = IM_MIN(blob_x1, x);
                                     blob_y1 = IM_MIN(blob_y1, y);
                                     blob_x2 = IM_MAX(blob_x2, x);
@@ -160,13 +160,53 @@ namespace maix::app
 
     /**
      * Get APP info list.
+     * APP info file is parsed only once and reparsed when it changed, so it's cheap to call frequently.
      * @param ignore_launcher if true, ignore launcher APP. default false.
      * @param ignore_app_store if true, ignore app store APP. default false.
-     * @return APP info list. APP_Info object list.
+     * @return APP info list. APP_Info object list, reused and changed when file reparsed,
+     *         use copy_apps_info if other threads may call this function meanwhile.
      * @maixpy maix.app.get_apps_info
     */
     vector<app::APP_Info> &get_apps_info(bool ignore_launcher = false, bool ignore_app_store = false);
 
+    /**
+     * Get a copy of APP info list, copied in the same lock as reload, safe to use while other threads reload.
+     * @param ignore_launcher the same as get_apps_info.
+     * @param ignore_app_store the same as get_apps_info.
+     * @return APP info list.
+     * @maixcdk maix.app.copy_apps_info
+    */
+    vector<app::APP_Info> copy_apps_info(bool ignore_launcher = false, bool ignore_app_store = false);
+
+    /**
+     * Get APP count of APP info list, locked with reload, no list copy.
+     * @param ignore_launcher the same as get_apps_info.
+     * @param ignore_app_store the same as get_apps_info.
+     * @return APP count.
+     * @maixcdk maix.app.apps_count
+    */
+    int apps_count(bool ignore_launcher = false, bool ignore_app_store = false);
+
+    /**
+     * Get a copy of one APP info by index, locked with reload.
+     * @param idx index of get_apps_info(ignore_launcher, ignore_app_store) list.
+     * @param ignore_launcher the same as get_apps_info.
+     * @param ignore_app_store the same as get_apps_info.
+     * @return app.APP_Info type, throw err::Exception with err::ERR_ARGS if idx out of range.
+     * @maixcdk maix.app.get_app_info
+    */
+    app::APP_Info get_app_info(int idx, bool ignore_launcher = false, bool ignore_app_store = false);
+
+    /**
+     * Find APP index in APP info list by app id.
+     * @param app_id APP ID.
+     * @param ignore_launcher the same as get_apps_info.
+     * @param ignore_app_store the same as get_apps_info.
+     * @return index of get_apps_info(ignore_launcher, ignore_app_store) list, -1 if not found.
+     * @maixpy maix.app.find_app
+    */
+    int find_app(const std::string &app_id, bool ignore_launcher = false, bool ignore_app_store = false);
+
     /**
      * Get app info by app id.
      * @return app.APP_Info type.
@@ -23,6 +23,7 @@
 #include "maix_thread.hpp"
 #include "maix_time.hpp"
 #include "maix_tensor.hpp"
+#include "maix_tensor_view.hpp"
 #include "maix_i18n.hpp"
 #include "maix_log.hpp"
 #include "maix_comm_base.hpp"
@@ -30,4 +31,5 @@
 #include "maix_app.hpp"
 #include "maix_util.hpp"
 #include "maix_sys.hpp"
+#include "maix_sys_telemetry.hpp"
 
@@ -415,5 +415,163 @@ namespace maix
         */
         int encode(uint8_t *out_buff, int out_buff_len, uint8_t cmd, uint8_t flags, uint8_t *body, int body_len, uint8_t code = 0xFF, const uint8_t version = VERSION);
 
+        /**
+         * @brief Find a whole frame in stream data, only check header and length, CRC is checked by decoder.
+         *        Used by transports which need frame boundaries, e.g. to route frames of many peers.
+         * @param data stream data
+         * @param len data length
+         * @param start output, offset of frame or of the first byte maybe a header, bytes before it can be dropped.
+         * @param max_len max frame length, frames claim longer are treated as invalid header.
+         * @param header protocol header
+         * @return frame length from start if a whole frame found, else 0.
+         * @maixcdk maix.protocol.find_frame
+        */
+        int find_frame(const uint8_t *data, int len, int *start, int max_len = 65536, uint32_t header = HEADER);
+
+        /**
+         * @brief Part of message body for scatter/gather encoding, message body is all parts concatenated in order.
+         * @maixcdk maix.protocol.BodyPart
+        */
+        struct BodyPart
+        {
+            const uint8_t *data;
+            int len;
+        };
+
+        /**
+         * @brief CRC16-IBM of more data
+         * @param crc CRC16-IBM of previous data, 0 for the first data.
+         * @param data data
+         * @param len data length
+         * @return CRC16-IBM value of previous data and this data.
+         * @maixcdk maix.protocol.crc16_IBM_update
+        */
+        uint16_t crc16_IBM_update(uint16_t crc, const uint8_t *data, size_t len);
+
+        /**
+         * @brief Encoded length of message
+         * @param body_len message body length
+         * @param code error code, only for error message, the same as encode.
+         * @return encoded data length
+         * @maixcdk maix.protocol.encoded_len
+        */
+        static inline int encoded_len(int body_len, uint8_t code = 0xFF)
+        {
+            return body_len + (code != 0xFF ? 13 : 12);
+        }
+
+        /**
+         * @brief Encode message to buffer, body is gathered from parts, no intermediate copy.
+         * @param out_buff output buffer, no alignment required.
+         * @param out_buff_len output buffer length
+         * @param cmd CMD value
+         * @param flags FLAGS value, @see maix.protocol.FLAGS
+         * @param parts message body parts, can be null if num is 0.
+         * @param num number of parts
+         * @param code error code, only for error message, that is FLAGS.FLAG_ERR in flags
+         * @param version protocol version
+         * @return encoded data length, if < 0, means error, and the error code is -err.Err
+         * @maixcdk maix.protocol.encode_parts
+        */
+        int encode_parts(uint8_t *out_buff, int out_buff_len, uint8_t cmd, uint8_t flags, const BodyPart *parts, int num, uint8_t code = 0xFF, const uint8_t version = VERSION);
+
+        /**
+         * @brief Policy of TxRing::push when ring is full
+         * @maixpy maix.protocol.TxPolicy
+        */
+        enum TxPolicy
+        {
+            TX_BLOCK = 0,    // wait until there is space or timeout
+            TX_DROP_NEW,     // drop the new message
+            TX_DROP_OLD,     // drop oldest queued messages until there is space
+        };
+
+        /**
+         * @brief Bounded queue of encoded messages.
+         *        Messages are encoded directly into a preallocated ring buffer, a message never wraps,
+         *        so consumer can take many queued messages at once and send them in one write.
+         *        Thread safe, for many producers and one consumer.
+         * @maixcdk maix.protocol.TxRing
+        */
+        class TxRing
+        {
+        public:
+            /**
+             * @brief Construct a new TxRing object
+             * @param size ring buffer size in bytes, max encoded length of one message is size / 2.
+             * @maixcdk maix.protocol.TxRing.TxRing
+            */
+            TxRing(int size = 8192);
+            ~TxRing();
+
+            /**
+             * @brief Encode message into ring
+             * @param cmd CMD value
+             * @param flags FLAGS value
+             * @param parts message body parts
+             * @param num number of parts
+             * @param code error code, only for error message, the same as encode.
+             * @param policy what to do if ring is full
+             * @param timeout max wait time in ms for TX_BLOCK, -1 means wait forever.
+             * @return err::ERR_NONE if queued, err::ERR_BUFF_FULL if dropped, err::ERR_ARGS if message too large,
+             *         err::ERR_NOT_READY if ring closed.
+             * @maixcdk maix.protocol.TxRing.push
+            */
+            err::Err push(uint8_t cmd, uint8_t flags, const BodyPart *parts, int num, uint8_t code = 0xFF,
+                          protocol::TxPolicy policy = protocol::TX_BLOCK, int timeout = -1);
+
+            /**
+             * @brief Take queued messages, as many whole messages as out_buff can hold.
+             * @param out_buff output buffer, should not smaller than size() / 2.
+             * @param out_buff_len output buffer length
+             * @param timeout max wait time in ms if ring is empty, -1 means wait forever, 0 means not wait.
+             * @return data length taken, 0 if no data or ring closed and empty,
+             *         -err::ERR_ARGS if out_buff can not hold the oldest message.
+             * @maixcdk maix.protocol.TxRing.pop
+            */
+            int pop(uint8_t *out_buff, int out_buff_len, int timeout = -1);
+
+            /**
+             * @brief Tell ring data taken by last pop is sent, wait_empty waits for it.
+             * @maixcdk maix.protocol.TxRing.done
+            */
+            void done();
+
+            /**
+             * @brief Wait until ring is empty and data taken by last pop is sent(done called).
+             * @param timeout max wait time in ms, -1 means wait forever.
+             * @return true if empty
+             * @maixcdk maix.protocol.TxRing.wait_empty
+            */
+            bool wait_empty(int timeout = -1);
+
+            /**
+             * @brief Wake up all waiting push and pop, push fails after close, pop still takes remaining data.
+             * @maixcdk maix.protocol.TxRing.close
+            */
+            void close();
+
+            /**
+             * @brief Ring buffer size in bytes
+             * @maixcdk maix.protocol.TxRing.size
+            */
+            int size();
+
+            /**
+             * @brief Queued data length in bytes
+             * @maixcdk maix.protocol.TxRing.used
+            */
+            int used();
+
+            /**
+             * @brief Number of messages dropped by TX_DROP_NEW, TX_DROP_OLD and TX_BLOCK timeout
+             * @maixcdk maix.protocol.TxRing.dropped
+            */
+            uint64_t dropped();
+
+        private:
+            void *_data;
+        };
+
     } // namespace protocol
 } // namespace maix
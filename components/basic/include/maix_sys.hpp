@@ -136,7 +136,8 @@ namespace maix::sys
     std::map<std::string, float> cpu_temp();
 
     /**
-     * Get CPU usage
+     * Get CPU usage since last call, the first call returns usage since boot.
+     * For periodic monitoring, sys.Telemetry (MaixCDK) samples in background and is cheaper.
      * @return CPU usage, dict type, e.g. {"cpu": 50.0, "cpu0": 50, "cpu1": 50}
      * @maixpy maix.sys.cpu_usage
      */
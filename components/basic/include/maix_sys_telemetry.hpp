@@ -0,0 +1,124 @@
+/**
+ * @author neucrack@sipeed
+ * @copyright Sipeed Ltd 2024-
+ * @license Apache 2.0
+ * @update 2024.11.20: Add telemetry sampler.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include "maix_err.hpp"
+#include "maix_thread.hpp"
+
+namespace maix::sys
+{
+    /**
+     * CPU usage of one thread of current process
+     * @maixcdk maix.sys.ThreadUsage
+     */
+    struct ThreadUsage
+    {
+        int tid;
+        char name[16];
+        float usage;        // percent of one core in the window, 0 ~ 100
+    };
+
+    /**
+     * System telemetry snapshot, plain data, can be copied freely.
+     * Values not supported by the platform are 0, cpu_temp is -273.15 if not supported.
+     * @maixcdk maix.sys.TelemetrySnapshot
+     */
+    struct TelemetrySnapshot
+    {
+        static const int MAX_CPU = 8;
+        static const int MAX_THREADS = 32;
+
+        uint32_t seq;                       // sample sequence, starts from 1, 0 means no sample yet
+        uint64_t timestamp_us;              // time.ticks_us() of this sample
+        uint32_t window_ms;                 // actual time window of usage values
+
+        int cpu_num;
+        float cpu_usage;                    // all cores usage, percent
+        float cpu_core_usage[MAX_CPU];      // usage of each core, percent
+        uint64_t cpu_freq[MAX_CPU];         // frequency of each core, Hz
+        float cpu_temp;                     // degree
+
+        uint64_t mem_total;                 // Byte
+        uint64_t mem_used;                  // Byte, total - available
+        uint64_t mem_hw_total;              // Byte, see sys.memory_info
+
+        float process_usage;                // current process usage, percent of one core
+        int thread_num;                     // valid items of threads, at most MAX_THREADS
+        ThreadUsage threads[MAX_THREADS];
+    };
+
+    /**
+     * Background system telemetry sampler.
+     * Keep /proc and /sys files opened and sample them on a timer thread,
+     * usage values are deltas over the recent time window rather than since boot.
+     * snapshot() is lock free, so it's cheap for high frequency polling like watchdog.
+     * @maixcdk maix.sys.Telemetry
+     */
+    class Telemetry
+    {
+    public:
+        /**
+         * Telemetry constructor, will not start sample thread, call start() or sample() manually.
+         * @param interval_ms sample interval of background thread.
+         * @param window_ms usage time window, rounded to multiple of interval_ms, at most 63 intervals.
+         * @param threads sample per thread usage of current process or not.
+         * @maixcdk maix.sys.Telemetry.Telemetry
+         */
+        Telemetry(int interval_ms = 100, int window_ms = 1000, bool threads = true);
+        ~Telemetry();
+
+        /**
+         * Start background sample thread.
+         * @return err::Err type
+         * @maixcdk maix.sys.Telemetry.start
+         */
+        err::Err start();
+
+        /**
+         * Stop background sample thread.
+         * @maixcdk maix.sys.Telemetry.stop
+         */
+        void stop();
+
+        /**
+         * Sample once in caller's thread, don't call it when background thread started.
+         * @return err::Err type
+         * @maixcdk maix.sys.Telemetry.sample
+         */
+        err::Err sample();
+
+        /**
+         * Get latest snapshot, lock free, can be called from any thread.
+         * @param[out] out snapshot.
+         * @return false if no sample yet.
+         * @maixcdk maix.sys.Telemetry.snapshot
+         */
+        bool snapshot(TelemetrySnapshot &out) const;
+
+    private:
+        void *_data;
+        int _interval_ms;
+        thread::Thread *_thread;
+        std::atomic<bool> _exit;
+        // seqlock, odd value means writing
+        std::atomic<uint32_t> _seq;
+        TelemetrySnapshot _snapshot;
+
+        static void _process(void *args);
+        void _publish(const TelemetrySnapshot &s);
+    };
+
+    /**
+     * Process wide telemetry sampler, started on first call.
+     * @return Telemetry object, sample every 100ms with 1s window.
+     * @maixcdk maix.sys.telemetry
+     */
+    Telemetry &telemetry();
+} // namespace maix::sys
@@ -352,60 +352,104 @@ namespace maix
             */
             std::tuple<tensor::Tensor*, std::vector<int>*> topk(int k)
             {
-                if(k > size_int())
+                tensor::Tensor *value = new tensor::Tensor({k < 0 ? 0 : k}, _dtype);
+                std::vector<int> *index = new std::vector<int>(k < 0 ? 0 : k);
+                try
                 {
-                    log::error("k > tensor size\n");
-                    throw err::Exception(err::ERR_ARGS);
+                    topk(k, index->data());
+                }
+                catch(...)
+                {
+                    delete value;
+                    delete index;
+                    throw;
                 }
 
-                tensor::Tensor *value = new tensor::Tensor({k}, _dtype);
-                std::vector<int> *index = new std::vector<int>(k);
-
-                #define SORT_TOP_K(type) do{\
+                #define COPY_TOP_K(type) do{\
                     type *data = (type *)_data;\
                     type *value_data = (type *)value->data();\
-                    std::vector<int> idx(size_int());\
-                    std::iota(idx.begin(), idx.end(), 0);\
-                    std::sort(idx.begin(), idx.end(), [&data](int idx_0, int idx_1) {return data[idx_0] > data[idx_1];});\
                     for (int i = 0; i < k; i++)\
-                    {\
-                        value_data[i] = data[idx[i]];\
-                        (*index)[i] = idx[i];\
-                    }\
+                        value_data[i] = data[(*index)[i]];\
                 }while(0)
 
                 switch (_dtype)
                 {
                 case tensor::DType::FLOAT32:
-                    SORT_TOP_K(float);
+                    COPY_TOP_K(float);
+                    break;
+                case tensor::DType::FLOAT64:
+                    COPY_TOP_K(double);
+                    break;
+                case tensor::DType::UINT8:
+                    COPY_TOP_K(uint8_t);
+                    break;
+                case tensor::DType::INT8:
+                    COPY_TOP_K(int8_t);
+                    break;
+                case tensor::DType::UINT16:
+                    COPY_TOP_K(uint16_t);
+                    break;
+                case tensor::DType::INT16:
+                    COPY_TOP_K(int16_t);
+                    break;
+                case tensor::DType::UINT32:
+                    COPY_TOP_K(uint32_t);
+                    break;
+                case tensor::DType::INT32:
+                    COPY_TOP_K(int32_t);
+                    break;
+                default:
+                    break;
+                }
+                #undef COPY_TOP_K
+                return std::make_tuple(value, index);
+            }
+
+            /**
+             * TopK index from tensor(flattened) into caller's buffer, no memory allocated.
+             * Uses a k size heap, O(n*log(k)), faster than sort all values when k is small.
+             * @param k top k, k must less than tensor size, wrong k will raise an err::Exception
+             * @param indices output buffer, at least k int, index of max value first, equal values keep the smaller index first.
+             * @maixcdk maix.tensor.Tensor.topk
+            */
+            void topk(int k, int *indices)
+            {
+                if(k > size_int() || k < 0)
+                {
+                    log::error("k > tensor size\n");
+                    throw err::Exception(err::ERR_ARGS);
+                }
+
+                switch (_dtype)
+                {
+                case tensor::DType::FLOAT32:
+                    _get_topk<float>(_data, size_int(), k, indices);
                     break;
                 case tensor::DType::FLOAT64:
-                    SORT_TOP_K(double);
+                    _get_topk<double>(_data, size_int(), k, indices);
                     break;
                 case tensor::DType::UINT8:
-                    SORT_TOP_K(uint8_t);
+                    _get_topk<uint8_t>(_data, size_int(), k, indices);
                     break;
                 case tensor::DType::INT8:
-                    SORT_TOP_K(int8_t);
+                    _get_topk<int8_t>(_data, size_int(), k, indices);
                     break;
                 case tensor::DType::UINT16:
-                    SORT_TOP_K(uint16_t);
+                    _get_topk<uint16_t>(_data, size_int(), k, indices);
                     break;
                 case tensor::DType::INT16:
-                    SORT_TOP_K(int16_t);
+                    _get_topk<int16_t>(_data, size_int(), k, indices);
                     break;
                 case tensor::DType::UINT32:
-                    SORT_TOP_K(uint32_t);
+                    _get_topk<uint32_t>(_data, size_int(), k, indices);
                     break;
                 case tensor::DType::INT32:
-                    SORT_TOP_K(int32_t);
+                    _get_topk<int32_t>(_data, size_int(), k, indices);
                     break;
                 default:
                     log::error("not support dtype %d\n", _dtype);
                     throw err::Exception(err::ERR_NOT_IMPL);
                 }
-                #undef SORT_TOP_K
-                return std::make_tuple(value, index);
             }
 
         private:
@@ -432,6 +476,33 @@ namespace maix
                 return max_index;
             }
 
+            template <typename T>
+            static void _get_topk(void *data, int size, int k, int *indices)
+            {
+                if (k == 0)
+                    return;
+                const T *data_t = (const T *)data;
+                // "a before b" in result order, heap top is the worst one of current top k
+                auto before = [data_t](int a, int b) {
+                    return data_t[a] > data_t[b] || (data_t[a] == data_t[b] && a < b);
+                };
+                for (int i = 0; i < k; i++)
+                {
+                    indices[i] = i;
+                    std::push_heap(indices, indices + i + 1, before);
+                }
+                for (int i = k; i < size; i++)
+                {
+                    if (data_t[i] > data_t[indices[0]])
+                    {
+                        std::pop_heap(indices, indices + k, before);
+                        indices[k - 1] = i;
+                        std::push_heap(indices, indices + k, before);
+                    }
+                }
+                std::sort_heap(indices, indices + k, before);
+            }
+
             static int _get_argmax0(tensor::DType dtype, void *data, int size)
             {
                 int max_idx = -1;
@@ -627,6 +698,112 @@ namespace maix
             std::map<std::string, bool> _auto_delete;
         };
 
+        /**
+         * Integer slots of Tensors, bind tensor names once (e.g. output names when load model),
+         * then get tensors of every forward result by slot index, no string compare or map lookup per frame.
+         * Slots are in key order of Tensors, so results with the same keys always map to the same slots.
+         * @maixcdk maix.tensor.TensorSlots
+        */
+        class TensorSlots
+        {
+        public:
+            /**
+             * Bind names to slots
+             * @param names tensor names, slot order is sorted order of names, same as Tensors iteration order.
+             * @maixcdk maix.tensor.TensorSlots.bind
+            */
+            void bind(const std::vector<std::string> &names)
+            {
+                _names = names;
+                std::sort(_names.begin(), _names.end());
+                _names.erase(std::unique(_names.begin(), _names.end()), _names.end());
+                _tensors.assign(_names.size(), nullptr);
+                _verified = false;
+            }
+
+            /**
+             * Slot index of a name
+             * @return slot index, -1 if not found
+             * @maixcdk maix.tensor.TensorSlots.index
+            */
+            int index(const std::string &name) const
+            {
+                auto it = std::lower_bound(_names.begin(), _names.end(), name);
+                if (it == _names.end() || *it != name)
+                    return -1;
+                return it - _names.begin();
+            }
+
+            /**
+             * Slot index of first name contains sub string
+             * @return slot index, -1 if not found
+             * @maixcdk maix.tensor.TensorSlots.find
+            */
+            int find(const std::string &sub) const
+            {
+                for (size_t i = 0; i < _names.size(); i++)
+                {
+                    if (_names[i].find(sub) != std::string::npos)
+                        return i;
+                }
+                return -1;
+            }
+
+            /**
+             * Name of slot
+             * @maixcdk maix.tensor.TensorSlots.name
+            */
+            const std::string &name(int idx) const
+            {
+                return _names[idx];
+            }
+
+            /**
+             * Number of slots
+             * @maixcdk maix.tensor.TensorSlots.size
+            */
+            size_t size() const
+            {
+                return _names.size();
+            }
+
+            /**
+             * Point slots to tensors of a forward result.
+             * Keys are compared only the first time after bind, then only count is checked.
+             * @param tensors forward result, slots are valid until tensors changed or deleted.
+             * @return false if keys of tensors not match bound names.
+             * @maixcdk maix.tensor.TensorSlots.resolve
+            */
+            bool resolve(tensor::Tensors &tensors)
+            {
+                if (tensors.size() != _names.size())
+                    return false;
+                size_t i = 0;
+                for (auto &item : tensors)
+                {
+                    if (!_verified && item.first != _names[i])
+                        return false;
+                    _tensors[i++] = item.second;
+                }
+                _verified = true;
+                return true;
+            }
+
+            /**
+             * Tensor of slot resolved last time
+             * @maixcdk maix.tensor.TensorSlots.[]
+            */
+            tensor::Tensor *operator[](int idx) const
+            {
+                return _tensors[idx];
+            }
+
+        private:
+            std::vector<std::string> _names;
+            std::vector<tensor::Tensor *> _tensors;
+            bool _verified = false;
+        };
+
 
     } // namespace tensor
 }; // namespace maix
@@ -0,0 +1,289 @@
+/**
+ * @author neucrack@sipeed
+ * @copyright Sipeed Ltd 2023-
+ * @license Apache 2.0
+ * @update 2024.12.3: Add tensor view and conversion kernels.
+ */
+
+#pragma once
+
+#include "maix_tensor.hpp"
+#include <stdint.h>
+#include <vector>
+
+namespace maix::tensor
+{
+    /**
+     * Non-owning strided view of tensor data.
+     * slice, transpose and broadcast_to only change shape, strides and data pointer, no data is copied,
+     * so post processing can read model outputs (e.g. int8) in any layout directly.
+     * The viewed memory must be alive while the view is used.
+     * @maixcdk maix.tensor.TensorView
+     */
+    class TensorView
+    {
+    public:
+        TensorView();
+
+        /**
+         * View of a contiguous tensor
+         * @param t tensor, view shares its data
+         * @maixcdk maix.tensor.TensorView.TensorView
+         */
+        TensorView(tensor::Tensor &t);
+
+        /**
+         * View of raw data
+         * @param data data pointer
+         * @param dtype element data type
+         * @param shape shape
+         * @param strides strides of every axis in elements, can be 0 or negative, empty means contiguous.
+         * @maixcdk maix.tensor.TensorView.TensorView
+         */
+        TensorView(void *data, tensor::DType dtype, const std::vector<int> &shape, const std::vector<int> &strides = std::vector<int>());
+
+        /**
+         * Data pointer of first element
+         * @maixcdk maix.tensor.TensorView.data
+         */
+        void *data() const { return _data; }
+
+        /**
+         * Element data type
+         * @maixcdk maix.tensor.TensorView.dtype
+         */
+        tensor::DType dtype() const { return _dtype; }
+
+        /**
+         * Shape
+         * @maixcdk maix.tensor.TensorView.shape
+         */
+        const std::vector<int> &shape() const { return _shape; }
+
+        /**
+         * Strides of every axis in elements
+         * @maixcdk maix.tensor.TensorView.strides
+         */
+        const std::vector<int> &strides() const { return _strides; }
+
+        /**
+         * Number of axes
+         * @maixcdk maix.tensor.TensorView.ndim
+         */
+        int ndim() const { return (int)_shape.size(); }
+
+        /**
+         * Number of elements
+         * @maixcdk maix.tensor.TensorView.size
+         */
+        int size() const;
+
+        /**
+         * Whether elements are stored contiguously in row major order
+         * @maixcdk maix.tensor.TensorView.is_contiguous
+         */
+        bool is_contiguous() const;
+
+        /**
+         * Slice along an axis, like python [start:end:step]
+         * @param axis axis, negative means from last.
+         * @param start start index, negative means from end.
+         * @param end end index(not included), negative means from end, larger than axis size is clipped.
+         * @param step step, must > 0.
+         * @throw err::Exception if args error.
+         * @maixcdk maix.tensor.TensorView.slice
+         */
+        TensorView slice(int axis, int start, int end, int step = 1) const;
+
+        /**
+         * Permute axes
+         * @param perm new order of axes, e.g. {0, 2, 3, 1} for NCHW to NHWC.
+         * @throw err::Exception if args error.
+         * @maixcdk maix.tensor.TensorView.transpose
+         */
+        TensorView transpose(const std::vector<int> &perm) const;
+
+        /**
+         * Broadcast to a larger shape like numpy, axes of size 1 get stride 0.
+         * @param shape target shape, must have at least ndim() axes.
+         * @throw err::Exception if shape not compatible.
+         * @maixcdk maix.tensor.TensorView.broadcast_to
+         */
+        TensorView broadcast_to(const std::vector<int> &shape) const;
+
+        /**
+         * Reshape, only for contiguous view.
+         * @throw err::Exception if size not match or view not contiguous.
+         * @maixcdk maix.tensor.TensorView.reshape
+         */
+        TensorView reshape(const std::vector<int> &shape) const;
+
+        /**
+         * Pointer of an element
+         * @param index index of every axis
+         * @maixcdk maix.tensor.TensorView.ptr
+         */
+        void *ptr(const std::vector<int> &index) const;
+
+        /**
+         * Reference of an element, T must match dtype.
+         * @param index index of every axis
+         * @maixcdk maix.tensor.TensorView.at
+         */
+        template <typename T>
+        T &at(const std::vector<int> &index) const
+        {
+            return *(T *)ptr(index);
+        }
+
+        /**
+         * Copy elements to a contiguous buffer in row major order, same dtype.
+         * @param out output buffer, at least size() elements.
+         * @maixcdk maix.tensor.TensorView.copy_to
+         */
+        void copy_to(void *out) const;
+
+    private:
+        void *_data;
+        tensor::DType _dtype;
+        std::vector<int> _shape;
+        std::vector<int> _strides;
+    };
+
+    /**
+     * Convert IEEE half float to float
+     * @maixcdk maix.tensor.fp16_to_fp32
+     */
+    static inline float fp16_to_fp32(uint16_t h)
+    {
+        uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+        uint32_t exp = (h >> 10) & 0x1f;
+        uint32_t mant = h & 0x3ff;
+        uint32_t bits;
+        if (exp == 0x1f)                // inf, nan
+            bits = sign | 0x7f800000 | (mant << 13);
+        else if (exp != 0)              // normal
+            bits = sign | ((exp + 112) << 23) | (mant << 13);
+        else if (mant == 0)             // zero
+            bits = sign;
+        else                            // subnormal, normalize
+        {
+            exp = 113;
+            while (!(mant & 0x400))
+            {
+                mant <<= 1;
+                --exp;
+            }
+            bits = sign | (exp << 23) | ((mant & 0x3ff) << 13);
+        }
+        float f;
+        memcpy(&f, &bits, 4);
+        return f;
+    }
+
+    /**
+     * Convert float to IEEE half float, round to nearest even
+     * @maixcdk maix.tensor.fp32_to_fp16
+     */
+    static inline uint16_t fp32_to_fp16(float f)
+    {
+        uint32_t bits;
+        memcpy(&bits, &f, 4);
+        uint16_t sign = (bits >> 16) & 0x8000;
+        uint32_t abs = bits & 0x7fffffff;
+        if (abs >= 0x7f800000)          // inf, nan
+            return sign | 0x7c00 | (abs > 0x7f800000 ? 0x200 : 0);
+        if (abs >= 0x477ff000)          // overflow after rounding
+            return sign | 0x7c00;
+        if (abs < 0x38800000)           // subnormal or zero
+        {
+            if (abs < 0x33000000)
+                return sign;
+            uint32_t mant = (abs & 0x7fffff) | 0x800000;
+            int shift = 126 - (abs >> 23);
+            uint32_t half = mant >> shift;
+            uint32_t rem = mant & ((1u << shift) - 1);
+            uint32_t mid = 1u << (shift - 1);
+            if (rem > mid || (rem == mid && (half & 1)))
+                ++half;
+            return sign | half;
+        }
+        uint32_t half = ((abs >> 13) - (112 << 10));
+        uint32_t rem = abs & 0x1fff;
+        if (rem > 0x1000 || (rem == 0x1000 && (half & 1)))
+            ++half;
+        return sign | half;
+    }
+
+    /**
+     * Convert view to float, out = (value - zero_point) * scale,
+     * dequantize int8/uint8 outputs or convert float16, float32 is copied with default args.
+     * @param in input view, any layout, dtype UINT8, INT8, UINT16, INT16, INT32, FLOAT16, FLOAT32.
+     * @param out output buffer, in.size() float in row major order of in.shape().
+     * @param scale quantization scale.
+     * @param zero_point quantization zero point.
+     * @throw err::Exception if dtype not supported.
+     * @maixcdk maix.tensor.to_float
+     */
+    void to_float(const TensorView &in, float *out, float scale = 1.0f, int zero_point = 0);
+
+    /**
+     * Affine quantize, out = round(in / scale) + zero_point, saturated to range of dtype.
+     * @param in input float data.
+     * @param num number of elements.
+     * @param out output buffer, num elements of dtype.
+     * @param dtype output dtype, UINT8, INT8, UINT16, INT16, INT32 or FLOAT16(scale and zero_point are also applied).
+     * @param scale quantization scale, must not be 0.
+     * @param zero_point quantization zero point.
+     * @throw err::Exception if args error.
+     * @maixcdk maix.tensor.quantize
+     */
+    void quantize(const float *in, int num, void *out, tensor::DType dtype, float scale, int zero_point = 0);
+
+    /**
+     * Sigmoid of every element, input dequantized as to_float.
+     * @param in input view, any layout.
+     * @param out output buffer, in.size() float in row major order, can be the same memory as contiguous float32 in.
+     * @param scale quantization scale of in.
+     * @param zero_point quantization zero point of in.
+     * @maixcdk maix.tensor.sigmoid
+     */
+    void sigmoid(const TensorView &in, float *out, float scale = 1.0f, int zero_point = 0);
+
+    /**
+     * Softmax along an axis, input dequantized as to_float.
+     * @param in input view, any layout.
+     * @param axis axis to normalize, negative means from last.
+     * @param out output buffer, in.size() float in row major order, can be the same memory as contiguous float32 in.
+     * @param scale quantization scale of in.
+     * @param zero_point quantization zero point of in.
+     * @maixcdk maix.tensor.softmax
+     */
+    void softmax(const TensorView &in, int axis, float *out, float scale = 1.0f, int zero_point = 0);
+
+    /**
+     * Transpose into a contiguous buffer, same as in.transpose(perm).copy_to(out).
+     * @param in input view.
+     * @param perm new order of axes.
+     * @param out output buffer, in.size() elements of in.dtype().
+     * @maixcdk maix.tensor.transpose
+     */
+    void transpose(const TensorView &in, const std::vector<int> &perm, void *out);
+
+    /**
+     * NCHW to NHWC into a contiguous buffer
+     * @param in 4 axes input view.
+     * @param out output buffer, in.size() elements of in.dtype().
+     * @maixcdk maix.tensor.nchw_to_nhwc
+     */
+    void nchw_to_nhwc(const TensorView &in, void *out);
+
+    /**
+     * NHWC to NCHW into a contiguous buffer
+     * @param in 4 axes input view.
+     * @param out output buffer, in.size() elements of in.dtype().
+     * @maixcdk maix.tensor.nhwc_to_nchw
+     */
+    void nhwc_to_nchw(const TensorView &in, void *out);
+
+} // namespace maix::tensor
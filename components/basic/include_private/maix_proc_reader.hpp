@@ -0,0 +1,253 @@
+/**
+ * Lightweight /proc and /sys readers, keep file opened and parse without iostream.
+ * @author neucrack@sipeed
+ * @copyright Sipeed Ltd 2024-
+ * @license Apache 2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <vector>
+
+namespace maix::sys::proc
+{
+    /**
+     * Opened proc/sysfs file, read() re-reads whole content from offset 0 by pread,
+     * buffer grows when content is larger than it.
+     */
+    class File
+    {
+    public:
+        File() : _fd(-1), _len(0) {}
+        ~File() { close(); }
+        File(const File &) = delete;
+        File &operator=(const File &) = delete;
+
+        bool open(const char *path, size_t buf_size = 1024)
+        {
+            close();
+            _fd = ::open(path, O_RDONLY | O_CLOEXEC);
+            if (_buf.size() < buf_size)
+                _buf.resize(buf_size);
+            return _fd >= 0;
+        }
+
+        void close()
+        {
+            if (_fd >= 0)
+                ::close(_fd);
+            _fd = -1;
+            _len = 0;
+        }
+
+        bool is_open() const { return _fd >= 0; }
+
+        /**
+         * Read whole file, content is null terminated.
+         * @return content length, -1 if failed.
+         */
+        ssize_t read()
+        {
+            if (_fd < 0)
+                return -1;
+            while (true)
+            {
+                ssize_t n = ::pread(_fd, _buf.data(), _buf.size() - 1, 0);
+                if (n < 0)
+                    return -1;
+                if ((size_t)n < _buf.size() - 1)
+                {
+                    _buf[n] = 0;
+                    _len = n;
+                    return n;
+                }
+                // proc files report size 0, can only know it's full by filling the buffer
+                _buf.resize(_buf.size() * 2);
+            }
+        }
+
+        const char *data() const { return _buf.data(); }
+        const char *end() const { return _buf.data() + _len; }
+
+    private:
+        int _fd;
+        size_t _len;
+        std::vector<char> _buf;
+    };
+
+    inline const char *skip_space(const char *p, const char *end)
+    {
+        while (p < end && (*p == ' ' || *p == '\t'))
+            ++p;
+        return p;
+    }
+
+    inline const char *next_line(const char *p, const char *end)
+    {
+        while (p < end && *p != '\n')
+            ++p;
+        return p < end ? p + 1 : end;
+    }
+
+    /**
+     * Parse unsigned decimal, leading spaces skipped.
+     * @return pointer after number, nullptr if no digit.
+     */
+    inline const char *parse_u64(const char *p, const char *end, uint64_t &v)
+    {
+        p = skip_space(p, end);
+        if (p >= end || *p < '0' || *p > '9')
+            return nullptr;
+        uint64_t r = 0;
+        while (p < end && *p >= '0' && *p <= '9')
+            r = r * 10 + (uint64_t)(*p++ - '0');
+        v = r;
+        return p;
+    }
+
+    /**
+     * Parse signed decimal, leading spaces skipped.
+     */
+    inline const char *parse_i64(const char *p, const char *end, int64_t &v)
+    {
+        p = skip_space(p, end);
+        bool neg = p < end && *p == '-';
+        uint64_t u;
+        p = parse_u64(neg ? p + 1 : p, end, u);
+        if (p)
+            v = neg ? -(int64_t)u : (int64_t)u;
+        return p;
+    }
+
+    /**
+     * Find line starts with key.
+     * @return pointer after key, nullptr if not found.
+     */
+    inline const char *find_key(const char *p, const char *end, const char *key)
+    {
+        size_t n = strlen(key);
+        while (p < end)
+        {
+            if ((size_t)(end - p) >= n && memcmp(p, key, n) == 0)
+                return p + n;
+            p = next_line(p, end);
+        }
+        return nullptr;
+    }
+
+    /**
+     * Jiffies of one cpu line in /proc/stat.
+     */
+    struct CpuTimes
+    {
+        uint64_t total;
+        uint64_t idle; // idle + iowait
+    };
+
+    /**
+     * Parse /proc/stat cpu lines.
+     * @param all the first "cpu" line.
+     * @param cores "cpuN" lines, at most max_cores.
+     * @return cores number parsed, -1 if format error.
+     */
+    inline int parse_stat(const char *p, const char *end, CpuTimes &all, CpuTimes *cores, int max_cores)
+    {
+        int n = 0;
+        while (p < end && end - p > 3 && memcmp(p, "cpu", 3) == 0)
+        {
+            p += 3;
+            bool is_core = p < end && *p >= '0' && *p <= '9';
+            uint64_t id = 0;
+            if (is_core)
+                p = parse_u64(p, end, id);
+            // user nice system idle iowait irq softirq steal, guest ones are already counted in user and nice
+            uint64_t v[8] = {0};
+            for (int i = 0; i < 8 && p; ++i)
+            {
+                const char *q = parse_u64(p, end, v[i]);
+                if (!q)
+                    break;
+                p = q;
+            }
+            if (!p)
+                return -1;
+            CpuTimes t;
+            t.idle = v[3] + v[4];
+            t.total = t.idle + v[0] + v[1] + v[2] + v[5] + v[6] + v[7];
+            if (!is_core)
+                all = t;
+            else if (id < (uint64_t)max_cores)
+            {
+                cores[id] = t;
+                if ((int)id + 1 > n)
+                    n = id + 1;
+            }
+            p = next_line(p, end);
+        }
+        return n;
+    }
+
+    /**
+     * Cpu usage between two /proc/stat samples.
+     * Counters of a cpu may go back after it's hotplugged, such interval gives 0.
+     * @return usage in [0, 100].
+     */
+    inline float cpu_usage(const CpuTimes &now, const CpuTimes &old)
+    {
+        if (now.total <= old.total)
+            return 0;
+        uint64_t total = now.total - old.total;
+        uint64_t idle = now.idle >= old.idle ? now.idle - old.idle : 0;
+        return 100.f * (float)(total - (idle > total ? total : idle)) / total;
+    }
+
+    /**
+     * Parse utime + stime of /proc/[pid]/task/[tid]/stat content.
+     * @param name optional, thread name output buffer.
+     * @return true if success.
+     */
+    inline bool parse_task_stat(const char *p, const char *end, uint64_t &ticks, char *name = nullptr, size_t name_size = 0)
+    {
+        // comm may contain spaces and ')', so find the last ')'
+        const char *l = (const char *)memchr(p, '(', end - p);
+        const char *r = end;
+        while (r > p && *(r - 1) != ')')
+            --r;
+        if (!l || r <= l)
+            return false;
+        if (name && name_size > 0)
+        {
+            size_t n = r - 1 - (l + 1);
+            if (n >= name_size)
+                n = name_size - 1;
+            memcpy(name, l + 1, n);
+            name[n] = 0;
+        }
+        // field 3 state is after ')', utime and stime are field 14 and 15
+        p = skip_space(r, end);
+        if (p >= end)
+            return false;
+        ++p;
+        int64_t skip;
+        for (int field = 4; field <= 13; ++field)
+        {
+            p = parse_i64(p, end, skip);
+            if (!p)
+                return false;
+        }
+        uint64_t utime, stime;
+        p = parse_u64(p, end, utime);
+        if (!p)
+            return false;
+        p = parse_u64(p, end, stime);
+        if (!p)
+            return false;
+        ticks = utime + stime;
+        return true;
+    }
+} // namespace maix::sys::proc
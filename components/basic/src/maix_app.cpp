@@ -14,18 +14,283 @@
 #include "math.h"
 #include "inifile.h"
 #include <sys/stat.h>
+#include <sys/inotify.h>
+#include <fcntl.h>
 #include <unistd.h>
+#include <errno.h>
 #include <map>
+#include <unordered_map>
+#include <mutex>
 #include <assert.h>
 
 #define APP_ROOT_PATH "/maixapp"
 namespace maix::app
 {
+    /**
+     * Watch files for changes by inotify on their parent directories, so replacing by rename is also caught.
+     * inotify only tells maybe changed, stat confirms it, so our own writes won't trigger reload.
+     * Fall back to stat every check if inotify not available.
+     */
+    class FileWatcher
+    {
+    public:
+        static FileWatcher &instance()
+        {
+            static FileWatcher watcher;
+            return watcher;
+        }
+
+        int add(const string &path)
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            for (size_t i = 0; i < _items.size(); ++i)
+            {
+                if (_items[i].path == path)
+                    return (int)i;
+            }
+            Item item;
+            item.path = path;
+            size_t pos = path.rfind('/');
+            string dir = pos == string::npos ? "." : (pos == 0 ? "/" : path.substr(0, pos));
+            item.name = pos == string::npos ? path : path.substr(pos + 1);
+            item.wd = -1;
+            item.dirty = true;
+            memset(&item.stamp, 0, sizeof(item.stamp));
+            if (_fd >= 0)
+                item.wd = inotify_add_watch(_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_MOVED_FROM);
+            _items.push_back(item);
+            return (int)_items.size() - 1;
+        }
+
+        /**
+         * Check if file changed since last mark, usually only one nonblocking read syscall.
+         */
+        bool changed(int id)
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            _poll();
+            Item &item = _items[id];
+            if (item.wd >= 0 && !item.dirty)
+                return false;
+            item.dirty = false;
+            Stamp now;
+            _stat(item.path, now);
+            return memcmp(&now, &item.stamp, sizeof(now)) != 0;
+        }
+
+        /**
+         * Record current file state as latest, call after load or write by ourself.
+         */
+        void mark(int id)
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            _poll();
+            Item &item = _items[id];
+            item.dirty = false;
+            _stat(item.path, item.stamp);
+        }
+
+    private:
+        struct Stamp
+        {
+            uint64_t ino;
+            uint64_t size;
+            int64_t mtime_sec;
+            int64_t mtime_nsec;
+        };
+
+        struct Item
+        {
+            string path;
+            string name;
+            int wd;
+            bool dirty;
+            Stamp stamp;
+        };
+
+        FileWatcher()
+        {
+            _fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        }
+
+        ~FileWatcher()
+        {
+            if (_fd >= 0)
+                close(_fd);
+        }
+
+        static void _stat(const string &path, Stamp &stamp)
+        {
+            struct stat st;
+            memset(&stamp, 0, sizeof(stamp));
+            if (stat(path.c_str(), &st) != 0)
+                return;
+            stamp.ino = st.st_ino;
+            stamp.size = st.st_size;
+            stamp.mtime_sec = st.st_mtim.tv_sec;
+            stamp.mtime_nsec = st.st_mtim.tv_nsec;
+        }
+
+        void _poll()
+        {
+            if (_fd < 0)
+                return;
+            alignas(struct inotify_event) char buf[4096];
+            while (true)
+            {
+                ssize_t n = read(_fd, buf, sizeof(buf));
+                if (n <= 0)
+                    break;
+                for (char *p = buf; p < buf + n;)
+                {
+                    struct inotify_event *ev = (struct inotify_event *)p;
+                    for (auto &item : _items)
+                    {
+                        if (ev->mask & IN_Q_OVERFLOW)
+                            item.dirty = true;
+                        else if (item.wd == ev->wd && ev->len > 0 && item.name == ev->name)
+                            item.dirty = true;
+                    }
+                    p += sizeof(struct inotify_event) + ev->len;
+                }
+            }
+        }
+
+        int _fd;
+        std::mutex _lock;
+        std::vector<Item> _items;
+    };
+
+    /**
+     * Cached ini config, lookup by hash index, write by temp file and rename.
+     */
+    class ConfigStore
+    {
+    public:
+        ConfigStore() : _watch_id(-1), _loaded(false), _unsaved(false) {}
+
+        /**
+         * Load config if not loaded, path changed or file changed by others.
+         * @param force_check check file changed even if have unsaved values, unsaved values will be dropped if file changed.
+         */
+        int load(const string &path, bool force_check)
+        {
+            if (_loaded && path == _path)
+            {
+                if (_unsaved && !force_check)
+                    return RET_OK;
+                if (!FileWatcher::instance().changed(_watch_id))
+                    return RET_OK;
+            }
+            if (path != _path)
+            {
+                _path = path;
+                _watch_id = FileWatcher::instance().add(path);
+            }
+            if (!fs::exists(path))
+                _ini.SaveAs(path);
+            // mark before load, changes during loading will be caught next time
+            FileWatcher::instance().mark(_watch_id);
+            int ret = _ini.Load(path);
+            _kv.clear();
+            _loaded = false;
+            _unsaved = false;
+            if (ret != RET_OK)
+                return ret;
+            vector<string> sections;
+            _ini.GetSections(&sections);
+            for (auto &section : sections)
+            {
+                inifile::IniSection *kvs = _ini.getSection(section);
+                if (!kvs)
+                    continue;
+                for (auto it = kvs->begin(); it != kvs->end(); ++it)
+                    _kv[_hash_key(section, it->key)] = it->value;
+            }
+            _loaded = true;
+            return RET_OK;
+        }
+
+        bool loaded()
+        {
+            return _loaded;
+        }
+
+        bool get(const string &item, const string &key, string &value)
+        {
+            auto it = _kv.find(_hash_key(item, key));
+            if (it == _kv.end())
+                return false;
+            value = it->second;
+            return true;
+        }
+
+        int set(const string &item, const string &key, const string &value)
+        {
+            string k = _hash_key(item, key);
+            auto it = _kv.find(k);
+            if (it != _kv.end() && it->second == value && _ini.HasKey(item, key))
+                return RET_OK;
+            int ret = _ini.SetStringValue(item, key, value);
+            if (ret != RET_OK)
+                return ret;
+            // update cache only after ini updated, keep them the same on failure
+            _kv[k] = value;
+            _unsaved = true;
+            return RET_OK;
+        }
+
+        /**
+         * Save unsaved values, write to temp file then rename, so readers never see a half written file.
+         */
+        int save()
+        {
+            if (!_unsaved)
+                return RET_OK;
+            string tmp = _path + ".tmp";
+            int ret = _ini.SaveAs(tmp);
+            if (ret != RET_OK)
+                return ret;
+            int fd = open(tmp.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd >= 0)
+            {
+                fsync(fd);
+                close(fd);
+            }
+            if (rename(tmp.c_str(), _path.c_str()) != 0)
+            {
+                log::error("rename %s failed: %s\n", tmp.c_str(), strerror(errno));
+                unlink(tmp.c_str());
+                return ERR_OPEN_FILE_FAILED;
+            }
+            FileWatcher::instance().mark(_watch_id);
+            _unsaved = false;
+            return RET_OK;
+        }
+
+    private:
+        static string _hash_key(const string &item, const string &key)
+        {
+            string k;
+            k.reserve(item.size() + key.size() + 1);
+            k += item;
+            k += '\n';
+            k += key;
+            return k;
+        }
+
+        inifile::IniFile _ini;
+        std::unordered_map<string, string> _kv;
+        string _path;
+        int _watch_id;
+        bool _loaded;
+        bool _unsaved;
+    };
+
     // cache system config info
-    static inifile::IniFile sys_conf_ini;
-    static inifile::IniFile app_conf_ini;
-    static bool sys_conf_ini_loaded = false;
-    static bool app_conf_ini_loaded = false;
+    static ConfigStore sys_conf;
+    static ConfigStore app_conf;
+    static std::mutex conf_lock;
     static err::Err exit_code = err::ERR_NONE;
     static std::string exit_msg = "";
     static bool should_exit = false;
@@ -88,6 +353,25 @@ namespace maix::app
         return APP_ROOT_PATH "/apps/app.info";
     }
 
+    /**
+     * Parsed app.info, reparsed only when file changed.
+     * lists[i] and index[i] are filtered by i: bit 0 ignore launcher, bit 1 ignore app store.
+     */
+    struct AppRegistry
+    {
+        std::mutex lock;
+        int watch_id = -1;
+        bool loaded = false;
+        vector<APP_Info> lists[4];
+        std::unordered_map<string, int> index[4];
+    };
+
+    static AppRegistry &_app_registry()
+    {
+        static AppRegistry registry;
+        return registry;
+    }
+
     /**
      *
      * app.info file, ini format
@@ -106,31 +390,26 @@ namespace maix::app
      * [app_id2]
      * ...
      */
-    vector<APP_Info> &get_apps_info(bool ignore_launcher, bool ignore_app_store)
+    static void _parse_apps_info(vector<APP_Info> &apps_info)
     {
         int ret = 0;
         int app_num = 0;
         int ini_version = 0;
         vector<string> app_ids;
 
-        // create a vector of APP_Info
-        static vector<APP_Info> apps_info;
-        // clear the vector
-        apps_info.clear();
-
         // read apps info from APP_ROOT_PATH/apps/app.info
         inifile::IniFile ini;
         ret = ini.Load(get_apps_info_path());
         if (ret != RET_OK)
         {
             printf("open app info failed: %d\n", ret);
-            return apps_info;
+            return;
         }
         ret = ini.GetIntValue("basic", "version", &ini_version);
         if (ret != RET_OK)
         {
             printf("get app info version failed: %d\n", ret);
-            return apps_info;
+            return;
         }
         // delete basic section, only app info left
         ini.DeleteSection("basic");
@@ -151,14 +430,6 @@ namespace maix::app
             {
                 continue;
             }
-            if (ignore_launcher && app_id == "launcher")
-            {
-                continue;
-            }
-            if (ignore_app_store && app_id == "app_store")
-            {
-                continue;
-            }
             // print app_id
             ret = ini.GetStringValue(app_id, "name", &app_name);
             if (ret != RET_OK)
@@ -219,20 +490,96 @@ namespace maix::app
             APP_Info app_info(app_id, app_name, app_icon, app_version, app_exec, app_author, app_desc, names, descs);
             apps_info.push_back(app_info);
         }
-        return apps_info;
     }
 
-    app::APP_Info get_app_info(const std::string &app_id)
+    static AppRegistry &_load_apps_info()
     {
-        vector<APP_Info> info = get_apps_info();
-        for(auto i : info)
+        AppRegistry &r = _app_registry();
+        if (r.watch_id < 0)
+            r.watch_id = FileWatcher::instance().add(get_apps_info_path());
+        if (r.loaded && !FileWatcher::instance().changed(r.watch_id))
+            return r;
+        FileWatcher::instance().mark(r.watch_id);
+        vector<APP_Info> apps_info;
+        _parse_apps_info(apps_info);
+        for (int i = 0; i < 4; ++i)
         {
-            if (i.id == app_id)
+            bool ignore_launcher = i & 1;
+            bool ignore_app_store = i & 2;
+            r.lists[i].clear();
+            r.index[i].clear();
+            for (auto &info : apps_info)
             {
-                return i;
+                if (ignore_launcher && info.id == "launcher")
+                    continue;
+                if (ignore_app_store && info.id == "app_store")
+                    continue;
+                r.index[i][info.id] = (int)r.lists[i].size();
+                r.lists[i].push_back(info);
             }
         }
-        throw err::Exception(err::ERR_ARGS, "app_id not found");
+        r.loaded = true;
+        return r;
+    }
+
+    vector<APP_Info> &get_apps_info(bool ignore_launcher, bool ignore_app_store)
+    {
+        AppRegistry &r = _app_registry();
+        std::lock_guard<std::mutex> guard(r.lock);
+        _load_apps_info();
+        return r.lists[(ignore_launcher ? 1 : 0) | (ignore_app_store ? 2 : 0)];
+    }
+
+    int find_app(const std::string &app_id, bool ignore_launcher, bool ignore_app_store)
+    {
+        AppRegistry &r = _app_registry();
+        std::lock_guard<std::mutex> guard(r.lock);
+        _load_apps_info();
+        auto &index = r.index[(ignore_launcher ? 1 : 0) | (ignore_app_store ? 2 : 0)];
+        auto it = index.find(app_id);
+        return it == index.end() ? -1 : it->second;
+    }
+
+    vector<APP_Info> copy_apps_info(bool ignore_launcher, bool ignore_app_store)
+    {
+        AppRegistry &r = _app_registry();
+        std::lock_guard<std::mutex> guard(r.lock);
+        _load_apps_info();
+        return r.lists[(ignore_launcher ? 1 : 0) | (ignore_app_store ? 2 : 0)];
+    }
+
+    int apps_count(bool ignore_launcher, bool ignore_app_store)
+    {
+        AppRegistry &r = _app_registry();
+        std::lock_guard<std::mutex> guard(r.lock);
+        _load_apps_info();
+        return (int)r.lists[(ignore_launcher ? 1 : 0) | (ignore_app_store ? 2 : 0)].size();
+    }
+
+    app::APP_Info get_app_info(int idx, bool ignore_launcher, bool ignore_app_store)
+    {
+        AppRegistry &r = _app_registry();
+        std::lock_guard<std::mutex> guard(r.lock);
+        _load_apps_info();
+        auto &list = r.lists[(ignore_launcher ? 1 : 0) | (ignore_app_store ? 2 : 0)];
+        if (idx < 0 || (size_t)idx >= list.size())
+        {
+            throw err::Exception(err::ERR_ARGS, "app idx out of range");
+        }
+        return list[idx];
+    }
+
+    app::APP_Info get_app_info(const std::string &app_id)
+    {
+        AppRegistry &r = _app_registry();
+        std::lock_guard<std::mutex> guard(r.lock);
+        _load_apps_info();
+        auto it = r.index[0].find(app_id);
+        if (it == r.index[0].end())
+        {
+            throw err::Exception(err::ERR_ARGS, "app_id not found");
+        }
+        return r.lists[0][it->second];
     }
 
     string get_app_data_path()
@@ -342,50 +689,30 @@ namespace maix::app
         return path;
     }
 
-    static inline int create_sys_conf_load()
-    {
-        string path = get_sys_config_path();
-        if (!fs::exists(path))
-            sys_conf_ini.SaveAs(path);
-        return sys_conf_ini.Load(path);
-    }
-
     string get_sys_config_kv(const string &item, const string &key, const string &value, bool from_cache)
     {
         string _value = value;
-        if (from_cache && sys_conf_ini_loaded)
-        {
-            // read from cache
-            sys_conf_ini.GetStringValue(item, key, &_value);
-        }
-        else
+        std::lock_guard<std::mutex> guard(conf_lock);
+        int ret = sys_conf.load(get_sys_config_path(), !from_cache);
+        if (ret != RET_OK)
         {
-            // read from file
-            int ret = create_sys_conf_load();
-            if (ret != RET_OK)
-            {
-                log::error("open sys config failed: %d\n", ret);
-                return value;
-            }
-            sys_conf_ini.GetStringValue(item, key, &_value);
-            sys_conf_ini_loaded = true;
+            log::error("open sys config failed: %d\n", ret);
+            return value;
         }
+        sys_conf.get(item, key, _value);
         return _value;
     }
 
     err::Err set_sys_config_kv(const string &item, const string &key, const string &value, bool write_file)
     {
-        if (!sys_conf_ini_loaded)
+        std::lock_guard<std::mutex> guard(conf_lock);
+        int ret = sys_conf.load(get_sys_config_path(), false);
+        if (ret != RET_OK)
         {
-            int ret = create_sys_conf_load();
-            if (ret != RET_OK)
-            {
-                log::error("open sys config failed: %d\n", ret);
-                return err::ERR_RUNTIME;
-            }
-            sys_conf_ini_loaded = true;
+            log::error("open sys config failed: %d\n", ret);
+            return err::ERR_RUNTIME;
         }
-        int ret = sys_conf_ini.SetStringValue(item, key, value);
+        ret = sys_conf.set(item, key, value);
         if (ret != RET_OK)
         {
             log::error("set sys config failed: %d\n", ret);
@@ -393,7 +720,7 @@ namespace maix::app
         }
         if (write_file)
         {
-            ret = sys_conf_ini.Save();
+            ret = sys_conf.save();
             if (ret != RET_OK)
             {
                 log::error("save sys config failed: %d\n", ret);
@@ -406,45 +733,27 @@ namespace maix::app
     string get_app_config_kv(const string &item, const string &key, const string &value, bool from_cache)
     {
         string _value = value;
-        if (from_cache && app_conf_ini_loaded)
-        {
-            // read from cache
-            app_conf_ini.GetStringValue(item, key, &_value);
-        }
-        else
+        std::lock_guard<std::mutex> guard(conf_lock);
+        int ret = app_conf.load(get_app_config_path(), !from_cache);
+        if (ret != RET_OK)
         {
-            // read from file
-            string path = get_app_config_path();
-            if (!fs::exists(path))
-                app_conf_ini.SaveAs(path);
-            int ret = app_conf_ini.Load(path);
-            if (ret != RET_OK)
-            {
-                log::error("open app config failed: %d\n", ret);
-                return value;
-            }
-            app_conf_ini.GetStringValue(item, key, &_value);
-            app_conf_ini_loaded = true;
+            log::error("open app config failed: %d\n", ret);
+            return value;
         }
+        app_conf.get(item, key, _value);
         return _value;
     }
 
     err::Err set_app_config_kv(const string &item, const string &key, const string &value, bool write_file)
     {
-        if (!app_conf_ini_loaded)
+        std::lock_guard<std::mutex> guard(conf_lock);
+        int ret = app_conf.load(get_app_config_path(), false);
+        if (ret != RET_OK)
         {
-            string path = get_app_config_path();
-            if (!fs::exists(path))
-                app_conf_ini.SaveAs(path);
-            int ret = app_conf_ini.Load(path);
-            if (ret != RET_OK)
-            {
-                log::error("open app config failed: %d\n", ret);
-                return err::ERR_RUNTIME;
-            }
-            app_conf_ini_loaded = true;
+            log::error("open app config failed: %d\n", ret);
+            return err::ERR_RUNTIME;
         }
-        int ret = app_conf_ini.SetStringValue(item, key, value);
+        ret = app_conf.set(item, key, value);
         if (ret != RET_OK)
         {
             log::error("set app config failed: %d\n", ret);
@@ -452,7 +761,7 @@ namespace maix::app
         }
         if (write_file)
         {
-            ret = app_conf_ini.Save();
+            ret = app_conf.save();
             if (ret != RET_OK)
             {
                 log::error("save app config failed: %d\n", ret);
@@ -580,7 +889,7 @@ namespace maix::app
             log::error("switch app failed, app_id and idx must have one is valid\n");
             return;
         }
-        vector<APP_Info> &apps_info = get_apps_info();
+        vector<APP_Info> apps_info = copy_apps_info();
         std::string final_app_id = app_id;
         std::string final_app_path = "";
         if (idx >= 0)
@@ -596,11 +905,11 @@ namespace maix::app
         else
         {
             final_app_id = app_id;
-            for (auto i : apps_info)
+            for (auto &info : apps_info)
             {
-                if (final_app_id == i.id)
+                if (info.id == final_app_id)
                 {
-                    final_app_path = get_app_path(final_app_id) + "/" + i.exec;
+                    final_app_path = get_app_path(final_app_id) + "/" + info.exec;
                     break;
                 }
             }
@@ -7,98 +7,175 @@
 
 
 #include "maix_protocol.hpp"
+#include "maix_log.hpp"
 #include <string.h>
 #include <assert.h>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 
 namespace maix::protocol
 {
     uint32_t HEADER = 0xBBACCAAA;
-    uint16_t crc16_IBM(uint8_t *ptr, size_t len)
-    {
-        unsigned int i;
-        uint16_t crc = 0x0000;
 
-        while (len--)
+    class Crc16Table
+    {
+    public:
+        uint16_t table[256];
+        Crc16Table()
         {
-            crc ^= *ptr++;
-            for (i = 0; i < 8; ++i)
+            for (int i = 0; i < 256; ++i)
             {
-                if (crc & 1)
-                    crc = (crc >> 1) ^ 0xA001;
-                else
-                    crc = (crc >> 1);
+                uint16_t crc = i;
+                for (int j = 0; j < 8; ++j)
+                    crc = (crc & 1) ? ((crc >> 1) ^ 0xA001) : (crc >> 1);
+                table[i] = crc;
             }
         }
+    };
+    static const Crc16Table _crc16_table;
 
+    uint16_t crc16_IBM_update(uint16_t crc, const uint8_t *data, size_t len)
+    {
+        const uint16_t *table = _crc16_table.table;
+        while (len--)
+            crc = (crc >> 8) ^ table[(crc ^ *data++) & 0xFF];
         return crc;
     }
 
+    uint16_t crc16_IBM(uint8_t *ptr, size_t len)
+    {
+        return crc16_IBM_update(0, ptr, len);
+    }
+
     uint16_t crc16_IBM(const Bytes *bytes)
     {
         return crc16_IBM(bytes->data, bytes->size());
     }
 
-    int encode(uint8_t *out_buff, int out_buff_len,
-               uint8_t cmd, uint8_t flags, uint8_t *body, int body_len,
-               uint8_t code,
-               const uint8_t version)
+    static inline void _put_u32(uint8_t *p, uint32_t v)
+    {
+        p[0] = v & 0xFF;
+        p[1] = (v >> 8) & 0xFF;
+        p[2] = (v >> 16) & 0xFF;
+        p[3] = (v >> 24) & 0xFF;
+    }
+
+    static inline uint32_t _get_u32(const uint8_t *p)
     {
-        assert((uint64_t)out_buff % 4 == 0);
+        return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
 
+    static int _body_len(const BodyPart *parts, int num)
+    {
+        int body_len = 0;
+        for (int i = 0; i < num; ++i)
+        {
+            if (parts[i].len < 0 || (parts[i].len > 0 && !parts[i].data))
+                return -1;
+            body_len += parts[i].len;
+        }
+        return body_len;
+    }
+
+    int encode_parts(uint8_t *out_buff, int out_buff_len,
+                     uint8_t cmd, uint8_t flags, const BodyPart *parts, int num,
+                     uint8_t code,
+                     const uint8_t version)
+    {
         if (version != VERSION)
             return -err::ERR_ARGS;
-        if (out_buff_len < body_len + 12)
+        int body_len = _body_len(parts, num);
+        if (body_len < 0)
             return -err::ERR_ARGS;
-        ((uint32_t *)out_buff)[0] = HEADER;
-        ((uint32_t *)out_buff)[1] = body_len + 4;
+        int len = encoded_len(body_len, code);
+        if (out_buff_len < len)
+            return -err::ERR_ARGS;
+        // data length field counts flags, cmd, body(error code is the first byte of body) and crc
+        _put_u32(out_buff, HEADER);
+        _put_u32(out_buff + 4, len - 8);
         out_buff[8] = flags | version;
         out_buff[9] = cmd;
+        uint8_t *p = out_buff + 10;
         if (code != 0xFF)
+            *p++ = code;
+        uint16_t crc16 = crc16_IBM_update(0, out_buff, p - out_buff);
+        for (int i = 0; i < num; ++i)
         {
-            out_buff[10] = code;
-            memcpy(out_buff + 11, body, body_len);
-            uint16_t crc16 = crc16_IBM(out_buff, body_len + 11);
-            out_buff[11 + body_len] = crc16 & 0xFF;
-            out_buff[12 + body_len] = crc16 >> 8 & 0xFF;
-            return body_len + 13;
+            if (parts[i].len == 0)
+                continue;
+            memcpy(p, parts[i].data, parts[i].len);
+            crc16 = crc16_IBM_update(crc16, p, parts[i].len);
+            p += parts[i].len;
         }
-        memcpy(out_buff + 10, body, body_len);
-        uint16_t crc16 = crc16_IBM(out_buff, body_len + 10);
-        out_buff[10 + body_len] = crc16 & 0xFF;
-        out_buff[11 + body_len] = crc16 >> 8 & 0xFF;
-        return body_len + 12;
+        p[0] = crc16 & 0xFF;
+        p[1] = crc16 >> 8 & 0xFF;
+        return len;
     }
 
-    Bytes *encode_resp_ok(uint8_t cmd, uint8_t *body, int body_len)
+    int encode(uint8_t *out_buff, int out_buff_len,
+               uint8_t cmd, uint8_t flags, uint8_t *body, int body_len,
+               uint8_t code,
+               const uint8_t version)
+    {
+        BodyPart part = {body, body_len};
+        return encode_parts(out_buff, out_buff_len, cmd, flags, &part, 1, code, version);
+    }
+
+    int find_frame(const uint8_t *data, int len, int *start, int max_len, uint32_t header)
+    {
+        int i = 0;
+        for (; i + 4 <= len; ++i)
+        {
+            if (_get_u32(data + i) != header)
+                continue;
+            *start = i;
+            if (len - i < 8)
+                return 0;
+            uint32_t data_len = _get_u32(data + i + 4);
+            if (data_len < 4 || data_len + 8 > (uint32_t)max_len)
+                continue; // header bytes in data, not a frame
+            if ((uint32_t)(len - i) < data_len + 8)
+                return 0;
+            return data_len + 8;
+        }
+        *start = i;
+        return 0;
+    }
+
+    /**
+     * Encode into a new Bytes object, only one buffer allocated.
+     */
+    static Bytes *_encode_bytes(uint8_t cmd, uint8_t flags, const uint8_t *body, int body_len, uint8_t code = 0xFF)
     {
-        uint8_t *buff = new uint8_t[12 + body_len];
-        int len = encode(buff, 12 + body_len, cmd, FLAG_RESP | FLAG_RESP_OK, body, body_len);
-        if (len < 0)
+        if (body_len < 0)
+            return nullptr;
+        int len = encoded_len(body_len, code);
+        Bytes *ret = new Bytes(nullptr, len);
+        BodyPart part = {body, body_len};
+        if (encode_parts(ret->data, len, cmd, flags, &part, 1, code) < 0)
         {
-            delete[] buff;
+            delete ret;
             return nullptr;
         }
-        Bytes *ret = new Bytes(buff, len, true, false);
         return ret;
     }
 
+    Bytes *encode_resp_ok(uint8_t cmd, uint8_t *body, int body_len)
+    {
+        return _encode_bytes(cmd, FLAG_RESP | FLAG_RESP_OK, body, body_len);
+    }
+
     Bytes *encode_resp_ok(uint8_t cmd, Bytes *body)
     {
-        int body_len = body->size();
-        return protocol::encode_resp_ok(cmd, body->data, body_len);
+        if (!body)
+            return protocol::encode_resp_ok(cmd, nullptr, 0);
+        return protocol::encode_resp_ok(cmd, body->data, body->size());
     }
 
     Bytes *encode_resp_err(uint8_t cmd, err::Err code, const std::string &msg)
     {
-        uint8_t *buff = new uint8_t[13 + msg.length()];
-        int len = encode(buff, 13 + msg.length(), cmd, FLAG_RESP | FLAG_RESP_ERR, (uint8_t *)msg.c_str(), msg.length(), code);
-        if (len < 0)
-        {
-            delete[] buff;
-            return nullptr;
-        }
-        Bytes *ret = new Bytes(buff, len, true, false);
-        return ret;
+        return _encode_bytes(cmd, FLAG_RESP | FLAG_RESP_ERR, (const uint8_t *)msg.c_str(), msg.length(), code);
     }
 
     int encode_resp_ok(uint8_t *buff, int buff_len, uint8_t cmd, uint8_t *body, int body_len)
@@ -218,28 +295,14 @@ namespace maix::protocol
 
     Bytes *MSG::encode_report(uint8_t *body, int body_len)
     {
-        uint8_t *buff = new uint8_t[12 + body_len];
-        int len = protocol::encode(buff, 12 + body_len, this->cmd, FLAG_RESP | FLAG_RESP_OK | FLAG_REPORT, body, body_len);
-        if (len < 0)
-        {
-            delete[] buff;
-            return nullptr;
-        }
-        Bytes *ret = new Bytes(buff, len, true, false);
-        return ret;
+        return _encode_bytes(this->cmd, FLAG_RESP | FLAG_RESP_OK | FLAG_REPORT, body, body_len);
     }
 
     Bytes *MSG::encode_report(Bytes *body)
     {
-        uint8_t *buff = new uint8_t[12 + body_len];
-        int len = protocol::encode(buff, 12 + body_len, this->cmd, FLAG_RESP | FLAG_RESP_OK | FLAG_REPORT, body->data, (int)body->size());
-        if (len < 0)
-        {
-            delete[] buff;
-            return nullptr;
-        }
-        Bytes *ret = new Bytes(buff, len, true, false);
-        return ret;
+        if (!body)
+            return _encode_bytes(this->cmd, FLAG_RESP | FLAG_RESP_OK | FLAG_REPORT, nullptr, 0);
+        return _encode_bytes(this->cmd, FLAG_RESP | FLAG_RESP_OK | FLAG_REPORT, body->data, (int)body->size());
     }
 
     int MSG::encode_resp_err(uint8_t *buff, int buff_len, err::Err code, const std::string &msg)
@@ -291,19 +354,13 @@ namespace maix::protocol
 
     Bytes *Protocol::encode_report(uint8_t cmd, uint8_t *body, int body_len)
     {
-        uint8_t *buff = new uint8_t[12 + body_len];
-        int len = protocol::encode(buff, 12 + body_len, cmd, FLAG_RESP | FLAG_RESP_OK | FLAG_REPORT, body, body_len);
-        if (len < 0)
-        {
-            delete[] buff;
-            return nullptr;
-        }
-        Bytes *ret = new Bytes(buff, len, true, false);
-        return ret;
+        return _encode_bytes(cmd, FLAG_RESP | FLAG_RESP_OK | FLAG_REPORT, body, body_len);
     }
 
     Bytes *Protocol::encode_report(uint8_t cmd, Bytes *body)
     {
+        if (!body)
+            return Protocol::encode_report(cmd, nullptr, 0);
         return Protocol::encode_report(cmd, body->data, body->size());
     }
 
@@ -373,4 +430,231 @@ namespace maix::protocol
         return decode((uint8_t *)&new_data[0], new_data->size());
     }
 
+    typedef struct
+    {
+        uint8_t *buff;
+        int size;
+        int head;       // first byte of oldest message
+        int tail;       // end of newest message
+        int wrap;       // end of data before tail wrapped to 0, -1 if not wrapped
+        int used;
+        bool closed;
+        uint64_t dropped;
+        uint64_t pop_count;
+        bool taken;     // data taken by pop is not sent yet
+        std::mutex lock;
+        std::condition_variable cond_data;
+        std::condition_variable cond_space;
+    } tx_ring_t;
+
+    static inline int _ring_msg_len(tx_ring_t *r)
+    {
+        return _get_u32(r->buff + r->head + 4) + 8;
+    }
+
+    static void _ring_remove_head(tx_ring_t *r, int len)
+    {
+        r->head += len;
+        r->used -= len;
+        if (r->used == 0)
+        {
+            r->head = r->tail = 0;
+            r->wrap = -1;
+        }
+        else if (r->wrap >= 0 && r->head == r->wrap)
+        {
+            r->head = 0;
+            r->wrap = -1;
+        }
+    }
+
+    // reserve len contiguous bytes, messages never wrap so they can be sent with one write
+    static uint8_t *_ring_reserve(tx_ring_t *r, int len)
+    {
+        int off = -1;
+        if (r->wrap < 0)
+        {
+            if (r->size - r->tail >= len)
+                off = r->tail;
+            else if (r->head >= len)
+            {
+                r->wrap = r->tail;
+                off = 0;
+            }
+        }
+        else if (r->head - r->tail >= len)
+            off = r->tail;
+        if (off < 0)
+            return nullptr;
+        r->tail = off + len;
+        r->used += len;
+        return r->buff + off;
+    }
+
+    template <typename Pred>
+    static bool _wait(std::condition_variable &cond, std::unique_lock<std::mutex> &lock, int timeout, Pred pred)
+    {
+        if (timeout < 0)
+        {
+            cond.wait(lock, pred);
+            return true;
+        }
+        return cond.wait_for(lock, std::chrono::milliseconds(timeout), pred);
+    }
+
+    TxRing::TxRing(int size)
+    {
+        if (size < 64)
+            throw err::Exception(err::ERR_ARGS, "TxRing size too small");
+        tx_ring_t *r = new tx_ring_t();
+        r->buff = new uint8_t[size];
+        r->size = size;
+        r->head = 0;
+        r->tail = 0;
+        r->wrap = -1;
+        r->used = 0;
+        r->closed = false;
+        r->dropped = 0;
+        r->pop_count = 0;
+        r->taken = false;
+        _data = r;
+    }
+
+    TxRing::~TxRing()
+    {
+        tx_ring_t *r = (tx_ring_t *)_data;
+        delete[] r->buff;
+        delete r;
+    }
+
+    err::Err TxRing::push(uint8_t cmd, uint8_t flags, const BodyPart *parts, int num, uint8_t code, protocol::TxPolicy policy, int timeout)
+    {
+        tx_ring_t *r = (tx_ring_t *)_data;
+        int body_len = _body_len(parts, num);
+        if (body_len < 0)
+            return err::ERR_ARGS;
+        int len = encoded_len(body_len, code);
+        if (len > r->size / 2)
+        {
+            log::error("message too large for tx ring, %d > %d", len, r->size / 2);
+            return err::ERR_ARGS;
+        }
+        std::unique_lock<std::mutex> lock(r->lock);
+        uint8_t *p = nullptr;
+        while (!r->closed && !(p = _ring_reserve(r, len)))
+        {
+            if (policy == TX_DROP_OLD)
+            {
+                _ring_remove_head(r, _ring_msg_len(r));
+                ++r->dropped;
+            }
+            else if (policy == TX_DROP_NEW)
+            {
+                ++r->dropped;
+                return err::ERR_BUFF_FULL;
+            }
+            else
+            {
+                // space may be fragmented, check again after every pop
+                uint64_t pop_count = r->pop_count;
+                if (!_wait(r->cond_space, lock, timeout, [r, pop_count] { return r->closed || r->pop_count != pop_count; }))
+                {
+                    ++r->dropped;
+                    return err::ERR_BUFF_FULL;
+                }
+            }
+        }
+        if (r->closed)
+            return err::ERR_NOT_READY;
+        encode_parts(p, len, cmd, flags, parts, num, code);
+        lock.unlock();
+        r->cond_data.notify_one();
+        return err::ERR_NONE;
+    }
+
+    int TxRing::pop(uint8_t *out_buff, int out_buff_len, int timeout)
+    {
+        tx_ring_t *r = (tx_ring_t *)_data;
+        std::unique_lock<std::mutex> lock(r->lock);
+        if (!_wait(r->cond_data, lock, timeout, [r] { return r->closed || r->used > 0; }))
+            return 0;
+        int n = 0;
+        while (r->used > 0)
+        {
+            // copy every contiguous run of whole messages at once
+            int start = r->head;
+            int end = r->wrap >= 0 ? r->wrap : r->tail;
+            int run = 0;
+            while (start + run < end)
+            {
+                int len = _get_u32(r->buff + start + run + 4) + 8;
+                if (n + run + len > out_buff_len)
+                    break;
+                run += len;
+            }
+            if (run == 0)
+                break;
+            memcpy(out_buff + n, r->buff + start, run);
+            n += run;
+            _ring_remove_head(r, run);
+            ++r->pop_count;
+            if (start + run < end) // out_buff full
+                break;
+        }
+        r->taken = n > 0;
+        lock.unlock();
+        if (n > 0)
+            r->cond_space.notify_all();
+        else if (r->used > 0)
+            return -err::ERR_ARGS;
+        return n;
+    }
+
+    bool TxRing::wait_empty(int timeout)
+    {
+        tx_ring_t *r = (tx_ring_t *)_data;
+        std::unique_lock<std::mutex> lock(r->lock);
+        return _wait(r->cond_space, lock, timeout, [r] { return r->used == 0 && !r->taken; });
+    }
+
+    void TxRing::done()
+    {
+        tx_ring_t *r = (tx_ring_t *)_data;
+        {
+            std::lock_guard<std::mutex> lock(r->lock);
+            r->taken = false;
+        }
+        r->cond_space.notify_all();
+    }
+
+    void TxRing::close()
+    {
+        tx_ring_t *r = (tx_ring_t *)_data;
+        {
+            std::lock_guard<std::mutex> lock(r->lock);
+            r->closed = true;
+        }
+        r->cond_data.notify_all();
+        r->cond_space.notify_all();
+    }
+
+    int TxRing::size()
+    {
+        return ((tx_ring_t *)_data)->size;
+    }
+
+    int TxRing::used()
+    {
+        tx_ring_t *r = (tx_ring_t *)_data;
+        std::lock_guard<std::mutex> lock(r->lock);
+        return r->used;
+    }
+
+    uint64_t TxRing::dropped()
+    {
+        tx_ring_t *r = (tx_ring_t *)_data;
+        std::lock_guard<std::mutex> lock(r->lock);
+        return r->dropped;
+    }
+
 } // namespace maix::protocol
@@ -23,7 +23,9 @@
 #include <iomanip>
 #include <iterator>
 #include <iostream>
+#include <mutex>
 #include "maix_basic.hpp"
+#include "maix_proc_reader.hpp"
 
 #define LIB_VERSION_FILE_PATH "/maixapp/maixcam_lib.version"
 
@@ -448,31 +450,21 @@ namespace maix::sys
     std::map<std::string, int> memory_info()
     {
         std::map<std::string, int> res;
-        FILE *file = fopen("/proc/meminfo", "r");
-        if (!file)
+        proc::File file;
+        if (!file.open("/proc/meminfo", 2048) || file.read() <= 0)
         {
             log::error("Cannot open /proc/meminfo");
             return res;
         }
 
-        unsigned long total_memory = 0;
-        unsigned long free_memory = 0;
-        char line[256];
-
-        while (fgets(line, sizeof(line), file))
-        {
-            if (sscanf(line, "MemTotal: %lu kB", &total_memory) == 1)
-            {
-                // printf("Total memory: %lu kB\n", total_memory);
-            }
-            if (sscanf(line, "MemAvailable: %lu kB", &free_memory) == 1)
-            {
-                // printf("MemAvailable memory: %lu kB\n", free_memory);
-                break;
-            }
-        }
-
-        fclose(file);
+        uint64_t total_memory = 0;
+        uint64_t free_memory = 0;
+        const char *p = proc::find_key(file.data(), file.end(), "MemTotal:");
+        if (p)
+            proc::parse_u64(p, file.end(), total_memory);
+        p = proc::find_key(file.data(), file.end(), "MemAvailable:");
+        if (p)
+            proc::parse_u64(p, file.end(), free_memory);
 
         res["used"] = (total_memory - free_memory) * 1024;
         res["total"] = total_memory * 1024;
@@ -561,46 +553,45 @@ namespace maix::sys
     std::map<std::string, float> cpu_temp()
     {
         std::map<std::string, float> res;
-        FILE *file = fopen("/sys/class/thermal/thermal_zone0/temp", "r");
-        if (!file)
+        proc::File file;
+        if (!file.open("/sys/class/thermal/thermal_zone0/temp", 32) || file.read() <= 0)
         {
             perror("Cannot open /sys/class/thermal/thermal_zone0/temp");
             return res;
         }
-        int temp = 0;
-        if (fscanf(file, "%d", &temp) == 1)
-        {
-            // printf("CPU temp: %d\n", temp);
-        }
-        fclose(file);
+        int64_t temp = 0;
+        proc::parse_i64(file.data(), file.end(), temp);
         res["cpu"] = temp / 1000.0;
         return res;
     }
 
     std::map<std::string, float> cpu_usage()
     {
+        // usage since last call, so keep the file and last counters
+        static std::mutex lock;
+        static proc::File file;
+        static proc::CpuTimes last_all = {0, 0};
+        static proc::CpuTimes last_cores[TelemetrySnapshot::MAX_CPU] = {};
         std::map<std::string, float> usage;
+        std::lock_guard<std::mutex> guard(lock);
 
-        std::ifstream proc_stat("/proc/stat");
-        std::string line;
-        while (std::getline(proc_stat, line))
-        {
-            std::istringstream iss(line);
-            std::vector<std::string> words((std::istream_iterator<std::string>(iss)), std::istream_iterator<std::string>());
-
-            if (words[0].substr(0, 3) == "cpu")
-            {
-                long total_time = 0;
-                for (size_t i = 1; i < words.size(); i++)
-                    total_time += std::stol(words[i]);
-
-                long idle_time = std::stol(words[4]); // idle time is 4th field
-                float cpu_usage = 100 * (1 - (float)idle_time / total_time);
-
-                usage[words[0]] = cpu_usage;
-            }
-        }
-
+        if (!file.is_open() && !file.open("/proc/stat", 4096))
+            return usage;
+        if (file.read() <= 0)
+            return usage;
+        proc::CpuTimes all;
+        proc::CpuTimes cores[TelemetrySnapshot::MAX_CPU];
+        int num = proc::parse_stat(file.data(), file.end(), all, cores, TelemetrySnapshot::MAX_CPU);
+        if (num < 0)
+            return usage;
+        // no time passed since last call, use usage since boot
+        bool since_boot = all.total == last_all.total;
+        proc::CpuTimes zero = {0, 0};
+        usage["cpu"] = proc::cpu_usage(all, since_boot ? zero : last_all);
+        for (int i = 0; i < num; ++i)
+            usage["cpu" + std::to_string(i)] = proc::cpu_usage(cores[i], since_boot ? zero : last_cores[i]);
+        last_all = all;
+        memcpy(last_cores, cores, sizeof(cores[0]) * num);
         return usage;
     }
 
@@ -0,0 +1,371 @@
+/**
+ * @author neucrack@sipeed
+ * @copyright Sipeed Ltd 2024-
+ * @license Apache 2.0
+ * @update 2024.11.20: Add telemetry sampler.
+ */
+
+#include "maix_sys_telemetry.hpp"
+#include "maix_proc_reader.hpp"
+#include "maix_basic.hpp"
+#include <dirent.h>
+#include <stdlib.h>
+
+namespace maix::sys
+{
+    // ring of cumulative counters, usage is delta between newest and the one window ago
+    static const int RING_SIZE = 64;
+
+    struct TelemetryThread
+    {
+        int tid;
+        char name[16];
+        bool seen;
+        uint64_t first;                 // sample index of first seen
+        uint64_t ticks[RING_SIZE];
+        proc::File file;
+    };
+
+    struct TelemetryData
+    {
+        int window;                     // window in samples
+        bool threads_enable;
+        float clk_tck;
+        uint64_t n;                     // samples taken
+
+        proc::File stat;
+        proc::File meminfo;
+        proc::File temp;
+        proc::File self_stat;
+#if PLATFORM_MAIXCAM
+        proc::File clk;
+#else
+        proc::File freq[TelemetrySnapshot::MAX_CPU];
+        bool freq_opened;
+#endif
+
+        uint64_t time_us[RING_SIZE];
+        proc::CpuTimes all[RING_SIZE];
+        proc::CpuTimes cores[RING_SIZE][TelemetrySnapshot::MAX_CPU];
+        int cpu_num;
+        uint64_t self_ticks[RING_SIZE];
+
+        TelemetryThread threads[TelemetrySnapshot::MAX_THREADS];
+
+        TelemetrySnapshot snap;
+    };
+
+    Telemetry::Telemetry(int interval_ms, int window_ms, bool threads)
+        : _thread(nullptr), _exit(false), _seq(0)
+    {
+        if (interval_ms <= 0)
+            throw err::Exception(err::ERR_ARGS, "interval_ms must > 0");
+        _interval_ms = interval_ms;
+        TelemetryData *d = new TelemetryData();
+        d->window = window_ms / interval_ms;
+        if (d->window < 1)
+            d->window = 1;
+        if (d->window > RING_SIZE - 1)
+            d->window = RING_SIZE - 1;
+        d->threads_enable = threads;
+        long tck = sysconf(_SC_CLK_TCK);
+        d->clk_tck = tck > 0 ? (float)tck : 100.f;
+        d->n = 0;
+        d->cpu_num = 0;
+        d->stat.open("/proc/stat", 4096);
+        d->meminfo.open("/proc/meminfo", 2048);
+        d->temp.open("/sys/class/thermal/thermal_zone0/temp", 32);
+        d->self_stat.open("/proc/self/stat", 512);
+#if PLATFORM_MAIXCAM
+        d->clk.open("/sys/kernel/debug/clk/clk_summary", 16384);
+#else
+        d->freq_opened = false;
+#endif
+        for (int i = 0; i < TelemetrySnapshot::MAX_THREADS; ++i)
+            d->threads[i].tid = 0;
+        memset(&d->snap, 0, sizeof(d->snap));
+        memset(&_snapshot, 0, sizeof(_snapshot));
+        _data = d;
+    }
+
+    Telemetry::~Telemetry()
+    {
+        stop();
+        delete (TelemetryData *)_data;
+    }
+
+    err::Err Telemetry::start()
+    {
+        if (_thread)
+            return err::ERR_NONE;
+        _exit = false;
+        _thread = new thread::Thread(_process, this);
+        return err::ERR_NONE;
+    }
+
+    void Telemetry::stop()
+    {
+        if (!_thread)
+            return;
+        _exit = true;
+        _thread->join();
+        delete _thread;
+        _thread = nullptr;
+    }
+
+    void Telemetry::_process(void *args)
+    {
+        Telemetry *self = (Telemetry *)args;
+        uint64_t next = time::ticks_us();
+        while (!self->_exit)
+        {
+            self->sample();
+            // fixed rate, skip ticks if sampling was late
+            next += self->_interval_ms * 1000;
+            uint64_t now = time::ticks_us();
+            if (next <= now)
+                next = now + self->_interval_ms * 1000;
+            // sleep in small steps so stop() returns fast
+            while (!self->_exit && (now = time::ticks_us()) < next)
+            {
+                uint64_t left = next - now;
+                time::sleep_us(left > 20000 ? 20000 : left);
+            }
+        }
+    }
+
+    static void _sample_threads(TelemetryData *d, int idx, int base_idx, uint64_t base_n, float elapsed_s)
+    {
+        TelemetrySnapshot &s = d->snap;
+        for (int i = 0; i < TelemetrySnapshot::MAX_THREADS; ++i)
+            d->threads[i].seen = false;
+
+        DIR *dir = opendir("/proc/self/task");
+        if (!dir)
+        {
+            s.thread_num = 0;
+            return;
+        }
+        struct dirent *ent;
+        char path[64];
+        while ((ent = readdir(dir)) != nullptr)
+        {
+            if (ent->d_name[0] < '0' || ent->d_name[0] > '9')
+                continue;
+            int tid = atoi(ent->d_name);
+            TelemetryThread *t = nullptr;
+            TelemetryThread *free_slot = nullptr;
+            for (int i = 0; i < TelemetrySnapshot::MAX_THREADS; ++i)
+            {
+                if (d->threads[i].tid == tid)
+                {
+                    t = &d->threads[i];
+                    break;
+                }
+                if (!free_slot && d->threads[i].tid == 0)
+                    free_slot = &d->threads[i];
+            }
+            if (!t)
+            {
+                if (!free_slot)
+                    continue; // more threads than MAX_THREADS, ignore the rest
+                snprintf(path, sizeof(path), "/proc/self/task/%d/stat", tid);
+                if (!free_slot->file.open(path, 512))
+                    continue;
+                t = free_slot;
+                t->tid = tid;
+                t->first = d->n;
+            }
+            uint64_t ticks;
+            if (t->file.read() <= 0 || !proc::parse_task_stat(t->file.data(), t->file.end(), ticks, t->name, sizeof(t->name)))
+                continue;
+            t->ticks[idx] = ticks;
+            t->seen = true;
+        }
+        closedir(dir);
+
+        int num = 0;
+        for (int i = 0; i < TelemetrySnapshot::MAX_THREADS; ++i)
+        {
+            TelemetryThread *t = &d->threads[i];
+            if (t->tid == 0)
+                continue;
+            if (!t->seen)
+            {
+                // thread exited, free slot
+                t->file.close();
+                t->tid = 0;
+                continue;
+            }
+            ThreadUsage &u = s.threads[num++];
+            u.tid = t->tid;
+            memcpy(u.name, t->name, sizeof(u.name));
+            u.usage = 0;
+            if (elapsed_s <= 0)
+                continue;
+            // new threads use the first sample of their own as base
+            uint64_t start = t->first > base_n ? t->first : base_n;
+            if (start >= d->n)
+                continue;
+            int b = start % RING_SIZE;
+            float elapsed = elapsed_s;
+            if (b != base_idx)
+                elapsed = (d->time_us[idx] - d->time_us[b]) / 1000000.f;
+            if (elapsed > 0)
+                u.usage = (t->ticks[idx] - t->ticks[b]) / d->clk_tck / elapsed * 100.f;
+        }
+        s.thread_num = num;
+    }
+
+    err::Err Telemetry::sample()
+    {
+        TelemetryData *d = (TelemetryData *)_data;
+        TelemetrySnapshot &s = d->snap;
+        int idx = d->n % RING_SIZE;
+        d->time_us[idx] = time::ticks_us();
+
+        // cpu usage
+        if (d->stat.read() <= 0)
+            return err::ERR_IO;
+        int cpu_num = proc::parse_stat(d->stat.data(), d->stat.end(), d->all[idx], d->cores[idx], TelemetrySnapshot::MAX_CPU);
+        if (cpu_num < 0)
+            return err::ERR_IO;
+        d->cpu_num = cpu_num;
+        uint64_t base_n = d->n > (uint64_t)d->window ? d->n - d->window : 0;
+        int base_idx = base_n % RING_SIZE;
+        s.cpu_num = cpu_num;
+        float elapsed_s = 0;
+        if (base_n < d->n)
+        {
+            elapsed_s = (d->time_us[idx] - d->time_us[base_idx]) / 1000000.f;
+            s.cpu_usage = proc::cpu_usage(d->all[idx], d->all[base_idx]);
+            for (int i = 0; i < cpu_num; ++i)
+                s.cpu_core_usage[i] = proc::cpu_usage(d->cores[idx][i], d->cores[base_idx][i]);
+        }
+        else
+        {
+            // first sample, usage since boot
+            proc::CpuTimes zero = {0, 0};
+            s.cpu_usage = proc::cpu_usage(d->all[idx], zero);
+            for (int i = 0; i < cpu_num; ++i)
+                s.cpu_core_usage[i] = proc::cpu_usage(d->cores[idx][i], zero);
+        }
+        s.window_ms = elapsed_s * 1000;
+
+        // memory
+        if (d->meminfo.read() > 0)
+        {
+            uint64_t total = 0, avail = 0;
+            const char *p = proc::find_key(d->meminfo.data(), d->meminfo.end(), "MemTotal:");
+            if (p)
+                proc::parse_u64(p, d->meminfo.end(), total);
+            p = proc::find_key(d->meminfo.data(), d->meminfo.end(), "MemAvailable:");
+            if (p)
+                proc::parse_u64(p, d->meminfo.end(), avail);
+            s.mem_total = total * 1024;
+            s.mem_used = (total - (avail > total ? total : avail)) * 1024;
+#if PLATFORM_MAIXCAM
+            s.mem_hw_total = 256 * 1024 * 1024;
+#else
+            s.mem_hw_total = s.mem_total;
+#endif
+        }
+
+        // temperature
+        s.cpu_temp = -273.15f;
+        if (d->temp.read() > 0)
+        {
+            int64_t t;
+            if (proc::parse_i64(d->temp.data(), d->temp.end(), t))
+                s.cpu_temp = t / 1000.f;
+        }
+
+        // frequency
+        memset(s.cpu_freq, 0, sizeof(s.cpu_freq));
+#if PLATFORM_MAIXCAM
+        if (d->clk.read() > 0)
+        {
+            const char *p = strstr(d->clk.data(), "clk_c906_0");
+            uint64_t v[4];
+            if (p)
+            {
+                p += strlen("clk_c906_0");
+                for (int i = 0; i < 4 && p; ++i)
+                    p = proc::parse_u64(p, d->clk.end(), v[i]);
+                if (p)
+                    s.cpu_freq[0] = v[3];
+            }
+        }
+#else
+        if (!d->freq_opened)
+        {
+            char path[80];
+            for (int i = 0; i < cpu_num; ++i)
+            {
+                snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_cur_freq", i);
+                d->freq[i].open(path, 32);
+            }
+            d->freq_opened = true;
+        }
+        for (int i = 0; i < cpu_num; ++i)
+        {
+            uint64_t khz;
+            if (d->freq[i].read() > 0 && proc::parse_u64(d->freq[i].data(), d->freq[i].end(), khz))
+                s.cpu_freq[i] = khz * 1000;
+        }
+#endif
+
+        // current process and threads
+        s.process_usage = 0;
+        uint64_t ticks;
+        if (d->self_stat.read() > 0 && proc::parse_task_stat(d->self_stat.data(), d->self_stat.end(), ticks))
+        {
+            d->self_ticks[idx] = ticks;
+            if (elapsed_s > 0)
+                s.process_usage = (ticks - d->self_ticks[base_idx]) / d->clk_tck / elapsed_s * 100.f;
+        }
+        if (d->threads_enable)
+            _sample_threads(d, idx, base_idx, base_n, elapsed_s);
+        else
+            s.thread_num = 0;
+
+        ++d->n;
+        s.seq = (uint32_t)d->n;
+        s.timestamp_us = d->time_us[idx];
+        _publish(s);
+        return err::ERR_NONE;
+    }
+
+    void Telemetry::_publish(const TelemetrySnapshot &s)
+    {
+        uint32_t seq = _seq.load(std::memory_order_relaxed);
+        _seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(&_snapshot, &s, sizeof(s));
+        _seq.store(seq + 2, std::memory_order_release);
+    }
+
+    bool Telemetry::snapshot(TelemetrySnapshot &out) const
+    {
+        while (true)
+        {
+            uint32_t seq0 = _seq.load(std::memory_order_acquire);
+            if (seq0 & 1)
+                continue;
+            if (seq0 == 0)
+                return false;
+            memcpy(&out, &_snapshot, sizeof(out));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (_seq.load(std::memory_order_relaxed) == seq0)
+                return true;
+        }
+    }
+
+    Telemetry &telemetry()
+    {
+        static Telemetry t;
+        static bool started = (t.start(), true);
+        (void)started;
+        return t;
+    }
+} // namespace maix::sys
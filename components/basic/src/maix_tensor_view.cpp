@@ -0,0 +1,476 @@
+/**
+ * @author neucrack@sipeed
+ * @copyright Sipeed Ltd 2023-
+ * @license Apache 2.0
+ * @update 2024.12.3: Add tensor view and conversion kernels.
+ */
+
+#include "maix_tensor_view.hpp"
+#include <math.h>
+#include <stddef.h>
+
+namespace maix::tensor
+{
+    static std::vector<int> _contiguous_strides(const std::vector<int> &shape)
+    {
+        std::vector<int> strides(shape.size());
+        int stride = 1;
+        for (int i = (int)shape.size() - 1; i >= 0; --i)
+        {
+            strides[i] = stride;
+            stride *= shape[i];
+        }
+        return strides;
+    }
+
+    TensorView::TensorView()
+    {
+        _data = nullptr;
+        _dtype = DType::FLOAT32;
+    }
+
+    TensorView::TensorView(tensor::Tensor &t)
+    {
+        _data = t.data();
+        _dtype = t.dtype();
+        _shape = t.shape();
+        _strides = _contiguous_strides(_shape);
+    }
+
+    TensorView::TensorView(void *data, tensor::DType dtype, const std::vector<int> &shape, const std::vector<int> &strides)
+    {
+        if (!strides.empty() && strides.size() != shape.size())
+        {
+            throw err::Exception(err::ERR_ARGS, "strides size not match shape");
+        }
+        _data = data;
+        _dtype = dtype;
+        _shape = shape;
+        _strides = strides.empty() ? _contiguous_strides(shape) : strides;
+    }
+
+    int TensorView::size() const
+    {
+        if (_shape.empty())
+            return 0;
+        int size = 1;
+        for (auto s : _shape)
+            size *= s;
+        return size;
+    }
+
+    bool TensorView::is_contiguous() const
+    {
+        int stride = 1;
+        for (int i = (int)_shape.size() - 1; i >= 0; --i)
+        {
+            if (_shape[i] != 1 && _strides[i] != stride)
+                return false;
+            stride *= _shape[i];
+        }
+        return true;
+    }
+
+    TensorView TensorView::slice(int axis, int start, int end, int step) const
+    {
+        int nd = ndim();
+        if (axis < 0)
+            axis += nd;
+        if (axis < 0 || axis >= nd || step <= 0)
+        {
+            throw err::Exception(err::ERR_ARGS, "slice axis or step error");
+        }
+        int len = _shape[axis];
+        if (start < 0)
+            start += len;
+        if (end < 0)
+            end += len;
+        start = std::max(0, std::min(start, len));
+        end = std::max(start, std::min(end, len));
+        TensorView v = *this;
+        v._shape[axis] = (end - start + step - 1) / step;
+        v._strides[axis] = _strides[axis] * step;
+        v._data = (uint8_t *)_data + (ptrdiff_t)start * _strides[axis] * dtype_size[_dtype];
+        return v;
+    }
+
+    TensorView TensorView::transpose(const std::vector<int> &perm) const
+    {
+        int nd = ndim();
+        if ((int)perm.size() != nd)
+        {
+            throw err::Exception(err::ERR_ARGS, "transpose perm size not match");
+        }
+        std::vector<bool> used(nd, false);
+        TensorView v = *this;
+        for (int i = 0; i < nd; ++i)
+        {
+            int p = perm[i];
+            if (p < 0 || p >= nd || used[p])
+            {
+                throw err::Exception(err::ERR_ARGS, "transpose perm error");
+            }
+            used[p] = true;
+            v._shape[i] = _shape[p];
+            v._strides[i] = _strides[p];
+        }
+        return v;
+    }
+
+    TensorView TensorView::broadcast_to(const std::vector<int> &shape) const
+    {
+        int nd = ndim();
+        int new_nd = (int)shape.size();
+        if (new_nd < nd)
+        {
+            throw err::Exception(err::ERR_ARGS, "broadcast shape has less axes");
+        }
+        TensorView v = *this;
+        v._shape = shape;
+        v._strides.assign(new_nd, 0);
+        for (int i = 0; i < nd; ++i)
+        {
+            int src = nd - 1 - i;
+            int dst = new_nd - 1 - i;
+            if (_shape[src] == shape[dst])
+                v._strides[dst] = _strides[src];
+            else if (_shape[src] != 1)
+            {
+                throw err::Exception(err::ERR_ARGS, "broadcast shape not compatible");
+            }
+        }
+        return v;
+    }
+
+    TensorView TensorView::reshape(const std::vector<int> &shape) const
+    {
+        int size = 1;
+        for (auto s : shape)
+            size *= s;
+        if (size != this->size())
+        {
+            throw err::Exception(err::ERR_ARGS, "reshape size not match");
+        }
+        if (!is_contiguous())
+        {
+            throw err::Exception(err::ERR_ARGS, "reshape only support contiguous view, copy_to first");
+        }
+        return TensorView(_data, _dtype, shape);
+    }
+
+    void *TensorView::ptr(const std::vector<int> &index) const
+    {
+        ptrdiff_t offset = 0;
+        size_t n = std::min(index.size(), _strides.size());
+        for (size_t i = 0; i < n; ++i)
+            offset += (ptrdiff_t)index[i] * _strides[i];
+        return (uint8_t *)_data + offset * dtype_size[_dtype];
+    }
+
+    /**
+     * Call f(row, n, stride, out_offset) for every innermost row of view in row major order,
+     * adjacent axes stored contiguously are merged first so contiguous views are one single row.
+     * row: pointer of first element, n: elements, stride: in elements, out_offset: index of first element in row major order.
+     */
+    template <typename F>
+    static void _for_each_row(const TensorView &v, F f)
+    {
+        int total = v.size();
+        if (total <= 0)
+            return;
+        const std::vector<int> &shape0 = v.shape();
+        const std::vector<int> &strides0 = v.strides();
+        // drop size 1 axes and merge axes can be walked as one
+        int shape[16], strides[16];
+        int nd = 0;
+        for (size_t i = 0; i < shape0.size(); ++i)
+        {
+            if (shape0[i] == 1)
+                continue;
+            if (nd > 0 && strides[nd - 1] == strides0[i] * shape0[i])
+            {
+                shape[nd - 1] *= shape0[i];
+                strides[nd - 1] = strides0[i];
+                continue;
+            }
+            if (nd >= 16)
+            {
+                throw err::Exception(err::ERR_ARGS, "too many axes");
+            }
+            shape[nd] = shape0[i];
+            strides[nd] = strides0[i];
+            ++nd;
+        }
+        int esize = dtype_size[v.dtype()];
+        if (nd == 0)
+        {
+            f((const uint8_t *)v.data(), 1, 1, 0);
+            return;
+        }
+        int n = shape[nd - 1];
+        int stride = strides[nd - 1];
+        int idx[16] = {0};
+        const uint8_t *p = (const uint8_t *)v.data();
+        for (int out = 0; out < total; out += n)
+        {
+            f(p, n, stride, out);
+            // next row, carry like a counter
+            for (int i = nd - 2; i >= 0; --i)
+            {
+                p += (ptrdiff_t)strides[i] * esize;
+                if (++idx[i] < shape[i])
+                    break;
+                p -= (ptrdiff_t)strides[i] * shape[i] * esize;
+                idx[i] = 0;
+            }
+        }
+    }
+
+    template <typename T>
+    static inline void _copy_row(const uint8_t *row, int n, int stride, T *__restrict out)
+    {
+        const T *in = (const T *)row;
+        for (int i = 0; i < n; ++i)
+            out[i] = in[(ptrdiff_t)i * stride];
+    }
+
+    void TensorView::copy_to(void *out) const
+    {
+        int esize = dtype_size[_dtype];
+        uint8_t *dst = (uint8_t *)out;
+        _for_each_row(*this, [&](const uint8_t *row, int n, int stride, int offset) {
+            uint8_t *o = dst + (ptrdiff_t)offset * esize;
+            if (stride == 1)
+            {
+                memcpy(o, row, (size_t)n * esize);
+                return;
+            }
+            switch (esize)
+            {
+            case 1:
+                _copy_row<uint8_t>(row, n, stride, o);
+                break;
+            case 2:
+                _copy_row<uint16_t>(row, n, stride, (uint16_t *)o);
+                break;
+            case 4:
+                _copy_row<uint32_t>(row, n, stride, (uint32_t *)o);
+                break;
+            default:
+                for (int i = 0; i < n; ++i)
+                    memcpy(o + (ptrdiff_t)i * esize, row + (ptrdiff_t)i * stride * esize, esize);
+                break;
+            }
+        });
+    }
+
+    // contiguous rows are separate loops so compiler can vectorize them, out may be the same memory as row
+    template <typename T>
+    static inline void _dequant_row(const uint8_t *row, int n, int stride, float *out, float scale, int zero_point)
+    {
+        const T *in = (const T *)row;
+        float zp = (float)zero_point;
+        if (stride == 1)
+        {
+            for (int i = 0; i < n; ++i)
+                out[i] = ((float)in[i] - zp) * scale;
+        }
+        else
+        {
+            for (int i = 0; i < n; ++i)
+                out[i] = ((float)in[(ptrdiff_t)i * stride] - zp) * scale;
+        }
+    }
+
+    static inline void _dequant_row_fp16(const uint8_t *row, int n, int stride, float *__restrict out, float scale, int zero_point)
+    {
+        const uint16_t *in = (const uint16_t *)row;
+        float zp = (float)zero_point;
+        for (int i = 0; i < n; ++i)
+            out[i] = (fp16_to_fp32(in[(ptrdiff_t)i * stride]) - zp) * scale;
+    }
+
+    void to_float(const TensorView &in, float *out, float scale, int zero_point)
+    {
+        tensor::DType dtype = in.dtype();
+        switch (dtype)
+        {
+        case DType::UINT8:
+        case DType::INT8:
+        case DType::UINT16:
+        case DType::INT16:
+        case DType::INT32:
+        case DType::FLOAT16:
+        case DType::FLOAT32:
+            break;
+        default:
+            throw err::Exception(err::ERR_ARGS, "to_float not support dtype " + dtype_name[dtype]);
+        }
+        bool identity = scale == 1.0f && zero_point == 0;
+        _for_each_row(in, [&](const uint8_t *row, int n, int stride, int offset) {
+            float *o = out + offset;
+            switch (dtype)
+            {
+            case DType::UINT8:
+                _dequant_row<uint8_t>(row, n, stride, o, scale, zero_point);
+                break;
+            case DType::INT8:
+                _dequant_row<int8_t>(row, n, stride, o, scale, zero_point);
+                break;
+            case DType::UINT16:
+                _dequant_row<uint16_t>(row, n, stride, o, scale, zero_point);
+                break;
+            case DType::INT16:
+                _dequant_row<int16_t>(row, n, stride, o, scale, zero_point);
+                break;
+            case DType::INT32:
+                _dequant_row<int32_t>(row, n, stride, o, scale, zero_point);
+                break;
+            case DType::FLOAT16:
+                _dequant_row_fp16(row, n, stride, o, scale, zero_point);
+                break;
+            default:
+                if (identity)
+                {
+                    if (stride == 1)
+                    {
+                        if ((const void *)row != (const void *)o)
+                            memmove(o, row, (size_t)n * sizeof(float));
+                    }
+                    else
+                        _copy_row<float>(row, n, stride, o);
+                }
+                else
+                    _dequant_row<float>(row, n, stride, o, scale, zero_point);
+                break;
+            }
+        });
+    }
+
+    template <typename T>
+    static void _quantize(const float *__restrict in, int num, T *__restrict out, float scale, int zero_point, float min, float max)
+    {
+        float inv_scale = 1.0f / scale;
+        float zp = (float)zero_point;
+        for (int i = 0; i < num; ++i)
+        {
+            float v = floorf(in[i] * inv_scale + 0.5f) + zp;   // round half up
+            v = v < min ? min : (v > max ? max : v);
+            out[i] = (T)v;
+        }
+    }
+
+    void quantize(const float *in, int num, void *out, tensor::DType dtype, float scale, int zero_point)
+    {
+        if (scale == 0)
+        {
+            throw err::Exception(err::ERR_ARGS, "quantize scale is 0");
+        }
+        switch (dtype)
+        {
+        case DType::UINT8:
+            _quantize<uint8_t>(in, num, (uint8_t *)out, scale, zero_point, 0, 255);
+            break;
+        case DType::INT8:
+            _quantize<int8_t>(in, num, (int8_t *)out, scale, zero_point, -128, 127);
+            break;
+        case DType::UINT16:
+            _quantize<uint16_t>(in, num, (uint16_t *)out, scale, zero_point, 0, 65535);
+            break;
+        case DType::INT16:
+            _quantize<int16_t>(in, num, (int16_t *)out, scale, zero_point, -32768, 32767);
+            break;
+        case DType::INT32:
+            // float can't represent INT32_MAX, use the largest float below it
+            _quantize<int32_t>(in, num, (int32_t *)out, scale, zero_point, -2147483648.0f, 2147483520.0f);
+            break;
+        case DType::FLOAT16:
+        {
+            float inv_scale = 1.0f / scale;
+            uint16_t *o = (uint16_t *)out;
+            for (int i = 0; i < num; ++i)
+                o[i] = fp32_to_fp16(in[i] * inv_scale + zero_point);
+            break;
+        }
+        default:
+            throw err::Exception(err::ERR_ARGS, "quantize not support dtype " + dtype_name[dtype]);
+        }
+    }
+
+    void sigmoid(const TensorView &in, float *out, float scale, int zero_point)
+    {
+        to_float(in, out, scale, zero_point);
+        int num = in.size();
+        for (int i = 0; i < num; ++i)
+            out[i] = 1.0f / (1.0f + expf(-out[i]));
+    }
+
+    void softmax(const TensorView &in, int axis, float *out, float scale, int zero_point)
+    {
+        int nd = in.ndim();
+        if (axis < 0)
+            axis += nd;
+        if (axis < 0 || axis >= nd)
+        {
+            throw err::Exception(err::ERR_ARGS, "softmax axis error");
+        }
+        to_float(in, out, scale, zero_point);
+        const std::vector<int> &shape = in.shape();
+        int outer = 1, inner = 1;
+        int len = shape[axis];
+        for (int i = 0; i < axis; ++i)
+            outer *= shape[i];
+        for (int i = axis + 1; i < nd; ++i)
+            inner *= shape[i];
+        if (len <= 0)
+            return;
+        for (int o = 0; o < outer; ++o)
+        {
+            float *base = out + (ptrdiff_t)o * len * inner;
+            for (int j = 0; j < inner; ++j)
+            {
+                float *p = base + j;
+                float largest = p[0];
+                for (int i = 1; i < len; ++i)
+                {
+                    if (p[(ptrdiff_t)i * inner] > largest)
+                        largest = p[(ptrdiff_t)i * inner];
+                }
+                float sum = 0;
+                for (int i = 0; i < len; ++i)
+                {
+                    float e = expf(p[(ptrdiff_t)i * inner] - largest);
+                    p[(ptrdiff_t)i * inner] = e;
+                    sum += e;
+                }
+                float inv_sum = 1.0f / sum;
+                for (int i = 0; i < len; ++i)
+                    p[(ptrdiff_t)i * inner] *= inv_sum;
+            }
+        }
+    }
+
+    void transpose(const TensorView &in, const std::vector<int> &perm, void *out)
+    {
+        in.transpose(perm).copy_to(out);
+    }
+
+    void nchw_to_nhwc(const TensorView &in, void *out)
+    {
+        if (in.ndim() != 4)
+        {
+            throw err::Exception(err::ERR_ARGS, "nchw_to_nhwc need 4 axes");
+        }
+        in.transpose({0, 2, 3, 1}).copy_to(out);
+    }
+
+    void nhwc_to_nchw(const TensorView &in, void *out)
+    {
+        if (in.ndim() != 4)
+        {
+            throw err::Exception(err::ERR_ARGS, "nhwc_to_nchw need 4 axes");
+        }
+        in.transpose({0, 3, 1, 2}).copy_to(out);
+    }
+
+} // namespace maix::tensor
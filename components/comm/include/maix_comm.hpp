@@ -158,8 +158,53 @@ namespace maix
              */
             err::Err resp_err(uint8_t cmd, err::Err code, const std::string &msg);
 
+            /**
+             * Send report message, body is gathered from parts without intermediate copy
+             * @param cmd CMD value
+             * @param parts report body parts
+             * @param num number of parts
+             * @return send report error code, maix.err.Err type
+             * @maixcdk maix.comm.CommProtocol.report
+             */
+            err::Err report(uint8_t cmd, const protocol::BodyPart *parts, int num);
+
+            /**
+             * Set TX queue, messages are encoded into a preallocated queue and sent by a background thread,
+             * queued messages are sent together in one write, so send functions return without waiting for the device.
+             * @param size queue buffer size in bytes, max message length is size / 2, 0 means no queue, send in caller thread.
+             * @return error code, maix.err.Err type, err.ERR_NOT_PERMIT for socket transports(tcp, udp, unix),
+             *         they never block on write and route responses to the peer of last read frame when written.
+             * @maixpy maix.comm.CommProtocol.set_tx_queue
+             */
+            err::Err set_tx_queue(int size = 8192);
+
+            /**
+             * Set what to do when TX queue is full for a CMD, default is protocol.TxPolicy.TX_BLOCK without timeout.
+             * E.g. use TX_DROP_OLD for high rate reports to always send the latest data.
+             * @param cmd CMD value
+             * @param policy policy when queue full
+             * @param timeout max wait time in ms for TX_BLOCK, -1 means wait forever.
+             * @maixpy maix.comm.CommProtocol.set_tx_policy
+             */
+            void set_tx_policy(uint8_t cmd, protocol::TxPolicy policy, int timeout = -1);
+
+            /**
+             * Wait until all queued messages are sent, return immediately if no TX queue.
+             * @param timeout max wait time in ms, -1 means wait forever.
+             * @return err.Err.ERR_NONE if all sent, err.Err.ERR_TIMEOUT if timeout.
+             * @maixpy maix.comm.CommProtocol.flush
+             */
+            err::Err flush(int timeout = -1);
+
+            /**
+             * Number of messages dropped because TX queue full
+             * @maixpy maix.comm.CommProtocol.tx_dropped
+             */
+            uint64_t tx_dropped();
+
         private:
             void execute_cmd(protocol::MSG* msg);
+            err::Err _send(uint8_t cmd, uint8_t flags, const protocol::BodyPart *parts, int num, uint8_t code = 0xFF);
 
         private:
             protocol::Protocol *_p;
@@ -168,6 +213,7 @@ namespace maix
             CommBase *_get_comm_obj(const std::string &method);
             uint8_t  *_tmp_buff;
             int       _tmp_buff_len;
+            void     *_tx;
         };
     } // namespace comm
 } // namespace maix
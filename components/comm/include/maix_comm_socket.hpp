@@ -0,0 +1,113 @@
+/**
+ * @author neucrack@sipeed
+ * @copyright Sipeed Ltd 2023-
+ * @license Apache 2.0
+ * @update 2024.12.5: Add socket transports for CommProtocol.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include "maix_err.hpp"
+#include "maix_type.hpp"
+#include "maix_comm_base.hpp"
+
+namespace maix::comm
+{
+    /**
+     * Socket transport of maix.protocol frames, TCP, UDP(unicast or multicast) or Unix domain socket.
+     * Serve many peers at the same time with non-blocking sockets on one epoll, no thread is created.
+     * Received data is split into frames per peer, read() returns bytes of one frame at a time and returns 0 after every frame,
+     * so frames of different peers never mix in the decoder.
+     * Frames written are routed by flags, reports(FLAG_REPORT) are sent to all peers(or the multicast group),
+     * other frames(responses) are sent to the peer of the last read frame when written, so write responses before next read,
+     * CommProtocol refuses TX queue on socket transports for this reason.
+     * Data not accepted by a TCP or Unix socket is queued per peer and sent when writable, a peer too slow is disconnected.
+     * @maixcdk maix.comm.SocketComm
+     */
+    class SocketComm : public comm::CommBase
+    {
+    public:
+        /**
+         * Construct a new SocketComm object, call open() to start listening.
+         * @param url address to listen, format:
+         *            "tcp://ip:port", ip can be empty, means "0.0.0.0".
+         *            "udp://ip:port", if ip is a multicast address(224.0.0.0 ~ 239.255.255.255), join the group and send reports to it.
+         *            "unix:///path/to/socket", stream socket.
+         * @param max_peers max peers at the same time, new TCP and Unix peers are rejected when full,
+         *                  the least recently active UDP peer is replaced when full.
+         * @maixcdk maix.comm.SocketComm.SocketComm
+         */
+        SocketComm(const std::string &url, int max_peers = 8);
+        ~SocketComm();
+
+        /**
+         * Open socket and start listening, if already opened, do nothing and return err.ERR_NONE.
+         * @return open device error code, err.Err type.
+         * @maixcdk maix.comm.SocketComm.open
+         */
+        err::Err open();
+
+        /**
+         * Close socket and all peers, if already closed, do nothing and return err.ERR_NONE.
+         * @return close device error code, err.Err type.
+         * @maixcdk maix.comm.SocketComm.close
+         */
+        err::Err close();
+
+        /**
+         * Check if opened
+         * @return true if opened, else false.
+         * @maixcdk maix.comm.SocketComm.is_open
+         */
+        bool is_open();
+
+        /**
+         * Send frames, reports to all peers, others to the peer of last read frame(dropped if no peer read or it's gone).
+         * Data not started with a frame is sent as responses.
+         * @param buff data buffer, one or more whole frames.
+         * @param len data length
+         * @return len, < 0 means error, value is -err.Err. Sending to a peer failed only disconnects the peer.
+         * @maixcdk maix.comm.SocketComm.write
+         */
+        int write(const uint8_t *buff, int len);
+
+        /**
+         * Send frames, the same as write(buff, len)
+         * @param data data to send
+         * @return sent length, int type, if < 0 means error, value is -err.Err.
+         * @maixcdk maix.comm.SocketComm.write
+         */
+        int write(Bytes &data);
+
+        /**
+         * Receive bytes of one frame, returns 0 once after the last bytes of every frame.
+         * @param buff data buffer to store received data
+         * @param buff_len data buffer length
+         * @param recv_len not used, frames are returned in pieces of at most buff_len bytes.
+         * @param timeout unit ms, 0 means return immediately, -1 means block until data, >0 means block until data or timeout.
+         * @return received data length, < 0 means error, value is -err.Err.
+         * @maixcdk maix.comm.SocketComm.read
+         */
+        int read(uint8_t *buff, int buff_len, int recv_len = -1, int timeout = 0);
+
+        /**
+         * Receive bytes of one frame, the same as read(buff, buff_len, recv_len, timeout)
+         * @param len max data length, -1 means 4096.
+         * @param timeout unit ms, the same as read(buff, buff_len, recv_len, timeout).
+         * @return received data, bytes type, nullptr if error.
+         * @maixcdk maix.comm.SocketComm.read
+         */
+        Bytes *read(int len = -1, int timeout = 0);
+
+        /**
+         * Number of peers, for UDP it's peers ever sent data.
+         * @maixcdk maix.comm.SocketComm.peers
+         */
+        int peers();
+
+    private:
+        void *_data;
+    };
+} // namespace maix::comm
@@ -11,6 +11,7 @@
 #include "maix_basic.hpp"
 #include "maix_uart.hpp"
 #include "maix_comm.hpp"
+#include "maix_comm_socket.hpp"
 
 using namespace maix::peripheral;
 
@@ -28,6 +29,7 @@ using namespace maix::peripheral;
 #include <mutex>
 #include <atomic>
 #include <thread>
+#include <memory>
 #include <unordered_set>
 #include <climits>
 #include "maix_fs.hpp"
@@ -112,9 +114,29 @@ namespace maix::comm
                 log::error("No uart port found");
                 return nullptr;
             }
-            maix::log::debug("Comm uart: %s", ports[ports.size() - 1].c_str());
-            listener_priv::CommFileHandle::write_comm_info(ports[ports.size() - 1]);
-            return new uart::UART(ports[ports.size() - 1], 115200);
+            std::string port = app::get_sys_config_kv("comm", "uart_port", ports[ports.size() - 1]);
+            int baudrate = atoi(app::get_sys_config_kv("comm", "uart_baudrate", "115200").c_str());
+            maix::log::debug("Comm uart: %s, %d", port.c_str(), baudrate);
+            listener_priv::CommFileHandle::write_comm_info(port);
+            return new uart::UART(port, baudrate);
+        }
+        else if (method == "tcp" || method == "udp" || method == "unix")
+        {
+            // e.g. tcp://0.0.0.0:5555, udp://239.0.0.1:5556(multicast), unix:///tmp/maix_comm.sock
+            std::string default_addr = method == "tcp" ? "tcp://0.0.0.0:5555" :
+                                       method == "udp" ? "udp://0.0.0.0:5556" : "unix:///tmp/maix_comm.sock";
+            std::string addr = app::get_sys_config_kv("comm", "addr", default_addr);
+            int max_peers = atoi(app::get_sys_config_kv("comm", "max_peers", "8").c_str());
+            maix::log::debug("Comm socket: %s", addr.c_str());
+            try
+            {
+                return new SocketComm(addr, max_peers);
+            }
+            catch (const err::Exception &e)
+            {
+                log::error("%s", e.what());
+                return nullptr;
+            }
         }
         else
         {
@@ -125,8 +147,42 @@ namespace maix::comm
             listener_priv::CommFileHandle::write_comm_info("/dev/i2c-x"); */
     }
 
+    typedef struct
+    {
+        std::mutex lock;                // serialize encode buffer and write of caller threads, guard ring and thread
+        std::vector<uint8_t> buff;      // encode buffer of caller threads, grows to max message length
+        std::shared_ptr<protocol::TxRing> ring; // callers push on a copy, so set_tx_queue can swap it any time
+        std::thread *thread;
+        uint8_t policy[256];
+        int timeout[256];
+    } comm_tx_t;
+
+    static void _tx_loop(CommBase *comm, std::shared_ptr<protocol::TxRing> ring)
+    {
+        // one write for all messages queued while last write was in progress
+        std::vector<uint8_t> out(ring->size());
+        while (1)
+        {
+            int len = ring->pop(out.data(), out.size(), -1);
+            if (len <= 0)
+                break;
+            int ret = comm->write(out.data(), len);
+            if (ret < 0)
+                log::error("comm write failed: %s", err::to_str((err::Err)-ret).c_str());
+            ring->done();
+        }
+    }
+
     CommProtocol::CommProtocol(int buff_size, uint32_t header)
     {
+        comm_tx_t *tx = new comm_tx_t();
+        tx->thread = nullptr;
+        for (int i = 0; i < 256; ++i)
+        {
+            tx->policy[i] = protocol::TX_BLOCK;
+            tx->timeout[i] = -1;
+        }
+        _tx = tx;
         _tmp_buff_len = 128;
         _tmp_buff = new uint8_t[_tmp_buff_len];
         if (!_tmp_buff)
@@ -153,6 +209,8 @@ namespace maix::comm
 
     CommProtocol::~CommProtocol()
     {
+        set_tx_queue(0);
+        delete (comm_tx_t *)_tx;
         if (_comm)
         {
             _comm->close();
@@ -189,22 +247,14 @@ namespace maix::comm
     static uint32_t find_idx(std::string &id, bool override_id = false)
     {
         // log::info("[%s] Need to find %s, len: %u", __PRETTY_FUNCTION__, id.c_str(), id.size());
-        uint32_t idx = 0;
-        auto apps_info = app::get_apps_info();
-        for (const auto &info : apps_info)
+        int idx = app::find_app(id);
+        if (idx < 0)
+            return UINT32_MAX;
+        if (override_id)
         {
-            // log::info("[%s] %s, len: %u", __PRETTY_FUNCTION__, info.id.c_str(), info.id.size());
-            if (id == info.id)
-            {
-                if (override_id)
-                {
-                    id = app::get_app_path(id);
-                }
-                return idx;
-            }
-            ++idx;
+            id = app::get_app_path(id);
         }
-        return UINT32_MAX;
+        return (uint32_t)idx;
     }
 
     static void debug_show_strings(char *data, uint32_t data_len, uint32_t try_find_cnt = 0)
@@ -225,22 +275,32 @@ namespace maix::comm
         {
         case maix::protocol::CMD_APP_LIST:
         {
-            auto apps_info = app::get_apps_info();
+            std::vector<std::string> ids;
+            int count = app::apps_count();
+            try
+            {
+                for (int i = 0; i < count; ++i)
+                    ids.push_back(app::get_app_info(i).id);
+            }
+            catch (const err::Exception &)
+            {
+                // list reloaded shorter meanwhile, reply apps got
+            }
             uint32_t size = 1;
-            for (const auto &app_info : apps_info)
+            for (const auto &id : ids)
             {
-                size += static_cast<uint32_t>(app_info.id.size());
+                size += static_cast<uint32_t>(id.size());
                 ++size;
             }
             auto buff = new uint8_t[size];
-            buff[0] = static_cast<uint8_t>(apps_info.size() & 0xFF);
+            buff[0] = static_cast<uint8_t>(ids.size() & 0xFF);
             uint32_t index = 1;
-            for (const auto &app_info : apps_info)
+            for (const auto &id : ids)
             {
                 // log::info("[%s:%d] CMD_APP_LIST find app: %s",
-                //             __PRETTY_FUNCTION__, __LINE__, app_info.id.c_str());
-                std::copy(app_info.id.begin(), app_info.id.end(), buff + index);
-                index += app_info.id.size();
+                //             __PRETTY_FUNCTION__, __LINE__, id.c_str());
+                std::copy(id.begin(), id.end(), buff + index);
+                index += id.size();
                 buff[index++] = '\0';
             }
             // debug_show_strings((char*)buff+1, size-1);
@@ -305,8 +365,7 @@ namespace maix::comm
             {
                 /* idx WITH ARG */
                 // log::info("[%s:%d] START APP idx {%u} with arg {%s}", __PRETTY_FUNCTION__, __LINE__, idx, res[0].c_str());
-                auto app_list = app::get_apps_info();
-                if (idx >= app_list.size())
+                if (idx >= app::apps_count())
                 {
                     auto resp_ret = this->resp_err(maix::protocol::CMD_START_APP,
                                                    err::Err::ERR_NOT_FOUND, "app not found with this idx");
@@ -382,7 +441,7 @@ namespace maix::comm
             auto idx = find_idx(res);
             int len = static_cast<int>(res.size() + 2);
             auto buff = new uint8_t[len];
-            if (idx >= app::get_apps_info().size())
+            if (idx >= (uint32_t)app::apps_count())
                 buff[0] = 0xFF; /* app::app_idx() */
             else
                 buff[0] = static_cast<uint8_t>(idx & 0xFF);
@@ -414,8 +473,27 @@ namespace maix::comm
                 msg->has_been_replied = true;
                 break;
             }
-            auto apps_info = app::get_apps_info();
-            if (idx != 0xFF && idx >= apps_info.size())
+            if (idx == 0xFF)
+            {
+                /* find app with id */
+                int i = app::find_app(res[0]);
+                if (i >= 0 && i < 0xFF)
+                    idx = static_cast<uint8_t>(i);
+            }
+            app::APP_Info app_info;
+            bool found = idx != 0xFF;
+            if (found)
+            {
+                try
+                {
+                    app_info = app::get_app_info((int)idx);
+                }
+                catch (const err::Exception &)
+                {
+                    found = false;
+                }
+            }
+            if (!found)
             {
                 auto resp_ret = this->resp_err(maix::protocol::CMD_APP_INFO, err::Err::ERR_ARGS, "ERROR ARGS");
                 if (resp_ret != err::Err::ERR_NONE)
@@ -426,13 +504,6 @@ namespace maix::comm
                 msg->has_been_replied = true;
                 break;
             }
-            if (idx == 0xFF)
-            {
-                /* find app with id */
-                idx = static_cast<uint8_t>(find_idx(res[0]));
-            }
-            /* find app with idx */
-            auto &app_info = apps_info.at(idx);
             uint32_t size = 1 + app_info.id.size() + 1 + app_info.name.size() + 1 + app_info.desc.size() + 1;
             auto buff = new uint8_t[size];
             buff[0] = idx;
@@ -504,6 +575,13 @@ namespace maix::comm
 
     err::Err CommProtocol::resp_ok(uint8_t *buff, int buff_len, uint8_t cmd, uint8_t *body, int body_len)
     {
+        comm_tx_t *tx = (comm_tx_t *)_tx;
+        std::unique_lock<std::mutex> lock(tx->lock);
+        if (tx->ring)
+        {
+            lock.unlock();
+            return resp_ok(cmd, body, body_len);
+        }
         int len = _p->encode_resp_ok(buff, buff_len, cmd, body, body_len);
         if (len < 0)
         {
@@ -519,38 +597,25 @@ namespace maix::comm
 
     err::Err CommProtocol::resp_ok(uint8_t cmd, uint8_t *body, int body_len)
     {
-        Bytes *buff = _p->encode_resp_ok(cmd, body, body_len);
-        if (!buff)
-        {
-            return err::ERR_RUNTIME;
-        }
-        int len = _comm->write(buff->data, buff->size());
-        delete buff;
-        if (len < 0)
-        {
-            return (err::Err)-len;
-        }
-        return err::ERR_NONE;
+        protocol::BodyPart part = {body, body_len};
+        return _send(cmd, protocol::FLAG_RESP | protocol::FLAG_RESP_OK, &part, 1);
     }
 
     err::Err CommProtocol::resp_ok(uint8_t cmd, Bytes *body)
     {
-        Bytes *buff = _p->encode_resp_ok(cmd, body);
-        if (!buff)
-        {
-            return err::ERR_RUNTIME;
-        }
-        int len = _comm->write(buff->data, buff->size());
-        delete buff;
-        if (len < 0)
-        {
-            return (err::Err)-len;
-        }
-        return err::ERR_NONE;
+        protocol::BodyPart part = {body ? body->data : nullptr, body ? (int)body->size() : 0};
+        return _send(cmd, protocol::FLAG_RESP | protocol::FLAG_RESP_OK, &part, 1);
     }
 
     err::Err CommProtocol::report(uint8_t *buff, int buff_len, uint8_t cmd, uint8_t *body, int body_len)
     {
+        comm_tx_t *tx = (comm_tx_t *)_tx;
+        std::unique_lock<std::mutex> lock(tx->lock);
+        if (tx->ring)
+        {
+            lock.unlock();
+            return report(cmd, body, body_len);
+        }
         int len = _p->encode_report(buff, buff_len, cmd, body, body_len);
         if (len < 0)
         {
@@ -566,29 +631,36 @@ namespace maix::comm
 
     err::Err CommProtocol::report(uint8_t cmd, uint8_t *body, int body_len)
     {
-        Bytes *buff = _p->encode_report(cmd, body, body_len);
-        if (!buff)
-        {
-            return err::ERR_RUNTIME;
-        }
-        int len = _comm->write(buff->data, buff->size());
-        delete buff;
-        if (len < 0)
-        {
-            return (err::Err)-len;
-        }
-        return err::ERR_NONE;
+        protocol::BodyPart part = {body, body_len};
+        return _send(cmd, protocol::FLAG_RESP | protocol::FLAG_RESP_OK | protocol::FLAG_REPORT, &part, 1);
     }
 
     err::Err CommProtocol::report(uint8_t cmd, Bytes *body)
     {
-        Bytes *buff = _p->encode_report(cmd, body);
-        if (!buff)
+        protocol::BodyPart part = {body ? body->data : nullptr, body ? (int)body->size() : 0};
+        return _send(cmd, protocol::FLAG_RESP | protocol::FLAG_RESP_OK | protocol::FLAG_REPORT, &part, 1);
+    }
+
+    err::Err CommProtocol::report(uint8_t cmd, const protocol::BodyPart *parts, int num)
+    {
+        return _send(cmd, protocol::FLAG_RESP | protocol::FLAG_RESP_OK | protocol::FLAG_REPORT, parts, num);
+    }
+
+    err::Err CommProtocol::resp_err(uint8_t *buff, int buff_len, uint8_t cmd, err::Err code, const std::string &msg)
+    {
+        comm_tx_t *tx = (comm_tx_t *)_tx;
+        std::unique_lock<std::mutex> lock(tx->lock);
+        if (tx->ring)
         {
-            return err::ERR_RUNTIME;
+            lock.unlock();
+            return resp_err(cmd, code, msg);
         }
-        int len = _comm->write(buff->data, buff->size());
-        delete buff;
+        int len = _p->encode_resp_err(buff, buff_len, cmd, code, msg);
+        if (len < 0)
+        {
+            return (err::Err)-len;
+        }
+        len = _comm->write(buff, len);
         if (len < 0)
         {
             return (err::Err)-len;
@@ -596,14 +668,37 @@ namespace maix::comm
         return err::ERR_NONE;
     }
 
-    err::Err CommProtocol::resp_err(uint8_t *buff, int buff_len, uint8_t cmd, err::Err code, const std::string &msg)
+    err::Err CommProtocol::resp_err(uint8_t cmd, err::Err code, const std::string &msg)
     {
-        int len = _p->encode_resp_err(buff, buff_len, cmd, code, msg);
+        protocol::BodyPart part = {(const uint8_t *)msg.c_str(), (int)msg.length()};
+        return _send(cmd, protocol::FLAG_RESP | protocol::FLAG_RESP_ERR, &part, 1, code);
+    }
+
+    err::Err CommProtocol::_send(uint8_t cmd, uint8_t flags, const protocol::BodyPart *parts, int num, uint8_t code)
+    {
+        comm_tx_t *tx = (comm_tx_t *)_tx;
+        std::unique_lock<std::mutex> lock(tx->lock);
+        if (tx->ring)
+        {
+            // push may block, don't hold lock, ring is kept alive by the copy even if queue removed meanwhile
+            std::shared_ptr<protocol::TxRing> ring = tx->ring;
+            protocol::TxPolicy policy = (protocol::TxPolicy)tx->policy[cmd];
+            int timeout = tx->timeout[cmd];
+            lock.unlock();
+            return ring->push(cmd, flags, parts, num, code, policy, timeout);
+        }
+        int body_len = 0;
+        for (int i = 0; i < num; ++i)
+            body_len += parts[i].len > 0 ? parts[i].len : 0;
+        int len = protocol::encoded_len(body_len, code);
+        if ((int)tx->buff.size() < len)
+            tx->buff.resize(len);
+        len = protocol::encode_parts(tx->buff.data(), tx->buff.size(), cmd, flags, parts, num, code);
         if (len < 0)
         {
             return (err::Err)-len;
         }
-        len = _comm->write(buff, len);
+        len = _comm->write(tx->buff.data(), len);
         if (len < 0)
         {
             return (err::Err)-len;
@@ -611,22 +706,63 @@ namespace maix::comm
         return err::ERR_NONE;
     }
 
-    err::Err CommProtocol::resp_err(uint8_t cmd, err::Err code, const std::string &msg)
+    err::Err CommProtocol::set_tx_queue(int size)
     {
-        Bytes *buff = _p->encode_resp_err(cmd, code, msg);
-        if (!buff)
+        comm_tx_t *tx = (comm_tx_t *)_tx;
+        if (size < 0 || (size > 0 && size < 64))
+            return err::ERR_ARGS;
+        if (size > 0 && (_comm_method == "tcp" || _comm_method == "udp" || _comm_method == "unix"))
         {
-            return err::ERR_RUNTIME;
+            // SocketComm sends a response to the peer of last read frame at write time, a queued response may
+            // be written after next frame read and go to the wrong peer, its writes never block anyway.
+            log::warn("comm %s not support tx queue", _comm_method.c_str());
+            return err::ERR_NOT_PERMIT;
         }
-        int len = _comm->write(buff->data, buff->size());
-        delete buff;
-        if (len < 0)
+        // hold lock until new queue is set, so messages sent meanwhile wait and keep order
+        std::lock_guard<std::mutex> lock(tx->lock);
+        if (tx->ring)
         {
-            return (err::Err)-len;
+            // send all queued messages before remove queue, writer thread never takes lock,
+            // pushes blocked on full ring are woken up by close and return error
+            tx->ring->close();
+            tx->thread->join();
+            delete tx->thread;
+            tx->thread = nullptr;
+            tx->ring.reset();
         }
+        if (size == 0)
+            return err::ERR_NONE;
+        tx->ring = std::make_shared<protocol::TxRing>(size);
+        tx->thread = new std::thread(_tx_loop, _comm, tx->ring);
         return err::ERR_NONE;
     }
 
+    void CommProtocol::set_tx_policy(uint8_t cmd, protocol::TxPolicy policy, int timeout)
+    {
+        comm_tx_t *tx = (comm_tx_t *)_tx;
+        std::lock_guard<std::mutex> lock(tx->lock);
+        tx->policy[cmd] = policy;
+        tx->timeout[cmd] = timeout;
+    }
+
+    err::Err CommProtocol::flush(int timeout)
+    {
+        comm_tx_t *tx = (comm_tx_t *)_tx;
+        std::unique_lock<std::mutex> lock(tx->lock);
+        std::shared_ptr<protocol::TxRing> ring = tx->ring;
+        lock.unlock();
+        if (!ring)
+            return err::ERR_NONE;
+        return ring->wait_empty(timeout) ? err::ERR_NONE : err::ERR_TIMEOUT;
+    }
+
+    uint64_t CommProtocol::tx_dropped()
+    {
+        comm_tx_t *tx = (comm_tx_t *)_tx;
+        std::lock_guard<std::mutex> lock(tx->lock);
+        return tx->ring ? tx->ring->dropped() : 0;
+    }
+
     void add_default_comm_listener()
     {
         comm::listener_priv::CommListener &listener = comm::listener_priv::CommListener::get_instance();
@@ -0,0 +1,621 @@
+/**
+ * @author neucrack@sipeed
+ * @copyright Sipeed Ltd 2023-
+ * @license Apache 2.0
+ * @update 2024.12.5: Add socket transports for CommProtocol.
+ */
+
+#include "maix_comm_socket.hpp"
+#include "maix_protocol.hpp"
+#include "maix_basic.hpp"
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <algorithm>
+#include <vector>
+#include <mutex>
+
+namespace maix::comm
+{
+    #define SOCK_FRAME_MAX   65536          // max frame length accepted from peers
+    #define SOCK_RX_MAX      (SOCK_FRAME_MAX * 2)
+    #define SOCK_TX_MAX      (256 * 1024)   // peer is disconnected if more data not sent
+    #define SOCK_DGRAM_MAX   65507
+
+    typedef struct
+    {
+        uint64_t id;                    // never reused, identify peer in epoll events
+        int fd;                         // -1 for datagram peer
+        struct sockaddr_storage addr;
+        socklen_t addr_len;
+        std::vector<uint8_t> rx;        // received data not delivered yet
+        std::vector<uint8_t> tx;        // data not sent yet because socket buffer full
+        bool wait_out;                  // EPOLLOUT enabled
+        uint64_t last_ms;
+    } sock_peer_t;
+
+    typedef struct
+    {
+        std::string url;
+        int type;                       // SOCK_STREAM or SOCK_DGRAM
+        struct sockaddr_storage addr;   // listen address
+        socklen_t addr_len;
+        struct sockaddr_storage group;  // report destination of UDP multicast
+        socklen_t group_len;
+        int max_peers;
+        int fd;
+        int epoll_fd;
+        std::vector<sock_peer_t *> peers;
+        uint64_t next_id;               // id of next peer, 0 is listen socket
+        sock_peer_t *cur;               // peer of last read frame, responses are sent to it
+        int cur_left;                   // bytes of current frame not read yet
+        bool boundary;                  // whole frame read, next read returns 0
+        size_t next;                    // peer to check first, round robin
+        std::vector<uint8_t> dgram_buff;
+        std::mutex lock;
+    } sock_comm_t;
+
+    static bool _parse_url(sock_comm_t *s)
+    {
+        const std::string &url = s->url;
+        memset(&s->addr, 0, sizeof(s->addr));
+        memset(&s->group, 0, sizeof(s->group));
+        s->group_len = 0;
+        if (url.compare(0, 7, "unix://") == 0)
+        {
+            std::string path = url.substr(7);
+            struct sockaddr_un *un = (struct sockaddr_un *)&s->addr;
+            if (path.empty() || path.size() >= sizeof(un->sun_path))
+                return false;
+            un->sun_family = AF_UNIX;
+            strcpy(un->sun_path, path.c_str());
+            s->addr_len = sizeof(struct sockaddr_un);
+            s->type = SOCK_STREAM;
+            return true;
+        }
+        if (url.compare(0, 6, "tcp://") == 0)
+            s->type = SOCK_STREAM;
+        else if (url.compare(0, 6, "udp://") == 0)
+            s->type = SOCK_DGRAM;
+        else
+            return false;
+        std::string host_port = url.substr(6);
+        size_t pos = host_port.rfind(':');
+        if (pos == std::string::npos)
+            return false;
+        std::string host = host_port.substr(0, pos);
+        int port = atoi(host_port.c_str() + pos + 1);
+        if (port <= 0 || port > 65535)
+            return false;
+        struct sockaddr_in *in = (struct sockaddr_in *)&s->addr;
+        in->sin_family = AF_INET;
+        in->sin_port = htons(port);
+        in->sin_addr.s_addr = htonl(INADDR_ANY);
+        if (!host.empty() && inet_pton(AF_INET, host.c_str(), &in->sin_addr) != 1)
+            return false;
+        s->addr_len = sizeof(struct sockaddr_in);
+        if (s->type == SOCK_DGRAM && IN_MULTICAST(ntohl(in->sin_addr.s_addr)))
+        {
+            memcpy(&s->group, in, sizeof(struct sockaddr_in));
+            s->group_len = sizeof(struct sockaddr_in);
+            in->sin_addr.s_addr = htonl(INADDR_ANY);
+        }
+        return true;
+    }
+
+    SocketComm::SocketComm(const std::string &url, int max_peers)
+    {
+        sock_comm_t *s = new sock_comm_t();
+        s->url = url;
+        if (!_parse_url(s))
+        {
+            delete s;
+            throw err::Exception(err::ERR_ARGS, "invalid socket url: " + url);
+        }
+        s->max_peers = max_peers > 0 ? max_peers : 1;
+        s->fd = -1;
+        s->epoll_fd = -1;
+        s->next_id = 1;
+        s->cur = nullptr;
+        s->cur_left = 0;
+        s->boundary = false;
+        s->next = 0;
+        _data = s;
+    }
+
+    SocketComm::~SocketComm()
+    {
+        close();
+        delete (sock_comm_t *)_data;
+    }
+
+    static void _epoll_set(sock_comm_t *s, sock_peer_t *p, bool out)
+    {
+        struct epoll_event ev;
+        ev.events = EPOLLIN | (out ? (uint32_t)EPOLLOUT : 0u);
+        ev.data.u64 = p->id;
+        epoll_ctl(s->epoll_fd, EPOLL_CTL_MOD, p->fd, &ev);
+        p->wait_out = out;
+    }
+
+    static void _remove_peer(sock_comm_t *s, sock_peer_t *p)
+    {
+        if (p->fd >= 0)
+        {
+            epoll_ctl(s->epoll_fd, EPOLL_CTL_DEL, p->fd, nullptr);
+            ::close(p->fd);
+        }
+        if (s->cur == p)
+        {
+            s->cur = nullptr;
+            if (s->cur_left > 0) // end the broken frame, decoder drops it by CRC
+            {
+                s->cur_left = 0;
+                s->boundary = true;
+            }
+        }
+        s->peers.erase(std::find(s->peers.begin(), s->peers.end(), p));
+        delete p;
+    }
+
+    static sock_peer_t *_new_peer(sock_comm_t *s, int fd, const struct sockaddr_storage *addr, socklen_t addr_len)
+    {
+        sock_peer_t *p = new sock_peer_t();
+        p->id = s->next_id++;
+        p->fd = fd;
+        memcpy(&p->addr, addr, addr_len);
+        p->addr_len = addr_len;
+        p->wait_out = false;
+        p->last_ms = time::ticks_ms();
+        s->peers.push_back(p);
+        return p;
+    }
+
+    err::Err SocketComm::open()
+    {
+        sock_comm_t *s = (sock_comm_t *)_data;
+        std::lock_guard<std::mutex> lock(s->lock);
+        if (s->fd >= 0)
+            return err::ERR_NONE;
+        int family = ((struct sockaddr *)&s->addr)->sa_family;
+        int fd = socket(family, s->type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+        {
+            log::error("create socket failed: %s", strerror(errno));
+            return err::ERR_IO;
+        }
+        int on = 1;
+        if (family == AF_UNIX)
+            unlink(((struct sockaddr_un *)&s->addr)->sun_path);
+        else
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (bind(fd, (struct sockaddr *)&s->addr, s->addr_len) < 0)
+        {
+            log::error("bind %s failed: %s", s->url.c_str(), strerror(errno));
+            ::close(fd);
+            return err::ERR_IO;
+        }
+        if (s->type == SOCK_STREAM && listen(fd, s->max_peers) < 0)
+        {
+            log::error("listen %s failed: %s", s->url.c_str(), strerror(errno));
+            ::close(fd);
+            return err::ERR_IO;
+        }
+        if (s->group_len > 0)
+        {
+            struct ip_mreq mreq;
+            mreq.imr_multiaddr = ((struct sockaddr_in *)&s->group)->sin_addr;
+            mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+            if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0)
+            {
+                log::error("join multicast group %s failed: %s", s->url.c_str(), strerror(errno));
+                ::close(fd);
+                return err::ERR_IO;
+            }
+        }
+        int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd < 0)
+        {
+            log::error("create epoll failed: %s", strerror(errno));
+            ::close(fd);
+            return err::ERR_IO;
+        }
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u64 = 0;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+        if (s->type == SOCK_DGRAM)
+            s->dgram_buff.resize(SOCK_DGRAM_MAX);
+        s->fd = fd;
+        s->epoll_fd = epoll_fd;
+        log::info("comm listen on %s", s->url.c_str());
+        return err::ERR_NONE;
+    }
+
+    err::Err SocketComm::close()
+    {
+        sock_comm_t *s = (sock_comm_t *)_data;
+        std::lock_guard<std::mutex> lock(s->lock);
+        if (s->fd < 0)
+            return err::ERR_NONE;
+        while (!s->peers.empty())
+            _remove_peer(s, s->peers.back());
+        ::close(s->epoll_fd);
+        ::close(s->fd);
+        if (((struct sockaddr *)&s->addr)->sa_family == AF_UNIX)
+            unlink(((struct sockaddr_un *)&s->addr)->sun_path);
+        s->fd = -1;
+        s->epoll_fd = -1;
+        s->cur_left = 0;
+        s->boundary = false;
+        return err::ERR_NONE;
+    }
+
+    bool SocketComm::is_open()
+    {
+        return ((sock_comm_t *)_data)->fd >= 0;
+    }
+
+    int SocketComm::peers()
+    {
+        sock_comm_t *s = (sock_comm_t *)_data;
+        std::lock_guard<std::mutex> lock(s->lock);
+        return s->peers.size();
+    }
+
+    static void _append_rx(sock_peer_t *p, const uint8_t *data, int len)
+    {
+        if (p->rx.size() + len > SOCK_RX_MAX)
+        {
+            log::warn("comm peer rx buffer full, drop %d bytes", (int)p->rx.size());
+            p->rx.clear();
+        }
+        p->rx.insert(p->rx.end(), data, data + len);
+        p->last_ms = time::ticks_ms();
+    }
+
+    // send queued data, return false if peer broken
+    static bool _flush_peer(sock_comm_t *s, sock_peer_t *p)
+    {
+        while (!p->tx.empty())
+        {
+            ssize_t n = send(p->fd, p->tx.data(), p->tx.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                    return false;
+                break;
+            }
+            p->tx.erase(p->tx.begin(), p->tx.begin() + n);
+        }
+        if (p->tx.empty() == p->wait_out)
+            _epoll_set(s, p, !p->tx.empty());
+        return true;
+    }
+
+    static bool _send_peer(sock_comm_t *s, sock_peer_t *p, const uint8_t *data, int len)
+    {
+        if (p->fd < 0)
+        {
+            // lost datagram is like lost UART bytes, not an error of peer
+            sendto(s->fd, data, len, MSG_DONTWAIT, (struct sockaddr *)&p->addr, p->addr_len);
+            return true;
+        }
+        if (p->tx.empty())
+        {
+            ssize_t n;
+            do
+            {
+                n = send(p->fd, data, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+            } while (n < 0 && errno == EINTR);
+            if (n < 0)
+            {
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                    return false;
+                n = 0;
+            }
+            data += n;
+            len -= n;
+            if (len == 0)
+                return true;
+        }
+        if (p->tx.size() + len > SOCK_TX_MAX)
+        {
+            log::warn("comm peer too slow, %d bytes not sent, disconnect", (int)(p->tx.size() + len));
+            return false;
+        }
+        p->tx.insert(p->tx.end(), data, data + len);
+        return _flush_peer(s, p);
+    }
+
+    // send to one peer, or all peers if report
+    static void _send(sock_comm_t *s, bool report, const uint8_t *data, int len)
+    {
+        if (len <= 0)
+            return;
+        if (!report)
+        {
+            // only reports are broadcast, response of a peer gone is dropped
+            sock_peer_t *p = s->cur;
+            if (!p)
+            {
+                log::warn("comm no peer to send response, drop %d bytes", len);
+                return;
+            }
+            if (!_send_peer(s, p, data, len))
+                _remove_peer(s, p);
+            return;
+        }
+        if (s->group_len > 0)
+        {
+            sendto(s->fd, data, len, MSG_DONTWAIT, (struct sockaddr *)&s->group, s->group_len);
+            return;
+        }
+        for (size_t i = 0; i < s->peers.size();)
+        {
+            sock_peer_t *peer = s->peers[i];
+            if (_send_peer(s, peer, data, len))
+                ++i;
+            else
+                _remove_peer(s, peer);
+        }
+    }
+
+    static void _accept(sock_comm_t *s)
+    {
+        while (1)
+        {
+            struct sockaddr_storage addr;
+            socklen_t addr_len = sizeof(addr);
+            int fd = accept4(s->fd, (struct sockaddr *)&addr, &addr_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0)
+            {
+                if (errno == EINTR || errno == ECONNABORTED)
+                    continue;
+                break;
+            }
+            if ((int)s->peers.size() >= s->max_peers)
+            {
+                log::warn("comm peers reach max %d, reject new peer", s->max_peers);
+                ::close(fd);
+                continue;
+            }
+            if (addr.ss_family == AF_INET)
+            {
+                int on = 1; // frames are already coalesced by caller
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            }
+            sock_peer_t *p = _new_peer(s, fd, &addr, addr_len);
+            struct epoll_event ev;
+            ev.events = EPOLLIN;
+            ev.data.u64 = p->id;
+            epoll_ctl(s->epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+        }
+    }
+
+    static void _recv_dgram(sock_comm_t *s)
+    {
+        while (1)
+        {
+            struct sockaddr_storage addr;
+            socklen_t addr_len = sizeof(addr);
+            ssize_t n = recvfrom(s->fd, s->dgram_buff.data(), s->dgram_buff.size(), MSG_DONTWAIT, (struct sockaddr *)&addr, &addr_len);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                break;
+            }
+            sock_peer_t *p = nullptr;
+            for (auto peer : s->peers)
+            {
+                if (peer->addr_len == addr_len && memcmp(&peer->addr, &addr, addr_len) == 0)
+                {
+                    p = peer;
+                    break;
+                }
+            }
+            if (!p)
+            {
+                if ((int)s->peers.size() >= s->max_peers)
+                {
+                    sock_peer_t *oldest = *std::min_element(s->peers.begin(), s->peers.end(),
+                                                            [](sock_peer_t *a, sock_peer_t *b) { return a->last_ms < b->last_ms; });
+                    _remove_peer(s, oldest);
+                }
+                p = _new_peer(s, -1, &addr, addr_len);
+            }
+            _append_rx(p, s->dgram_buff.data(), n);
+        }
+    }
+
+    static void _recv_stream(sock_comm_t *s, sock_peer_t *p)
+    {
+        uint8_t buff[4096];
+        while (1)
+        {
+            ssize_t n = recv(p->fd, buff, sizeof(buff), MSG_DONTWAIT);
+            if (n > 0)
+            {
+                _append_rx(p, buff, n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                return;
+            _remove_peer(s, p); // closed by peer or error
+            return;
+        }
+    }
+
+    static void _process(sock_comm_t *s, struct epoll_event *events, int num)
+    {
+        for (int i = 0; i < num; ++i)
+        {
+            uint64_t id = events[i].data.u64;
+            if (id == 0)
+            {
+                if (s->type == SOCK_STREAM)
+                    _accept(s);
+                else
+                    _recv_dgram(s);
+                continue;
+            }
+            // peer may be removed by other thread while waiting or by former events,
+            // find by id, a new peer may got the same address
+            auto it = std::find_if(s->peers.begin(), s->peers.end(), [id](sock_peer_t *peer) { return peer->id == id; });
+            if (it == s->peers.end())
+                continue;
+            sock_peer_t *p = *it;
+            if (events[i].events & EPOLLOUT)
+            {
+                if (!_flush_peer(s, p))
+                {
+                    _remove_peer(s, p);
+                    continue;
+                }
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                _recv_stream(s, p);
+        }
+    }
+
+    // read bytes of current frame, or find next frame, return -1 if no frame
+    static int _deliver(sock_comm_t *s, uint8_t *buff, int buff_len)
+    {
+        if (s->cur_left == 0)
+        {
+            if (s->boundary)
+            {
+                s->boundary = false;
+                return 0;
+            }
+            size_t num = s->peers.size();
+            for (size_t i = 0; i < num && s->cur_left == 0; ++i)
+            {
+                size_t idx = (s->next + i) % num;
+                sock_peer_t *p = s->peers[idx];
+                if (p->rx.empty())
+                    continue;
+                int start = 0;
+                int len = protocol::find_frame(p->rx.data(), p->rx.size(), &start, SOCK_FRAME_MAX);
+                if (start > 0)
+                    p->rx.erase(p->rx.begin(), p->rx.begin() + start);
+                if (len > 0)
+                {
+                    s->cur = p;
+                    s->cur_left = len;
+                    s->next = idx + 1;
+                }
+            }
+            if (s->cur_left == 0)
+                return -1;
+        }
+        int n = std::min(buff_len, s->cur_left);
+        memcpy(buff, s->cur->rx.data(), n);
+        s->cur->rx.erase(s->cur->rx.begin(), s->cur->rx.begin() + n);
+        s->cur_left -= n;
+        if (s->cur_left == 0)
+            s->boundary = true;
+        return n;
+    }
+
+    int SocketComm::read(uint8_t *buff, int buff_len, int recv_len, int timeout)
+    {
+        (void)recv_len;
+        sock_comm_t *s = (sock_comm_t *)_data;
+        if (buff_len <= 0)
+            return -err::ERR_ARGS;
+        std::unique_lock<std::mutex> lock(s->lock);
+        if (s->fd < 0)
+            return -err::ERR_NOT_OPEN;
+        uint64_t t = time::ticks_ms();
+        struct epoll_event events[16];
+        while (1)
+        {
+            int n = _deliver(s, buff, buff_len);
+            if (n >= 0)
+                return n;
+            int wait_ms = timeout;
+            if (timeout > 0)
+            {
+                uint64_t passed = time::ticks_ms() - t;
+                if (passed >= (uint64_t)timeout)
+                    wait_ms = 0;
+                else
+                    wait_ms = timeout - passed;
+            }
+            lock.unlock();
+            int num = epoll_wait(s->epoll_fd, events, sizeof(events) / sizeof(events[0]), wait_ms);
+            lock.lock();
+            if (s->fd < 0)
+                return -err::ERR_NOT_OPEN;
+            if (num < 0 && errno != EINTR)
+                return -err::ERR_IO;
+            if (num > 0)
+                _process(s, events, num);
+            else if (wait_ms == 0)
+                return 0;
+        }
+    }
+
+    Bytes *SocketComm::read(int len, int timeout)
+    {
+        if (len < 0)
+            len = 4096;
+        Bytes *data = new Bytes(nullptr, len);
+        int ret = read(data->data, len, -1, timeout);
+        if (ret < 0)
+        {
+            delete data;
+            return nullptr;
+        }
+        data->data_len = ret;
+        return data;
+    }
+
+    int SocketComm::write(const uint8_t *buff, int len)
+    {
+        sock_comm_t *s = (sock_comm_t *)_data;
+        std::lock_guard<std::mutex> lock(s->lock);
+        if (s->fd < 0)
+            return -err::ERR_NOT_OPEN;
+        // route frames, consecutive frames to the same destination are sent together
+        int pos = 0;        // start of data not sent
+        int route = -1;     // 1: report to all peers, 0: response to current peer
+        int off = 0;
+        while (off < len)
+        {
+            int start = 0;
+            int flen = protocol::find_frame(buff + off, len - off, &start, SOCK_FRAME_MAX);
+            int end = flen > 0 ? off + start + flen : len; // not framed bytes go with the next frame
+            int report = flen > 0 && (buff[off + start + 8] & protocol::FLAG_REPORT) ? 1 : 0;
+            bool full = s->type == SOCK_DGRAM && end - pos > SOCK_DGRAM_MAX;
+            if (route >= 0 && (route != report || full))
+            {
+                _send(s, route, buff + pos, off - pos);
+                pos = off;
+            }
+            route = report;
+            off = end;
+        }
+        if (off > pos)
+            _send(s, route, buff + pos, off - pos);
+        return len;
+    }
+
+    int SocketComm::write(Bytes &data)
+    {
+        return write(data.data, data.data_len);
+    }
+} // namespace maix::comm
@@ -85,6 +85,63 @@ enum class GyroOdr {
     GYRO_ODR_31_25,    // Gyroscope ODR set to 31.25 Hz.
 };
 
+/**
+ * @brief imu sample with timestamp
+ * @maixcdk maix.ext_dev.imu.Sample
+ */
+struct Sample {
+    uint64_t t_us;      // timestamp, unit:us, time::ticks_us() clock for sensor, file time for replay.
+    float acc[3];       // acc x, y, z, unit:g
+    float gyro[3];      // gyro x, y, z, unit:radians/second
+};
+
+/**
+ * Madgwick orientation filter for 6 axis IMU
+ * @maixcdk maix.ext_dev.imu.Madgwick
+ */
+class Madgwick {
+public:
+    /**
+     * @brief Construct a new Madgwick object
+     * @param beta filter gain, larger trusts acc more and converges faster, smaller is smoother.
+     * @maixcdk maix.ext_dev.imu.Madgwick.Madgwick
+     */
+    Madgwick(float beta = 0.1f);
+
+    /**
+     * @brief Update orientation with one sample
+     * @param gyro gyro x, y, z, unit:radians/second
+     * @param acc acc x, y, z, any unit, all 0 means only integrate gyro.
+     * @param dt time since last sample, unit:s
+     * @maixcdk maix.ext_dev.imu.Madgwick.update
+     */
+    void update(const float gyro[3], const float acc[3], float dt);
+
+    /**
+     * @brief Reset orientation
+     * @param acc if not NULL, init roll and pitch from gravity, yaw is 0, or reset to identity.
+     * @maixcdk maix.ext_dev.imu.Madgwick.reset
+     */
+    void reset(const float *acc = nullptr);
+
+    /**
+     * @brief Get quaternion
+     * @param q output [w, x, y, z]
+     * @maixcdk maix.ext_dev.imu.Madgwick.quaternion
+     */
+    void quaternion(float q[4]) const;
+
+    /**
+     * @brief Get euler angles
+     * @param e output [roll, pitch, yaw], unit:degree
+     * @maixcdk maix.ext_dev.imu.Madgwick.euler
+     */
+    void euler(float e[3]) const;
+private:
+    float _beta;
+    float _q[4];
+};
+
 /**
  * QMI8656 driver class
  * @maixpy maix.ext_dev.imu.IMU
@@ -94,7 +151,7 @@ public:
     /**
      * @brief Construct a new IMU object, will open IMU
      *
-     * @param driver driver name, only support "qmi8656"
+     * @param driver driver name, support "qmi8658", and "replay" to only replay gcsv file by start() without hardware.
      * @param i2c_bus i2c bus number. Automatically selects the on-board imu when -1 is passed in.
      * @param addr IMU i2c addr.
      * @param freq IMU freq
@@ -126,6 +183,7 @@ public:
      *
      * @return list type. If only one of the outputs is initialized, only [x,y,z] of that output will be returned.
      *                    If all outputs are initialized, [acc_x, acc_y, acc_z, gyro_x, gyro_y, gyro_z] is returned.
+     * @throw err::Exception with err::ERR_BUSY if sample stream of sensor is running, use read_samples() instead.
      *
      * @maixpy maix.ext_dev.imu.IMU.read
      */
@@ -134,7 +192,7 @@ public:
     /**
      * @brief Caculate calibration, save calibration data to /maixapp/shart/imu_calibration
      * @param time_ms caculate max time, unit:ms
-     * @return err::Err
+     * @return err::Err, err::ERR_BUSY if sample stream of sensor is running.
      *
      * @maixpy maix.ext_dev.imu.IMU.calculate_calibration
      */
@@ -147,6 +205,72 @@ public:
      * @maixpy maix.ext_dev.imu.IMU.get_calibration
     */
     std::vector<double> get_calibration();
+
+    /**
+     * @brief Start background acquisition.
+     * A thread drains sensor FIFO in burst i2c reads and pushes timestamped samples to a ring buffer,
+     * so no sample is lost at high ODR as long as read_samples is called before the ring is full.
+     * Timestamps are estimated on host from read time and sample rate, they are monotonic and evenly spaced.
+     *
+     * @param ring_size ring buffer size in samples, rounded up to power of 2.
+     * @param fusion run Madgwick filter on every sample, then quaternion() and euler() are available.
+     * @param replay_path if not empty, read samples from this gcsv file(written by Gcsv) instead of sensor.
+     * @param replay_realtime replay at the recorded speed, false to replay as fast as read_samples consumes.
+     * @return err::Err
+     *
+     * @maixpy maix.ext_dev.imu.IMU.start
+     */
+    err::Err start(int ring_size = 4096, bool fusion = true, std::string replay_path = "", bool replay_realtime = true);
+
+    /**
+     * @brief Stop background acquisition
+     * @maixpy maix.ext_dev.imu.IMU.stop
+     */
+    void stop();
+
+    /**
+     * @brief Number of samples in ring buffer
+     * @maixpy maix.ext_dev.imu.IMU.available
+     */
+    int available();
+
+    /**
+     * @brief Pop samples from ring buffer, oldest first, no allocation.
+     * @param out output buffer
+     * @param max_num max sample number
+     * @return sample number popped
+     * @maixcdk maix.ext_dev.imu.IMU.read_samples
+     */
+    int read_samples(imu::Sample *out, int max_num);
+
+    /**
+     * @brief Pop samples from ring buffer, oldest first.
+     * @param max_num max sample number, -1 means all.
+     * @return flat list, 7 values every sample: [t, acc_x, acc_y, acc_z, gyro_x, gyro_y, gyro_z, ...],
+     *         t unit:s, acc unit:g, gyro unit:radians/second.
+     * @maixpy maix.ext_dev.imu.IMU.read_samples
+     */
+    std::vector<double> read_samples(int max_num = -1);
+
+    /**
+     * @brief Number of samples dropped since start(), because ring buffer was full or sensor FIFO overflowed(estimated from read interval)
+     * @maixpy maix.ext_dev.imu.IMU.dropped
+     */
+    uint64_t dropped();
+
+    /**
+     * @brief Orientation quaternion of latest sample, need start() with fusion
+     * @return [w, x, y, z], empty if fusion not running.
+     * @maixpy maix.ext_dev.imu.IMU.quaternion
+     */
+    std::vector<float> quaternion();
+
+    /**
+     * @brief Orientation euler angles of latest sample, need start() with fusion
+     * @return [roll, pitch, yaw], unit:degree, empty if fusion not running.
+     * @maixpy maix.ext_dev.imu.IMU.euler
+     */
+    std::vector<float> euler();
 private:
     void* _param;
     std::string _driver;
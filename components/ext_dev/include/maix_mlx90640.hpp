@@ -4,6 +4,7 @@
 #include <vector>
 #include <memory>
 #include <cstdint>
+#include <string>
 
 #include "maix_image.hpp"
 #include "MLX90640_API.h"
@@ -85,6 +86,116 @@ KMatrix to_kmatrix(const CMatrix& matrix);
  */
 CMatrix to_cmatrix(const KMatrix& matrix);
 
+/**
+ * @brief Per pixel calibration table of MLX90640
+ *
+ * Calibration parameters are extracted from EEPROM once and folded into per pixel tables,
+ * grouped by measurement mode and sub page, so converting a frame to temperature
+ * is one branch free loop over contiguous arrays, the compiler can vectorize it.
+ * It does not need the sensor, recorded EEPROM and frame dumps can be converted offline.
+ *
+ * @maixcdk maix.ext_dev.mlx90640.MLX90640Calib
+ */
+class MLX90640Calib final {
+public:
+    MLX90640Calib();
+
+    /**
+     * @brief Load calibration from EEPROM data
+     * @param eeprom EEPROM dump, 832 words.
+     * @return err::Err
+     * @maixcdk maix.ext_dev.mlx90640.MLX90640Calib.load
+     */
+    err::Err load(const uint16_t *eeprom);
+
+    /**
+     * @brief Load calibration from EEPROM dump file
+     * @param path binary file of 832 little endian uint16 words.
+     * @return err::Err
+     * @maixcdk maix.ext_dev.mlx90640.MLX90640Calib.load
+     */
+    err::Err load(const std::string &path);
+
+    /**
+     * @brief Whether calibration is loaded
+     * @maixcdk maix.ext_dev.mlx90640.MLX90640Calib.loaded
+     */
+    bool loaded() const { return _loaded; }
+
+    /**
+     * @brief EEPROM data, 832 words, for saving dump.
+     * @maixcdk maix.ext_dev.mlx90640.MLX90640Calib.eeprom
+     */
+    const uint16_t *eeprom() const { return _ee; }
+
+    /**
+     * @brief Ambient temperature of a frame, unit:℃
+     * @param frame frame data, 834 words, the same as MLX90640_GetFrameData.
+     * @maixcdk maix.ext_dev.mlx90640.MLX90640Calib.ta
+     */
+    float ta(const uint16_t *frame) const;
+
+    /**
+     * @brief Calculate object temperature, the same as MLX90640_CalculateTo.
+     * Only pixels of the frame's sub page are updated, pixels of the other sub page keep last value.
+     * @param frame frame data, 834 words.
+     * @param emissivity emissivity.
+     * @param tr reflected temperature, unit:℃
+     * @param result 768 floats in sensor order, unit:℃
+     * @return sub page number calculated, -1 if not loaded or frame invalid.
+     * @maixcdk maix.ext_dev.mlx90640.MLX90640Calib.calculate
+     */
+    int calculate(const uint16_t *frame, float emissivity, float tr, float *result) const;
+
+private:
+    struct Part {
+        int num;
+        uint16_t idx[MLX90640_PIXEL_NUM / 2];
+        float offset[MLX90640_PIXEL_NUM / 2];
+        float kta[MLX90640_PIXEL_NUM / 2];
+        float kv[MLX90640_PIXEL_NUM / 2];
+        float alpha[MLX90640_PIXEL_NUM / 2];
+        float il[MLX90640_PIXEL_NUM / 2];
+    };
+    bool _loaded;
+    uint16_t _ee[MLX90640_EEPROM_DUMP_NUM];
+    paramsMLX90640 _params;
+    Part _parts[2][2];  // [chess mode][sub page]
+};
+
+/**
+ * @brief Find min, max and center points in one pass
+ *
+ * @param temp temperature data, width * height floats, row major.
+ * @param width data width
+ * @param height data height
+ * @param min output min point, can be nullptr.
+ * @param max output max point, can be nullptr.
+ * @param center output center point, can be nullptr.
+ *
+ * @maixcdk maix.ext_dev.mlx90640.stats
+ */
+void stats(const float *temp, int width, int height, Point *min, Point *max, Point *center);
+
+/**
+ * @brief Render temperature data to pseudo color image
+ *
+ * Temperature is mapped to color with the cmap table directly,
+ * and bilinear upscaled(or downscaled) to the size of out.
+ *
+ * @param temp temperature data, width * height floats, row major.
+ * @param width data width
+ * @param height data height
+ * @param tmin temperature of the first color of cmap.
+ * @param tmax temperature of the last color of cmap.
+ * @param cmap color map.
+ * @param out output image, format must be FMT_RGB888, any size.
+ * @return err::Err
+ *
+ * @maixcdk maix.ext_dev.mlx90640.render
+ */
+err::Err render(const float *temp, int width, int height, float tmin, float tmax, Cmap cmap, ::maix::image::Image &out);
+
 /**
  * @brief MLX90640 (℃)
  * @maixpy maix.ext_dev.mlx90640.MLX90640Celsius
@@ -115,6 +226,59 @@ public:
                     ::maix::ext_dev::mlx90640::Cmap cmap=::maix::ext_dev::mlx90640::Cmap::WHITE_HOT,
                     float temp_min=-1, float temp_max=-1, float emissivity=0.95);
 
+    /**
+     * @brief Construct a new MLX90640Celsius object without sensor, from a recorded EEPROM dump.
+     * Feed recorded frames with update(frame).
+     *
+     * @param eeprom_path EEPROM dump file, 832 little endian uint16 words.
+     * @param cmap The color mapping to be used for generating the pseudo color image.
+     * @param temp_min The minimum reference temperature (in °C), the same as the other constructor.
+     * @param temp_max The maximum reference temperature (in °C), the same as the other constructor.
+     * @param emissivity The emissivity parameter for the MLX90640.
+     * @throw err::Exception if load EEPROM dump failed.
+     *
+     * @maixcdk maix.ext_dev.mlx90640.MLX90640Celsius.MLX90640Celsius
+     */
+    MLX90640Celsius(const std::string &eeprom_path,
+                    ::maix::ext_dev::mlx90640::Cmap cmap=::maix::ext_dev::mlx90640::Cmap::WHITE_HOT,
+                    float temp_min=-1, float temp_max=-1, float emissivity=0.95);
+
+    /**
+     * @brief Update temperature and min, max, center points with a new frame
+     *
+     * @param frame frame data, 834 words, nullptr means read from sensor.
+     * @return err::Err, the last temperature is kept if failed.
+     *
+     * @maixcdk maix.ext_dev.mlx90640.MLX90640Celsius.update
+     */
+    err::Err update(const uint16_t *frame = nullptr);
+
+    /**
+     * @brief Temperature of last update, MLX_W * MLX_H floats, row major, the same orientation as matrix().
+     * @maixcdk maix.ext_dev.mlx90640.MLX90640Celsius.temperature
+     */
+    const float *temperature() const { return _temp; }
+
+    /**
+     * @brief Last frame read from sensor, 834 words, for saving dump.
+     * @maixcdk maix.ext_dev.mlx90640.MLX90640Celsius.frame
+     */
+    const uint16_t *frame() const { return _frame; }
+
+    /**
+     * @brief Calibration table, EEPROM data can be got from it for saving dump.
+     * @maixcdk maix.ext_dev.mlx90640.MLX90640Celsius.calib
+     */
+    const MLX90640Calib &calib() const { return _calib; }
+
+    /**
+     * @brief Render temperature of last update to an existing image, no allocation.
+     * @param out output image, format must be FMT_RGB888, any size, temperature is bilinear scaled to it.
+     * @return err::Err
+     * @maixcdk maix.ext_dev.mlx90640.MLX90640Celsius.image_to
+     */
+    err::Err image_to(::maix::image::Image &out);
+
     /**
      * @brief Retrieves sensor data and returns a temperature matrix of size MLX_H * MLX_W
      *
@@ -139,13 +303,15 @@ public:
      * This function retrieves the thermal data from the sensor and processes it
      * to generate a pseudo-color representation of the temperature distribution.
      *
+     * @param width image width, temperature is bilinear upscaled to it, -1 means MLX_W.
+     * @param height image height, -1 means MLX_H.
      * @return maix::image::Image* A raw pointer to a maix image object.
      *         It is the responsibility of the caller to free this memory
      *         in C/C++ to prevent memory leaks.
      *
      * @maixpy maix.ext_dev.mlx90640.MLX90640Celsius.image
      */
-    ::maix::image::Image* image();
+    ::maix::image::Image* image(int width = -1, int height = -1);
 
     /**
      * @brief Finds the pixel with the minimum temperature from the most recent reading
@@ -197,13 +363,15 @@ public:
      * configured color map and other parameters.
      *
      * @param matrix The temperature matrix to be converted.
+     * @param width image width, temperature is bilinear upscaled to it, -1 means MLX_W.
+     * @param height image height, -1 means MLX_H.
      * @return maix::image::Image* A pointer to the generated image.
      *         It is the responsibility of the caller to free this memory
      *         in C/C++ to prevent memory leaks.
      *
      * @maixpy maix.ext_dev.mlx90640.MLX90640Celsius.image_from
      */
-    ::maix::image::Image* image_from(const CMatrix& matrix);
+    ::maix::image::Image* image_from(const CMatrix& matrix, int width = -1, int height = -1);
 
     /**
      * @brief Finds the pixel with the maximum temperature from the given matrix
@@ -251,14 +419,17 @@ public:
     static Point center_point_from(const CMatrix& matrix);
 
 private:
+    void _range(float &tmin, float &tmax, const Point &min, const Point &max);
+
     Cmap _cmap;
     float _min;
     float _max;
     float _emissivity;
-    uint16_t _eeMLX90640[832];
+    bool _has_sensor;
     uint16_t _frame[834];
     float _mlx90640To[768];
-    paramsMLX90640 _mlx90640;
+    float _temp[768];
+    MLX90640Calib _calib;
     Point _temp_min;
     Point _temp_max;
     Point _center;
@@ -318,13 +489,15 @@ public:
      * This function retrieves the thermal data from the sensor and processes it
      * to generate a pseudo-color representation of the temperature distribution.
      *
+     * @param width image width, temperature is bilinear upscaled to it, -1 means MLX_W.
+     * @param height image height, -1 means MLX_H.
      * @return maix::image::Image* A raw pointer to a maix image object.
      *         It is the responsibility of the caller to free this memory
      *         in C/C++ to prevent memory leaks.
      *
      * @maixpy maix.ext_dev.mlx90640.MLX90640Kelvin.image
      */
-    ::maix::image::Image* image();
+    ::maix::image::Image* image(int width = -1, int height = -1);
 
     /**
      * @brief Finds the pixel with the minimum temperature from the most recent reading
@@ -376,13 +549,15 @@ public:
      * configured color map and other parameters.
      *
      * @param matrix The temperature matrix to be converted.
+     * @param width image width, temperature is bilinear upscaled to it, -1 means MLX_W.
+     * @param height image height, -1 means MLX_H.
      * @return maix::image::Image* A pointer to the generated image.
      *         It is the responsibility of the caller to free this memory
      *         in C/C++ to prevent memory leaks.
      *
      * @maixpy maix.ext_dev.mlx90640.MLX90640Kelvin.image_from
      */
-    ::maix::image::Image* image_from(const KMatrix& matrix);
+    ::maix::image::Image* image_from(const KMatrix& matrix, int width = -1, int height = -1);
 
     /**
      * @brief Finds the pixel with the maximum temperature from the given matrix
@@ -57,9 +57,42 @@ public:
      * @maixpy maix.ext_dev.qmi8658.QMI8658.read
      */
     std::vector<float> read();
+
+    /**
+     * @brief Enable or disable FIFO stream mode.
+     * Sensor buffers at most 128 samples, read_fifo drains them in burst i2c transactions,
+     * so no sample is lost if read_fifo is called before FIFO is full.
+     *
+     * @param enable true to enable, false to disable(bypass mode).
+     * @return err::Err, err::ERR_NOT_READY if not open, err::ERR_IO if sensor not response.
+     *
+     * @maixcdk maix.ext_dev.qmi8658.QMI8658.fifo_enable
+     */
+    err::Err fifo_enable(bool enable);
+
+    /**
+     * @brief Read all samples in FIFO, oldest first, need fifo_enable(true) first.
+     *
+     * @param out output buffer, 6 floats every sample, [acc_x, acc_y, acc_z, gyro_x, gyro_y, gyro_z],
+     *            acc unit is g, gyro unit is degree/s, the same as read().
+     * @param max_num max sample number can be saved in out.
+     * @return sample number read, < 0 means error.
+     *
+     * @maixcdk maix.ext_dev.qmi8658.QMI8658.read_fifo
+     */
+    int read_fifo(float *out, int max_num);
+
+    /**
+     * @brief Sample rate of FIFO in dual mode, unit:Hz.
+     * Sensor runs acc at gyro ODR in dual mode, which is slightly lower than the configured nominal value, e.g. 896.8Hz for GYRO_ODR_1000.
+     *
+     * @maixcdk maix.ext_dev.qmi8658.QMI8658.odr
+     */
+    float odr();
 private:
     void* _data;
     imu::Mode _mode;
+    imu::GyroOdr _gyro_odr;
     std::atomic_bool reset_finished{false};
     std::future<std::pair<int, std::string>> open_future;
     bool open_fut_need_get{false};
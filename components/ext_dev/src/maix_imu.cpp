@@ -2,23 +2,200 @@
 #include "maix_basic.hpp"
 #include "maix_imu.hpp"
 #include "maix_qmi8658.hpp"
+#include <math.h>
+#include <thread>
+#include <mutex>
 
 #define CALIBRATION_DATA_PATH "/maixapp/share/imu_calibration"
 namespace maix::ext_dev::imu {
 
+static const float DEG2RAD = (float)M_PI / 180;
+
+/**
+ * Single producer single consumer ring of samples,
+ * producer is the acquisition thread, consumer is read_samples, no lock needed.
+ */
+class SampleRing {
+public:
+    SampleRing(int size)
+    {
+        uint32_t cap = 1;
+        while (cap < (uint32_t)size)
+            cap <<= 1;
+        _buf.resize(cap);
+        _mask = cap - 1;
+        _head.store(0);
+        _tail.store(0);
+    }
+
+    uint32_t capacity() { return _mask + 1; }
+
+    uint32_t size() { return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire); }
+
+    bool push(const Sample &s)
+    {
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        if (head - _tail.load(std::memory_order_acquire) > _mask)
+            return false;
+        _buf[head & _mask] = s;
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    int pop(Sample *out, int max_num)
+    {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        uint32_t n = _head.load(std::memory_order_acquire) - tail;
+        if (n > (uint32_t)max_num)
+            n = max_num;
+        uint32_t idx = tail & _mask;
+        uint32_t first = std::min(n, _mask + 1 - idx);
+        memcpy(out, &_buf[idx], first * sizeof(Sample));
+        memcpy(out + first, &_buf[0], (n - first) * sizeof(Sample));
+        _tail.store(tail + n, std::memory_order_release);
+        return (int)n;
+    }
+private:
+    std::vector<Sample> _buf;
+    uint32_t _mask;
+    std::atomic<uint32_t> _head;
+    std::atomic<uint32_t> _tail;
+};
+
+typedef struct {
+    SampleRing *ring;
+    std::thread thread;
+    std::atomic_bool running;
+    std::atomic<uint64_t> dropped;
+    bool fusion;
+    Madgwick madgwick;
+    float gyro_bias[3];
+    uint64_t last_t_us;
+    std::mutex q_mutex;
+    float q[4];
+    FILE *replay_file;
+    bool replay_realtime;
+    double tscale;
+    double gscale;
+    double ascale;
+} imu_stream_t;
+
+static void _stream_delete(imu_stream_t *stream)
+{
+    if (!stream)
+        return;
+    if (stream->replay_file)
+        fclose(stream->replay_file);
+    delete stream->ring;
+    delete stream;
+}
+
 typedef struct {
     union {
         maix::ext_dev::qmi8658::QMI8658 *qmi8658;
     } driver;
     double bias[6];
+    imu_stream_t *stream;
 } imu_param_t;
 
+Madgwick::Madgwick(float beta)
+{
+    _beta = beta;
+    reset();
+}
+
+void Madgwick::reset(const float *acc)
+{
+    _q[0] = 1;
+    _q[1] = _q[2] = _q[3] = 0;
+    if (!acc || (acc[0] == 0 && acc[1] == 0 && acc[2] == 0))
+        return;
+    float roll = atan2f(acc[1], acc[2]);
+    float pitch = atan2f(-acc[0], sqrtf(acc[1] * acc[1] + acc[2] * acc[2]));
+    float cr = cosf(roll * 0.5f), sr = sinf(roll * 0.5f);
+    float cp = cosf(pitch * 0.5f), sp = sinf(pitch * 0.5f);
+    _q[0] = cr * cp;
+    _q[1] = sr * cp;
+    _q[2] = cr * sp;
+    _q[3] = -sr * sp;
+}
+
+void Madgwick::update(const float gyro[3], const float acc[3], float dt)
+{
+    float q0 = _q[0], q1 = _q[1], q2 = _q[2], q3 = _q[3];
+    float gx = gyro[0], gy = gyro[1], gz = gyro[2];
+
+    // rate of change of quaternion from gyroscope
+    float qd0 = 0.5f * (-q1 * gx - q2 * gy - q3 * gz);
+    float qd1 = 0.5f * (q0 * gx + q2 * gz - q3 * gy);
+    float qd2 = 0.5f * (q0 * gy - q1 * gz + q3 * gx);
+    float qd3 = 0.5f * (q0 * gz + q1 * gy - q2 * gx);
+
+    float ax = acc[0], ay = acc[1], az = acc[2];
+    if (!(ax == 0 && ay == 0 && az == 0)) {
+        float norm = 1.0f / sqrtf(ax * ax + ay * ay + az * az);
+        ax *= norm;
+        ay *= norm;
+        az *= norm;
+
+        // gradient decent step of gravity error
+        float _2q0 = 2 * q0, _2q1 = 2 * q1, _2q2 = 2 * q2, _2q3 = 2 * q3;
+        float _4q0 = 4 * q0, _4q1 = 4 * q1, _4q2 = 4 * q2;
+        float _8q1 = 8 * q1, _8q2 = 8 * q2;
+        float q0q0 = q0 * q0, q1q1 = q1 * q1, q2q2 = q2 * q2, q3q3 = q3 * q3;
+        float s0 = _4q0 * q2q2 + _2q2 * ax + _4q0 * q1q1 - _2q1 * ay;
+        float s1 = _4q1 * q3q3 - _2q3 * ax + 4 * q0q0 * q1 - _2q0 * ay - _4q1 + _8q1 * q1q1 + _8q1 * q2q2 + _4q1 * az;
+        float s2 = 4 * q0q0 * q2 + _2q0 * ax + _4q2 * q3q3 - _2q3 * ay - _4q2 + _8q2 * q1q1 + _8q2 * q2q2 + _4q2 * az;
+        float s3 = 4 * q1q1 * q3 - _2q1 * ax + 4 * q2q2 * q3 - _2q2 * ay;
+        float s_norm = sqrtf(s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3);
+        if (s_norm > 0) {
+            s_norm = _beta / s_norm;
+            qd0 -= s0 * s_norm;
+            qd1 -= s1 * s_norm;
+            qd2 -= s2 * s_norm;
+            qd3 -= s3 * s_norm;
+        }
+    }
+
+    q0 += qd0 * dt;
+    q1 += qd1 * dt;
+    q2 += qd2 * dt;
+    q3 += qd3 * dt;
+    float norm = 1.0f / sqrtf(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+    _q[0] = q0 * norm;
+    _q[1] = q1 * norm;
+    _q[2] = q2 * norm;
+    _q[3] = q3 * norm;
+}
+
+void Madgwick::quaternion(float q[4]) const
+{
+    memcpy(q, _q, sizeof(_q));
+}
+
+static void _quat_to_euler(const float q[4], float e[3])
+{
+    float q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3];
+    float sinp = 2 * (q0 * q2 - q3 * q1);
+    sinp = sinp > 1 ? 1 : (sinp < -1 ? -1 : sinp);
+    e[0] = atan2f(2 * (q0 * q1 + q2 * q3), 1 - 2 * (q1 * q1 + q2 * q2)) / DEG2RAD;
+    e[1] = asinf(sinp) / DEG2RAD;
+    e[2] = atan2f(2 * (q0 * q3 + q1 * q2), 1 - 2 * (q2 * q2 + q3 * q3)) / DEG2RAD;
+}
+
+void Madgwick::euler(float e[3]) const
+{
+    _quat_to_euler(_q, e);
+}
+
 IMU::IMU(std::string driver, int i2c_bus, int addr, int freq, imu::Mode mode, imu::AccScale acc_scale,
                 imu::AccOdr acc_odr, imu::GyroScale gyro_scale, imu::GyroOdr gyro_odr, bool block)
 {
-    err::check_bool_raise(driver == "qmi8658", "Only support qmi8658 now");
+    err::check_bool_raise(driver == "qmi8658" || driver == "replay", "Only support qmi8658 and replay now");
     imu_param_t *param = (imu_param_t *)malloc(sizeof(imu_param_t));
     err::check_null_raise(param, "Failed to malloc param");
+    param->driver.qmi8658 = NULL;
+    param->stream = NULL;
 
     memset(param->bias, 0, sizeof(param->bias));
     std::vector<double> calibration_data = get_calibration();
@@ -27,7 +204,9 @@ IMU::IMU(std::string driver, int i2c_bus, int addr, int freq, imu::Mode mode, im
     }
     // log::info("load calibration data: {%f, %f, %f, %f, %f, %f}",
     //         param->bias[0], param->bias[1], param->bias[2], param->bias[3], param->bias[4], param->bias[5]);
-    param->driver.qmi8658 = new maix::ext_dev::qmi8658::QMI8658(i2c_bus, addr, freq, mode, acc_scale, acc_odr, gyro_scale, gyro_odr, block);
+    if (driver == "qmi8658") {
+        param->driver.qmi8658 = new maix::ext_dev::qmi8658::QMI8658(i2c_bus, addr, freq, mode, acc_scale, acc_odr, gyro_scale, gyro_odr, block);
+    }
     _param = (void *)param;
     _driver = driver;
 }
@@ -36,6 +215,9 @@ IMU::~IMU()
 {
     if (_param) {
         imu_param_t *param = (imu_param_t *)_param;
+        stop();
+        _stream_delete(param->stream);
+        param->stream = NULL;
         if (_driver == "qmi8658") {
             delete param->driver.qmi8658;
             param->driver.qmi8658 = NULL;
@@ -45,10 +227,19 @@ IMU::~IMU()
     }
 }
 
+// sensor stream thread owns the I2C device until stop()
+static bool _sensor_streaming(imu_param_t *param)
+{
+    return param->stream && param->stream->running.load() && !param->stream->replay_file;
+}
+
 std::vector<float> IMU::read()
 {
     std::vector<float> out;
     imu_param_t *param = (imu_param_t *)_param;
+    if (_sensor_streaming(param)) {
+        err::check_raise(err::ERR_BUSY, "imu is streaming, use read_samples() or stop() first");
+    }
     if (_driver == "qmi8658") {
         out = param->driver.qmi8658->read();
     }
@@ -58,6 +249,14 @@ std::vector<float> IMU::read()
 err::Err IMU::calculate_calibration(uint64_t time_ms)
 {
     imu_param_t *param = (imu_param_t *)_param;
+    if (_driver != "qmi8658") {
+        log::error("calibration need sensor");
+        return err::ERR_NOT_IMPL;
+    }
+    if (_sensor_streaming(param)) {
+        log::error("imu is streaming, stop() first");
+        return err::ERR_BUSY;
+    }
     uint64_t start_ms = time::ticks_ms();
     uint64_t last_ms = start_ms;
     uint64_t caculate_total_time = time_ms;
@@ -123,4 +322,280 @@ std::vector<double> IMU::get_calibration()
     return bias;
 }
 
-}
\ No newline at end of file
+static void _stream_push(imu_stream_t *stream, const Sample &s)
+{
+    if (stream->fusion) {
+        float gyro[3] = {s.gyro[0] - stream->gyro_bias[0], s.gyro[1] - stream->gyro_bias[1], s.gyro[2] - stream->gyro_bias[2]};
+        if (stream->last_t_us == 0) {
+            stream->madgwick.reset(s.acc);
+        } else {
+            stream->madgwick.update(gyro, s.acc, (s.t_us - stream->last_t_us) * 1e-6f);
+        }
+        std::lock_guard<std::mutex> lock(stream->q_mutex);
+        stream->madgwick.quaternion(stream->q);
+    }
+    stream->last_t_us = s.t_us;
+    // drop newest if consumer is too slow, keep samples in ring continuous
+    if (!stream->ring->push(s))
+        stream->dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void _sensor_loop(imu_stream_t *stream, maix::ext_dev::qmi8658::QMI8658 *dev)
+{
+    const int max_num = 128;
+    float buf[max_num * 6];
+    float nominal_us = 1e6f / dev->odr();
+    float period_us = nominal_us;
+    // poll before FIFO is half full
+    uint64_t poll_us = (uint64_t)(nominal_us * max_num / 4);
+    poll_us = poll_us < 1000 ? 1000 : (poll_us > 20000 ? 20000 : poll_us);
+    uint64_t last_read_us = time::ticks_us();
+    uint64_t last_t = 0;
+    int err_count = 0;
+
+    while (stream->running.load()) {
+        time::sleep_us(poll_us);
+        int n = dev->read_fifo(buf, max_num);
+        uint64_t now = time::ticks_us();
+        if (n < 0) {
+            if (err_count++ % 1000 == 0)
+                log::warn("read imu fifo failed: %d", n);
+            continue;
+        }
+        if (n == 0)
+            continue;
+        // refine sample period from read interval, FIFO full means samples were overwritten, interval not usable
+        if (n < max_num) {
+            float p = (float)(now - last_read_us) / n;
+            if (p > nominal_us * 0.8f && p < nominal_us * 1.2f)
+                period_us += (p - period_us) * 0.02f;
+        } else {
+            // count lost samples estimated from read interval, at least one
+            uint64_t expect = (uint64_t)((now - last_read_us) / period_us);
+            stream->dropped.fetch_add(expect > (uint64_t)n ? expect - n : 1, std::memory_order_relaxed);
+        }
+        last_read_us = now;
+
+        // newest sample is at read time, back-date the others
+        for (int i = 0; i < n; i++) {
+            Sample s;
+            uint64_t t = now - (uint64_t)((n - 1 - i) * period_us);
+            s.t_us = t > last_t ? t : last_t + 1;
+            last_t = s.t_us;
+            const float *d = buf + i * 6;
+            s.acc[0] = d[0];
+            s.acc[1] = d[1];
+            s.acc[2] = d[2];
+            s.gyro[0] = d[3] * DEG2RAD;
+            s.gyro[1] = d[4] * DEG2RAD;
+            s.gyro[2] = d[5] * DEG2RAD;
+            _stream_push(stream, s);
+        }
+    }
+    dev->fifo_enable(false);
+}
+
+static void _replay_loop(imu_stream_t *stream)
+{
+    char line[256];
+    uint64_t t0 = 0, host_t0 = 0;
+    bool first = true;
+    while (stream->running.load() && fgets(line, sizeof(line), stream->replay_file)) {
+        double v[7];
+        char *p = line;
+        int i = 0;
+        for (; i < 7; i++) {
+            char *end;
+            v[i] = strtod(p, &end);
+            if (end == p)
+                break;
+            p = (*end == ',') ? end + 1 : end;
+        }
+        if (i != 7)
+            continue;
+        Sample s;
+        s.t_us = (uint64_t)(v[0] * stream->tscale * 1e6 + 0.5);
+        s.gyro[0] = v[1] * stream->gscale;
+        s.gyro[1] = v[2] * stream->gscale;
+        s.gyro[2] = v[3] * stream->gscale;
+        s.acc[0] = v[4] * stream->ascale;
+        s.acc[1] = v[5] * stream->ascale;
+        s.acc[2] = v[6] * stream->ascale;
+        if (first) {
+            t0 = s.t_us;
+            host_t0 = time::ticks_us();
+            first = false;
+        }
+        if (stream->replay_realtime) {
+            while (stream->running.load()) {
+                uint64_t elapsed = time::ticks_us() - host_t0;
+                if (elapsed + t0 >= s.t_us)
+                    break;
+                uint64_t wait = s.t_us - t0 - elapsed;
+                time::sleep_us(wait > 10000 ? 10000 : wait);
+            }
+        } else {
+            while (stream->running.load() && stream->ring->size() >= stream->ring->capacity())
+                time::sleep_ms(1);
+        }
+        if (!stream->running.load())
+            break;
+        _stream_push(stream, s);
+    }
+}
+
+static FILE *_replay_open(const std::string &path, imu_stream_t *stream)
+{
+    FILE *f = fopen(path.c_str(), "r");
+    if (!f)
+        return NULL;
+    char line[256];
+    stream->tscale = 0.001;
+    stream->gscale = 1;
+    stream->ascale = 1;
+    while (fgets(line, sizeof(line), f)) {
+        if (!strncmp(line, "tscale,", 7))
+            stream->tscale = atof(line + 7);
+        else if (!strncmp(line, "gscale,", 7))
+            stream->gscale = atof(line + 7);
+        else if (!strncmp(line, "ascale,", 7))
+            stream->ascale = atof(line + 7);
+        else if (!strncmp(line, "t,", 2))
+            return f;
+    }
+    fclose(f);
+    return NULL;
+}
+
+err::Err IMU::start(int ring_size, bool fusion, std::string replay_path, bool replay_realtime)
+{
+    imu_param_t *param = (imu_param_t *)_param;
+    if (ring_size <= 0)
+        return err::ERR_ARGS;
+    if (replay_path.empty() && _driver != "qmi8658") {
+        log::error("replay driver need replay_path");
+        return err::ERR_ARGS;
+    }
+    stop();
+    _stream_delete(param->stream);
+    param->stream = NULL;
+
+    imu_stream_t *stream = new imu_stream_t();
+    stream->ring = new SampleRing(ring_size);
+    stream->dropped.store(0);
+    stream->fusion = fusion;
+    stream->last_t_us = 0;
+    stream->q[0] = 1;
+    stream->q[1] = stream->q[2] = stream->q[3] = 0;
+    stream->replay_file = NULL;
+    stream->replay_realtime = replay_realtime;
+    for (int i = 0; i < 3; i++)
+        stream->gyro_bias[i] = replay_path.empty() ? param->bias[3 + i] * DEG2RAD : 0;
+
+    if (!replay_path.empty()) {
+        stream->replay_file = _replay_open(replay_path, stream);
+        if (!stream->replay_file) {
+            log::error("open gcsv file %s failed", replay_path.c_str());
+            _stream_delete(stream);
+            return err::ERR_ARGS;
+        }
+    } else {
+        err::Err e = param->driver.qmi8658->fifo_enable(true);
+        if (e != err::ERR_NONE) {
+            _stream_delete(stream);
+            return e;
+        }
+    }
+
+    stream->running.store(true);
+    param->stream = stream;
+    if (stream->replay_file)
+        stream->thread = std::thread(_replay_loop, stream);
+    else
+        stream->thread = std::thread(_sensor_loop, stream, param->driver.qmi8658);
+    return err::ERR_NONE;
+}
+
+void IMU::stop()
+{
+    imu_param_t *param = (imu_param_t *)_param;
+    imu_stream_t *stream = param->stream;
+    if (!stream || !stream->thread.joinable())
+        return;
+    stream->running.store(false);
+    stream->thread.join();
+    if (stream->replay_file) {
+        fclose(stream->replay_file);
+        stream->replay_file = NULL;
+    }
+    // keep ring, samples not read yet are still available
+}
+
+int IMU::available()
+{
+    imu_param_t *param = (imu_param_t *)_param;
+    return param->stream ? (int)param->stream->ring->size() : 0;
+}
+
+int IMU::read_samples(imu::Sample *out, int max_num)
+{
+    imu_param_t *param = (imu_param_t *)_param;
+    if (!param->stream || max_num <= 0)
+        return 0;
+    return param->stream->ring->pop(out, max_num);
+}
+
+std::vector<double> IMU::read_samples(int max_num)
+{
+    imu_param_t *param = (imu_param_t *)_param;
+    std::vector<double> out;
+    if (!param->stream)
+        return out;
+    int n = (int)param->stream->ring->size();
+    if (max_num >= 0 && n > max_num)
+        n = max_num;
+    std::vector<Sample> samples(n);
+    n = param->stream->ring->pop(samples.data(), n);
+    out.resize(n * 7);
+    double *o = out.data();
+    for (int i = 0; i < n; i++) {
+        const Sample &s = samples[i];
+        o[0] = s.t_us * 1e-6;
+        o[1] = s.acc[0];
+        o[2] = s.acc[1];
+        o[3] = s.acc[2];
+        o[4] = s.gyro[0];
+        o[5] = s.gyro[1];
+        o[6] = s.gyro[2];
+        o += 7;
+    }
+    return out;
+}
+
+uint64_t IMU::dropped()
+{
+    imu_param_t *param = (imu_param_t *)_param;
+    return param->stream ? param->stream->dropped.load() : 0;
+}
+
+std::vector<float> IMU::quaternion()
+{
+    imu_param_t *param = (imu_param_t *)_param;
+    imu_stream_t *stream = param->stream;
+    if (!stream || !stream->fusion)
+        return std::vector<float>();
+    std::lock_guard<std::mutex> lock(stream->q_mutex);
+    return std::vector<float>(stream->q, stream->q + 4);
+}
+
+std::vector<float> IMU::euler()
+{
+    std::vector<float> q = quaternion();
+    if (q.empty())
+        return q;
+    float e[3];
+    _quat_to_euler(q.data(), e);
+    return std::vector<float>(e, e + 3);
+}
+
+}
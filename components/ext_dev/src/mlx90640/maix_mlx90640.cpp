@@ -115,36 +115,289 @@ CMatrix to_cmatrix(const KMatrix& matrix)
     // return cmatrix;
 }
 
-void make_maix_image_pixel(float min, float max, float value, uint8_t* buffer, const cmap::CmapArray* array)
-{
-    float vrange = max - min;
-    size_t index = 0;
-    if (std::isnan(value)) {
-        index = 0;
-    } else if (std::isinf(value)) {
-        index = array->size()-1;
-    } else {
-        value -= min;
-        value /= vrange;
-        if (value <= 0)
-            index = 0;
-        else if (value >= 1)
-            index = array->size()-1;
-        else {
-            value *= (array->size()-1);
-            index = ::floor(value);
+static const cmap::CmapArray* cmap_array(Cmap cmap)
+{
+    switch (cmap) {
+    case Cmap::WHITE_HOT:
+        return &cmap::white_hot_yp0103;
+    case Cmap::WHITE_HOT_SD:
+        return &cmap::whitehotsd_yp0100;
+    case Cmap::BLACK_HOT:
+        return &cmap::black_hot_yp0203;
+    case Cmap::BLACK_HOT_SD:
+        return &cmap::blackhotsd_yp0204;
+    case Cmap::RED_HOT:
+        return &cmap::red_hot_yp1303;
+    case Cmap::RED_HOT_SD:
+        return &cmap::redhotsd_yp1304;
+    case Cmap::NIGHT:
+        return &cmap::night_yp0901;
+    case Cmap::IRONBOW:
+        return &cmap::ironbow_yp0301;
+    default:
+        return nullptr;
+    }
+}
+
+MLX90640Calib::MLX90640Calib()
+{
+    this->_loaded = false;
+    ::memset(this->_ee, 0x00, sizeof(this->_ee));
+}
+
+err::Err MLX90640Calib::load(const uint16_t *eeprom)
+{
+    this->_loaded = false;
+    ::memcpy(this->_ee, eeprom, sizeof(this->_ee));
+    int ret = MLX90640_ExtractParameters(this->_ee, &this->_params);
+    if (ret != MLX90640_NO_ERROR) {
+        // deviating pixels only, the same as before, keep going
+        log::warn("%s extract parameters: %d", TAG(), ret);
+    }
+
+    const paramsMLX90640 *p = &this->_params;
+    float kta_scale = 1.0f / (1 << p->ktaScale);
+    float kv_scale = 1.0f / (1 << p->kvScale);
+    float alpha_scale = SCALEALPHA * pow(2, (double)p->alphaScale);
+
+    for (int chess = 0; chess < 2; ++chess) {
+        // calibration mode is stored as bit 7, the same as frame mode
+        uint8_t mode = chess ? 0x80 : 0;
+        for (int sub = 0; sub < 2; ++sub)
+            this->_parts[chess][sub].num = 0;
+        for (int i = 0; i < MLX90640_PIXEL_NUM; ++i) {
+            int il_pattern = i / 32 - (i / 64) * 2;
+            int chess_pattern = il_pattern ^ (i - (i / 2) * 2);
+            int conversion_pattern = ((i + 2) / 4 - (i + 3) / 4 + (i + 1) / 4 - i / 4) * (1 - 2 * il_pattern);
+            int sub = chess ? chess_pattern : il_pattern;
+            Part &part = this->_parts[chess][sub];
+            int n = part.num++;
+            part.idx[n] = i;
+            part.offset[n] = p->offset[i];
+            part.kta[n] = p->kta[i] * kta_scale;
+            part.kv[n] = p->kv[i] * kv_scale;
+            part.alpha[n] = alpha_scale / p->alpha[i];
+            part.il[n] = 0;
+            if (mode != p->calibrationModeEE)
+                part.il[n] = p->ilChessC[2] * (2 * il_pattern - 1) - p->ilChessC[1] * conversion_pattern;
         }
     }
+    this->_loaded = true;
+    return err::ERR_NONE;
+}
 
-    auto ir = (*array)[index][0];
-    auto ig = (*array)[index][1];
-    auto ib = (*array)[index][2];
+err::Err MLX90640Calib::load(const std::string &path)
+{
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f) {
+        log::error("%s open %s failed", TAG(), path.c_str());
+        return err::ERR_ARGS;
+    }
+    uint8_t buf[MLX90640_EEPROM_DUMP_NUM * 2];
+    size_t len = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+    if (len != sizeof(buf)) {
+        log::error("%s %s size %d != %d", TAG(), path.c_str(), (int)len, (int)sizeof(buf));
+        return err::ERR_ARGS;
+    }
+    uint16_t ee[MLX90640_EEPROM_DUMP_NUM];
+    for (int i = 0; i < MLX90640_EEPROM_DUMP_NUM; ++i)
+        ee[i] = buf[i * 2] | (buf[i * 2 + 1] << 8);
+    return this->load(ee);
+}
 
-    buffer[0] = ir;
-    buffer[1] = ig;
-    buffer[2] = ib;
+float MLX90640Calib::ta(const uint16_t *frame) const
+{
+    return MLX90640_GetTa(const_cast<uint16_t*>(frame), &this->_params);
 }
 
+int MLX90640Calib::calculate(const uint16_t *frame, float emissivity, float tr, float *result) const
+{
+    if (!this->_loaded)
+        return -1;
+    int sub = frame[833];
+    if (sub != 0 && sub != 1)
+        return -1;
+
+    const paramsMLX90640 *p = &this->_params;
+    uint16_t *f = const_cast<uint16_t*>(frame);
+    float vdd = MLX90640_GetVdd(f, p);
+    float ta = MLX90640_GetTa(f, p);
+
+    // per frame constants, the same as MLX90640_CalculateTo
+    float ta4 = ta + 273.15;
+    ta4 = ta4 * ta4;
+    ta4 = ta4 * ta4;
+    float tr4 = tr + 273.15;
+    tr4 = tr4 * tr4;
+    tr4 = tr4 * tr4;
+    float ta_tr = tr4 - (tr4 - ta4) / emissivity;
+
+    float alpha_corr_r[4];
+    alpha_corr_r[0] = 1 / (1 + p->ksTo[0] * 40);
+    alpha_corr_r[1] = 1;
+    alpha_corr_r[2] = (1 + p->ksTo[1] * p->ct[2]);
+    alpha_corr_r[3] = alpha_corr_r[2] * (1 + p->ksTo[2] * (p->ct[3] - p->ct[2]));
+
+    float gain = p->gainEE / (float)(int16_t)frame[778];
+    uint8_t mode = (frame[832] & 0x1000) >> 5;
+    float ta_factor = 1 + p->cpKta * (ta - 25);
+    float vdd_factor = 1 + p->cpKv * (vdd - 3.3);
+    float cp = (int16_t)frame[sub ? 808 : 776] * gain;
+    if (sub == 0 || mode == p->calibrationModeEE)
+        cp -= p->cpOffset[sub] * ta_factor * vdd_factor;
+    else
+        cp -= (p->cpOffset[1] + p->ilChessC[0]) * ta_factor * vdd_factor;
+    cp *= p->tgc;
+
+    const Part &part = this->_parts[mode ? 1 : 0][sub];
+    const float dta = ta - 25;
+    const float dvdd = vdd - 3.3;
+    const float ks_ta = 1 + p->KsTa * dta;
+    const float inv_e = 1 / emissivity;
+    const float k1 = 1 - p->ksTo[1] * 273.15;
+    const float ks0 = p->ksTo[0], ks1 = p->ksTo[1], ks2 = p->ksTo[2], ks3 = p->ksTo[3];
+    const float ct0 = p->ct[0], ct1 = p->ct[1], ct2 = p->ct[2], ct3 = p->ct[3];
+    const float cr0 = alpha_corr_r[0], cr1 = alpha_corr_r[1], cr2 = alpha_corr_r[2], cr3 = alpha_corr_r[3];
+    float to[MLX90640_PIXEL_NUM / 2];
+    float ir[MLX90640_PIXEL_NUM / 2];
+    const int num = part.num;
+
+    // gather raw data of this sub page
+    for (int i = 0; i < num; ++i)
+        ir[i] = (int16_t)frame[part.idx[i]];
+
+    // branch free, contiguous arrays, vectorizable
+    for (int i = 0; i < num; ++i) {
+        float v = ir[i] * gain - part.offset[i] * (1 + part.kta[i] * dta) * (1 + part.kv[i] * dvdd);
+        v = (v + part.il[i] - cp) * inv_e;
+        float a = part.alpha[i] * ks_ta;
+        float sx = a * a * a * (v + a * ta_tr);
+        sx = sqrtf(sqrtf(sx)) * ks1;
+        float t = sqrtf(sqrtf(v / (a * k1 + sx) + ta_tr)) - 273.15f;
+
+        // select range with steps instead of branches, ct is ascending
+        float r1 = t >= ct1, r2 = t >= ct2, r3 = t >= ct3;
+        float corr = cr0 + r1 * (cr1 - cr0) + r2 * (cr2 - cr1) + r3 * (cr3 - cr2);
+        float ks = ks0 + r1 * (ks1 - ks0) + r2 * (ks2 - ks1) + r3 * (ks3 - ks2);
+        float ct = ct0 + r1 * (ct1 - ct0) + r2 * (ct2 - ct1) + r3 * (ct3 - ct2);
+        to[i] = sqrtf(sqrtf(v / (a * corr * (1 + ks * (t - ct))) + ta_tr)) - 273.15f;
+    }
+
+    for (int i = 0; i < num; ++i)
+        result[part.idx[i]] = to[i];
+    return sub;
+}
+
+void stats(const float *temp, int width, int height, Point *min, Point *max, Point *center)
+{
+    int num = width * height;
+    if (num <= 0) {
+        if (min) *min = empty_point;
+        if (max) *max = empty_point;
+        if (center) *center = empty_point;
+        return;
+    }
+    float tmin = temp[0], tmax = temp[0];
+    int imin = 0, imax = 0;
+    for (int i = 1; i < num; ++i) {
+        float t = temp[i];
+        if (t < tmin) {
+            tmin = t;
+            imin = i;
+        }
+        if (t > tmax) {
+            tmax = t;
+            imax = i;
+        }
+    }
+    if (min)
+        *min = std::make_tuple(imin % width, imin / width, tmin);
+    if (max)
+        *max = std::make_tuple(imax % width, imax / width, tmax);
+    if (center)
+        *center = std::make_tuple(width / 2, height / 2, temp[(height / 2) * width + width / 2]);
+}
+
+err::Err render(const float *temp, int width, int height, float tmin, float tmax, Cmap cmap, image::Image &out)
+{
+    const cmap::CmapArray* array = cmap_array(cmap);
+    if (!array) {
+        maix::log::error("%s Unknown CMAP!", TAG());
+        return err::ERR_ARGS;
+    }
+    int ow = out.width();
+    int oh = out.height();
+    if (out.format() != image::FMT_RGB888 || width <= 0 || height <= 0 || ow <= 0 || oh <= 0)
+        return err::ERR_ARGS;
+
+    const uint8_t *lut = reinterpret_cast<const uint8_t*>(array->data());
+    const float lut_max = array->size() - 1;
+    float range = tmax - tmin;
+    float k = range > 0 ? lut_max / range : 0;
+
+    // temperature to color index once per source pixel, NaN to 0, inf to last
+    std::vector<float> index(width * height);
+    for (int i = 0; i < width * height; ++i) {
+        float v = (temp[i] - tmin) * k;
+        index[i] = v > 0 ? (v < lut_max ? v : lut_max) : 0;
+    }
+
+    uint8_t *dst = reinterpret_cast<uint8_t*>(out.data());
+    if (ow == width && oh == height) {
+        for (int i = 0; i < width * height; ++i) {
+            const uint8_t *c = lut + (int)index[i] * 3;
+            dst[i * 3 + 0] = c[0];
+            dst[i * 3 + 1] = c[1];
+            dst[i * 3 + 2] = c[2];
+        }
+        return err::ERR_NONE;
+    }
+
+    // bilinear, pixel centers aligned, index is linear in temperature so interpolate index directly
+    std::vector<int> x0(ow), x1(ow);
+    std::vector<float> fx(ow);
+    float sx_scale = (float)width / ow;
+    for (int x = 0; x < ow; ++x) {
+        float sx = (x + 0.5f) * sx_scale - 0.5f;
+        sx = sx < 0 ? 0 : (sx > width - 1 ? width - 1 : sx);
+        x0[x] = (int)sx;
+        x1[x] = x0[x] + 1 < width ? x0[x] + 1 : x0[x];
+        fx[x] = sx - x0[x];
+    }
+    std::vector<float> row(width);
+    float sy_scale = (float)height / oh;
+    for (int y = 0; y < oh; ++y) {
+        float sy = (y + 0.5f) * sy_scale - 0.5f;
+        sy = sy < 0 ? 0 : (sy > height - 1 ? height - 1 : sy);
+        int y0 = (int)sy;
+        int y1 = y0 + 1 < height ? y0 + 1 : y0;
+        float fy = sy - y0;
+        const float *r0 = index.data() + y0 * width;
+        const float *r1 = index.data() + y1 * width;
+        for (int x = 0; x < width; ++x)
+            row[x] = r0[x] + (r1[x] - r0[x]) * fy;
+        uint8_t *d = dst + y * ow * 3;
+        for (int x = 0; x < ow; ++x) {
+            float v = row[x0[x]] + (row[x1[x]] - row[x0[x]]) * fx[x];
+            const uint8_t *c = lut + (int)v * 3;
+            d[0] = c[0];
+            d[1] = c[1];
+            d[2] = c[2];
+            d += 3;
+        }
+    }
+    return err::ERR_NONE;
+}
+
+static image::Image *new_rgb_image(int width, int height)
+{
+    if (width <= 0)
+        width = MLX_W;
+    if (height <= 0)
+        height = MLX_H;
+    return new image::Image(width, height, image::FMT_RGB888);
+}
 
 MLX90640Kelvin::MLX90640Kelvin(int i2c_bus_num, FPS fps, Cmap cmap, float temp_min, float temp_max, float emissivity)
 {
@@ -159,9 +412,9 @@ KMatrix MLX90640Kelvin::matrix()
     return to_kmatrix(this->_mlx->matrix());
 }
 
-maix::image::Image* MLX90640Kelvin::image()
+maix::image::Image* MLX90640Kelvin::image(int width, int height)
 {
-    return this->_mlx->image();
+    return this->_mlx->image(width, height);
 }
 
 Point MLX90640Kelvin::max_temp_point()
@@ -179,9 +432,9 @@ Point MLX90640Kelvin::center_point()
     return c2k(this->_mlx->center_point());
 }
 
-maix::image::Image* MLX90640Kelvin::image_from(const KMatrix& matrix)
+maix::image::Image* MLX90640Kelvin::image_from(const KMatrix& matrix, int width, int height)
 {
-    return this->_mlx->image_from(to_cmatrix(matrix));
+    return this->_mlx->image_from(to_cmatrix(matrix), width, height);
 }
 
 Point MLX90640Kelvin::max_temp_point_from(const KMatrix& matrix)
@@ -205,69 +458,103 @@ MLX90640Celsius::MLX90640Celsius(int i2c_bus_num, FPS fps, Cmap cmap, float temp
     this->_max = temp_max;
     this->_min = temp_min;
     this->_emissivity = emissivity;
+    this->_has_sensor = true;
 
-    ::memset(this->_eeMLX90640, 0x00, std::size(this->_eeMLX90640)*sizeof(uint16_t));
     ::memset(this->_frame, 0x00, std::size(this->_frame)*sizeof(uint16_t));
     ::memset(this->_mlx90640To, 0x00, std::size(this->_mlx90640To)*sizeof(float));
+    ::memset(this->_temp, 0x00, std::size(this->_temp)*sizeof(float));
+    this->_temp_min = this->_temp_max = this->_center = empty_point;
 
     MLX90640_I2CInit(i2c_bus_num);
     MLX90640_SetResolution(MLX_ADDR, 0x03);
     MLX90640_SetRefreshRate(MLX_ADDR, static_cast<uint8_t>(fps));
 
     MLX90640_SetChessMode(MLX_ADDR);
-    MLX90640_DumpEE(MLX_ADDR, this->_eeMLX90640);
-    MLX90640_ExtractParameters(this->_eeMLX90640, &this->_mlx90640);
-
+    uint16_t ee[MLX90640_EEPROM_DUMP_NUM];
+    ::memset(ee, 0x00, sizeof(ee));
+    MLX90640_DumpEE(MLX_ADDR, ee);
+    this->_calib.load(ee);
 }
 
-CMatrix MLX90640Celsius::matrix()
+MLX90640Celsius::MLX90640Celsius(const std::string &eeprom_path, Cmap cmap, float temp_min, float temp_max, float emissivity)
 {
+    this->_cmap = cmap;
+    this->_max = temp_max;
+    this->_min = temp_min;
+    this->_emissivity = emissivity;
+    this->_has_sensor = false;
 
-    MLX90640_GetFrameData(MLX_ADDR, this->_frame);
-
-    auto eTa = MLX90640_GetTa(this->_frame, &this->_mlx90640);
-    auto eTr = eTa-8.0;
+    ::memset(this->_frame, 0x00, std::size(this->_frame)*sizeof(uint16_t));
+    ::memset(this->_mlx90640To, 0x00, std::size(this->_mlx90640To)*sizeof(float));
+    ::memset(this->_temp, 0x00, std::size(this->_temp)*sizeof(float));
+    this->_temp_min = this->_temp_max = this->_center = empty_point;
 
-    MLX90640_CalculateTo(this->_frame, &this->_mlx90640, this->_emissivity, eTr, this->_mlx90640To);
+    err::check_raise(this->_calib.load(eeprom_path), "load mlx90640 eeprom dump failed");
+}
 
-    CMatrix m(MLX_H, std::vector<float>(MLX_W));
+err::Err MLX90640Celsius::update(const uint16_t *frame)
+{
+    if (!frame) {
+        if (!this->_has_sensor)
+            return err::ERR_NOT_OPEN;
+        if (MLX90640_GetFrameData(MLX_ADDR, this->_frame) < 0)
+            return err::ERR_IO;
+        frame = this->_frame;
+    }
 
-    float temp_min = std::numeric_limits<float>::max();
-    int temp_min_x{};
-    int temp_min_y{};
+    auto eTa = this->_calib.ta(frame);
+    auto eTr = eTa-8.0;
 
-    float temp_max = std::numeric_limits<float>::min();
-    int temp_max_x{};
-    int temp_max_y{};
+    if (this->_calib.calculate(frame, this->_emissivity, eTr, this->_mlx90640To) < 0)
+        return err::ERR_ARGS;
 
-    for_each_in_matrix([&](int x, int y){
-        auto xx = MLX_W-1-x;
-        auto yy = y;
-        m[yy][xx] = this->_mlx90640To[(y*MLX_W)+x];
-        if (m[yy][xx] < temp_min) {
-            temp_min_x = xx;
-            temp_min_y = yy;
-            temp_min = m[yy][xx];
-        }
-        if (m[yy][xx] > temp_max) {
-            temp_max_x = xx;
-            temp_max_y = yy;
-            temp_max = m[yy][xx];
-        }
-    });
+    // mirror x, the same orientation as before
+    for (int y = 0; y < static_cast<int>(MLX_H); ++y) {
+        const float *src = this->_mlx90640To + y * MLX_W;
+        float *dst = this->_temp + y * MLX_W;
+        for (int x = 0; x < static_cast<int>(MLX_W); ++x)
+            dst[MLX_W-1-x] = src[x];
+    }
+    stats(this->_temp, MLX_W, MLX_H, &this->_temp_min, &this->_temp_max, &this->_center);
+    return err::ERR_NONE;
+}
 
-    /* make points */
-    this->_temp_min = std::make_tuple(temp_min_x, temp_min_y, temp_min);
-    this->_temp_max = std::make_tuple(temp_max_x, temp_max_y, temp_max);
-    this->_center   = std::make_tuple(MLX_W/2, MLX_H/2, m[MLX_H/2][MLX_W/2]);
+CMatrix MLX90640Celsius::matrix()
+{
+    this->update();
 
+    CMatrix m(MLX_H, std::vector<float>(MLX_W));
+    for (int y = 0; y < static_cast<int>(MLX_H); ++y)
+        ::memcpy(m[y].data(), this->_temp + y * MLX_W, MLX_W * sizeof(float));
     return m;
 }
 
-maix::image::Image* MLX90640Celsius::image()
+void MLX90640Celsius::_range(float &tmin, float &tmax, const Point &min, const Point &max)
+{
+    tmin = this->_min;
+    tmax = this->_max;
+    if (tmin == tmax) {
+        tmin = std::get<2>(min);
+        tmax = std::get<2>(max);
+    }
+}
+
+err::Err MLX90640Celsius::image_to(image::Image &out)
+{
+    float tmin, tmax;
+    this->_range(tmin, tmax, this->_temp_min, this->_temp_max);
+    return render(this->_temp, MLX_W, MLX_H, tmin, tmax, this->_cmap, out);
+}
+
+maix::image::Image* MLX90640Celsius::image(int width, int height)
 {
-    CMatrix m = this->matrix();
-    return image_from(m);
+    this->update();
+    image::Image *img = new_rgb_image(width, height);
+    if (this->image_to(*img) != err::ERR_NONE) {
+        delete img;
+        return nullptr;
+    }
+    return img;
 }
 
 Point MLX90640Celsius::max_temp_point()
@@ -285,53 +572,27 @@ Point MLX90640Celsius::center_point()
     return this->_center;
 }
 
-maix::image::Image* MLX90640Celsius::image_from(const CMatrix& matrix)
+maix::image::Image* MLX90640Celsius::image_from(const CMatrix& matrix, int width, int height)
 {
-    const cmap::CmapArray* array = nullptr;
-
-    switch (this->_cmap) {
-    case Cmap::WHITE_HOT:
-        array = &cmap::white_hot_yp0103;
-        break;
-    case Cmap::WHITE_HOT_SD:
-        array = &cmap::whitehotsd_yp0100;
-        break;
-    case Cmap::BLACK_HOT:
-        array = &cmap::black_hot_yp0203;
-        break;
-    case Cmap::BLACK_HOT_SD:
-        array = &cmap::blackhotsd_yp0204;
-        break;
-    case Cmap::RED_HOT:
-        array = &cmap::red_hot_yp1303;
-        break;
-    case Cmap::RED_HOT_SD:
-        array = &cmap::redhotsd_yp1304;
-        break;
-    case Cmap::NIGHT:
-        array = &cmap::night_yp0901;
-        break;
-    case Cmap::IRONBOW:
-        array = &cmap::ironbow_yp0301;
-        break;
-    default:
-        maix::log::error("%s Unknown CMAP!", TAG());
-        return {};
+    if (!check_matrix(matrix)) {
+        log::error("%s matrix <format != 24x32> !", TAG());
+        return nullptr;
     }
-    uint8_t img_buffer[MLX_H][MLX_W][3];
-
-    auto tmin = this->_min;
-    auto tmax = this->_max;
-    if (tmin == tmax) {
-        tmin = std::get<2>(this->_temp_min);
-        tmax = std::get<2>(this->_temp_max);
+    float temp[MLX_H * MLX_W];
+    for (int y = 0; y < static_cast<int>(MLX_H); ++y)
+        ::memcpy(temp + y * MLX_W, matrix[y].data(), MLX_W * sizeof(float));
+
+    Point min, max;
+    stats(temp, MLX_W, MLX_H, &min, &max, nullptr);
+    float tmin, tmax;
+    this->_range(tmin, tmax, min, max);
+
+    image::Image *img = new_rgb_image(width, height);
+    if (render(temp, MLX_W, MLX_H, tmin, tmax, this->_cmap, *img) != err::ERR_NONE) {
+        delete img;
+        return nullptr;
     }
-
-    for_each_in_matrix([&](int x, int y){
-        make_maix_image_pixel(tmin, tmax, matrix[y][x], img_buffer[y][x], array);
-    });
-
-    return new maix::image::Image(MLX_W, MLX_H, image::FMT_RGB888, reinterpret_cast<uint8_t*>(img_buffer), MLX_W*MLX_H*3, true);
+    return img;
 }
 
 Point MLX90640Celsius::max_temp_point_from(const CMatrix& matrix)
@@ -341,19 +602,12 @@ Point MLX90640Celsius::max_temp_point_from(const CMatrix& matrix)
         return empty_point;
     }
 
-    float temp = std::numeric_limits<float>::min();
-    int temp_x{-1};
-    int temp_y{-1};
-
+    Point max = empty_point;
     for_each_in_matrix([&](int x, int y){
-        if (matrix[y][x] > temp) {
-            temp_x = x;
-            temp_y = y;
-            temp = matrix[y][x];
-        }
+        if (std::get<0>(max) < 0 || matrix[y][x] > std::get<2>(max))
+            max = std::make_tuple(x, y, matrix[y][x]);
     });
-
-    return std::make_tuple(temp_x, temp_y, temp);
+    return max;
 }
 
 Point MLX90640Celsius::min_temp_point_from(const CMatrix& matrix)
@@ -363,19 +617,12 @@ Point MLX90640Celsius::min_temp_point_from(const CMatrix& matrix)
         return empty_point;
     }
 
-    float temp = std::numeric_limits<float>::max();
-    int temp_x{-1};
-    int temp_y{-1};
-
+    Point min = empty_point;
     for_each_in_matrix([&](int x, int y){
-        if (matrix[y][x] < temp) {
-            temp_x = x;
-            temp_y = y;
-            temp = matrix[y][x];
-        }
+        if (std::get<0>(min) < 0 || matrix[y][x] < std::get<2>(min))
+            min = std::make_tuple(x, y, matrix[y][x]);
     });
-
-    return std::make_tuple(temp_x, temp_y, temp);
+    return min;
 }
 
 Point MLX90640Celsius::center_point_from(const CMatrix& matrix)
@@ -389,4 +636,4 @@ Point MLX90640Celsius::center_point_from(const CMatrix& matrix)
 }
 
 
-}
\ No newline at end of file
+}
@@ -175,6 +175,7 @@ Qmi8658c::Qmi8658c(int bus, uint8_t deviceAdress, uint32_t deviceFrequency) {
     this->i2cbus = this->maix_qmi_init_i2c_bus(bus, deviceFrequency, this->need_reset);
     // this->i2cbus->scan();
     this->maix_i2c_bus = bus;
+    this->fifo_ctrl = QMI8658_FIFO_MODE_BYPASS;
     // maix::log::info("i2cbus addr = %p", this->i2cbus);
 }
 
@@ -282,6 +283,65 @@ qmi8658_result_t Qmi8658c::close() {
    return ret;
 }
 
+// Run a CTRL9 command: write command, wait command done, then ack.
+
+bool Qmi8658c::ctrl9_cmd(uint8_t cmd)
+{
+    this->qmi8658_write(QMI8658_CTRL9, cmd);
+    int retry = 0;
+    while ((this->qmi8658_read(QMI8658_STATUSINT) & 0x80) == 0) {
+        if (++retry > 100)
+            return false;
+        maix::time::sleep_us(100);
+    }
+    this->qmi8658_write(QMI8658_CTRL9, QMI8658_CTRL_CMD_ACK);
+    retry = 0;
+    while (this->qmi8658_read(QMI8658_STATUSINT) & 0x80) {
+        if (++retry > 100)
+            return false;
+        maix::time::sleep_us(100);
+    }
+    return true;
+}
+
+// Enable FIFO in stream mode, sensor keeps newest 128 samples, host drains them with fifo_read.
+
+bool Qmi8658c::fifo_enable(bool enable)
+{
+    this->fifo_ctrl = enable ? (QMI8658_FIFO_SIZE_128 | QMI8658_FIFO_MODE_STREAM) : QMI8658_FIFO_MODE_BYPASS;
+    this->qmi8658_write(QMI8658_FIFO_WTM_TH, QMI8658_FIFO_MAX_SAMPLES / 2);
+    this->qmi8658_write(QMI8658_FIFO_CTRL, this->fifo_ctrl);
+    return this->ctrl9_cmd(QMI8658_CTRL_CMD_RST_FIFO);
+}
+
+// Read all samples in FIFO, one burst i2c transaction for data.
+
+int Qmi8658c::fifo_read(int16_t *raw, int max_num)
+{
+    uint8_t status[2];
+    if (!this->ctrl9_cmd(QMI8658_CTRL_CMD_REQ_FIFO))
+        return -1;
+    if (i2cbus->readfrom_mem(this->deviceAdress, QMI8658_FIFO_SMPL_CNT, status, 2) < 0)
+        return -1;
+    // count in 2 bytes, one sample is acc and gyro, 6 * 2 bytes
+    int words = ((status[1] & 0x03) << 8) | status[0];
+    int num = words / 6;
+    if (num > max_num)
+        num = max_num;
+    if (num > QMI8658_FIFO_MAX_SAMPLES)
+        num = QMI8658_FIFO_MAX_SAMPLES;
+    if (num > 0) {
+        if (i2cbus->readfrom_mem(this->deviceAdress, QMI8658_FIFO_DATA, fifo_buf, num * 12) < 0)
+            num = -1;
+    }
+    // leave FIFO read mode
+    this->qmi8658_write(QMI8658_FIFO_CTRL, this->fifo_ctrl);
+    for (int i = 0; i < num * 6; i++) {
+        raw[i] = (int16_t)(((uint16_t)fifo_buf[i * 2 + 1] << 8) | fifo_buf[i * 2]);
+    }
+    return num;
+}
+
 // Convert a qmi8658_result_t enum value into a corresponding string.
 char* Qmi8658c::resultToString(qmi8658_result_t result) {
     (void)result;
@@ -52,6 +52,24 @@ namespace maix::ext_dev::qmi8658::priv {
 #define QMI8658_TEMP_L      0x33  // Temperature sensor low byte.
 #define QMI8658_TEMP_H      0x34  // Temperature sensor high byte.
 
+/* FIFO registers */
+#define QMI8658_FIFO_WTM_TH     0x13  // FIFO watermark level, in ODR samples.
+#define QMI8658_FIFO_CTRL       0x14  // FIFO control: [7] read mode, [3:2] size, [1:0] mode.
+#define QMI8658_FIFO_SMPL_CNT   0x15  // FIFO sample count LSB, in 2 bytes.
+#define QMI8658_FIFO_STATUS     0x16  // FIFO status: [7] full, [6] watermark, [5] overflow, [4] not empty, [1:0] sample count MSB.
+#define QMI8658_FIFO_DATA       0x17  // FIFO data.
+#define QMI8658_STATUSINT       0x2D  // [7] CTRL9 command done.
+
+/* CTRL9 commands */
+#define QMI8658_CTRL_CMD_ACK        0x00
+#define QMI8658_CTRL_CMD_RST_FIFO   0x04
+#define QMI8658_CTRL_CMD_REQ_FIFO   0x05
+
+#define QMI8658_FIFO_MODE_BYPASS    0x00
+#define QMI8658_FIFO_MODE_STREAM    0x02
+#define QMI8658_FIFO_SIZE_128       (0x03 << 2)
+#define QMI8658_FIFO_MAX_SAMPLES    128
+
 /* Soft reset register */
 #define QMI8658_RESET       0x60  // Soft reset register address.
 
@@ -195,6 +213,8 @@ private:
     qmi_ctx_t qmi_ctx;
     ::maix::peripheral::i2c::I2C* i2cbus;
     int maix_i2c_bus;
+    uint8_t fifo_ctrl;
+    uint8_t fifo_buf[QMI8658_FIFO_MAX_SAMPLES * 12];
 
 public:
     Qmi8658c(int bus, uint8_t deviceAdress, uint32_t deviceFrequency); // Constructor for Qmi8658c class.
@@ -203,11 +223,16 @@ public:
     qmi8658_result_t close(void);                             // Close communication with the Qmi8658c.
     char* resultToString(qmi8658_result_t result);            // Convert a qmi8658_result_t enum value into a corresponding string representation.
     void reset(void);
+    bool fifo_enable(bool enable);                            // Enable or disable FIFO stream mode, 128 samples.
+    int fifo_read(int16_t *raw, int max_num);                 // Burst read FIFO, 6 int16 (acc xyz, gyro xyz) per sample, return sample number or -1.
+    float acc_sensitivity(void) { return qmi_ctx.acc_sensitivity; }
+    float gyro_sensitivity(void) { return qmi_ctx.gyro_sensitivity; }
     ~Qmi8658c();
 
 private:
     void qmi8658_write(uint8_t reg,uint8_t value);            // Write a value to a register of the Qmi8658c.    
     uint8_t qmi8658_read(uint8_t reg);                        // Read a value from a register of the Qmi8658c.   
+    bool ctrl9_cmd(uint8_t cmd);                              // Run a CTRL9 command and ack it.
     void qmi_reset(void);                                     // Reset the Qmi8658c.
     void select_mode(qmi8658_mode_t qmi8658_mode);            // Select the mode of the Qmi8658c.
     void acc_set_odr(acc_odr_t odr);                          // Set the output data rate (ODR) for the accelerometer.
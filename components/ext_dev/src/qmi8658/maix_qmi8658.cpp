@@ -101,6 +101,7 @@ QMI8658::QMI8658(int i2c_bus, int addr, int freq, imu::Mode mode, imu::AccScale
 
     qmi8658c->deviceID = 0x0;
     this->_mode = mode;
+    this->_gyro_odr = gyro_odr;
     priv::qmi8658_cfg_t cfg;
     cfg.qmi8658_mode = priv::qmi8658_mode_dual;
     maix::log::info("cfg.qmi8658_mode: 0x%x", cfg.qmi8658_mode);
@@ -198,4 +199,50 @@ std::vector<float> QMI8658::read()
     return make_read_result(this->_mode, data);
 }
 
-}
\ No newline at end of file
+err::Err QMI8658::fifo_enable(bool enable)
+{
+    auto qmi8658c = (priv::Qmi8658c*)this->_data;
+    if (qmi8658c->deviceID != 0x5)
+        return err::ERR_NOT_READY;
+    if (!qmi8658c->fifo_enable(enable)) {
+        log::error("[%s] FIFO %s failed", priv::TAG, enable ? "enable" : "disable");
+        return err::ERR_IO;
+    }
+    return err::ERR_NONE;
+}
+
+int QMI8658::read_fifo(float *out, int max_num)
+{
+    auto qmi8658c = (priv::Qmi8658c*)this->_data;
+    if (qmi8658c->deviceID != 0x5)
+        return -err::ERR_NOT_READY;
+    int16_t raw[QMI8658_FIFO_MAX_SAMPLES * 6];
+    int num = qmi8658c->fifo_read(raw, max_num);
+    if (num < 0)
+        return -err::ERR_IO;
+    float acc_k = 1.0f / qmi8658c->acc_sensitivity();
+    float gyro_k = 1.0f / qmi8658c->gyro_sensitivity();
+    for (int i = 0; i < num; i++) {
+        const int16_t *r = raw + i * 6;
+        float *o = out + i * 6;
+        o[0] = r[0] * acc_k;
+        o[1] = r[1] * acc_k;
+        o[2] = r[2] * acc_k;
+        o[3] = r[3] * gyro_k;
+        o[4] = r[4] * gyro_k;
+        o[5] = r[5] * gyro_k;
+    }
+    return num;
+}
+
+float QMI8658::odr()
+{
+    // 6DOF mode ODR, acc follows gyro clock
+    static const float odr_table[] = {7174.4f, 3587.2f, 1793.6f, 896.8f, 448.4f, 224.2f, 112.1f, 56.05f, 28.025f};
+    int idx = (int)this->_gyro_odr;
+    if (idx < 0 || idx >= (int)(sizeof(odr_table) / sizeof(odr_table[0])))
+        return 0;
+    return odr_table[idx];
+}
+
+}
@@ -0,0 +1,209 @@
+/**
+ * @author neucrack@sipeed
+ * @copyright Sipeed Ltd 2023-
+ * @license Apache 2.0
+ * @update 2024.12.6: Add HTTP/1.1 and WebSocket server on epoll reactor.
+ */
+
+#pragma once
+
+#include "maix_basic.hpp"
+#include "maix_socket.hpp"
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+
+namespace maix::network::http
+{
+    /**
+     * HTTP request
+     * @maixcdk maix.network.http.Request
+     */
+    struct Request
+    {
+        std::string method;                         // e.g. GET, POST
+        std::string path;                           // path without query, e.g. /api/detections
+        std::string query;                          // string after '?', not decoded
+        std::string version;                        // e.g. HTTP/1.1
+        std::map<std::string, std::string> headers; // keys are lower case
+        std::string body;
+
+        /**
+         * Get header value
+         * @param key header name, lower case.
+         * @param default_value value if header not exists.
+         * @maixcdk maix.network.http.Request.header
+         */
+        std::string header(const std::string &key, const std::string &default_value = "") const
+        {
+            auto it = headers.find(key);
+            return it == headers.end() ? default_value : it->second;
+        }
+    };
+
+    class Server;
+
+    /**
+     * HTTP request handler, call Server::respond or Server::stream_begin with conn to reply, from any thread, now or later.
+     * The next request of the same connection is handled after reply.
+     * @maixcdk maix.network.http.Handler
+     */
+    typedef std::function<void(http::Server &server, int conn, const http::Request &req)> Handler;
+
+    /**
+     * WebSocket message handler
+     * @maixcdk maix.network.http.WsMessageHandler
+     */
+    typedef std::function<void(http::Server &server, int conn, const uint8_t *data, int len, bool binary)> WsMessageHandler;
+
+    /**
+     * WebSocket close handler
+     * @maixcdk maix.network.http.WsCloseHandler
+     */
+    typedef std::function<void(http::Server &server, int conn)> WsCloseHandler;
+
+    /**
+     * HTTP/1.1 server with keep-alive, chunked streaming response and WebSocket, all connections run on one network::Reactor.
+     * Every connection has a bounded send queue, data from any thread is queued and sent when socket writable.
+     * Messages sent with a slot replace the unsent message of the same slot, so a slow client always gets the latest
+     * value of telemetry like detections or frames instead of a growing delay.
+     * Send buffers are blocks of network::BufferPool::shared().
+     * Request bodies with Transfer-Encoding chunked are not supported.
+     * @maixcdk maix.network.http.Server
+     */
+    class Server
+    {
+    public:
+        /**
+         * Construct a new Server object
+         * @param host listen ip
+         * @param port listen port
+         * @param reactor event loop to run on, nullptr means create one and run it in a new thread in start().
+         *                Callbacks run in the loop thread, don't block in them.
+         * @param max_conns max connections, new connections are closed when full.
+         * @param max_queue max bytes queued to send of every connection.
+         * @maixcdk maix.network.http.Server.Server
+         */
+        Server(const std::string &host = "0.0.0.0", int port = 8000, network::Reactor *reactor = nullptr,
+               int max_conns = 32, int max_queue = 1024 * 1024);
+        ~Server();
+
+        /**
+         * Add HTTP route, set before start().
+         * @param path request path, prefix match with trailing `*`, e.g. "/static/" with a trailing `*` matches every path under "/static/".
+         * @param handler request handler.
+         * @maixcdk maix.network.http.Server.route
+         */
+        void route(const std::string &path, http::Handler handler);
+
+        /**
+         * Add WebSocket route, set before start().
+         * @param path request path, ends with '*' means match prefix.
+         * @param on_message called for every whole message.
+         * @param on_open called after handshake, the request is the upgrade request, can be nullptr.
+         * @param on_close called after connection closed, can be nullptr.
+         * @maixcdk maix.network.http.Server.ws_route
+         */
+        void ws_route(const std::string &path, http::WsMessageHandler on_message, http::Handler on_open = nullptr,
+                      http::WsCloseHandler on_close = nullptr);
+
+        /**
+         * Start listening
+         * @return err::ERR_NONE or err::ERR_IO if listen failed.
+         * @maixcdk maix.network.http.Server.start
+         */
+        err::Err start();
+
+        /**
+         * Close all connections and stop listening
+         * @maixcdk maix.network.http.Server.stop
+         */
+        void stop();
+
+        /**
+         * Reply a request
+         * @param conn connection id passed to handler.
+         * @param status HTTP status code, e.g. 200.
+         * @param content_type content type, e.g. "application/json".
+         * @param body response body
+         * @param len body length
+         * @param headers extra headers
+         * @return err::ERR_NONE, err::ERR_NOT_FOUND if connection closed, err::ERR_BUFF_FULL if send queue full.
+         * @maixcdk maix.network.http.Server.respond
+         */
+        err::Err respond(int conn, int status, const std::string &content_type, const uint8_t *body, int len,
+                         const std::map<std::string, std::string> &headers = std::map<std::string, std::string>());
+
+        /**
+         * Reply a request with string body
+         * @maixcdk maix.network.http.Server.respond
+         */
+        err::Err respond(int conn, int status, const std::string &content_type, const std::string &body)
+        {
+            return respond(conn, status, content_type, (const uint8_t *)body.data(), (int)body.size());
+        }
+
+        /**
+         * Reply a request with chunked response, send data with stream_send later, e.g. MJPEG or server sent events.
+         * @return err::ERR_NONE, err::ERR_NOT_FOUND if connection closed.
+         * @maixcdk maix.network.http.Server.stream_begin
+         */
+        err::Err stream_begin(int conn, int status, const std::string &content_type,
+                              const std::map<std::string, std::string> &headers = std::map<std::string, std::string>());
+
+        /**
+         * Send a chunk of stream response
+         * @param slot >= 0 means replace the unsent chunk sent with the same slot, -1 means always queue.
+         * @return err::ERR_NONE, err::ERR_NOT_FOUND if connection closed, err::ERR_BUFF_FULL if send queue full.
+         * @maixcdk maix.network.http.Server.stream_send
+         */
+        err::Err stream_send(int conn, const uint8_t *data, int len, int slot = -1);
+
+        /**
+         * End stream response, connection handles next request after queued data sent.
+         * @maixcdk maix.network.http.Server.stream_end
+         */
+        err::Err stream_end(int conn);
+
+        /**
+         * Send WebSocket message
+         * @param binary true for binary message, false for text message.
+         * @param slot >= 0 means replace the unsent message sent with the same slot, -1 means always queue.
+         * @return err::ERR_NONE, err::ERR_NOT_FOUND if connection closed, err::ERR_BUFF_FULL if send queue full.
+         * @maixcdk maix.network.http.Server.ws_send
+         */
+        err::Err ws_send(int conn, const uint8_t *data, int len, bool binary = true, int slot = -1);
+
+        /**
+         * Send WebSocket message to all connections of a path
+         * @param path WebSocket request path, empty means all WebSocket connections.
+         * @return number of connections the message queued to.
+         * @maixcdk maix.network.http.Server.ws_broadcast
+         */
+        int ws_broadcast(const std::string &path, const uint8_t *data, int len, bool binary = true, int slot = -1);
+
+        /**
+         * Close connection after queued data sent
+         * @maixcdk maix.network.http.Server.close
+         */
+        void close(int conn);
+
+        /**
+         * Bytes queued to send of a connection, -1 if connection closed.
+         * @maixcdk maix.network.http.Server.queued
+         */
+        int queued(int conn);
+
+        /**
+         * WebSocket connections of a path
+         * @param path WebSocket request path, empty means all WebSocket connections.
+         * @maixcdk maix.network.http.Server.ws_conns
+         */
+        std::vector<int> ws_conns(const std::string &path = "");
+
+    private:
+        void *_data;
+    };
+} // namespace maix::network::http
@@ -0,0 +1,186 @@
+/**
+ * @author neucrack@sipeed
+ * @copyright Sipeed Ltd 2023-
+ * @license Apache 2.0
+ * @update 2024.12.6: Add non-blocking MQTT client with batching and offline store.
+ */
+
+#pragma once
+
+#include "maix_basic.hpp"
+#include "maix_socket.hpp"
+#include <stdint.h>
+#include <string>
+#include <functional>
+
+namespace maix::network::mqtt
+{
+    /**
+     * MQTT protocol version
+     * @maixcdk maix.network.mqtt.Version
+     */
+    enum Version
+    {
+        V311 = 4,   // MQTT 3.1.1
+        V5 = 5,     // MQTT 5.0, support topic alias
+    };
+
+    class Client;
+
+    /**
+     * Message handler of subscribed topic, called in loop thread.
+     * @maixcdk maix.network.mqtt.MessageHandler
+     */
+    typedef std::function<void(mqtt::Client &client, const std::string &topic, const uint8_t *data, int len)> MessageHandler;
+
+    /**
+     * Connection state change handler, called in loop thread.
+     * @maixcdk maix.network.mqtt.ConnectHandler
+     */
+    typedef std::function<void(mqtt::Client &client, bool connected)> ConnectHandler;
+
+    /**
+     * MQTT client on non-blocking socket and network::Reactor, publish never blocks.
+     * QoS 0 and 1 are supported, QoS 1 messages are sent within an in-flight window and resent with DUP after reconnect.
+     * Small messages of the same topic can be batched into one publish per interval, and messages published
+     * while offline can be kept in an on-disk ring buffer, memory used by queued messages is bounded by max_queue.
+     * With V5, topics are sent with topic alias after first publish if broker allows.
+     * Reconnect automatically after connect() until disconnect().
+     * @maixcdk maix.network.mqtt.Client
+     */
+    class Client
+    {
+    public:
+        /**
+         * Construct a new Client object
+         * @param host broker host name or ip.
+         * @param port broker port.
+         * @param client_id client id, empty means generate one from pid and time.
+         * @param version protocol version, mqtt::V311 or mqtt::V5.
+         * @param reactor event loop to run on, nullptr means create one and run it in a new thread in connect().
+         * @maixcdk maix.network.mqtt.Client.Client
+         */
+        Client(const std::string &host, int port = 1883, const std::string &client_id = "",
+               mqtt::Version version = mqtt::V311, network::Reactor *reactor = nullptr);
+        ~Client();
+
+        /**
+         * Set username and password, set before connect().
+         * @maixcdk maix.network.mqtt.Client.set_auth
+         */
+        void set_auth(const std::string &username, const std::string &password);
+
+        /**
+         * Set keep alive interval, set before connect().
+         * @param keepalive keep alive in seconds, 0 means disable.
+         * @maixcdk maix.network.mqtt.Client.set_keepalive
+         */
+        void set_keepalive(int keepalive = 60);
+
+        /**
+         * Set max QoS 1 messages waiting PUBACK, broker's receive maximum is also respected with V5.
+         * @maixcdk maix.network.mqtt.Client.set_inflight
+         */
+        void set_inflight(int max_inflight = 16);
+
+        /**
+         * Set max bytes of messages queued in memory, messages over this go to offline store if set, or are dropped.
+         * @maixcdk maix.network.mqtt.Client.set_max_queue
+         */
+        void set_max_queue(int max_bytes = 256 * 1024);
+
+        /**
+         * Batch small messages of the same topic, qos and retain into one publish,
+         * payloads are joined with separator and published every interval or when batch reaches max_bytes.
+         * @param interval_ms publish interval in ms, 0 means disable batching.
+         * @param max_bytes max payload of one batched publish, messages larger than this are not batched.
+         * @param separator string put between payloads, e.g. "\n" for JSON lines.
+         * @maixcdk maix.network.mqtt.Client.set_batch
+         */
+        void set_batch(int interval_ms, int max_bytes = 4096, const std::string &separator = "\n");
+
+        /**
+         * Keep messages published while offline in a ring buffer file, oldest messages are dropped when full.
+         * Messages in the file are kept after restart and sent after connected,
+         * a message leaves the file only after QoS0 data is written to socket or QoS1 PUBACK received.
+         * @param path file path, empty means disable.
+         * @param max_bytes max file data size.
+         * @return err::ERR_NONE or err::ERR_IO if open file failed.
+         * @maixcdk maix.network.mqtt.Client.set_offline_store
+         */
+        err::Err set_offline_store(const std::string &path, int max_bytes = 4 * 1024 * 1024);
+
+        /**
+         * Set connection state change handler
+         * @maixcdk maix.network.mqtt.Client.set_connect_handler
+         */
+        void set_connect_handler(mqtt::ConnectHandler handler);
+
+        /**
+         * Start connecting to broker in background, reconnect automatically when connection lost.
+         * Host is resolved here in caller thread(may block on DNS), reconnects use the same address.
+         * @return err::ERR_NONE, err::ERR_ARGS if host can't be resolved.
+         * @maixcdk maix.network.mqtt.Client.connect
+         */
+        err::Err connect();
+
+        /**
+         * Send DISCONNECT and close connection, stop reconnecting.
+         * @maixcdk maix.network.mqtt.Client.disconnect
+         */
+        void disconnect();
+
+        /**
+         * Whether connected to broker(CONNACK received)
+         * @maixcdk maix.network.mqtt.Client.is_connected
+         */
+        bool is_connected();
+
+        /**
+         * Publish message, only queue it and return immediately.
+         * @param qos 0 or 1.
+         * @return err::ERR_NONE, err::ERR_ARGS if args invalid, err::ERR_BUFF_FULL if queue full and no offline store.
+         * @maixcdk maix.network.mqtt.Client.publish
+         */
+        err::Err publish(const std::string &topic, const uint8_t *data, int len, int qos = 0, bool retain = false);
+
+        /**
+         * Publish string message
+         * @maixcdk maix.network.mqtt.Client.publish
+         */
+        err::Err publish(const std::string &topic, const std::string &data, int qos = 0, bool retain = false)
+        {
+            return publish(topic, (const uint8_t *)data.data(), (int)data.size(), qos, retain);
+        }
+
+        /**
+         * Subscribe topic, subscriptions are restored after reconnect.
+         * @param topic topic filter, support + and # wildcard.
+         * @param qos max qos, 0 or 1.
+         * @param handler called for every message matches topic.
+         * @maixcdk maix.network.mqtt.Client.subscribe
+         */
+        err::Err subscribe(const std::string &topic, int qos, mqtt::MessageHandler handler);
+
+        /**
+         * Unsubscribe topic
+         * @maixcdk maix.network.mqtt.Client.unsubscribe
+         */
+        err::Err unsubscribe(const std::string &topic);
+
+        /**
+         * Messages queued in memory and offline store and not acknowledged, batches not flushed are not counted.
+         * @maixcdk maix.network.mqtt.Client.pending
+         */
+        int pending();
+
+        /**
+         * Messages dropped because queue or offline store full, or rejected by broker (V5 PUBACK reason code)
+         * @maixcdk maix.network.mqtt.Client.dropped
+         */
+        uint64_t dropped();
+
+    private:
+        void *_data;
+    };
+} // namespace maix::network::mqtt
@@ -0,0 +1,142 @@
+/**
+ * @author neucrack@sipeed
+ * @copyright Sipeed Ltd 2023-
+ * @license Apache 2.0
+ * @update 2024.12.6: Add epoll reactor and buffer pool.
+ */
+
+#pragma once
+
+#include "maix_basic.hpp"
+#include <stdint.h>
+#include <functional>
+#include <string>
+
+namespace maix::network
+{
+    /**
+     * Pool of fixed size buffers shared by connections, blocks are reused instead of allocated per message.
+     * Thread safe.
+     * @maixcdk maix.network.BufferPool
+     */
+    class BufferPool
+    {
+    public:
+        /**
+         * Construct a new BufferPool object
+         * @param block_size size of every block in bytes.
+         * @param max_free max free blocks kept for reuse, more freed blocks are released to system.
+         * @maixcdk maix.network.BufferPool.BufferPool
+         */
+        BufferPool(int block_size = 4096, int max_free = 256);
+        ~BufferPool();
+
+        /**
+         * Get a block of block_size() bytes, never fails.
+         * @maixcdk maix.network.BufferPool.alloc
+         */
+        uint8_t *alloc();
+
+        /**
+         * Return a block got by alloc()
+         * @maixcdk maix.network.BufferPool.free
+         */
+        void free(uint8_t *block);
+
+        /**
+         * Block size in bytes
+         * @maixcdk maix.network.BufferPool.block_size
+         */
+        int block_size() { return _block_size; }
+
+        /**
+         * Pool shared by network servers and clients of this process
+         * @maixcdk maix.network.BufferPool.shared
+         */
+        static BufferPool &shared();
+
+    private:
+        int _block_size;
+        void *_data;
+    };
+
+    /**
+     * Epoll event loop, many servers and clients can share one loop thread.
+     * Callbacks run in the loop thread, add, mod, del and post can be called from any thread.
+     * @maixcdk maix.network.Reactor
+     */
+    class Reactor
+    {
+    public:
+        /**
+         * Construct a new Reactor object
+         * @throw err::Exception if create epoll failed.
+         * @maixcdk maix.network.Reactor.Reactor
+         */
+        Reactor();
+        ~Reactor();
+
+        /**
+         * Watch fd
+         * @param fd file descriptor, should be non-blocking.
+         * @param events epoll events, e.g. EPOLLIN, EPOLLOUT.
+         * @param callback called with ready events in loop thread.
+         * @return err::ERR_NONE or err::ERR_IO.
+         * @maixcdk maix.network.Reactor.add
+         */
+        err::Err add(int fd, uint32_t events, std::function<void(uint32_t)> callback);
+
+        /**
+         * Change events of fd
+         * @maixcdk maix.network.Reactor.mod
+         */
+        err::Err mod(int fd, uint32_t events);
+
+        /**
+         * Stop watching fd, callback of fd will not be called after return(except the one running now in loop thread).
+         * @maixcdk maix.network.Reactor.del
+         */
+        err::Err del(int fd);
+
+        /**
+         * Run function in loop thread as soon as possible
+         * @maixcdk maix.network.Reactor.post
+         */
+        void post(std::function<void()> fn);
+
+        /**
+         * Wait events once and call callbacks
+         * @param timeout max wait time in ms, -1 means wait forever.
+         * @return number of events handled, < 0 means error, value is -err.Err.
+         * @maixcdk maix.network.Reactor.run_once
+         */
+        int run_once(int timeout = -1);
+
+        /**
+         * Run loop until stop() called or app::need_exit()
+         * @maixcdk maix.network.Reactor.run
+         */
+        void run();
+
+        /**
+         * Run loop in a new thread
+         * @maixcdk maix.network.Reactor.start
+         */
+        void start();
+
+        /**
+         * Stop loop, and wait loop thread exit if started by start()
+         * @maixcdk maix.network.Reactor.stop
+         */
+        void stop();
+
+        /**
+         * Whether called in loop thread
+         * @maixcdk maix.network.Reactor.in_loop
+         */
+        bool in_loop();
+
+    private:
+        void *_data;
+    };
+} // namespace maix::network
@@ -0,0 +1,1091 @@
+/**
+ * @author neucrack@sipeed
+ * @copyright Sipeed Ltd 2023-
+ * @license Apache 2.0
+ * @update 2024.12.6: Add HTTP/1.1 and WebSocket server on epoll reactor.
+ */
+
+#include "maix_http_server.hpp"
+#include <unistd.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <unordered_map>
+
+namespace maix::network::http
+{
+    #define HTTP_MAX_HEADER     (16 * 1024)
+    #define HTTP_MAX_BODY       (1024 * 1024)
+    #define WS_MAX_MESSAGE      (1024 * 1024)
+    #define HTTP_IDLE_MS        60000           // close keep-alive connection idle for this time
+    #define HTTP_RX_MAX         (HTTP_MAX_BODY + HTTP_MAX_HEADER + WS_MAX_MESSAGE) // stop reading peer over this
+
+    enum
+    {
+        CONN_HTTP = 0,      // wait request
+        CONN_WAIT_REPLY,    // request dispatched, wait respond or stream_begin
+        CONN_STREAM,        // chunked response in progress
+        CONN_WS,
+    };
+
+    typedef struct
+    {
+        std::vector<uint8_t *> blocks;  // blocks of BufferPool::shared()
+        int len;
+        int sent;
+        int slot;
+    } msg_t;
+
+    typedef struct
+    {
+        int id;
+        int fd;
+        int state;
+        std::string rx;
+        std::deque<msg_t *> tx;
+        int tx_bytes;           // bytes queued not sent
+        bool want_out;
+        bool rx_paused;         // EPOLLIN removed because rx over HTTP_RX_MAX
+        bool keep_alive;        // keep connection after current reply
+        bool closing;           // close after queued data sent
+        int route;              // route index of websocket
+        std::string path;       // request path of websocket
+        std::string frag;       // fragmented websocket message
+        int frag_opcode;
+        uint64_t last_ms;
+    } conn_t;
+
+    typedef struct
+    {
+        std::string path;
+        bool ws;
+        Handler handler;
+        WsMessageHandler on_message;
+        Handler on_open;
+        WsCloseHandler on_close;
+    } route_t;
+
+    typedef std::vector<std::function<void()>> calls_t;
+
+    typedef struct server_s
+    {
+        Server *self;
+        std::string host;
+        int port;
+        network::Reactor *reactor;
+        bool own_reactor;
+        int max_conns;
+        int max_queue;
+        int listen_fd;
+        int timer_fd;
+        int next_id;
+        std::vector<route_t> routes;
+        std::unordered_map<int, conn_t *> conns;
+        std::mutex lock;
+        // owned by Server, reactor callbacks and posted functions hold a copy,
+        // so state outlives ~Server() until callbacks running or queued on a shared reactor finish
+        std::shared_ptr<server_s> ref;
+    } server_t;
+
+    static const char *_status_str(int status)
+    {
+        switch (status)
+        {
+        case 101: return "Switching Protocols";
+        case 200: return "OK";
+        case 204: return "No Content";
+        case 206: return "Partial Content";
+        case 301: return "Moved Permanently";
+        case 302: return "Found";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 401: return "Unauthorized";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 413: return "Payload Too Large";
+        case 431: return "Request Header Fields Too Large";
+        case 500: return "Internal Server Error";
+        case 501: return "Not Implemented";
+        case 503: return "Service Unavailable";
+        default: return "Unknown";
+        }
+    }
+
+    static void _sha1(const uint8_t *data, size_t len, uint8_t out[20])
+    {
+        uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+        uint64_t bits = (uint64_t)len * 8;
+        size_t total = ((len + 8) / 64 + 1) * 64;
+        std::vector<uint8_t> msg(total, 0);
+        memcpy(msg.data(), data, len);
+        msg[len] = 0x80;
+        for (int i = 0; i < 8; ++i)
+            msg[total - 1 - i] = bits >> (i * 8);
+        for (size_t off = 0; off < total; off += 64)
+        {
+            uint32_t w[80];
+            for (int i = 0; i < 16; ++i)
+                w[i] = (msg[off + i * 4] << 24) | (msg[off + i * 4 + 1] << 16) | (msg[off + i * 4 + 2] << 8) | msg[off + i * 4 + 3];
+            for (int i = 16; i < 80; ++i)
+            {
+                uint32_t v = w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16];
+                w[i] = (v << 1) | (v >> 31);
+            }
+            uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+            for (int i = 0; i < 80; ++i)
+            {
+                uint32_t f, k;
+                if (i < 20)
+                {
+                    f = (b & c) | (~b & d);
+                    k = 0x5A827999;
+                }
+                else if (i < 40)
+                {
+                    f = b ^ c ^ d;
+                    k = 0x6ED9EBA1;
+                }
+                else if (i < 60)
+                {
+                    f = (b & c) | (b & d) | (c & d);
+                    k = 0x8F1BBCDC;
+                }
+                else
+                {
+                    f = b ^ c ^ d;
+                    k = 0xCA62C1D6;
+                }
+                uint32_t t = ((a << 5) | (a >> 27)) + f + e + k + w[i];
+                e = d;
+                d = c;
+                c = (b << 30) | (b >> 2);
+                b = a;
+                a = t;
+            }
+            h[0] += a;
+            h[1] += b;
+            h[2] += c;
+            h[3] += d;
+            h[4] += e;
+        }
+        for (int i = 0; i < 20; ++i)
+            out[i] = h[i / 4] >> ((3 - i % 4) * 8);
+    }
+
+    static std::string _base64(const uint8_t *data, size_t len)
+    {
+        static const char *table = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        std::string out;
+        for (size_t i = 0; i < len; i += 3)
+        {
+            uint32_t v = data[i] << 16;
+            if (i + 1 < len)
+                v |= data[i + 1] << 8;
+            if (i + 2 < len)
+                v |= data[i + 2];
+            out += table[(v >> 18) & 0x3F];
+            out += table[(v >> 12) & 0x3F];
+            out += i + 1 < len ? table[(v >> 6) & 0x3F] : '=';
+            out += i + 2 < len ? table[v & 0x3F] : '=';
+        }
+        return out;
+    }
+
+    static std::string _lower(std::string s)
+    {
+        std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+        return s;
+    }
+
+    static std::string _trim(const std::string &s)
+    {
+        size_t b = s.find_first_not_of(" \t");
+        if (b == std::string::npos)
+            return "";
+        size_t e = s.find_last_not_of(" \t");
+        return s.substr(b, e - b + 1);
+    }
+
+    static msg_t *_msg_new(const std::string &head, const uint8_t *data, int len, const char *tail = nullptr, int slot = -1)
+    {
+        BufferPool &pool = BufferPool::shared();
+        int bs = pool.block_size();
+        int tail_len = tail ? strlen(tail) : 0;
+        msg_t *msg = new msg_t();
+        msg->len = head.size() + len + tail_len;
+        msg->sent = 0;
+        msg->slot = slot;
+        int off = 0;
+        auto copy = [&](const uint8_t *p, int n) {
+            while (n > 0)
+            {
+                if (off % bs == 0)
+                    msg->blocks.push_back(pool.alloc());
+                int take = std::min(n, bs - off % bs);
+                memcpy(msg->blocks.back() + off % bs, p, take);
+                p += take;
+                n -= take;
+                off += take;
+            }
+        };
+        copy((const uint8_t *)head.data(), head.size());
+        copy(data, len);
+        copy((const uint8_t *)tail, tail_len);
+        return msg;
+    }
+
+    static void _msg_free(msg_t *msg)
+    {
+        for (auto block : msg->blocks)
+            BufferPool::shared().free(block);
+        delete msg;
+    }
+
+    static void _close_conn(server_t *s, conn_t *c, calls_t &calls)
+    {
+        s->reactor->del(c->fd);
+        ::close(c->fd);
+        for (auto msg : c->tx)
+            _msg_free(msg);
+        if (c->state == CONN_WS && s->routes[c->route].on_close)
+        {
+            WsCloseHandler on_close = s->routes[c->route].on_close;
+            Server *self = s->self;
+            int id = c->id;
+            calls.push_back([on_close, self, id]() { on_close(*self, id); });
+        }
+        s->conns.erase(c->id);
+        delete c;
+    }
+
+    static void _set_events(server_t *s, conn_t *c, bool out, bool rx_paused)
+    {
+        if (c->want_out == out && c->rx_paused == rx_paused)
+            return;
+        s->reactor->mod(c->fd, (rx_paused ? 0u : (uint32_t)EPOLLIN) | (out ? (uint32_t)EPOLLOUT : 0u));
+        c->want_out = out;
+        c->rx_paused = rx_paused;
+    }
+
+    static void _want_out(server_t *s, conn_t *c, bool out)
+    {
+        _set_events(s, c, out, c->rx_paused);
+    }
+
+    // send queued data, return false if connection should be closed
+    static bool _flush(server_t *s, conn_t *c)
+    {
+        int bs = BufferPool::shared().block_size();
+        while (!c->tx.empty())
+        {
+            struct iovec iov[32];
+            int num = 0;
+            for (size_t i = 0; i < c->tx.size() && num < 32; ++i)
+            {
+                msg_t *msg = c->tx[i];
+                for (int off = msg->sent; off < msg->len && num < 32;)
+                {
+                    int take = std::min(msg->len - off, bs - off % bs);
+                    iov[num].iov_base = msg->blocks[off / bs] + off % bs;
+                    iov[num].iov_len = take;
+                    ++num;
+                    off += take;
+                }
+            }
+            struct msghdr mh;
+            memset(&mh, 0, sizeof(mh));
+            mh.msg_iov = iov;
+            mh.msg_iovlen = num;
+            ssize_t n = sendmsg(c->fd, &mh, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    break;
+                return false;
+            }
+            c->tx_bytes -= n;
+            while (n > 0)
+            {
+                msg_t *msg = c->tx.front();
+                int take = std::min((int)n, msg->len - msg->sent);
+                msg->sent += take;
+                n -= take;
+                if (msg->sent == msg->len)
+                {
+                    c->tx.pop_front();
+                    _msg_free(msg);
+                }
+            }
+        }
+        if (c->tx.empty() && c->closing)
+            return false;
+        _want_out(s, c, !c->tx.empty());
+        return true;
+    }
+
+    // queue and try to send, force means ignore queue limit, for protocol replies
+    static err::Err _queue(server_t *s, conn_t *c, msg_t *msg, calls_t &calls, bool force = false)
+    {
+        bool replaced = false;
+        if (msg->slot >= 0)
+        {
+            for (auto &old : c->tx)
+            {
+                if (old->slot == msg->slot && old->sent == 0)
+                {
+                    c->tx_bytes += msg->len - old->len;
+                    _msg_free(old);
+                    old = msg;
+                    replaced = true;
+                    break;
+                }
+            }
+        }
+        if (!replaced)
+        {
+            if (!force && c->tx_bytes + msg->len > s->max_queue)
+            {
+                _msg_free(msg);
+                return err::ERR_BUFF_FULL;
+            }
+            c->tx.push_back(msg);
+            c->tx_bytes += msg->len;
+        }
+        if (!_flush(s, c))
+            _close_conn(s, c, calls);
+        return err::ERR_NONE;
+    }
+
+    static void _run(calls_t &calls)
+    {
+        for (auto &fn : calls)
+            fn();
+    }
+
+    static void _reply_error(server_t *s, conn_t *c, int status, calls_t &calls)
+    {
+        char head[256];
+        snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\nContent-Length: 0\r\nConnection: close\r\n\r\n", status, _status_str(status));
+        c->closing = true;
+        c->rx.clear();
+        _queue(s, c, _msg_new(head, nullptr, 0), calls, true);
+    }
+
+    static int _find_route(server_t *s, const std::string &path, bool ws)
+    {
+        for (size_t i = 0; i < s->routes.size(); ++i)
+        {
+            const route_t &r = s->routes[i];
+            if (r.ws != ws)
+                continue;
+            if (r.path == path)
+                return i;
+            if (!r.path.empty() && r.path.back() == '*' && path.compare(0, r.path.size() - 1, r.path, 0, r.path.size() - 1) == 0)
+                return i;
+        }
+        return -1;
+    }
+
+    // parse one request, return false if need more data or connection closed
+    static bool _parse_request(server_t *s, conn_t *c, calls_t &calls)
+    {
+        size_t end = c->rx.find("\r\n\r\n");
+        if (end == std::string::npos)
+        {
+            if (c->rx.size() > HTTP_MAX_HEADER)
+                _reply_error(s, c, 431, calls);
+            return false;
+        }
+        Request req;
+        size_t line_end = c->rx.find("\r\n");
+        std::string line = c->rx.substr(0, line_end);
+        size_t sp1 = line.find(' ');
+        size_t sp2 = line.rfind(' ');
+        if (sp1 == std::string::npos || sp2 == sp1)
+        {
+            _reply_error(s, c, 400, calls);
+            return false;
+        }
+        req.method = line.substr(0, sp1);
+        std::string target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+        req.version = line.substr(sp2 + 1);
+        size_t q = target.find('?');
+        req.path = target.substr(0, q);
+        if (q != std::string::npos)
+            req.query = target.substr(q + 1);
+        for (size_t pos = line_end + 2; pos < end;)
+        {
+            size_t e = c->rx.find("\r\n", pos);
+            size_t colon = c->rx.find(':', pos);
+            if (colon != std::string::npos && colon < e)
+                req.headers[_lower(_trim(c->rx.substr(pos, colon - pos)))] = _trim(c->rx.substr(colon + 1, e - colon - 1));
+            pos = e + 2;
+        }
+        if (!req.header("transfer-encoding").empty())
+        {
+            _reply_error(s, c, 501, calls);
+            return false;
+        }
+        long body_len = atol(req.header("content-length", "0").c_str());
+        if (body_len < 0 || body_len > HTTP_MAX_BODY)
+        {
+            _reply_error(s, c, 413, calls);
+            return false;
+        }
+        if (c->rx.size() < end + 4 + body_len)
+            return false;
+        req.body = c->rx.substr(end + 4, body_len);
+        c->rx.erase(0, end + 4 + body_len);
+
+        std::string connection = _lower(req.header("connection"));
+        if (req.version == "HTTP/1.0")
+            c->keep_alive = connection.find("keep-alive") != std::string::npos;
+        else
+            c->keep_alive = connection.find("close") == std::string::npos;
+
+        Server *self = s->self;
+        int id = c->id;
+        if (_lower(req.header("upgrade")).find("websocket") != std::string::npos)
+        {
+            int idx = _find_route(s, req.path, true);
+            std::string key = req.header("sec-websocket-key");
+            if (idx < 0 || key.empty())
+            {
+                _reply_error(s, c, idx < 0 ? 404 : 400, calls);
+                return false;
+            }
+            key += "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+            uint8_t digest[20];
+            _sha1((const uint8_t *)key.data(), key.size(), digest);
+            std::string head = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: " +
+                               _base64(digest, 20) + "\r\n\r\n";
+            c->state = CONN_WS;
+            c->route = idx;
+            c->path = req.path;
+            if (s->routes[idx].on_open)
+            {
+                Handler on_open = s->routes[idx].on_open;
+                calls.push_back([on_open, self, id, req]() { on_open(*self, id, req); });
+            }
+            _queue(s, c, _msg_new(head, nullptr, 0), calls, true);
+            return s->conns.count(id) > 0;
+        }
+        int idx = _find_route(s, req.path, false);
+        if (idx < 0)
+        {
+            char head[256];
+            snprintf(head, sizeof(head), "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: %s\r\n\r\n",
+                     c->keep_alive ? "keep-alive" : "close");
+            c->closing = !c->keep_alive;
+            _queue(s, c, _msg_new(head, nullptr, 0), calls, true);
+            return s->conns.count(id) > 0;
+        }
+        c->state = CONN_WAIT_REPLY;
+        Handler handler = s->routes[idx].handler;
+        calls.push_back([handler, self, id, req]() { handler(*self, id, req); });
+        return false;
+    }
+
+    static void _ws_frame_head(std::string &head, int opcode, uint64_t len)
+    {
+        head.push_back((char)(0x80 | opcode));
+        if (len < 126)
+            head.push_back((char)len);
+        else if (len < 65536)
+        {
+            head.push_back(126);
+            head.push_back((char)(len >> 8));
+            head.push_back((char)len);
+        }
+        else
+        {
+            head.push_back(127);
+            for (int i = 7; i >= 0; --i)
+                head.push_back((char)(len >> (i * 8)));
+        }
+    }
+
+    static void _ws_close(server_t *s, conn_t *c, uint16_t code, calls_t &calls)
+    {
+        std::string head;
+        uint8_t payload[2] = {(uint8_t)(code >> 8), (uint8_t)code};
+        _ws_frame_head(head, 0x8, 2);
+        c->closing = true;
+        c->rx.clear();
+        _queue(s, c, _msg_new(head, payload, 2), calls, true);
+    }
+
+    // parse one websocket frame, return false if need more data or connection closed
+    static bool _parse_ws(server_t *s, conn_t *c, calls_t &calls)
+    {
+        const uint8_t *p = (const uint8_t *)c->rx.data();
+        size_t size = c->rx.size();
+        if (size < 2)
+            return false;
+        bool fin = p[0] & 0x80;
+        int opcode = p[0] & 0x0F;
+        bool masked = p[1] & 0x80;
+        uint64_t len = p[1] & 0x7F;
+        size_t head = 2;
+        if (len == 126)
+        {
+            if (size < 4)
+                return false;
+            len = (p[2] << 8) | p[3];
+            head = 4;
+        }
+        else if (len == 127)
+        {
+            if (size < 10)
+                return false;
+            len = 0;
+            for (int i = 0; i < 8; ++i)
+                len = (len << 8) | p[2 + i];
+            head = 10;
+        }
+        if (!masked)
+        {
+            _ws_close(s, c, 1002, calls);
+            return false;
+        }
+        if (len > WS_MAX_MESSAGE || c->frag.size() + len > WS_MAX_MESSAGE)
+        {
+            _ws_close(s, c, 1009, calls);
+            return false;
+        }
+        if (size < head + 4 + len)
+            return false;
+        const uint8_t *mask = p + head;
+        std::string payload(len, 0);
+        for (uint64_t i = 0; i < len; ++i)
+            payload[i] = p[head + 4 + i] ^ mask[i % 4];
+        c->rx.erase(0, head + 4 + len);
+
+        Server *self = s->self;
+        int id = c->id;
+        WsMessageHandler on_message = s->routes[c->route].on_message;
+        auto deliver = [&](int op, std::string &data) {
+            if (!on_message)
+                return;
+            calls.push_back([on_message, self, id, op, data]() {
+                on_message(*self, id, (const uint8_t *)data.data(), data.size(), op == 0x2);
+            });
+        };
+        std::string reply;
+        switch (opcode)
+        {
+        case 0x0:
+            c->frag += payload;
+            if (fin)
+            {
+                deliver(c->frag_opcode, c->frag);
+                c->frag.clear();
+            }
+            break;
+        case 0x1:
+        case 0x2:
+            if (fin)
+                deliver(opcode, payload);
+            else
+            {
+                c->frag = payload;
+                c->frag_opcode = opcode;
+            }
+            break;
+        case 0x8:
+            _ws_close(s, c, payload.size() >= 2 ? ((uint8_t)payload[0] << 8 | (uint8_t)payload[1]) : 1000, calls);
+            return false;
+        case 0x9:
+            _ws_frame_head(reply, 0xA, len);
+            _queue(s, c, _msg_new(reply, (const uint8_t *)payload.data(), len), calls, true);
+            return s->conns.count(id) > 0;
+        case 0xA:
+            break;
+        default:
+            _ws_close(s, c, 1002, calls);
+            return false;
+        }
+        return true;
+    }
+
+    static void _parse(server_t *s, conn_t *c, calls_t &calls)
+    {
+        while (!c->closing)
+        {
+            bool more;
+            if (c->state == CONN_WS)
+                more = _parse_ws(s, c, calls);
+            else if (c->state == CONN_HTTP)
+                more = _parse_request(s, c, calls);
+            else
+                break; // wait reply, keep data of next request
+            if (!more || !s->conns.count(c->id))
+                break;
+        }
+    }
+
+    static void _on_conn_event(server_t *s, int id, uint32_t events)
+    {
+        calls_t calls;
+        {
+            std::lock_guard<std::mutex> lock(s->lock);
+            auto it = s->conns.find(id);
+            if (it == s->conns.end())
+                return;
+            conn_t *c = it->second;
+            if ((events & EPOLLOUT) && !_flush(s, c))
+            {
+                _close_conn(s, c, calls);
+                goto end;
+            }
+            if (events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+            {
+                BufferPool &pool = BufferPool::shared();
+                uint8_t *buff = pool.alloc();
+                while (1)
+                {
+                    ssize_t n = recv(c->fd, buff, pool.block_size(), MSG_DONTWAIT);
+                    if (n > 0)
+                    {
+                        c->rx.append((const char *)buff, n);
+                        c->last_ms = time::ticks_ms();
+                        if (c->rx.size() >= HTTP_RX_MAX)
+                            break; // peer sends too fast, parse first
+                        continue;
+                    }
+                    if (n < 0 && errno == EINTR)
+                        continue;
+                    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                        break;
+                    pool.free(buff);
+                    buff = nullptr;
+                    _close_conn(s, c, calls); // closed by peer or error
+                    goto end;
+                }
+                pool.free(buff);
+            }
+            _parse(s, c, calls);
+            // data not consumed while waiting reply or streaming, stop reading until _reply_done parses it,
+            // EPOLLIN is level triggered, keep it would busy loop and grow rx without limit
+            if (s->conns.count(id))
+                _set_events(s, c, c->want_out, c->rx.size() >= HTTP_RX_MAX);
+        }
+    end:
+        _run(calls);
+    }
+
+    static void _on_accept(server_t *s)
+    {
+        std::lock_guard<std::mutex> lock(s->lock);
+        if (s->listen_fd < 0)
+            return; // stopped
+        while (1)
+        {
+            int fd = accept4(s->listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0)
+            {
+                if (errno == EINTR || errno == ECONNABORTED)
+                    continue;
+                break;
+            }
+            if ((int)s->conns.size() >= s->max_conns)
+            {
+                log::warn("http connections reach max %d, reject new connection", s->max_conns);
+                ::close(fd);
+                continue;
+            }
+            int on = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            conn_t *c = new conn_t();
+            c->id = s->next_id++;
+            c->fd = fd;
+            c->state = CONN_HTTP;
+            c->tx_bytes = 0;
+            c->want_out = false;
+            c->rx_paused = false;
+            c->keep_alive = true;
+            c->closing = false;
+            c->route = -1;
+            c->frag_opcode = 0;
+            c->last_ms = time::ticks_ms();
+            s->conns[c->id] = c;
+            int id = c->id;
+            std::shared_ptr<server_t> ref = s->ref;
+            s->reactor->add(fd, EPOLLIN, [ref, id](uint32_t events) { _on_conn_event(ref.get(), id, events); });
+        }
+    }
+
+    static void _on_timer(server_t *s)
+    {
+        calls_t calls;
+        {
+            std::lock_guard<std::mutex> lock(s->lock);
+            if (s->timer_fd < 0)
+                return; // stopped
+            uint64_t value;
+            ssize_t ret = ::read(s->timer_fd, &value, sizeof(value));
+            (void)ret;
+            uint64_t now = time::ticks_ms();
+            std::vector<conn_t *> idle;
+            for (auto &it : s->conns)
+            {
+                conn_t *c = it.second;
+                if (c->state == CONN_HTTP && c->tx.empty() && now - c->last_ms > HTTP_IDLE_MS)
+                    idle.push_back(c);
+            }
+            for (auto c : idle)
+                _close_conn(s, c, calls);
+        }
+        _run(calls);
+    }
+
+    Server::Server(const std::string &host, int port, network::Reactor *reactor, int max_conns, int max_queue)
+    {
+        server_t *s = new server_t();
+        s->self = this;
+        s->host = host;
+        s->port = port;
+        s->own_reactor = reactor == nullptr;
+        s->reactor = reactor ? reactor : new network::Reactor();
+        s->max_conns = max_conns;
+        s->max_queue = max_queue;
+        s->listen_fd = -1;
+        s->timer_fd = -1;
+        s->next_id = 1;
+        s->ref = std::shared_ptr<server_t>(s);
+        _data = s;
+    }
+
+    Server::~Server()
+    {
+        server_t *s = (server_t *)_data;
+        stop();
+        if (s->own_reactor)
+            delete s->reactor; // thread joined by stop(), posted functions are released here
+        // a callback may still be running or waiting lock on a shared reactor, last copy frees state
+        std::shared_ptr<server_t> ref;
+        {
+            std::lock_guard<std::mutex> lock(s->lock);
+            ref = std::move(s->ref);
+        }
+    }
+
+    void Server::route(const std::string &path, http::Handler handler)
+    {
+        server_t *s = (server_t *)_data;
+        route_t r;
+        r.path = path;
+        r.ws = false;
+        r.handler = handler;
+        s->routes.push_back(r);
+    }
+
+    void Server::ws_route(const std::string &path, http::WsMessageHandler on_message, http::Handler on_open, http::WsCloseHandler on_close)
+    {
+        server_t *s = (server_t *)_data;
+        route_t r;
+        r.path = path;
+        r.ws = true;
+        r.on_message = on_message;
+        r.on_open = on_open;
+        r.on_close = on_close;
+        s->routes.push_back(r);
+    }
+
+    err::Err Server::start()
+    {
+        server_t *s = (server_t *)_data;
+        if (s->listen_fd >= 0)
+            return err::ERR_NONE;
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(s->port);
+        if (inet_pton(AF_INET, s->host.c_str(), &addr.sin_addr) != 1)
+        {
+            log::error("invalid host %s", s->host.c_str());
+            return err::ERR_ARGS;
+        }
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+            return err::ERR_IO;
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 128) < 0)
+        {
+            log::error("http server listen on %s:%d failed: %s", s->host.c_str(), s->port, strerror(errno));
+            ::close(fd);
+            return err::ERR_IO;
+        }
+        s->listen_fd = fd;
+        std::shared_ptr<server_t> ref = s->ref;
+        s->reactor->add(fd, EPOLLIN, [ref](uint32_t) { _on_accept(ref.get()); });
+        s->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (s->timer_fd >= 0)
+        {
+            struct itimerspec its;
+            memset(&its, 0, sizeof(its));
+            its.it_value.tv_sec = 1;
+            its.it_interval.tv_sec = 1;
+            timerfd_settime(s->timer_fd, 0, &its, nullptr);
+            s->reactor->add(s->timer_fd, EPOLLIN, [ref](uint32_t) { _on_timer(ref.get()); });
+        }
+        if (s->own_reactor)
+            s->reactor->start();
+        log::info("http server listen on %s:%d", s->host.c_str(), s->port);
+        return err::ERR_NONE;
+    }
+
+    void Server::stop()
+    {
+        server_t *s = (server_t *)_data;
+        if (s->listen_fd < 0)
+            return;
+        if (s->own_reactor)
+            s->reactor->stop();
+        calls_t calls;
+        {
+            std::lock_guard<std::mutex> lock(s->lock);
+            s->reactor->del(s->listen_fd);
+            ::close(s->listen_fd);
+            s->listen_fd = -1;
+            if (s->timer_fd >= 0)
+            {
+                s->reactor->del(s->timer_fd);
+                ::close(s->timer_fd);
+                s->timer_fd = -1;
+            }
+            while (!s->conns.empty())
+                _close_conn(s, s->conns.begin()->second, calls);
+        }
+        _run(calls);
+    }
+
+    static std::string _head(int status, const std::string &content_type, const std::map<std::string, std::string> &headers, bool keep_alive)
+    {
+        char line[128];
+        snprintf(line, sizeof(line), "HTTP/1.1 %d %s\r\n", status, _status_str(status));
+        std::string head = line;
+        if (!content_type.empty())
+            head += "Content-Type: " + content_type + "\r\n";
+        head += keep_alive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+        for (auto &it : headers)
+            head += it.first + ": " + it.second + "\r\n";
+        return head;
+    }
+
+    // after a reply, handle requests received meanwhile
+    static void _reply_done(server_t *s, conn_t *c)
+    {
+        c->state = CONN_HTTP;
+        if (!c->keep_alive)
+        {
+            c->closing = true;
+            return;
+        }
+        if (!c->rx.empty())
+        {
+            int id = c->id;
+            std::shared_ptr<server_t> ref = s->ref;
+            s->reactor->post([ref, id]() { _on_conn_event(ref.get(), id, 0); });
+        }
+    }
+
+    err::Err Server::respond(int conn, int status, const std::string &content_type, const uint8_t *body, int len,
+                             const std::map<std::string, std::string> &headers)
+    {
+        server_t *s = (server_t *)_data;
+        calls_t calls;
+        err::Err e;
+        {
+            std::lock_guard<std::mutex> lock(s->lock);
+            auto it = s->conns.find(conn);
+            if (it == s->conns.end())
+                return err::ERR_NOT_FOUND;
+            conn_t *c = it->second;
+            if (c->state != CONN_WAIT_REPLY)
+                return err::ERR_NOT_PERMIT;
+            std::string head = _head(status, content_type, headers, c->keep_alive);
+            head += "Content-Length: " + std::to_string(len) + "\r\n\r\n";
+            _reply_done(s, c);
+            e = _queue(s, c, _msg_new(head, body, len), calls, true);
+        }
+        _run(calls);
+        return e;
+    }
+
+    err::Err Server::stream_begin(int conn, int status, const std::string &content_type, const std::map<std::string, std::string> &headers)
+    {
+        server_t *s = (server_t *)_data;
+        calls_t calls;
+        err::Err e;
+        {
+            std::lock_guard<std::mutex> lock(s->lock);
+            auto it = s->conns.find(conn);
+            if (it == s->conns.end())
+                return err::ERR_NOT_FOUND;
+            conn_t *c = it->second;
+            if (c->state != CONN_WAIT_REPLY)
+                return err::ERR_NOT_PERMIT;
+            std::string head = _head(status, content_type, headers, c->keep_alive);
+            head += "Transfer-Encoding: chunked\r\n\r\n";
+            c->state = CONN_STREAM;
+            e = _queue(s, c, _msg_new(head, nullptr, 0), calls, true);
+        }
+        _run(calls);
+        return e;
+    }
+
+    err::Err Server::stream_send(int conn, const uint8_t *data, int len, int slot)
+    {
+        server_t *s = (server_t *)_data;
+        if (len <= 0)
+            return err::ERR_NONE; // empty chunk means end of stream
+        calls_t calls;
+        err::Err e;
+        {
+            std::lock_guard<std::mutex> lock(s->lock);
+            auto it = s->conns.find(conn);
+            if (it == s->conns.end())
+                return err::ERR_NOT_FOUND;
+            conn_t *c = it->second;
+            if (c->state != CONN_STREAM)
+                return err::ERR_NOT_PERMIT;
+            char head[16];
+            snprintf(head, sizeof(head), "%x\r\n", len);
+            e = _queue(s, c, _msg_new(head, data, len, "\r\n", slot), calls);
+        }
+        _run(calls);
+        return e;
+    }
+
+    err::Err Server::stream_end(int conn)
+    {
+        server_t *s = (server_t *)_data;
+        calls_t calls;
+        err::Err e;
+        {
+            std::lock_guard<std::mutex> lock(s->lock);
+            auto it = s->conns.find(conn);
+            if (it == s->conns.end())
+                return err::ERR_NOT_FOUND;
+            conn_t *c = it->second;
+            if (c->state != CONN_STREAM)
+                return err::ERR_NOT_PERMIT;
+            _reply_done(s, c);
+            e = _queue(s, c, _msg_new("0\r\n\r\n", nullptr, 0), calls, true);
+        }
+        _run(calls);
+        return e;
+    }
+
+    static err::Err _ws_send(server_t *s, conn_t *c, const uint8_t *data, int len, bool binary, int slot, calls_t &calls)
+    {
+        std::string head;
+        _ws_frame_head(head, binary ? 0x2 : 0x1, len);
+        return _queue(s, c, _msg_new(head, data, len, nullptr, slot), calls);
+    }
+
+    err::Err Server::ws_send(int conn, const uint8_t *data, int len, bool binary, int slot)
+    {
+        server_t *s = (server_t *)_data;
+        calls_t calls;
+        err::Err e;
+        {
+            std::lock_guard<std::mutex> lock(s->lock);
+            auto it = s->conns.find(conn);
+            if (it == s->conns.end())
+                return err::ERR_NOT_FOUND;
+            conn_t *c = it->second;
+            if (c->state != CONN_WS || c->closing)
+                return err::ERR_NOT_PERMIT;
+            e = _ws_send(s, c, data, len, binary, slot, calls);
+        }
+        _run(calls);
+        return e;
+    }
+
+    int Server::ws_broadcast(const std::string &path, const uint8_t *data, int len, bool binary, int slot)
+    {
+        server_t *s = (server_t *)_data;
+        calls_t calls;
+        int count = 0;
+        {
+            std::lock_guard<std::mutex> lock(s->lock);
+            std::vector<conn_t *> conns;
+            for (auto &it : s->conns)
+            {
+                conn_t *c = it.second;
+                if (c->state == CONN_WS && !c->closing && (path.empty() || c->path == path))
+                    conns.push_back(c);
+            }
+            for (auto c : conns)
+            {
+                if (_ws_send(s, c, data, len, binary, slot, calls) == err::ERR_NONE)
+                    ++count;
+            }
+        }
+        _run(calls);
+        return count;
+    }
+
+    void Server::close(int conn)
+    {
+        server_t *s = (server_t *)_data;
+        calls_t calls;
+        {
+            std::lock_guard<std::mutex> lock(s->lock);
+            auto it = s->conns.find(conn);
+            if (it == s->conns.end())
+                return;
+            conn_t *c = it->second;
+            if (c->state == CONN_WS && !c->closing)
+                _ws_close(s, c, 1000, calls);
+            else
+            {
+                c->closing = true;
+                if (c->tx.empty())
+                    _close_conn(s, c, calls);
+            }
+        }
+        _run(calls);
+    }
+
+    int Server::queued(int conn)
+    {
+        server_t *s = (server_t *)_data;
+        std::lock_guard<std::mutex> lock(s->lock);
+        auto it = s->conns.find(conn);
+        if (it == s->conns.end())
+            return -1;
+        return it->second->tx_bytes;
+    }
+
+    std::vector<int> Server::ws_conns(const std::string &path)
+    {
+        server_t *s = (server_t *)_data;
+        std::lock_guard<std::mutex> lock(s->lock);
+        std::vector<int> ids;
+        for (auto &it : s->conns)
+        {
+            conn_t *c = it.second;
+            if (c->state == CONN_WS && (path.empty() || c->path == path))
+                ids.push_back(c->id);
+        }
+        return ids;
+    }
+} // namespace maix::network::http
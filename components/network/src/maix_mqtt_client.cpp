@@ -0,0 +1,1335 @@
+/**
+ * @author neucrack@sipeed
+ * @copyright Sipeed Ltd 2023-
+ * @license Apache 2.0
+ * @update 2024.12.6: Add non-blocking MQTT client with batching and offline store.
+ */
+
+#include "maix_mqtt_client.hpp"
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <errno.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace maix::network::mqtt
+{
+    #define MQTT_STORE_MAGIC        0x5154514D      // "MQTQ"
+    #define MQTT_STORE_DATA_OFFSET  64
+    #define MQTT_OUT_MAX            (64 * 1024)     // stop encoding queued messages when socket buffer over this
+    #define MQTT_PACKET_MAX         (4 * 1024 * 1024)
+    #define MQTT_CONNECT_TIMEOUT_MS 10000
+    #define MQTT_RETRY_MIN_MS       1000
+    #define MQTT_RETRY_MAX_MS       30000
+
+    enum
+    {
+        PKT_CONNECT = 1,
+        PKT_CONNACK = 2,
+        PKT_PUBLISH = 3,
+        PKT_PUBACK = 4,
+        PKT_SUBSCRIBE = 8,
+        PKT_SUBACK = 9,
+        PKT_UNSUBSCRIBE = 10,
+        PKT_UNSUBACK = 11,
+        PKT_PINGREQ = 12,
+        PKT_PINGRESP = 13,
+        PKT_DISCONNECT = 14,
+    };
+
+    enum
+    {
+        STATE_IDLE = 0,
+        STATE_CONNECTING,   // tcp connecting
+        STATE_WAIT_CONNACK,
+        STATE_CONNECTED,
+    };
+
+    typedef struct
+    {
+        std::string topic;
+        std::string payload;
+        uint8_t qos;
+        bool retain;
+        bool dup;
+        uint16_t pid;
+        uint64_t store_end;     // end position of the record in offline store, 0 if not loaded from store
+        uint32_t store_gen;
+    } msg_t;
+
+    typedef struct
+    {
+        std::string topic;
+        std::string data;
+        int qos;
+        bool retain;
+        uint64_t first_ms;
+    } batch_t;
+
+    typedef struct
+    {
+        std::string filter;
+        int qos;
+        MessageHandler handler;
+    } sub_t;
+
+    typedef struct
+    {
+        uint32_t magic;
+        uint32_t count;
+        uint64_t cap;
+        uint64_t head;      // read position, increase only
+        uint64_t tail;      // write position, increase only
+    } store_head_t;
+
+    typedef struct
+    {
+        uint64_t end;
+        bool done;
+    } store_rec_t;
+
+    /**
+     * Ring buffer file, records are [u32 len][u8 flags][u16 topic_len][topic][payload], len counts bytes after itself.
+     * head only moves after a loaded record is delivered, records between head and read are in memory,
+     * so they are sent again after restart if not delivered.
+     */
+    typedef struct
+    {
+        int fd;
+        uint32_t gen;                   // increase every open, records of an old file are never committed
+        uint64_t read;                  // next record to load, head <= read <= tail
+        std::deque<store_rec_t> loaded; // records in [head, read), in order
+        store_head_t head;
+    } store_t;
+
+    typedef struct
+    {
+        uint64_t out_end;   // position of the end of the QoS0 publish in sent bytes
+        uint64_t store_end;
+        uint32_t store_gen;
+    } out_rec_t;
+
+    typedef std::vector<std::function<void()>> calls_t;
+
+    typedef struct client_s
+    {
+        Client *self;
+        std::string host;
+        int port;
+        struct sockaddr_in addr;    // resolved in connect(), reactor thread never blocks on DNS
+        std::string client_id;
+        int version;
+        bool has_auth;
+        std::string username;
+        std::string password;
+        int keepalive;
+        int max_inflight;
+        int receive_max;        // broker's receive maximum
+        int max_queue;
+        int batch_interval;
+        int batch_max;
+        std::string batch_sep;
+        std::map<std::string, batch_t> batches;
+        network::Reactor *reactor;
+        bool own_reactor;
+        int fd;
+        int timer_fd;
+        int state;
+        bool want_connect;
+        bool want_out;
+        std::string out;
+        uint64_t out_pos;       // bytes of out already sent
+        std::deque<out_rec_t> out_store; // QoS0 store records in out, committed once sent
+        std::string rx;
+        std::deque<msg_t *> queue;
+        int queue_bytes;
+        std::deque<msg_t *> inflight;
+        uint16_t next_pid;
+        store_t store;
+        std::vector<sub_t> subs;
+        int alias_max;          // broker's topic alias maximum
+        std::unordered_map<std::string, uint16_t> aliases;
+        uint64_t last_tx_ms;
+        uint64_t last_rx_ms;
+        uint64_t state_ms;
+        uint64_t retry_ms;
+        int backoff_ms;
+        uint64_t dropped;
+        ConnectHandler on_connect;
+        std::mutex lock;
+        std::shared_ptr<client_s> ref;  // callbacks hold a copy, state freed with the last one
+    } client_t;
+
+    static void _put_u16(std::string &s, uint16_t v)
+    {
+        s.push_back((char)(v >> 8));
+        s.push_back((char)v);
+    }
+
+    static void _put_str(std::string &s, const std::string &str)
+    {
+        _put_u16(s, str.size());
+        s += str;
+    }
+
+    static void _put_varint(std::string &s, uint32_t v)
+    {
+        do
+        {
+            uint8_t b = v & 0x7F;
+            v >>= 7;
+            s.push_back((char)(v ? b | 0x80 : b));
+        } while (v);
+    }
+
+    // return bytes used, 0 if incomplete or invalid
+    static int _get_varint(const uint8_t *p, int len, uint32_t *v)
+    {
+        *v = 0;
+        for (int i = 0; i < 4 && i < len; ++i)
+        {
+            *v |= (p[i] & 0x7F) << (7 * i);
+            if (!(p[i] & 0x80))
+                return i + 1;
+        }
+        return 0;
+    }
+
+    static void _packet(std::string &out, uint8_t type_flags, const std::string &body)
+    {
+        out.push_back((char)type_flags);
+        _put_varint(out, body.size());
+        out += body;
+    }
+
+    static bool _topic_match(const std::string &filter, const std::string &topic)
+    {
+        size_t f = 0, t = 0;
+        while (f < filter.size())
+        {
+            size_t fe = filter.find('/', f);
+            if (fe == std::string::npos)
+                fe = filter.size();
+            std::string level = filter.substr(f, fe - f);
+            if (level == "#")
+                return true;
+            if (t > topic.size())
+                return false;
+            size_t te = topic.find('/', t);
+            if (te == std::string::npos)
+                te = topic.size();
+            if (level != "+" && level != topic.substr(t, te - t))
+                return false;
+            f = fe + 1;
+            t = te + 1;
+        }
+        return t > topic.size();
+    }
+
+    static void _store_io(store_t *st, uint64_t pos, void *buf, int len, bool write)
+    {
+        uint8_t *p = (uint8_t *)buf;
+        while (len > 0)
+        {
+            uint64_t off = pos % st->head.cap;
+            int n = std::min((uint64_t)len, st->head.cap - off);
+            ssize_t ret = write ? pwrite(st->fd, p, n, MQTT_STORE_DATA_OFFSET + off)
+                                : pread(st->fd, p, n, MQTT_STORE_DATA_OFFSET + off);
+            if (ret != n)
+            {
+                log::error("mqtt offline store %s failed: %s", write ? "write" : "read", strerror(errno));
+                return;
+            }
+            p += n;
+            pos += n;
+            len -= n;
+        }
+    }
+
+    static void _store_sync(store_t *st)
+    {
+        if (pwrite(st->fd, &st->head, sizeof(st->head), 0) != sizeof(st->head))
+            log::error("mqtt offline store write head failed: %s", strerror(errno));
+    }
+
+    // return number of messages dropped
+    static int _store_push(store_t *st, const msg_t *msg)
+    {
+        uint32_t len = 3 + msg->topic.size() + msg->payload.size();
+        if (4 + len > st->head.cap)
+            return 1;
+        int dropped = 0;
+        while (st->head.tail - st->head.head + 4 + len > st->head.cap)
+        {
+            uint32_t old;
+            _store_io(st, st->head.head, &old, 4, false);
+            st->head.head += 4 + old;
+            st->read = std::max(st->read, st->head.head);
+            --st->head.count;
+            if (st->loaded.empty())
+                ++dropped;
+            else
+                st->loaded.pop_front(); // already in memory, still sent
+        }
+        uint8_t hdr[7];
+        memcpy(hdr, &len, 4);
+        hdr[4] = msg->qos | (msg->retain ? 0x80 : 0);
+        hdr[5] = msg->topic.size() >> 8;
+        hdr[6] = msg->topic.size() & 0xFF;
+        _store_io(st, st->head.tail, hdr, 7, true);
+        _store_io(st, st->head.tail + 7, (void *)msg->topic.data(), msg->topic.size(), true);
+        _store_io(st, st->head.tail + 7 + msg->topic.size(), (void *)msg->payload.data(), msg->payload.size(), true);
+        st->head.tail += 4 + len;
+        ++st->head.count;
+        _store_sync(st);
+        return dropped;
+    }
+
+    // records not loaded to memory yet
+    static uint32_t _store_unread(store_t *st)
+    {
+        return st->fd < 0 ? 0 : st->head.count - st->loaded.size();
+    }
+
+    // load next record, it stays in file until _store_done
+    static msg_t *_store_pop(store_t *st)
+    {
+        uint8_t hdr[7];
+        uint32_t len;
+        _store_io(st, st->read, hdr, 7, false);
+        memcpy(&len, hdr, 4);
+        int topic_len = (hdr[5] << 8) | hdr[6];
+        msg_t *msg = new msg_t();
+        msg->qos = hdr[4] & 0x03;
+        msg->retain = hdr[4] & 0x80;
+        msg->dup = false;
+        msg->pid = 0;
+        msg->topic.resize(topic_len);
+        msg->payload.resize(len - 3 - topic_len);
+        _store_io(st, st->read + 7, &msg->topic[0], topic_len, false);
+        _store_io(st, st->read + 7 + topic_len, &msg->payload[0], msg->payload.size(), false);
+        st->read += 4 + len;
+        msg->store_end = st->read;
+        msg->store_gen = st->gen;
+        st->loaded.push_back({st->read, false});
+        return msg;
+    }
+
+    // record delivered, move head over delivered records in order
+    static void _store_done(store_t *st, uint64_t end, uint32_t gen)
+    {
+        if (st->fd < 0 || end == 0 || gen != st->gen)
+            return;
+        auto it = std::find_if(st->loaded.begin(), st->loaded.end(), [end](const store_rec_t &r) { return r.end == end; });
+        if (it == st->loaded.end())
+            return; // dropped by _store_push already
+        it->done = true;
+        if (!st->loaded.front().done)
+            return;
+        while (!st->loaded.empty() && st->loaded.front().done)
+        {
+            st->head.head = st->loaded.front().end;
+            --st->head.count;
+            st->loaded.pop_front();
+        }
+        if (st->head.count == 0)
+            st->head.head = st->head.tail = st->read = 0;
+        _store_sync(st);
+    }
+
+    // forget loaded records, they are loaded again from head
+    static void _store_rewind(store_t *st)
+    {
+        st->loaded.clear();
+        st->read = st->head.head;
+    }
+
+    static bool _flush_out(client_t *c)
+    {
+        while (!c->out.empty())
+        {
+            ssize_t n = send(c->fd, c->out.data(), c->out.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    break;
+                return false;
+            }
+            c->out.erase(0, n);
+            c->out_pos += n;
+            c->last_tx_ms = time::ticks_ms();
+        }
+        while (!c->out_store.empty() && c->out_store.front().out_end <= c->out_pos)
+        {
+            _store_done(&c->store, c->out_store.front().store_end, c->out_store.front().store_gen);
+            c->out_store.pop_front();
+        }
+        bool want_out = !c->out.empty() || c->state == STATE_CONNECTING;
+        if (want_out != c->want_out)
+        {
+            c->reactor->mod(c->fd, EPOLLIN | (want_out ? (uint32_t)EPOLLOUT : 0u));
+            c->want_out = want_out;
+        }
+        return true;
+    }
+
+    static void _encode_publish(client_t *c, msg_t *msg)
+    {
+        std::string body;
+        std::string props;
+        if (c->version == V5 && c->alias_max > 0)
+        {
+            auto it = c->aliases.find(msg->topic);
+            uint16_t alias = 0;
+            if (it != c->aliases.end())
+                alias = it->second;
+            else if ((int)c->aliases.size() < c->alias_max)
+            {
+                alias = c->aliases.size() + 1;
+                c->aliases[msg->topic] = alias;
+                it = c->aliases.end(); // first use, send topic with alias
+            }
+            if (alias)
+            {
+                props.push_back(0x23);
+                _put_u16(props, alias);
+            }
+            _put_str(body, it != c->aliases.end() ? std::string() : msg->topic);
+        }
+        else
+            _put_str(body, msg->topic);
+        if (msg->qos)
+            _put_u16(body, msg->pid);
+        if (c->version == V5)
+        {
+            _put_varint(body, props.size());
+            body += props;
+        }
+        body += msg->payload;
+        _packet(c->out, (PKT_PUBLISH << 4) | (msg->dup ? 0x08 : 0) | (msg->qos << 1) | (msg->retain ? 1 : 0), body);
+    }
+
+    static uint16_t _alloc_pid(client_t *c)
+    {
+        while (1)
+        {
+            uint16_t pid = c->next_pid++;
+            if (c->next_pid == 0)
+                c->next_pid = 1;
+            bool used = false;
+            for (auto msg : c->inflight)
+            {
+                if (msg->pid == pid)
+                {
+                    used = true;
+                    break;
+                }
+            }
+            if (!used)
+                return pid;
+        }
+    }
+
+    // move queued messages to socket buffer within in-flight window
+    static void _pump(client_t *c)
+    {
+        if (c->state != STATE_CONNECTED)
+            return;
+        int window = std::min(c->max_inflight, c->receive_max);
+        while ((int)c->out.size() < MQTT_OUT_MAX)
+        {
+            if (c->queue.empty())
+            {
+                if (_store_unread(&c->store) == 0)
+                    break;
+                msg_t *msg = _store_pop(&c->store);
+                c->queue.push_back(msg);
+                c->queue_bytes += msg->topic.size() + msg->payload.size();
+            }
+            msg_t *msg = c->queue.front();
+            if (msg->qos && (int)c->inflight.size() >= window)
+                break;
+            c->queue.pop_front();
+            c->queue_bytes -= msg->topic.size() + msg->payload.size();
+            if (msg->qos)
+            {
+                msg->pid = _alloc_pid(c); // clean session, ids of last connection are not kept
+                c->inflight.push_back(msg);
+                _encode_publish(c, msg);
+            }
+            else
+            {
+                _encode_publish(c, msg);
+                if (msg->store_end)
+                    c->out_store.push_back({c->out_pos + c->out.size(), msg->store_end, msg->store_gen});
+                delete msg;
+            }
+        }
+    }
+
+    static void _close(client_t *c, calls_t &calls)
+    {
+        if (c->fd < 0)
+            return;
+        bool was_connected = c->state == STATE_CONNECTED;
+        c->reactor->del(c->fd);
+        ::close(c->fd);
+        c->fd = -1;
+        c->state = STATE_IDLE;
+        c->want_out = false;
+        c->out_pos += c->out.size();
+        c->out.clear();
+        // QoS0 is at most once, records not sent are not kept
+        for (auto &r : c->out_store)
+            _store_done(&c->store, r.store_end, r.store_gen);
+        c->out_store.clear();
+        c->rx.clear();
+        c->aliases.clear();
+        // resend unacknowledged messages first after reconnect
+        while (!c->inflight.empty())
+        {
+            msg_t *msg = c->inflight.back();
+            c->inflight.pop_back();
+            msg->dup = true;
+            c->queue.push_front(msg);
+            c->queue_bytes += msg->topic.size() + msg->payload.size();
+        }
+        c->retry_ms = time::ticks_ms() + c->backoff_ms;
+        c->backoff_ms = std::min(c->backoff_ms * 2, MQTT_RETRY_MAX_MS);
+        if (was_connected && c->on_connect)
+        {
+            ConnectHandler on_connect = c->on_connect;
+            Client *self = c->self;
+            calls.push_back([on_connect, self]() { on_connect(*self, false); });
+        }
+    }
+
+    static err::Err _enqueue(client_t *c, msg_t *msg, calls_t &calls)
+    {
+        int size = msg->topic.size() + msg->payload.size();
+        if (c->store.fd >= 0 && (c->state != STATE_CONNECTED || _store_unread(&c->store) > 0 || c->queue_bytes + size > c->max_queue))
+        {
+            // keep order, go to store once store not empty
+            c->dropped += _store_push(&c->store, msg);
+            delete msg;
+        }
+        else if (c->queue_bytes + size > c->max_queue)
+        {
+            ++c->dropped;
+            delete msg;
+            return err::ERR_BUFF_FULL;
+        }
+        else
+        {
+            c->queue.push_back(msg);
+            c->queue_bytes += size;
+        }
+        if (c->state == STATE_CONNECTED)
+        {
+            _pump(c);
+            if (!_flush_out(c))
+                _close(c, calls);
+        }
+        return err::ERR_NONE;
+    }
+
+    static void _flush_batch(client_t *c, std::map<std::string, batch_t>::iterator it, calls_t &calls)
+    {
+        msg_t *msg = new msg_t();
+        msg->topic = it->second.topic;
+        msg->payload.swap(it->second.data);
+        msg->qos = it->second.qos;
+        msg->retain = it->second.retain;
+        msg->dup = false;
+        msg->pid = 0;
+        c->batches.erase(it);
+        _enqueue(c, msg, calls);
+    }
+
+    static void _flush_batches(client_t *c, bool all, calls_t &calls)
+    {
+        uint64_t now = time::ticks_ms();
+        for (auto it = c->batches.begin(); it != c->batches.end();)
+        {
+            auto cur = it++;
+            if (all || now - cur->second.first_ms >= (uint64_t)c->batch_interval)
+                _flush_batch(c, cur, calls);
+        }
+    }
+
+    static void _send_subscribe(client_t *c, const std::vector<sub_t> &subs)
+    {
+        if (subs.empty())
+            return;
+        std::string body;
+        _put_u16(body, _alloc_pid(c));
+        if (c->version == V5)
+            _put_varint(body, 0);
+        for (auto &sub : subs)
+        {
+            _put_str(body, sub.filter);
+            body.push_back((char)sub.qos);
+        }
+        _packet(c->out, (PKT_SUBSCRIBE << 4) | 0x02, body);
+    }
+
+    static void _send_connect(client_t *c)
+    {
+        std::string body;
+        _put_str(body, "MQTT");
+        body.push_back((char)c->version);
+        uint8_t flags = 0x02; // clean session, unacknowledged messages are resent by us with DUP
+        if (c->has_auth)
+            flags |= (c->username.empty() ? 0 : 0x80) | (c->password.empty() ? 0 : 0x40);
+        body.push_back((char)flags);
+        _put_u16(body, c->keepalive);
+        if (c->version == V5)
+            _put_varint(body, 0);
+        _put_str(body, c->client_id);
+        if (flags & 0x80)
+            _put_str(body, c->username);
+        if (flags & 0x40)
+            _put_str(body, c->password);
+        _packet(c->out, PKT_CONNECT << 4, body);
+    }
+
+    // parse CONNACK properties of V5
+    static void _parse_connack_props(client_t *c, const uint8_t *p, int len)
+    {
+        int i = 0;
+        while (i < len)
+        {
+            uint8_t id = p[i++];
+            switch (id)
+            {
+            case 0x21: // receive maximum
+                if (i + 2 > len)
+                    return;
+                c->receive_max = (p[i] << 8) | p[i + 1];
+                i += 2;
+                break;
+            case 0x22: // topic alias maximum
+                if (i + 2 > len)
+                    return;
+                c->alias_max = (p[i] << 8) | p[i + 1];
+                i += 2;
+                break;
+            case 0x13:
+                i += 2;
+                break;
+            case 0x01: case 0x17: case 0x19: case 0x24: case 0x25: case 0x28: case 0x29: case 0x2A:
+                i += 1;
+                break;
+            case 0x02: case 0x11: case 0x18: case 0x27:
+                i += 4;
+                break;
+            case 0x12: case 0x15: case 0x16: case 0x1A: case 0x1C: case 0x1F: case 0x03: case 0x08: case 0x09:
+                if (i + 2 > len)
+                    return;
+                i += 2 + ((p[i] << 8) | p[i + 1]);
+                break;
+            case 0x26: // user property, string pair
+                for (int k = 0; k < 2 && i + 2 <= len; ++k)
+                    i += 2 + ((p[i] << 8) | p[i + 1]);
+                break;
+            default:
+                return; // unknown property, ignore the rest
+            }
+        }
+    }
+
+    static void _handle_packet(client_t *c, int type, int flags, const uint8_t *p, int len, calls_t &calls)
+    {
+        switch (type)
+        {
+        case PKT_CONNACK:
+        {
+            if (len < 2 || p[1] != 0)
+            {
+                log::error("mqtt connect refused by %s:%d, code %d", c->host.c_str(), c->port, len < 2 ? -1 : p[1]);
+                _close(c, calls);
+                return;
+            }
+            c->receive_max = 65535;
+            c->alias_max = 0;
+            if (c->version == V5)
+            {
+                uint32_t props_len;
+                int n = _get_varint(p + 2, len - 2, &props_len);
+                if (n > 0 && 2 + n + (int)props_len <= len)
+                    _parse_connack_props(c, p + 2 + n, props_len);
+            }
+            c->state = STATE_CONNECTED;
+            c->backoff_ms = MQTT_RETRY_MIN_MS;
+            log::info("mqtt connected to %s:%d", c->host.c_str(), c->port);
+            _send_subscribe(c, c->subs);
+            if (c->on_connect)
+            {
+                ConnectHandler on_connect = c->on_connect;
+                Client *self = c->self;
+                calls.push_back([on_connect, self]() { on_connect(*self, true); });
+            }
+            _pump(c);
+            break;
+        }
+        case PKT_PUBLISH:
+        {
+            int qos = (flags >> 1) & 0x03;
+            if (len < 2)
+                break;
+            int topic_len = (p[0] << 8) | p[1];
+            int i = 2 + topic_len;
+            uint16_t pid = 0;
+            if (qos)
+            {
+                if (i + 2 > len)
+                    break;
+                pid = (p[i] << 8) | p[i + 1];
+                i += 2;
+            }
+            if (c->version == V5)
+            {
+                uint32_t props_len;
+                int n = _get_varint(p + i, len - i, &props_len);
+                if (n == 0)
+                    break;
+                i += n + props_len;
+            }
+            if (i > len)
+                break;
+            if (qos == 1)
+            {
+                std::string ack;
+                _put_u16(ack, pid);
+                _packet(c->out, PKT_PUBACK << 4, ack);
+            }
+            std::string topic((const char *)p + 2, topic_len);
+            std::string payload((const char *)p + i, len - i);
+            Client *self = c->self;
+            for (auto &sub : c->subs)
+            {
+                if (!_topic_match(sub.filter, topic))
+                    continue;
+                MessageHandler handler = sub.handler;
+                calls.push_back([handler, self, topic, payload]() {
+                    handler(*self, topic, (const uint8_t *)payload.data(), payload.size());
+                });
+            }
+            break;
+        }
+        case PKT_PUBACK:
+        {
+            if (len < 2)
+                break;
+            uint16_t pid = (p[0] << 8) | p[1];
+            for (auto it = c->inflight.begin(); it != c->inflight.end(); ++it)
+            {
+                if ((*it)->pid == pid)
+                {
+                    // V5 reason code, rejected by broker, resend will not help
+                    if (c->version == V5 && len > 2 && p[2] >= 0x80)
+                    {
+                        log::error("mqtt publish to %s rejected, code 0x%02x", (*it)->topic.c_str(), p[2]);
+                        ++c->dropped;
+                    }
+                    _store_done(&c->store, (*it)->store_end, (*it)->store_gen);
+                    delete *it;
+                    c->inflight.erase(it);
+                    break;
+                }
+            }
+            _pump(c);
+            break;
+        }
+        case PKT_SUBACK:
+        {
+            int i = 2;
+            if (c->version == V5)
+            {
+                uint32_t props_len;
+                int n = _get_varint(p + i, len - i, &props_len);
+                i += n + props_len;
+            }
+            for (; i < len; ++i)
+            {
+                if (p[i] >= 0x80)
+                    log::warn("mqtt subscribe rejected, code 0x%02x", p[i]);
+            }
+            break;
+        }
+        case PKT_DISCONNECT:
+            log::warn("mqtt disconnected by broker, reason %d", len > 0 ? p[0] : 0);
+            _close(c, calls);
+            break;
+        default: // UNSUBACK, PINGRESP
+            break;
+        }
+    }
+
+    static void _on_event(client_t *c, uint32_t events)
+    {
+        calls_t calls;
+        {
+            std::lock_guard<std::mutex> lock(c->lock);
+            if (c->fd < 0)
+                return;
+            if (c->state == STATE_CONNECTING)
+            {
+                int error = 0;
+                socklen_t len = sizeof(error);
+                getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &error, &len);
+                if (error)
+                {
+                    log::warn("mqtt connect %s:%d failed: %s", c->host.c_str(), c->port, strerror(error));
+                    _close(c, calls);
+                    goto end;
+                }
+                if (!(events & EPOLLOUT))
+                    goto end;
+                c->state = STATE_WAIT_CONNACK;
+                c->last_rx_ms = time::ticks_ms();
+                _send_connect(c);
+            }
+            if (events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+            {
+                BufferPool &pool = BufferPool::shared();
+                uint8_t *buff = pool.alloc();
+                bool closed = false;
+                while (1)
+                {
+                    ssize_t n = recv(c->fd, buff, pool.block_size(), MSG_DONTWAIT);
+                    if (n > 0)
+                    {
+                        c->rx.append((const char *)buff, n);
+                        continue;
+                    }
+                    if (n < 0 && errno == EINTR)
+                        continue;
+                    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                        break;
+                    closed = true;
+                    break;
+                }
+                pool.free(buff);
+                while (c->fd >= 0 && c->rx.size() >= 2)
+                {
+                    const uint8_t *p = (const uint8_t *)c->rx.data();
+                    uint32_t len;
+                    int n = _get_varint(p + 1, c->rx.size() - 1, &len);
+                    if (n == 0)
+                    {
+                        if (c->rx.size() >= 5)
+                            closed = true; // malformed length
+                        break;
+                    }
+                    if (len > MQTT_PACKET_MAX)
+                    {
+                        log::error("mqtt packet too large: %u", len);
+                        closed = true;
+                        break;
+                    }
+                    if (c->rx.size() < 1 + n + len)
+                        break;
+                    c->last_rx_ms = time::ticks_ms();
+                    std::string packet = c->rx.substr(0, 1 + n + len);
+                    c->rx.erase(0, 1 + n + len);
+                    _handle_packet(c, packet[0] >> 4 & 0x0F, packet[0] & 0x0F, (const uint8_t *)packet.data() + 1 + n, len, calls);
+                }
+                if (closed)
+                {
+                    if (c->state == STATE_CONNECTED)
+                        log::warn("mqtt connection to %s:%d lost", c->host.c_str(), c->port);
+                    _close(c, calls);
+                    goto end;
+                }
+            }
+            if (c->fd >= 0 && !_flush_out(c))
+                _close(c, calls);
+        }
+    end:
+        for (auto &fn : calls)
+            fn();
+    }
+
+    // blocking, call in caller thread
+    static bool _resolve(const std::string &host, int port, struct sockaddr_in *addr)
+    {
+        struct addrinfo hints, *res = nullptr;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        std::string port_str = std::to_string(port);
+        if (getaddrinfo(host.c_str(), port_str.c_str(), &hints, &res) != 0 || !res)
+            return false;
+        memcpy(addr, res->ai_addr, sizeof(struct sockaddr_in));
+        freeaddrinfo(res);
+        return true;
+    }
+
+    static void _start_connect(client_t *c)
+    {
+        c->state_ms = time::ticks_ms();
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int ret = fd < 0 ? -1 : ::connect(fd, (struct sockaddr *)&c->addr, sizeof(c->addr));
+        if (fd < 0 || (ret < 0 && errno != EINPROGRESS))
+        {
+            log::warn("mqtt connect %s:%d failed: %s", c->host.c_str(), c->port, strerror(errno));
+            if (fd >= 0)
+                ::close(fd);
+            c->retry_ms = c->state_ms + c->backoff_ms;
+            c->backoff_ms = std::min(c->backoff_ms * 2, MQTT_RETRY_MAX_MS);
+            return;
+        }
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        c->fd = fd;
+        c->state = STATE_CONNECTING;
+        c->want_out = true;
+        std::shared_ptr<client_t> ref = c->ref;
+        c->reactor->add(fd, EPOLLIN | EPOLLOUT, [ref](uint32_t events) { _on_event(ref.get(), events); });
+    }
+
+    static void _on_timer(client_t *c)
+    {
+        calls_t calls;
+        {
+            std::lock_guard<std::mutex> lock(c->lock);
+            if (c->timer_fd < 0)
+                return; // client destroyed
+            uint64_t value;
+            ssize_t ret = ::read(c->timer_fd, &value, sizeof(value));
+            (void)ret;
+            uint64_t now = time::ticks_ms();
+            _flush_batches(c, false, calls);
+            if (c->want_connect)
+            {
+                if (c->state == STATE_IDLE && now >= c->retry_ms)
+                    _start_connect(c);
+                else if ((c->state == STATE_CONNECTING || c->state == STATE_WAIT_CONNACK) && now - c->state_ms > MQTT_CONNECT_TIMEOUT_MS)
+                {
+                    log::warn("mqtt connect %s:%d timeout", c->host.c_str(), c->port);
+                    _close(c, calls);
+                }
+                else if (c->state == STATE_CONNECTED && c->keepalive > 0)
+                {
+                    if (now - c->last_rx_ms > (uint64_t)c->keepalive * 1500)
+                    {
+                        log::warn("mqtt keep alive timeout");
+                        _close(c, calls);
+                    }
+                    else if (now - c->last_tx_ms >= (uint64_t)c->keepalive * 1000)
+                        _packet(c->out, PKT_PINGREQ << 4, "");
+                }
+            }
+            if (c->state == STATE_CONNECTED)
+            {
+                _pump(c);
+                if (!_flush_out(c))
+                    _close(c, calls);
+            }
+        }
+        for (auto &fn : calls)
+            fn();
+    }
+
+    static void _set_timer(client_t *c)
+    {
+        if (c->timer_fd < 0)
+            return;
+        int ms = c->batch_interval > 0 ? std::max(10, std::min(c->batch_interval, 1000)) : 1000;
+        struct itimerspec its;
+        its.it_interval.tv_sec = ms / 1000;
+        its.it_interval.tv_nsec = (ms % 1000) * 1000000;
+        its.it_value = its.it_interval;
+        timerfd_settime(c->timer_fd, 0, &its, nullptr);
+    }
+
+    static void _free_client(client_t *c)
+    {
+        for (auto msg : c->queue)
+            delete msg;
+        for (auto msg : c->inflight)
+            delete msg;
+        if (c->store.fd >= 0)
+            ::close(c->store.fd);
+        delete c;
+    }
+
+    Client::Client(const std::string &host, int port, const std::string &client_id, mqtt::Version version, network::Reactor *reactor)
+    {
+        client_t *c = new client_t();
+        c->self = this;
+        c->host = host;
+        c->port = port;
+        c->client_id = client_id.empty() ? "maix_" + std::to_string(getpid()) + "_" + std::to_string(time::ticks_ms() % 100000) : client_id;
+        c->version = version;
+        c->has_auth = false;
+        c->keepalive = 60;
+        c->max_inflight = 16;
+        c->receive_max = 65535;
+        c->max_queue = 256 * 1024;
+        c->batch_interval = 0;
+        c->batch_max = 4096;
+        c->batch_sep = "\n";
+        c->own_reactor = reactor == nullptr;
+        c->reactor = reactor ? reactor : new network::Reactor();
+        c->fd = -1;
+        c->timer_fd = -1;
+        c->state = STATE_IDLE;
+        c->want_connect = false;
+        c->want_out = false;
+        c->out_pos = 0;
+        c->queue_bytes = 0;
+        c->next_pid = 1;
+        c->store.fd = -1;
+        c->store.gen = 0;
+        c->store.read = 0;
+        c->alias_max = 0;
+        c->last_tx_ms = 0;
+        c->last_rx_ms = 0;
+        c->state_ms = 0;
+        c->retry_ms = 0;
+        c->backoff_ms = MQTT_RETRY_MIN_MS;
+        c->dropped = 0;
+        c->ref = std::shared_ptr<client_t>(c, _free_client);
+        _data = c;
+    }
+
+    Client::~Client()
+    {
+        client_t *c = (client_t *)_data;
+        if (c->own_reactor)
+            c->reactor->stop();
+        disconnect();
+        {
+            std::lock_guard<std::mutex> lock(c->lock);
+            if (c->timer_fd >= 0)
+            {
+                c->reactor->del(c->timer_fd);
+                ::close(c->timer_fd);
+                c->timer_fd = -1;
+            }
+        }
+        if (c->own_reactor)
+            delete c->reactor; // thread joined by stop(), callbacks are released here
+        // a callback may still be running or waiting lock on a shared reactor, last copy frees state
+        std::shared_ptr<client_t> ref;
+        {
+            std::lock_guard<std::mutex> lock(c->lock);
+            ref = std::move(c->ref);
+        }
+    }
+
+    void Client::set_auth(const std::string &username, const std::string &password)
+    {
+        client_t *c = (client_t *)_data;
+        std::lock_guard<std::mutex> lock(c->lock);
+        c->has_auth = true;
+        c->username = username;
+        c->password = password;
+    }
+
+    void Client::set_keepalive(int keepalive)
+    {
+        client_t *c = (client_t *)_data;
+        std::lock_guard<std::mutex> lock(c->lock);
+        c->keepalive = std::max(0, std::min(keepalive, 65535));
+    }
+
+    void Client::set_inflight(int max_inflight)
+    {
+        client_t *c = (client_t *)_data;
+        std::lock_guard<std::mutex> lock(c->lock);
+        c->max_inflight = std::max(1, max_inflight);
+    }
+
+    void Client::set_max_queue(int max_bytes)
+    {
+        client_t *c = (client_t *)_data;
+        std::lock_guard<std::mutex> lock(c->lock);
+        c->max_queue = max_bytes;
+    }
+
+    void Client::set_batch(int interval_ms, int max_bytes, const std::string &separator)
+    {
+        client_t *c = (client_t *)_data;
+        calls_t calls;
+        {
+            std::lock_guard<std::mutex> lock(c->lock);
+            _flush_batches(c, true, calls);
+            c->batch_interval = interval_ms;
+            c->batch_max = max_bytes;
+            c->batch_sep = separator;
+            _set_timer(c);
+        }
+        for (auto &fn : calls)
+            fn();
+    }
+
+    err::Err Client::set_offline_store(const std::string &path, int max_bytes)
+    {
+        client_t *c = (client_t *)_data;
+        std::lock_guard<std::mutex> lock(c->lock);
+        if (c->store.fd >= 0)
+        {
+            ::close(c->store.fd);
+            c->store.fd = -1;
+        }
+        // messages already loaded stay in memory, the old file keeps them until delivered from it
+        ++c->store.gen;
+        c->store.loaded.clear();
+        c->store.read = 0;
+        if (path.empty())
+            return err::ERR_NONE;
+        if (max_bytes <= 0)
+            return err::ERR_ARGS;
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0)
+        {
+            log::error("open mqtt offline store %s failed: %s", path.c_str(), strerror(errno));
+            return err::ERR_IO;
+        }
+        store_head_t head;
+        if (pread(fd, &head, sizeof(head), 0) == sizeof(head) && head.magic == MQTT_STORE_MAGIC && head.cap == (uint64_t)max_bytes &&
+            head.tail - head.head <= head.cap)
+        {
+            c->store.head = head;
+            if (head.count)
+                log::info("mqtt offline store %s has %u messages", path.c_str(), head.count);
+        }
+        else
+        {
+            memset(&c->store.head, 0, sizeof(c->store.head));
+            c->store.head.magic = MQTT_STORE_MAGIC;
+            c->store.head.cap = max_bytes;
+        }
+        c->store.fd = fd;
+        c->store.read = c->store.head.head;
+        _store_sync(&c->store);
+        return err::ERR_NONE;
+    }
+
+    void Client::set_connect_handler(mqtt::ConnectHandler handler)
+    {
+        client_t *c = (client_t *)_data;
+        std::lock_guard<std::mutex> lock(c->lock);
+        c->on_connect = handler;
+    }
+
+    err::Err Client::connect()
+    {
+        client_t *c = (client_t *)_data;
+        {
+            std::lock_guard<std::mutex> lock(c->lock);
+            if (c->want_connect)
+                return err::ERR_NONE;
+        }
+        // resolve once here, reconnects in reactor thread use the same address
+        struct sockaddr_in addr;
+        if (!_resolve(c->host, c->port, &addr))
+        {
+            log::error("mqtt resolve %s failed", c->host.c_str());
+            return err::ERR_ARGS;
+        }
+        {
+            std::lock_guard<std::mutex> lock(c->lock);
+            if (c->want_connect)
+                return err::ERR_NONE;
+            if (c->timer_fd < 0)
+            {
+                c->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+                if (c->timer_fd < 0)
+                    return err::ERR_IO;
+                _set_timer(c);
+                std::shared_ptr<client_t> ref = c->ref;
+                c->reactor->add(c->timer_fd, EPOLLIN, [ref](uint32_t) { _on_timer(ref.get()); });
+            }
+            c->addr = addr;
+            c->want_connect = true;
+            c->backoff_ms = MQTT_RETRY_MIN_MS;
+            _start_connect(c);
+        }
+        if (c->own_reactor)
+            c->reactor->start();
+        return err::ERR_NONE;
+    }
+
+    void Client::disconnect()
+    {
+        client_t *c = (client_t *)_data;
+        calls_t calls;
+        {
+            std::lock_guard<std::mutex> lock(c->lock);
+            _flush_batches(c, true, calls);
+            c->want_connect = false;
+            if (c->fd >= 0)
+            {
+                if (c->state == STATE_CONNECTED)
+                {
+                    _packet(c->out, PKT_DISCONNECT << 4, "");
+                    _flush_out(c);
+                }
+                _close(c, calls);
+            }
+            // persist messages not sent, order kept only when no record after them in store,
+            // records loaded from store are still in it and loaded again
+            if (c->store.fd >= 0 && _store_unread(&c->store) == 0)
+            {
+                _store_rewind(&c->store);
+                for (auto msg : c->queue)
+                {
+                    if (msg->store_end == 0 || msg->store_gen != c->store.gen)
+                        c->dropped += _store_push(&c->store, msg);
+                    delete msg;
+                }
+                c->queue.clear();
+                c->queue_bytes = 0;
+            }
+        }
+        for (auto &fn : calls)
+            fn();
+    }
+
+    bool Client::is_connected()
+    {
+        client_t *c = (client_t *)_data;
+        std::lock_guard<std::mutex> lock(c->lock);
+        return c->state == STATE_CONNECTED;
+    }
+
+    err::Err Client::publish(const std::string &topic, const uint8_t *data, int len, int qos, bool retain)
+    {
+        client_t *c = (client_t *)_data;
+        if (topic.empty() || topic.size() > 65535 || topic.find_first_of("+#") != std::string::npos ||
+            qos < 0 || qos > 1 || len < 0 || (len > 0 && !data))
+            return err::ERR_ARGS;
+        calls_t calls;
+        err::Err e = err::ERR_NONE;
+        {
+            std::lock_guard<std::mutex> lock(c->lock);
+            std::string key = topic;
+            key.push_back((char)(qos | (retain ? 0x80 : 0)));
+            auto it = c->batches.find(key);
+            if (c->batch_interval > 0 && len + c->batch_sep.size() <= (size_t)c->batch_max)
+            {
+                if (it != c->batches.end() && it->second.data.size() + c->batch_sep.size() + len > (size_t)c->batch_max)
+                {
+                    _flush_batch(c, it, calls);
+                    it = c->batches.end();
+                }
+                if (it == c->batches.end())
+                {
+                    batch_t &batch = c->batches[key];
+                    batch.topic = topic;
+                    batch.qos = qos;
+                    batch.retain = retain;
+                    batch.first_ms = time::ticks_ms();
+                    batch.data.reserve(c->batch_max);
+                    batch.data.assign((const char *)data, len);
+                }
+                else
+                {
+                    it->second.data += c->batch_sep;
+                    it->second.data.append((const char *)data, len);
+                }
+            }
+            else
+            {
+                if (it != c->batches.end())
+                    _flush_batch(c, it, calls); // keep order
+                msg_t *msg = new msg_t();
+                msg->topic = topic;
+                msg->payload.assign((const char *)data, len);
+                msg->qos = qos;
+                msg->retain = retain;
+                msg->dup = false;
+                msg->pid = 0;
+                e = _enqueue(c, msg, calls);
+            }
+        }
+        for (auto &fn : calls)
+            fn();
+        return e;
+    }
+
+    err::Err Client::subscribe(const std::string &topic, int qos, mqtt::MessageHandler handler)
+    {
+        client_t *c = (client_t *)_data;
+        if (topic.empty() || qos < 0 || qos > 1 || !handler)
+            return err::ERR_ARGS;
+        calls_t calls;
+        {
+            std::lock_guard<std::mutex> lock(c->lock);
+            sub_t sub;
+            sub.filter = topic;
+            sub.qos = qos;
+            sub.handler = handler;
+            c->subs.push_back(sub);
+            if (c->state == STATE_CONNECTED)
+            {
+                _send_subscribe(c, std::vector<sub_t>{sub});
+                if (!_flush_out(c))
+                    _close(c, calls);
+            }
+        }
+        for (auto &fn : calls)
+            fn();
+        return err::ERR_NONE;
+    }
+
+    err::Err Client::unsubscribe(const std::string &topic)
+    {
+        client_t *c = (client_t *)_data;
+        calls_t calls;
+        {
+            std::lock_guard<std::mutex> lock(c->lock);
+            auto it = std::remove_if(c->subs.begin(), c->subs.end(), [&](const sub_t &sub) { return sub.filter == topic; });
+            if (it == c->subs.end())
+                return err::ERR_NOT_FOUND;
+            c->subs.erase(it, c->subs.end());
+            if (c->state == STATE_CONNECTED)
+            {
+                std::string body;
+                _put_u16(body, _alloc_pid(c));
+                if (c->version == V5)
+                    _put_varint(body, 0);
+                _put_str(body, topic);
+                _packet(c->out, (PKT_UNSUBSCRIBE << 4) | 0x02, body);
+                if (!_flush_out(c))
+                    _close(c, calls);
+            }
+        }
+        for (auto &fn : calls)
+            fn();
+        return err::ERR_NONE;
+    }
+
+    int Client::pending()
+    {
+        client_t *c = (client_t *)_data;
+        std::lock_guard<std::mutex> lock(c->lock);
+        return c->queue.size() + c->inflight.size() + _store_unread(&c->store);
+    }
+
+    uint64_t Client::dropped()
+    {
+        client_t *c = (client_t *)_data;
+        std::lock_guard<std::mutex> lock(c->lock);
+        return c->dropped;
+    }
+} // namespace maix::network::mqtt
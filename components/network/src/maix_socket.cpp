@@ -0,0 +1,290 @@
+/**
+ * @author neucrack@sipeed
+ * @copyright Sipeed Ltd 2023-
+ * @license Apache 2.0
+ * @update 2024.12.6: Add epoll reactor and buffer pool.
+ */
+
+#include "maix_socket.hpp"
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+namespace maix::network
+{
+    typedef struct
+    {
+        std::mutex lock;
+        std::vector<uint8_t *> blocks;
+        int max_free;
+    } buffer_pool_t;
+
+    BufferPool::BufferPool(int block_size, int max_free)
+    {
+        if (block_size <= 0)
+            throw err::Exception(err::ERR_ARGS, "block_size must > 0");
+        buffer_pool_t *pool = new buffer_pool_t();
+        pool->max_free = max_free;
+        _block_size = block_size;
+        _data = pool;
+    }
+
+    BufferPool::~BufferPool()
+    {
+        buffer_pool_t *pool = (buffer_pool_t *)_data;
+        for (auto block : pool->blocks)
+            delete[] block;
+        delete pool;
+    }
+
+    uint8_t *BufferPool::alloc()
+    {
+        buffer_pool_t *pool = (buffer_pool_t *)_data;
+        {
+            std::lock_guard<std::mutex> lock(pool->lock);
+            if (!pool->blocks.empty())
+            {
+                uint8_t *block = pool->blocks.back();
+                pool->blocks.pop_back();
+                return block;
+            }
+        }
+        return new uint8_t[_block_size];
+    }
+
+    void BufferPool::free(uint8_t *block)
+    {
+        if (!block)
+            return;
+        buffer_pool_t *pool = (buffer_pool_t *)_data;
+        {
+            std::lock_guard<std::mutex> lock(pool->lock);
+            if ((int)pool->blocks.size() < pool->max_free)
+            {
+                pool->blocks.push_back(block);
+                return;
+            }
+        }
+        delete[] block;
+    }
+
+    BufferPool &BufferPool::shared()
+    {
+        static BufferPool pool;
+        return pool;
+    }
+
+    typedef struct
+    {
+        uint32_t id;    // registration id, never reused(until wrap)
+        std::shared_ptr<std::function<void(uint32_t)>> fn;
+    } handler_t;
+
+    // epoll data is fd and registration id, so a stale event of a closed fd in the same batch
+    // is not dispatched to a new registration reusing the fd number, id 0 is wake fd
+    static uint64_t _event_key(int fd, uint32_t id)
+    {
+        return (uint64_t)id << 32 | (uint32_t)fd;
+    }
+
+    typedef struct
+    {
+        int epoll_fd;
+        int wake_fd;
+        std::mutex lock;
+        std::unordered_map<int, handler_t> handlers;
+        uint32_t next_id;
+        std::vector<std::function<void()>> posted;
+        std::atomic<bool> exit;
+        std::thread *thread;
+        std::atomic<std::thread::id> loop_id;
+    } reactor_t;
+
+    Reactor::Reactor()
+    {
+        reactor_t *r = new reactor_t();
+        r->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        r->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (r->epoll_fd < 0 || r->wake_fd < 0)
+        {
+            if (r->epoll_fd >= 0)
+                close(r->epoll_fd);
+            if (r->wake_fd >= 0)
+                close(r->wake_fd);
+            delete r;
+            throw err::Exception(err::ERR_IO, "create epoll failed");
+        }
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u64 = _event_key(r->wake_fd, 0);
+        epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, r->wake_fd, &ev);
+        r->next_id = 0;
+        r->exit = false;
+        r->thread = nullptr;
+        r->loop_id = std::thread::id();
+        _data = r;
+    }
+
+    Reactor::~Reactor()
+    {
+        reactor_t *r = (reactor_t *)_data;
+        stop();
+        close(r->wake_fd);
+        close(r->epoll_fd);
+        delete r;
+    }
+
+    err::Err Reactor::add(int fd, uint32_t events, std::function<void(uint32_t)> callback)
+    {
+        reactor_t *r = (reactor_t *)_data;
+        uint32_t id;
+        {
+            std::lock_guard<std::mutex> lock(r->lock);
+            id = ++r->next_id;
+            if (id == 0)
+                id = ++r->next_id;
+            r->handlers[fd] = {id, std::make_shared<std::function<void(uint32_t)>>(callback)};
+        }
+        struct epoll_event ev;
+        ev.events = events;
+        ev.data.u64 = _event_key(fd, id);
+        if (epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0)
+        {
+            log::error("epoll add fd %d failed: %s", fd, strerror(errno));
+            std::lock_guard<std::mutex> lock(r->lock);
+            r->handlers.erase(fd);
+            return err::ERR_IO;
+        }
+        return err::ERR_NONE;
+    }
+
+    err::Err Reactor::mod(int fd, uint32_t events)
+    {
+        reactor_t *r = (reactor_t *)_data;
+        struct epoll_event ev;
+        ev.events = events;
+        {
+            std::lock_guard<std::mutex> lock(r->lock);
+            auto it = r->handlers.find(fd);
+            if (it == r->handlers.end())
+                return err::ERR_ARGS;
+            ev.data.u64 = _event_key(fd, it->second.id);
+        }
+        if (epoll_ctl(r->epoll_fd, EPOLL_CTL_MOD, fd, &ev) < 0)
+            return err::ERR_IO;
+        return err::ERR_NONE;
+    }
+
+    err::Err Reactor::del(int fd)
+    {
+        reactor_t *r = (reactor_t *)_data;
+        {
+            std::lock_guard<std::mutex> lock(r->lock);
+            r->handlers.erase(fd);
+        }
+        if (epoll_ctl(r->epoll_fd, EPOLL_CTL_DEL, fd, nullptr) < 0)
+            return err::ERR_IO;
+        return err::ERR_NONE;
+    }
+
+    void Reactor::post(std::function<void()> fn)
+    {
+        reactor_t *r = (reactor_t *)_data;
+        {
+            std::lock_guard<std::mutex> lock(r->lock);
+            r->posted.push_back(fn);
+        }
+        uint64_t one = 1;
+        ssize_t ret = ::write(r->wake_fd, &one, sizeof(one));
+        (void)ret;
+    }
+
+    int Reactor::run_once(int timeout)
+    {
+        reactor_t *r = (reactor_t *)_data;
+        r->loop_id = std::this_thread::get_id();
+        struct epoll_event events[64];
+        int num = epoll_wait(r->epoll_fd, events, sizeof(events) / sizeof(events[0]), timeout);
+        if (num < 0)
+            return errno == EINTR ? 0 : -err::ERR_IO;
+        for (int i = 0; i < num; ++i)
+        {
+            int fd = (int)(uint32_t)events[i].data.u64;
+            uint32_t id = (uint32_t)(events[i].data.u64 >> 32);
+            if (id == 0 && fd == r->wake_fd)
+            {
+                uint64_t value;
+                ssize_t ret = ::read(r->wake_fd, &value, sizeof(value));
+                (void)ret;
+                std::vector<std::function<void()>> posted;
+                {
+                    std::lock_guard<std::mutex> lock(r->lock);
+                    posted.swap(r->posted);
+                }
+                for (auto &fn : posted)
+                    fn();
+                continue;
+            }
+            handler_t handler;
+            {
+                std::lock_guard<std::mutex> lock(r->lock);
+                auto it = r->handlers.find(fd);
+                if (it == r->handlers.end() || it->second.id != id)
+                    continue; // removed by previous callback, or fd closed and reused
+                handler = it->second;
+            }
+            (*handler.fn)(events[i].events);
+        }
+        return num;
+    }
+
+    void Reactor::run()
+    {
+        reactor_t *r = (reactor_t *)_data;
+        while (!r->exit && !app::need_exit())
+        {
+            if (run_once(500) < 0)
+            {
+                log::error("reactor wait failed: %s", strerror(errno));
+                break;
+            }
+        }
+    }
+
+    void Reactor::start()
+    {
+        reactor_t *r = (reactor_t *)_data;
+        if (r->thread)
+            return;
+        r->exit = false;
+        r->thread = new std::thread([this]() { run(); });
+    }
+
+    void Reactor::stop()
+    {
+        reactor_t *r = (reactor_t *)_data;
+        r->exit = true;
+        uint64_t one = 1;
+        ssize_t ret = ::write(r->wake_fd, &one, sizeof(one));
+        (void)ret;
+        if (r->thread && std::this_thread::get_id() != r->thread->get_id())
+        {
+            r->thread->join();
+            delete r->thread;
+            r->thread = nullptr;
+        }
+    }
+
+    bool Reactor::in_loop()
+    {
+        return std::this_thread::get_id() == ((reactor_t *)_data)->loop_id;
+    }
+} // namespace maix::network
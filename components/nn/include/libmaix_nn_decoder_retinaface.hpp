@@ -13,6 +13,7 @@
 #include "maix_nn_object.hpp"
 #include <stdint.h>
 #include <stdbool.h>
+#include <vector>
 
 using namespace maix;
 
@@ -41,5 +42,63 @@ extern int retinaface_decode(float* net_out_loc, float* net_out_conf, float* net
 extern int retinaface_get_channel_num(libmaix_nn_decoder_retinaface_config_t* config);
 
 
+/************ decoder class ***********/
+namespace maix::nn
+{
+    /**
+     * Retinaface style face detection decoder, used by FaceDetector and Retinaface.
+     * Priors are stored as contiguous arrays already scaled to input pixels,
+     * confidences are thresholded in one pass first, then only the survivors are
+     * decoded(box and landmarks) and go through NMS.
+     * All intermediate buffers are members and reused across frames.
+     */
+    class RetinafaceDecoder
+    {
+    public:
+        /**
+         * Clear priors and set decode params.
+         * @param input_w model input width
+         * @param input_h model input height
+         * @param variance variance of center offset and size
+         */
+        void reset(int input_w, int input_h, const float variance[2]);
+
+        /**
+         * Append one prior, values are normalized by input size as priorbox layer generates.
+         */
+        void add_prior(float cx, float cy, float w, float h);
+
+        /**
+         * Clear and generate priors from retinaface config, same order as retinaface_get_priorboxes.
+         */
+        void init_priors(const libmaix_nn_decoder_retinaface_config_t *config);
+
+        /**
+         * Priors number, the first dimension of model outputs.
+         */
+        int priors_num() const { return (int)_cx.size(); }
+
+        /**
+         * Decode model outputs, layout is [priors_num, 2], [priors_num, 4], [priors_num, 10].
+         * @param objs output objects, will be cleared first, coordinates are in model input size.
+         */
+        void decode(const float *conf, const float *loc, const float *landms, float conf_th, float iou_th, std::vector<nn::Object> &objs);
+
+    private:
+        int _input_w = 0;
+        int _input_h = 0;
+        float _variance0 = 0.1;
+        float _variance1 = 0.2;
+        // prior table, center in pixel, offset scale(variance0 * size), and size in pixel
+        std::vector<float> _cx, _cy, _dx, _dy, _pw, _ph;
+        // reused per frame buffers
+        std::vector<int> _valid;
+        std::vector<int> _order;
+        std::vector<float> _x1, _y1, _x2, _y2, _area;
+        std::vector<char> _suppressed;
+    };
+} // namespace maix::nn
+
+
 #endif
 
@@ -23,5 +23,17 @@ namespace maix::nn::F
     */
     tensor::Tensor *softmax(tensor::Tensor *tensor, bool replace);
 
+    /**
+     * Softmax probability of only some elements, input tensor not changed.
+     * Normalization still covers all elements, but only the selected ones are written out, e.g. the top k of a classifier.
+     * @param tensor input tensor, float32, treated as 1D
+     * @param indices index of elements to output
+     * @param num number of indices
+     * @param out output buffer, at least num float
+     * @throw If arg error, will raise err.Exception error
+     * @maixcdk maix.nn.F.softmax_select
+    */
+    void softmax_select(tensor::Tensor *tensor, const int *indices, int num, float *out);
+
 } // namespace maix::nn::F
 
@@ -189,6 +189,9 @@ namespace maix::nn
             }
             _inputs = _model->inputs_info();
             _input_size = image::Size(_inputs[0].shape[3], _inputs[0].shape[2]);
+            _input_elems = 1;
+            for (auto &d : _inputs[0].shape)
+                _input_elems *= d;
             return err::ERR_NONE;
         }
 
@@ -220,11 +223,37 @@ namespace maix::nn
          * @param img image, format should match model input_type， or will raise err.Exception
          * @param softmax if true, will do softmax to result, or will return raw value
          * @param fit image resize fit mode, default Fit.FIT_COVER, see image.Fit.
+         * @param topk only return the top k results, -1 means all classes. Small k is faster for models with many classes.
          * @throw If error occurred, will raise err::Exception, you can find reason in log, mostly caused by args error or hardware error.
          * @return result, a list of (label, score). If in dual_buff mode, value can be one element list and score is zero when not ready. In C++, you need to delete it after use.
          * @maixpy maix.nn.Classifier.classify
          */
-        std::vector<std::pair<int, float>> *classify(image::Image &img, bool softmax = true, image::Fit fit = image::FIT_COVER)
+        std::vector<std::pair<int, float>> *classify(image::Image &img, bool softmax = true, image::Fit fit = image::FIT_COVER, int topk = -1)
+        {
+            std::vector<std::pair<int, float>> *result = new std::vector<std::pair<int, float>>();
+            try
+            {
+                classify(img, *result, topk, softmax, fit);
+            }
+            catch(...)
+            {
+                delete result;
+                throw;
+            }
+            return result;
+        }
+
+        /**
+         * Forward image to model, get top k result into caller's vector, reuse it every frame to avoid memory allocation.
+         * @param img image, format should match model input_type， or will raise err.Exception
+         * @param result output, a list of (label, score), sorted by score. If in dual_buff mode, value can be one element list and score is zero when not ready.
+         * @param topk only output the top k results, -1 means all classes.
+         * @param softmax if true, will do softmax to result, or will return raw value
+         * @param fit image resize fit mode, default Fit.FIT_COVER, see image.Fit.
+         * @throw If error occurred, will raise err::Exception, you can find reason in log, mostly caused by args error or hardware error.
+         * @maixcdk maix.nn.Classifier.classify
+         */
+        void classify(image::Image &img, std::vector<std::pair<int, float>> &result, int topk, bool softmax = true, image::Fit fit = image::FIT_COVER)
         {
             if (img.format() != _input_img_fmt)
             {
@@ -234,43 +263,68 @@ namespace maix::nn
             outputs = _model->forward_image(img, this->mean, this->scale, fit, false);
             if (!outputs)
             {
-                std::vector<std::pair<int, float>> *res = new std::vector<std::pair<int, float>>(1);
-                res->at(0).first = 0;
-                res->at(0).second = 0;
-                return res;
+                result.resize(1);
+                result[0].first = 0;
+                result[0].second = 0;
+                return;
             }
-            tensor::Tensor *tensor = outputs->begin()->second;
-            if (tensor->dtype() != tensor::DType::FLOAT32)
+            _post_process(outputs, result, topk, softmax);
+        }
+
+        /**
+         * Forward tensor data to model, get result
+         * @param data tensor data, format should match model input_type， or will raise err.Excetion
+         * @param softmax if true, will do softmax to result, or will return raw value
+         * @param topk only return the top k results, -1 means all classes.
+         * @throw If error occurred, will raise err::Exception, you can find reason in log, mostly caused by args error or hardware error.
+         * @return result, a list of (label, score). In C++, you need to delete it after use.
+         * @maixpy maix.nn.Classifier.classify_raw
+         */
+        std::vector<std::pair<int, float>> *classify_raw(tensor::Tensor &data, bool softmax = true, int topk = -1)
+        {
+            std::vector<std::pair<int, float>> *result = new std::vector<std::pair<int, float>>();
+            try
             {
-                throw err::Exception("output tensor dtype only support float32 now");
+                classify_raw(data, *result, topk, softmax);
             }
-            if (softmax)
-                maix::nn::F::softmax(tensor, true);
-            std::vector<std::pair<int, float>> *result = new std::vector<std::pair<int, float>>(tensor->size_int());
-            float *data = (float *)tensor->data();
-            for (int i = 0; i < tensor->size_int(); i++)
+            catch(...)
             {
-                result->at(i).first = i;
-                result->at(i).second = data[i];
+                delete result;
+                throw;
             }
-            std::sort(result->begin(), result->end(), [](const std::pair<int, float> &a, const std::pair<int, float> &b)
-                      { return a.second > b.second; });
-            delete outputs;
             return result;
         }
 
         /**
-         * Forward tensor data to model, get result
-         * @param data tensor data, format should match model input_type， or will raise err.Excetion
+         * Forward tensor data to model, get top k result into caller's vector.
+         * @param data tensor data, shape and dtype should match model input, see input_shape().
+         * @param result output, a list of (label, score), sorted by score.
+         * @param topk only output the top k results, -1 means all classes.
          * @param softmax if true, will do softmax to result, or will return raw value
          * @throw If error occurred, will raise err::Exception, you can find reason in log, mostly caused by args error or hardware error.
-         * @return result, a list of (label, score). In C++, you need to delete it after use.
-         * @maixpy maix.nn.Classifier.classify_raw
+         * @maixcdk maix.nn.Classifier.classify_raw
          */
-        std::vector<std::pair<int, float>> *classify_raw(tensor::Tensor &data, bool softmax = true)
+        void classify_raw(tensor::Tensor &data, std::vector<std::pair<int, float>> &result, int topk, bool softmax = true)
         {
-            // TODO: add classify for tensor data
-            throw err::Exception(err::ERR_NOT_IMPL);
+            if (data.size_int() != _input_elems)
+            {
+                throw err::Exception(err::ERR_ARGS, "input tensor size not match model, input: " + std::to_string(data.size_int()) + ", model: " + std::to_string(_input_elems));
+            }
+            if (data.dtype() != _inputs[0].dtype)
+            {
+                throw err::Exception(err::ERR_ARGS, "input tensor dtype not match model, input: " + tensor::dtype_name[data.dtype()] + ", model: " + tensor::dtype_name[_inputs[0].dtype]);
+            }
+            tensor::Tensors inputs;
+            inputs.add_tensor(_inputs[0].name, &data, false, false);
+            tensor::Tensors *outputs = _model->forward(inputs, false);
+            if (!outputs)
+            {
+                result.resize(1);
+                result[0].first = 0;
+                result[0].second = 0;
+                return;
+            }
+            _post_process(outputs, result, topk, softmax);
         }
 
         /**
@@ -357,6 +411,46 @@ namespace maix::nn
         std::map<string, string> _extra_info;
         image::Size _input_size;
         std::vector<nn::LayerInfo> _inputs;
+        int _input_elems = 0;
+        std::vector<int> _topk_idx;    // top k index, reused
+        std::vector<float> _topk_prob; // top k softmax probability, reused
+
+        void _post_process(tensor::Tensors *outputs, std::vector<std::pair<int, float>> &result, int topk, bool softmax)
+        {
+            tensor::Tensor *tensor = outputs->begin()->second;
+            if (tensor->dtype() != tensor::DType::FLOAT32)
+            {
+                delete outputs;
+                throw err::Exception("output tensor dtype only support float32 now");
+            }
+            int num = tensor->size_int();
+            if (topk < 0 || topk > num)
+                topk = num;
+            // softmax keeps order, so select on raw values and only normalize selected ones
+            _topk_idx.resize(topk);
+            tensor->topk(topk, _topk_idx.data());
+            float *data = (float *)tensor->data();
+            result.resize(topk);
+            if (softmax)
+            {
+                _topk_prob.resize(topk);
+                maix::nn::F::softmax_select(tensor, _topk_idx.data(), topk, _topk_prob.data());
+                for (int i = 0; i < topk; i++)
+                {
+                    result[i].first = _topk_idx[i];
+                    result[i].second = _topk_prob[i];
+                }
+            }
+            else
+            {
+                for (int i = 0; i < topk; i++)
+                {
+                    result[i].first = _topk_idx[i];
+                    result[i].second = data[_topk_idx[i]];
+                }
+            }
+            delete outputs;
+        }
 
         static void split0(std::vector<std::string> &items, const std::string &s, const std::string &delimiter)
         {
@@ -11,6 +11,7 @@
 #include "maix_image.hpp"
 #include "maix_nn_F.hpp"
 #include "maix_nn_object.hpp"
+#include "libmaix_nn_decoder_retinaface.hpp"
 #include <tuple>
 
 namespace maix::nn
@@ -169,25 +170,22 @@ namespace maix::nn
 
             // decoder params
             // priorbox
-            std::vector<std::tuple<int, int>> feature_maps;
             int steps[] = {8, 16, 32, 64};
-            _variance.push_back(0.1);
-            _variance.push_back(0.2);
+            const float variance[2] = {0.1, 0.2};
             std::vector<std::vector<int>> min_sizes = {
                 {10, 16, 24},
                 {32, 48},
                 {64, 96},
                 {128, 192, 256}
             };
+            _decoder.reset(_input_size.width(), _input_size.height(), variance);
             for(size_t i=0; i<sizeof(steps) / sizeof(int); ++i)
             {
-                feature_maps.push_back(std::tuple<int, int>(ceil(_input_size.height() / steps[i]), ceil(_input_size.width() / steps[i])));
-            }
-            for(size_t i=0; i<feature_maps.size(); ++i)
-            {
-                for(int j=0; j < std::get<0>(feature_maps[i]); ++j)
+                int feature_h = ceil(_input_size.height() / steps[i]);
+                int feature_w = ceil(_input_size.width() / steps[i]);
+                for(int j=0; j < feature_h; ++j)
                 {
-                    for(int k=0; k < std::get<1>(feature_maps[i]); ++k)
+                    for(int k=0; k < feature_w; ++k)
                     {
                         for(size_t m=0; m < min_sizes[i].size(); ++m)
                         {
@@ -195,7 +193,7 @@ namespace maix::nn
                             float s_ky = min_sizes[i][m] * 1.0 / _input_size.height();
                             float dense_cx = (k + 0.5) * steps[i] / _input_size.width();
                             float dense_cy = (j + 0.5) * steps[i] / _input_size.height();
-                            _anchor.push_back({dense_cx, dense_cy, s_kx, s_ky});
+                            _decoder.add_prior(dense_cx, dense_cy, s_kx, s_ky);
                         }
                     }
                 }
@@ -294,13 +292,11 @@ namespace maix::nn
         float _conf_th = 0.5;
         float _iou_th = 0.45;
         bool _dual_buff;
-        std::vector<std::vector<float>> _anchor; // [[dense_cx, dense_cy, s_kx, s_ky],]
-        std::vector<float> _variance;
+        RetinafaceDecoder _decoder;
 
     private:
         std::vector<nn::Object> *_post_process(tensor::Tensors *outputs, int img_w, int img_h, maix::image::Fit fit)
         {
-            std::vector<nn::Object> *objects = new std::vector<nn::Object>();
             tensor::Tensor *conf = nullptr;
             tensor::Tensor *loc = nullptr;
             tensor::Tensor *landms = nullptr;
@@ -315,76 +311,18 @@ namespace maix::nn
             }
             if(!conf || !loc || !landms)
                 return nullptr;
-            float *conf_data = (float *)conf->data();
-            float *loc_data = (float *)loc->data();
-            float *landms_data = (float *)landms->data();
-
-            std::vector<int> valid_idx;
-            for (int i = 0; i < conf->size_int() / 2; ++i)
-            {
-                if (conf_data[i * 2 + 1] >= this->_conf_th)
-                {
-                    valid_idx.push_back(i);
-                }
-            }
-            for (int idx : valid_idx)
-            {
-                float x = (_anchor[idx][0] + loc_data[idx * 4] * _variance[0] * _anchor[idx][2]) * _input_size.width();
-                float y = (_anchor[idx][1] + loc_data[idx * 4 + 1] * _variance[0] * _anchor[idx][3]) * _input_size.height();
-                float w = _anchor[idx][2] * exp(loc_data[idx * 4 + 2] * _variance[1]) * _input_size.width();
-                float h = _anchor[idx][3] * exp(loc_data[idx * 4 + 3] * _variance[1]) * _input_size.height();
-                std::vector<int> points;
-                points.push_back(_input_size.width() * (_anchor[idx][0] + landms_data[idx * 10] * _variance[0] * _anchor[idx][2]));
-                points.push_back(_input_size.height() * (_anchor[idx][1] + landms_data[idx * 10 + 1] * _variance[0] * _anchor[idx][3]));
-                points.push_back(_input_size.width() * (_anchor[idx][0] + landms_data[idx * 10 + 2] * _variance[0] * _anchor[idx][2]));
-                points.push_back(_input_size.height() * (_anchor[idx][1] + landms_data[idx * 10 + 3] * _variance[0] * _anchor[idx][3]));
-                points.push_back(_input_size.width() * (_anchor[idx][0] + landms_data[idx * 10 + 4] * _variance[0] * _anchor[idx][2]));
-                points.push_back(_input_size.height() * (_anchor[idx][1] + landms_data[idx * 10 + 5] * _variance[0] * _anchor[idx][3]));
-                points.push_back(_input_size.width() * (_anchor[idx][0] + landms_data[idx * 10 + 6] * _variance[0] * _anchor[idx][2]));
-                points.push_back(_input_size.height() * (_anchor[idx][1] + landms_data[idx * 10 + 7] * _variance[0] * _anchor[idx][3]));
-                points.push_back(_input_size.width() * (_anchor[idx][0] + landms_data[idx * 10 + 8] * _variance[0] * _anchor[idx][2]));
-                points.push_back(_input_size.height() * (_anchor[idx][1] + landms_data[idx * 10 + 9] * _variance[0] * _anchor[idx][3]));
-                nn::Object object((int)(x - w/2), (int)(y - h/2), w, h, 0, conf_data[idx * 2 + 1], points);
-                objects->push_back(object);
-            }
-            if (objects->size() > 0)
+            if(conf->size_int() / 2 != _decoder.priors_num())
             {
-                std::vector<nn::Object> *objects_total = objects;
-                objects = _nms(*objects);
-                delete objects_total;
+                log::error("output size %d not match priors number %d", conf->size_int() / 2, _decoder.priors_num());
+                return nullptr;
             }
+            std::vector<nn::Object> *objects = new std::vector<nn::Object>();
+            _decoder.decode((float *)conf->data(), (float *)loc->data(), (float *)landms->data(), this->_conf_th, this->_iou_th, *objects);
             if (objects->size() > 0)
                 _correct_bbox(*objects, img_w, img_h, fit);
             return objects;
         }
 
-        std::vector<nn::Object> *_nms(std::vector<nn::Object> &objs)
-        {
-            std::vector<nn::Object> *result = new std::vector<nn::Object>();
-            std::sort(objs.begin(), objs.end(), [](const nn::Object &a, const nn::Object &b)
-                      { return a.score < b.score; });
-            for (size_t i = 0; i < objs.size(); ++i)
-            {
-                nn::Object &a = objs.at(i);
-                if (a.score == 0)
-                    continue;
-                for (size_t j = i + 1; j < objs.size(); ++j)
-                {
-                    nn::Object &b = objs.at(j);
-                    if (b.score != 0 && a.class_id == b.class_id && _calc_iou(a, b) > this->_iou_th)
-                    {
-                        b.score = 0;
-                    }
-                }
-            }
-            for (nn::Object &a : objs)
-            {
-                if (a.score != 0)
-                    result->push_back(a);
-            }
-            return result;
-        }
-
         void _correct_bbox(std::vector<nn::Object> &objs, int img_w, int img_h, maix::image::Fit fit)
         {
             if (img_w == _input_size.width() && img_h == _input_size.height())
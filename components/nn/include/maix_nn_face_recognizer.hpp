@@ -535,7 +535,7 @@ namespace maix::nn
                     delete std_img;
                     return new FaceObjects();
                 }
-                tensor::Tensor *out = outputs->tensors[outputs->keys()[0]];
+                tensor::Tensor *out = outputs->begin()->second;
                 int fea_len = out->size_int();
                 float *feature = (float *)out->data();
                 // compare feature from DB
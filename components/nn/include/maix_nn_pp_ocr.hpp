@@ -324,11 +324,12 @@ namespace maix::nn
                     labels.push_back(" ");
                 _prob_num = rec_outputs[0].shape[2];
                 _max_ch_num = rec_outputs[0].shape[1];
-                if(_max_ch_num * 8 != _rec_input_size.width())
-                {
-                    log::error("input width not match, model need: %lld, actual: %lld", _max_ch_num * 8, _input_size.width());
-                    return err::ERR_ARGS;
-                }
+                // input pixels covered by one output step, lines can only be packed at step boundaries
+                _rec_step = 0;
+                if(_max_ch_num > 0 && _rec_input_size.width() % _max_ch_num == 0)
+                    _rec_step = _rec_input_size.width() / _max_ch_num;
+                else
+                    log::warn("recognize model input width %d is not a multiple of output steps %d, rec_pack disabled", _rec_input_size.width(), _max_ch_num);
             }
             return err::ERR_NONE;
         }
@@ -357,7 +358,7 @@ namespace maix::nn
                 throw err::Exception("image format not match, input_type: " + image::fmt_names[_input_img_fmt] + ", image format: " + image::fmt_names[img.format()]);
             }
             tensor::Tensors *outputs;
-            outputs = _model->forward_image(img, this->mean, this->scale, fit, true);
+            outputs = _model->forward_image(img, this->mean, this->scale, fit, false);
             if (!outputs) // not ready, return empty result.
             {
                 return new nn::OCR_Objects();
@@ -532,6 +533,15 @@ namespace maix::nn
         */
         bool rec;
 
+        /**
+         * Pack several short text lines into one input of recognize model, so all lines of a frame need less forward calls.
+         * Lines are separated by blank gap, disabled by default until accuracy is validated for your model,
+         * keep it false if result of a line is affected by its neighbors.
+         * Ignored if recognize model input width is not a multiple of its output steps.
+         * @maixpy maix.nn.PP_OCR.rec_pack
+        */
+        bool rec_pack = false;
+
     private:
         image::Size _input_size;
         image::Size _rec_input_size;
@@ -547,7 +557,10 @@ namespace maix::nn
         bool _use_space_char = true;
         std::string _score_mode = "fast";
         int _max_ch_num;
+        int _rec_step = 0;                  // input pixels of one recognize output step, 0 if not integral
         int _prob_num;
+        std::vector<uint8_t> _bit_map;      // detect binary map, reused
+        std::vector<int> _max_idxes;        // argmax of every recognize step, reused
 
     private:
         err::Err _load_labels_from_file(std::vector<std::string> &labels, const std::string &label_path)
@@ -575,6 +588,8 @@ namespace maix::nn
 
         nn::OCR_Objects *_post_process(image::Image &img, tensor::Tensors *outputs, int img_w, int img_h, maix::image::Fit fit);
 
+        void _recognize_all(image::Image &img, nn::OCR_Objects &objects);
+
         void _recognize(image::Image &img, const nn::OCR_Box &box, std::vector<int> &idx_list, std::vector<std::string> &char_list, std::vector<int> &char_pos, bool crop);
 
         // void _get_layer_objs(std::vector<nn::Object> &objs, tensor::Tensor &output, int layer_i, int layer_num)
@@ -37,7 +37,6 @@ namespace maix::nn
         Retinaface(const string &model = "", bool dual_buff = true)
         {
             _model = nullptr;
-            _priorboxes = nullptr;
             _dual_buff = dual_buff;
             if (!model.empty())
             {
@@ -56,10 +55,6 @@ namespace maix::nn
                 delete _model;
                 _model = nullptr;
             }
-            if(_priorboxes)
-            {
-                free(_priorboxes);
-            }
         }
 
         /**
@@ -190,8 +185,7 @@ namespace maix::nn
             _config.min_sizes[4] = 256;
             _config.min_sizes[5] = 512;
 
-            _channel_num = retinaface_get_channel_num(&_config);
-            _priorboxes = retinaface_get_priorboxes(&_config, &_channel_num);
+            _decoder.init_priors(&_config);
 
             return err::ERR_NONE;
         }
@@ -286,14 +280,12 @@ namespace maix::nn
         float _conf_th = 0.5;
         float _iou_th = 0.45;
         libmaix_nn_decoder_retinaface_config_t _config;
-        nn::ObjectFloat *_priorboxes;
-        int _channel_num;
+        RetinafaceDecoder _decoder;
         bool _dual_buff;
 
     private:
         std::vector<nn::Object> *_post_process(tensor::Tensors *outputs, int img_w, int img_h, maix::image::Fit fit)
         {
-            std::vector<nn::Object> *objects = new std::vector<nn::Object>(_channel_num);
             tensor::Tensor *conf = nullptr;
             tensor::Tensor *loc = nullptr;
             tensor::Tensor *landms = nullptr;
@@ -308,56 +300,18 @@ namespace maix::nn
             }
             if(!conf || !loc || !landms)
                 return nullptr;
-            float *conf_data = (float *)conf->data();
-            float *loc_data = (float *)loc->data();
-            float *landms_data = (float *)landms->data();
-            int valid_num = _channel_num;
-            _config.nms = _iou_th;
-            _config.score_thresh = _conf_th;
-            retinaface_decode(loc_data, conf_data, landms_data, _priorboxes, objects, &valid_num, true, &_config);
-            if (valid_num > 0)
-            {
-                std::vector<nn::Object> *objects_total = objects;
-                objects = _nms(*objects, valid_num);
-                delete objects_total;
-            }
-            else
+            if(conf->size_int() / 2 != _decoder.priors_num())
             {
-                delete objects;
-                return new std::vector<nn::Object>();
+                log::error("output size %d not match priors number %d", conf->size_int() / 2, _decoder.priors_num());
+                return nullptr;
             }
-            _correct_bbox(*objects, img_w, img_h, fit);
+            std::vector<nn::Object> *objects = new std::vector<nn::Object>();
+            _decoder.decode((float *)conf->data(), (float *)loc->data(), (float *)landms->data(), _conf_th, _iou_th, *objects);
+            if (objects->size() > 0)
+                _correct_bbox(*objects, img_w, img_h, fit);
             return objects;
         }
 
-        std::vector<nn::Object> *_nms(std::vector<nn::Object> &objs, int num)
-        {
-            std::vector<nn::Object> *result = new std::vector<nn::Object>();
-            std::sort(objs.begin(), objs.begin() + num, [](const nn::Object &a, const nn::Object &b)
-                      { return a.score < b.score; });
-            for (int i = 0; i < num; ++i)
-            {
-                nn::Object &a = objs.at(i);
-                if (a.score == 0)
-                    continue;
-                for (int j = i + 1; j < num; ++j)
-                {
-                    nn::Object &b = objs.at(j);
-                    if (b.score != 0 && a.class_id == b.class_id && _calc_iou(a, b) > this->_iou_th)
-                    {
-                        b.score = 0;
-                    }
-                }
-            }
-            for (int i=0; i<num; ++i)
-            {
-                nn::Object &a = objs.at(i);
-                if (a.score != 0)
-                    result->push_back(a);
-            }
-            return result;
-        }
-
         void _correct_bbox(std::vector<nn::Object> &objs, int img_w, int img_h, maix::image::Fit fit)
         {
             if (img_w == _input_size.width() && img_h == _input_size.height())
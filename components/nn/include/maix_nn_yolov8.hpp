@@ -240,6 +240,7 @@ namespace maix::nn
             std::vector<nn::LayerInfo> inputs = _model->inputs_info();
             _input_size = image::Size(inputs[0].shape[3], inputs[0].shape[2]);
             log::print("\tinput size: %dx%d\n\n", _input_size.width(), _input_size.height());
+            _bind_outputs(_model->outputs_info());
             return err::ERR_NONE;
         }
 
@@ -438,6 +439,11 @@ namespace maix::nn
         float _keypoint_th = 0.5;
         YOLOv8_Type _type;
         bool _dual_buff;
+        tensor::TensorSlots _out_slots;    // outputs bound once at load
+        int _box_slot = -1;
+        int _score_slot = -1;
+        int _mask_slot = -1;
+        int _kp_slot = -1;
 
     private:
         err::Err _load_labels_from_file(std::vector<std::string> &labels, const std::string &label_path)
@@ -463,6 +469,39 @@ namespace maix::nn
             return err::ERR_NONE;
         }
 
+        // find out which output is box, score, mask or keypoints by name and shape, only once
+        void _bind_outputs(std::vector<nn::LayerInfo> outputs)
+        {
+            std::sort(outputs.begin(), outputs.end(), [](const nn::LayerInfo &a, const nn::LayerInfo &b) { return a.name < b.name; });
+            std::vector<std::string> names;
+            for (auto &i : outputs)
+            {
+                names.push_back(i.name);
+            }
+            _out_slots.bind(names);
+            _box_slot = _score_slot = _mask_slot = _kp_slot = -1;
+            for (auto &i : outputs)
+            {
+                int idx = _out_slots.index(i.name);
+                if (i.shape.size() > 2 && i.shape[2] == 4)
+                {
+                    _box_slot = idx;
+                }
+                else if (i.name.find("Sigmoid") != std::string::npos)
+                {
+                    _score_slot = idx;
+                }
+                else if (i.name.find("output1") != std::string::npos)
+                {
+                    _mask_slot = idx;
+                }
+                else
+                {
+                    _kp_slot = idx;
+                }
+            }
+        }
+
         nn::Objects *_post_process(tensor::Tensors *outputs, int img_w, int img_h, maix::image::Fit fit)
         {
             nn::Objects *objects = new nn::Objects();
@@ -501,36 +540,32 @@ namespace maix::nn
         bool _decode_objs(nn::Objects &objs, tensor::Tensors *outputs, float conf_thresh, int w, int h, tensor::Tensor **kp_out, tensor::Tensor **mask_out)
         {
             float stride[3] = {8, 16, 32};
-            tensor::Tensor *score_out = NULL; // shape 1, 80, 8400, 1
-            tensor::Tensor *box_out = NULL;   // shape 1,  1,    4, 8400
-            for (auto i : *outputs)
+            if (!_out_slots.resolve(*outputs))
             {
-                if (i.second->shape()[2] == 4)
+                // output names not the same as outputs_info, bind to this result's
+                std::vector<nn::LayerInfo> infos;
+                for (auto i : *outputs)
                 {
-                    box_out = i.second;
-                }
-                else if (strstr(i.first.c_str(), "Sigmoid") != NULL)
-                {
-                    score_out = i.second;
-                    if((size_t)score_out->shape()[1] != labels.size())
-                    {
-                        log::error("MUD labels(%d) must equal model's(%d)", score_out->shape()[1], labels.size());
-                        return false;
-                    }
-                }
-                else if (strstr(i.first.c_str(), "output1") != NULL)
-                {
-                    *mask_out = i.second;
-                }
-                else
-                {
-                    *kp_out = i.second;
+                    infos.push_back(nn::LayerInfo(i.first, i.second->dtype(), i.second->shape()));
                 }
+                _bind_outputs(infos);
+                _out_slots.resolve(*outputs);
             }
-            if (!score_out || !kp_out)
+            tensor::Tensor *score_out = _score_slot >= 0 ? _out_slots[_score_slot] : NULL; // shape 1, 80, 8400, 1
+            tensor::Tensor *box_out = _box_slot >= 0 ? _out_slots[_box_slot] : NULL;       // shape 1,  1,    4, 8400
+            if (_mask_slot >= 0)
+                *mask_out = _out_slots[_mask_slot];
+            if (_kp_slot >= 0)
+                *kp_out = _out_slots[_kp_slot];
+            if (!score_out || !box_out)
             {
                 throw err::Exception(err::ERR_ARGS, "model output not valid");
             }
+            if((size_t)score_out->shape()[1] != labels.size())
+            {
+                log::error("MUD labels(%d) must equal model's(%d)", score_out->shape()[1], labels.size());
+                return false;
+            }
             int total_box_num = box_out->shape()[3];
             // int class_num = this->labels.size();
             int class_num = score_out->shape()[1];
@@ -25,10 +25,12 @@ public:
   void GetContourArea(const std::vector<std::vector<float>> &box,
                       float unclip_ratio, float &distance);
 
+  void GetContourArea(const float box[8], float unclip_ratio, float &distance);
+
   cv::RotatedRect UnClip(std::vector<std::vector<float>> box,
                          const float &unclip_ratio);
 
-  float **Mat2Vec(cv::Mat mat);
+  cv::RotatedRect UnClip(const float box[8], float unclip_ratio);
 
   std::vector<std::vector<int>>
   OrderPointsClockwise(std::vector<std::vector<int>> pts);
@@ -36,22 +38,43 @@ public:
   std::vector<std::vector<float>> GetMiniBoxes(cv::RotatedRect box,
                                                float &ssid);
 
+  // flat version, box is x1, y1, ... x4, y4 from top-left in clockwise
+  void GetMiniBoxes(const cv::RotatedRect &box, float &ssid, float box_out[8]);
+
   float BoxScoreFast(std::vector<std::vector<float>> box_array, cv::Mat pred);
-  float PolygonScoreAcc(std::vector<cv::Point> contour, cv::Mat pred);
+
+  // mean of pred inside box, scanline of the quadrilateral without mask.
+  // Span ends are rounded from the edge intersections, which approximates
+  // cv::fillPoly rasterization, edge pixels may differ so the score is close
+  // to but not bit-exact with the mask version.
+  float BoxScoreFast(const float box[8], const cv::Mat &pred);
+
+  float PolygonScoreAcc(const std::vector<cv::Point> &contour,
+                        const cv::Mat &pred);
 
   std::vector<std::vector<std::vector<int>>>
   BoxesFromBitmap(const cv::Mat pred, const cv::Mat bitmap,
                   const float &box_thresh, const float &det_db_unclip_ratio,
                   const std::string &det_db_score_mode, std::vector<float> &scores);
 
+  // flat version, boxes appended as x1, y1, ... x4, y4, 8 ints per box,
+  // contours buffer is kept by the processor and reused by next call
+  int BoxesFromBitmap(const cv::Mat &pred, const cv::Mat &bitmap,
+                      float box_thresh, float det_db_unclip_ratio,
+                      const std::string &det_db_score_mode,
+                      std::vector<int> &boxes, std::vector<float> &scores);
+
   std::vector<std::vector<std::vector<int>>>
   FilterTagDetRes(std::vector<std::vector<std::vector<int>>> boxes,
                   float ratio_h, float ratio_w, cv::Mat srcimg);
 
 private:
-  static bool XsortInt(std::vector<int> a, std::vector<int> b);
+  std::vector<std::vector<cv::Point>> contours_;
+  std::vector<cv::Vec4i> hierarchy_;
+
+  static bool XsortInt(const std::vector<int> &a, const std::vector<int> &b);
 
-  static bool XsortFp32(std::vector<float> a, std::vector<float> b);
+  static bool XsortFp32(const std::vector<float> &a, const std::vector<float> &b);
 
   std::vector<std::vector<float>> Mat2Vector(cv::Mat mat);
 
@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <algorithm>
 
 #define debug_line  //printf("%s:%d %s %s %s \r\n", __FILE__, __LINE__, __FUNCTION__, __DATE__, __TIME__)
 
@@ -369,3 +370,137 @@ int retinaface_decode(float* net_out_loc, float* net_out_conf, float* net_out_la
     return 0;
 }
 
+
+namespace maix::nn
+{
+    void RetinafaceDecoder::reset(int input_w, int input_h, const float variance[2])
+    {
+        _cx.clear();
+        _cy.clear();
+        _dx.clear();
+        _dy.clear();
+        _pw.clear();
+        _ph.clear();
+        _input_w = input_w;
+        _input_h = input_h;
+        _variance0 = variance[0];
+        _variance1 = variance[1];
+    }
+
+    void RetinafaceDecoder::add_prior(float cx, float cy, float w, float h)
+    {
+        _cx.push_back(cx * _input_w);
+        _cy.push_back(cy * _input_h);
+        _dx.push_back(_variance0 * w * _input_w);
+        _dy.push_back(_variance0 * h * _input_h);
+        _pw.push_back(w * _input_w);
+        _ph.push_back(h * _input_h);
+    }
+
+    void RetinafaceDecoder::init_priors(const libmaix_nn_decoder_retinaface_config_t *config)
+    {
+        reset(config->input_w, config->input_h, config->variance);
+        int anchors_size[ANCHOR_SIZE_NUM * 2];
+        // MIN_SIZE_LEN == ANCHOR_SIZE_NUM * 2 means 2 min sizes every step, or use 3,2,2,3 layout
+        const int step_of_min_sizes_var[] = {3, 2, 2, 3};
+        const bool two_per_step = ANCHOR_SIZE_NUM * 2 == MIN_SIZE_LEN;
+        int start = 0;
+        for (int i = 0; i < ANCHOR_SIZE_NUM; ++i)
+        {
+            anchors_size[i * 2] = ceil(config->input_h * 1.0 / config->steps[i]);
+            anchors_size[i * 2 + 1] = ceil(config->input_w * 1.0 / config->steps[i]);
+            const int sizes_num = two_per_step ? 2 : step_of_min_sizes_var[i];
+            for (int j = 0; j < anchors_size[i * 2]; ++j)
+            {
+                for (int k = 0; k < anchors_size[i * 2 + 1]; ++k)
+                {
+                    for (int l = start; l < start + sizes_num; ++l)
+                    {
+                        int min_size = config->min_sizes[l];
+                        add_prior((k + 0.5) * config->steps[i] / config->input_w,
+                                  (j + 0.5) * config->steps[i] / config->input_h,
+                                  min_size * 1.0 / config->input_w,
+                                  min_size * 1.0 / config->input_h);
+                    }
+                }
+            }
+            start += sizes_num;
+        }
+    }
+
+    void RetinafaceDecoder::decode(const float *conf, const float *loc, const float *landms, float conf_th, float iou_th, std::vector<nn::Object> &objs)
+    {
+        objs.clear();
+        const int num = priors_num();
+        _valid.resize(num);
+
+        /* 1. threshold pass, branch free compaction of priors' index */
+        int *valid = _valid.data();
+        int valid_num = 0;
+        for (int i = 0; i < num; ++i)
+        {
+            valid[valid_num] = i;
+            valid_num += conf[i * 2 + 1] >= conf_th;
+        }
+        if (valid_num == 0)
+            return;
+
+        /* 2. decode boxes of survivors */
+        _x1.resize(valid_num);
+        _y1.resize(valid_num);
+        _x2.resize(valid_num);
+        _y2.resize(valid_num);
+        _area.resize(valid_num);
+        _order.resize(valid_num);
+        for (int n = 0; n < valid_num; ++n)
+        {
+            const int idx = valid[n];
+            const float *l = loc + idx * 4;
+            const float cx = _cx[idx] + l[0] * _dx[idx];
+            const float cy = _cy[idx] + l[1] * _dy[idx];
+            const float w = _pw[idx] * expf(l[2] * _variance1);
+            const float h = _ph[idx] * expf(l[3] * _variance1);
+            _x1[n] = cx - w / 2;
+            _y1[n] = cy - h / 2;
+            _x2[n] = _x1[n] + w;
+            _y2[n] = _y1[n] + h;
+            _area[n] = w * h;
+            _order[n] = n;
+        }
+
+        /* 3. NMS, greedy by score, only compare with kept boxes */
+        std::sort(_order.begin(), _order.end(), [conf, valid](int a, int b)
+                  { return conf[valid[a] * 2 + 1] > conf[valid[b] * 2 + 1]; });
+        _suppressed.assign(valid_num, 0);
+        for (int i = 0; i < valid_num; ++i)
+        {
+            const int a = _order[i];
+            if (_suppressed[a])
+                continue;
+            for (int j = i + 1; j < valid_num; ++j)
+            {
+                const int b = _order[j];
+                if (_suppressed[b])
+                    continue;
+                const float wi = std::min(_x2[a], _x2[b]) - std::max(_x1[a], _x1[b]);
+                const float hi = std::min(_y2[a], _y2[b]) - std::max(_y1[a], _y1[b]);
+                if (wi <= 0 || hi <= 0)
+                    continue;
+                const float area_i = wi * hi;
+                if (area_i / (_area[a] + _area[b] - area_i) > iou_th)
+                    _suppressed[b] = 1;
+            }
+
+            /* 4. decode landmarks only for kept boxes */
+            const int idx = valid[a];
+            const float *lm = landms + idx * 10;
+            std::vector<int> points(10);
+            for (int k = 0; k < 5; ++k)
+            {
+                points[k * 2] = _cx[idx] + lm[k * 2] * _dx[idx];
+                points[k * 2 + 1] = _cy[idx] + lm[k * 2 + 1] * _dy[idx];
+            }
+            objs.emplace_back((int)_x1[a], (int)_y1[a], (int)(_x2[a] - _x1[a]), (int)(_y2[a] - _y1[a]), 0, conf[idx * 2 + 1], std::move(points));
+        }
+    }
+} // namespace maix::nn
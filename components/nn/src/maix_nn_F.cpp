@@ -53,4 +53,31 @@ namespace maix::nn::F
         return t;
     }
 
+    void softmax_select(tensor::Tensor *tensor, const int *indices, int num, float *out)
+    {
+        if (tensor->dtype() != maix::tensor::DType::FLOAT32)
+        {
+            throw err::Exception(err::ERR_ARGS, "only support float32 dtype");
+        }
+        const float *data = (const float *)tensor->data();
+        int n = tensor->size_int();
+        if (n <= 0 || num <= 0)
+            return;
+        float largest = data[0];
+        for (int i = 1; i < n; ++i)
+        {
+            if (data[i] > largest)
+                largest = data[i];
+        }
+        float sum = 0;
+        for (int i = 0; i < n; ++i)
+        {
+            sum += expf(data[i] - largest);
+        }
+        for (int i = 0; i < num; ++i)
+        {
+            out[i] = expf(data[indices[i]] - largest) / sum;
+        }
+    }
+
 } // namespace maix::nn::F
@@ -34,110 +34,231 @@ namespace maix::nn
         h = h - y;
     }
 
+    static const int REC_PACK_GAP_STEPS = 2;    // blank steps between packed lines
+
+    // crop box from image and transform to a horizontal text line, then resize to height of recognize model keeping ratio
+    static void _crop_text_line(cv::Mat &img_src, const nn::OCR_Box &box, bool crop, int height, cv::Mat &out)
+    {
+        cv::Mat *std_img = &img_src;
+        cv::Mat img_dst;
+        cv::Mat srcCopy;
+        if(crop)
+        {
+            // crop and get std
+            cv::Point2f pts_std[4];
+            int img_crop_width = int(sqrt(pow(box.x1 - box.x2, 2) +
+                                    pow(box.y1 - box.y2, 2)));
+            int img_crop_height = int(sqrt(pow(box.x1 - box.x4, 2) +
+                                            pow(box.y1 - box.y4, 2)));
+            pts_std[0] = cv::Point2f(0., 0.);
+            pts_std[1] = cv::Point2f(img_crop_width, 0.);
+            pts_std[2] = cv::Point2f(img_crop_width, img_crop_height);
+            pts_std[3] = cv::Point2f(0.f, img_crop_height);
+            cv::Point2f pointsf[4];
+            pointsf[0] = cv::Point2f(box.x1, box.y1);
+            pointsf[1] = cv::Point2f(box.x2, box.y2);
+            pointsf[2] = cv::Point2f(box.x3, box.y3);
+            pointsf[3] = cv::Point2f(box.x4, box.y4);
+            cv::Mat M = cv::getPerspectiveTransform(pointsf, pts_std);
+            cv::warpPerspective(img_src, img_dst, M,
+                        cv::Size(img_crop_width, img_crop_height),
+                        cv::BORDER_REPLICATE);
+            std_img = &img_dst;
+            if (float(img_dst.rows) >= float(img_dst.cols) * 1.5) {
+                srcCopy = cv::Mat(img_dst.rows, img_dst.cols, img_dst.depth());
+                cv::transpose(img_dst, srcCopy);
+                cv::flip(srcCopy, srcCopy, 0);
+                std_img = &srcCopy;
+            }
+        }
+        float aspect_ratio = float(std_img->cols) / float(std_img->rows);
+        cv::resize(*std_img, out, cv::Size(std::max(1, static_cast<int>(height * aspect_ratio)), height));
+    }
+
+    // forward one model input and get argmax of every step, outputs shape: _max_ch_num x (_prob_num)
+    static void _recognize_stdimg(nn::NN *_rec_model, cv::Mat &input, std::vector<float> &mean, std::vector<float> &scale, std::vector<int> &max_idxes, const int &_max_ch_num, const int &_prob_num)
+    {
+        image::Image std_img(input.cols, input.rows, image::Format::FMT_BGR888, input.data, -1, false);
+        tensor::Tensors *outputs;
+        outputs = _rec_model->forward_image(std_img, mean, scale, image::Fit::FIT_FILL, false);
+        if (!outputs) // not happen here
+        {
+            throw err::Exception(err::ERR_RUNTIME);
+        }
+
+        max_idxes.resize(_max_ch_num);
+        for (auto it = outputs->begin(); it != outputs->end(); it++)
+        {
+            const float *data = (float*)it->second->data();
+            for(int i = 0; i < _max_ch_num; ++i)
+            {
+                // blank if no probability above 0, the same as before
+                float max_score = 0;
+                int max_idx = 0;
+                for(int j = 0; j < _prob_num; ++j)
+                {
+                    if(data[j] > max_score)
+                    {
+                        max_score = data[j];
+                        max_idx = j;
+                    }
+                }
+                max_idxes[i] = max_idx;
+                data += _prob_num;
+            }
+            break;
+        }
+        delete outputs;
+    }
+
+    // CTC greedy decode of steps [start, end), repeated labels are merged and blank(index 0) removed
+    static void _ctc_decode(const std::vector<int> &max_idxes, int start, int end, int pos_offset, const std::vector<std::string> &labels,
+                            std::vector<int> &idx_list, std::vector<std::string> &char_list, std::vector<int> &char_pos)
+    {
+        int last_idx = 0;
+        for(int i = start; i < end; ++i)
+        {
+            int idx = max_idxes[i];
+            if((idx != last_idx) && (idx != 0))
+            {
+                idx_list.push_back(idx - 1);
+                char_list.push_back(labels[idx - 1]);
+                char_pos.push_back(i - start + pos_offset);
+            }
+            last_idx = idx;
+        }
+    }
+
+    // recognize a text line already resized to model input height
+    static void _recognize_line(nn::NN *_rec_model, cv::Mat &resized_img, std::vector<float> &mean, std::vector<float> &scale, const std::vector<std::string> &labels,
+                                std::vector<int> &max_idxes, const int &_max_ch_num, const int &_prob_num, int rec_w, int rec_h,
+                                std::vector<int> &idx_list, std::vector<std::string> &char_list, std::vector<int> &char_pos)
+    {
+        // resize pad image to model input size(_rec_input_size) like 320x48
+        // keep ratio resize image's height to _rec_input_size.height(),
+        // if new image width > _rec_input_size.width()， slice to _rec_input_size.width() wide pieces,
+        // else if new image width < _rec_input_size.width(), keep new image content at left, right padding black color.
+        // finally we got _rec_input_size image
+        cv::Mat padded_img(rec_h, rec_w, CV_8UC3);
+        int slices = (resized_img.cols + rec_w - 1) / rec_w;
+        for(int i = 0; i < slices; ++i)
+        {
+            int w = std::min(rec_w, resized_img.cols - i * rec_w);
+            cv::Mat crop_img = resized_img(cv::Rect(i * rec_w, 0, w, resized_img.rows));
+            if (w < rec_w)
+                padded_img.setTo(cv::Scalar(0, 0, 0));
+            crop_img.copyTo(padded_img(cv::Rect(0, 0, w, crop_img.rows)));
+            _recognize_stdimg(_rec_model, padded_img, mean, scale, max_idxes, _max_ch_num, _prob_num);
+            _ctc_decode(max_idxes, 0, _max_ch_num, i * _max_ch_num, labels, idx_list, char_list, char_pos);
+        }
+    }
+
     nn::OCR_Objects *PP_OCR::_post_process(image::Image &img, tensor::Tensors *outputs, int img_w, int img_h, maix::image::Fit fit)
     {
         nn::OCR_Objects *objects = new nn::OCR_Objects();
-        // int layer_num = outputs->size();
-        // int i = 0;
         for (auto it = outputs->begin(); it != outputs->end(); it++)
         {
-        //     // log::info("output: %s, tensor: %s", it->first.c_str(), it->second->to_str().c_str());
-        //     _get_layer_objs(*objects, *it->second, i++, layer_num);
             tensor::Tensor *out = it->second;
             std::vector<int> shape = out->shape(); // 1, 1, h, w
-            image::Image *tmp_img = new image::Image(shape[3], shape[2], image::Format::FMT_GRAYSCALE);
+            int map_size = shape[3] * shape[2];
             float *data = (float*)out->data();
-            float *p_data = data;
-            uint8_t *img_data = (uint8_t*)tmp_img->data();
-            uint8_t *p_img_data = img_data;
-            cv::Mat bit_map(shape[2], shape[3], CV_8UC1);
-            uint8_t *p_binary_data = (uint8_t*)bit_map.data;
-            uint8_t _thresh_uint8 = (uint8_t)(_thresh * 255);
-            for(int i=0; i < shape[3] * shape[2]; ++i)
+
+            // same result as (uint8_t)(prob * 255) > (uint8_t)(thresh * 255), without the uint8 map
+            float thresh = ((uint8_t)(_thresh * 255) + 1) / 255.0f;
+            _bit_map.resize(map_size);
+            uint8_t *p_binary_data = _bit_map.data();
+            for(int i = 0; i < map_size; ++i)
             {
-                *p_img_data = (uint8_t)(*p_data * 255);
-                if(*p_img_data > _thresh_uint8)
-                    *p_binary_data = 1;
-                else
-                    *p_binary_data = 0;
-                ++p_data;
-                ++p_img_data;
-                ++p_binary_data;
+                p_binary_data[i] = data[i] >= thresh;
             }
 
             // post process
             PaddleOCR::DBPostProcessor post_processor;
-            cv::Mat cbuf_map(shape[2], shape[3], CV_8UC1, img_data);
+            cv::Mat bit_map(shape[2], shape[3], CV_8UC1, p_binary_data);
             cv::Mat pred_map(shape[2], shape[3], CV_32F, data);
             if (_use_dilation) {
                 cv::Mat dila_ele = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(2, 2));
                 cv::dilate(bit_map, bit_map, dila_ele);
             }
             std::vector<float> scores;
-            std::vector<std::vector<std::vector<int>>> boxes = post_processor.BoxesFromBitmap(pred_map, bit_map, _box_thresh, _unclip_ratio, _score_mode, scores);
-            for(size_t i = 0; i < boxes.size(); ++i)
+            std::vector<int> boxes;     // 8 values per box
+            int box_num = post_processor.BoxesFromBitmap(pred_map, bit_map, _box_thresh, _unclip_ratio, _score_mode, boxes, scores);
+            for(int i = 0; i < box_num; ++i)
             {
-                nn::OCR_Box box(boxes[i][0][0], boxes[i][0][1], boxes[i][1][0], boxes[i][1][1], boxes[i][2][0], boxes[i][2][1], boxes[i][3][0], boxes[i][3][1]);
+                const int *b = &boxes[i * 8];
+                nn::OCR_Box box(b[0], b[1], b[2], b[3], b[4], b[5], b[6], b[7]);
                 std::vector<int> idxes;
                 std::vector<std::string> chars;
                 std::vector<int> char_pos;
                 objects->add(box, idxes, chars, scores[i], char_pos);
             }
-            delete tmp_img;
 
             // correct boxes
             if(objects->size() > 0)
                 _correct_bbox(*objects, img_w, img_h, fit);
             // recognize charactors
-            for(size_t i = 0; i < boxes.size(); ++i)
-            {
-                // int x, y, w, h;
-                // _get_external_box(boxes[i], x, y, w, h, shape[3], shape[2]);
-                std::vector<std::string> char_list;
-                nn::OCR_Object &obj = objects->at(i);
-                _recognize(img, obj.box, obj.idx_list, char_list, obj.char_pos, true);
-                obj.update_chars(char_list);
-            }
+            _recognize_all(img, *objects);
             break;
         }
 
         return objects;
     }
 
-    static void _recognize_stdimg(nn::NN *_rec_model, image::Image &std_img, std::vector<float> &mean, std::vector<float> &scale, std::vector<int> &max_idxes, const int &_max_ch_num, const int &_prob_num)
+    void PP_OCR::_recognize_all(image::Image &img, nn::OCR_Objects &objects)
     {
-        // foward image
-        tensor::Tensors *outputs;
-        outputs = _rec_model->forward_image(std_img, mean, scale, image::Fit::FIT_FILL, true);
-        if (!outputs) // not happen here
-        {
-            throw err::Exception(err::ERR_RUNTIME);
-        }
+        int rec_w = _rec_input_size.width(), rec_h = _rec_input_size.height();
+        cv::Mat img_src(img.height(), img.width(), CV_8UC3, img.data());
+        cv::Mat line;
+        cv::Mat canvas;
+        // lines packed in canvas: object index, x, width
+        std::vector<int> packed;
+        int x = 0;
 
-        // rec postprocess, outputs shape: _max_ch_num x (_prob_num)
-        // get all max prob, totally _max_ch_num sections,
-        // then remove dumplicate and empty section, get charactors store in chars var.
-        for (auto it = outputs->begin(); it != outputs->end(); it++)
+        auto flush = [&]() {
+            if (packed.empty())
+                return;
+            _recognize_stdimg(_rec_model, canvas, this->rec_mean, this->rec_scale, _max_idxes, _max_ch_num, _prob_num);
+            for (size_t k = 0; k < packed.size(); k += 3)
+            {
+                nn::OCR_Object &obj = objects.at(packed[k]);
+                int start = packed[k + 1] / _rec_step;
+                int end = std::min(_max_ch_num, (packed[k + 1] + packed[k + 2] + _rec_step - 1) / _rec_step);
+                std::vector<std::string> char_list;
+                _ctc_decode(_max_idxes, start, end, 0, labels, obj.idx_list, char_list, obj.char_pos);
+                obj.update_chars(char_list);
+            }
+            packed.clear();
+            x = 0;
+        };
+
+        for (size_t i = 0; i < objects.size(); ++i)
         {
-            tensor::Tensor *out = it->second;
-            float *data = (float*)out->data();
-            float max_score;
-            for(int i = 0; i < _max_ch_num; ++i)
+            nn::OCR_Object &obj = objects.at(i);
+            obj.idx_list.clear();
+            _crop_text_line(img_src, obj.box, true, rec_h, line);
+            if (!rec_pack || _rec_step == 0 || line.cols > rec_w)
             {
-                max_score = 0;
-                for(int j = 0; j < _prob_num; ++j)
-                {
-                    if(*data > max_score)
-                    {
-                        max_score = *data;
-                        max_idxes[i] = j;
-                    }
-                    ++data;
-                }
+                std::vector<std::string> char_list;
+                _recognize_line(_rec_model, line, this->rec_mean, this->rec_scale, labels, _max_idxes, _max_ch_num, _prob_num, rec_w, rec_h,
+                                obj.idx_list, char_list, obj.char_pos);
+                obj.update_chars(char_list);
+                continue;
             }
-            break;
+            if (x + line.cols > rec_w)
+                flush();
+            if (packed.empty())
+            {
+                canvas.create(rec_h, rec_w, CV_8UC3);
+                canvas.setTo(cv::Scalar(0, 0, 0));
+            }
+            line.copyTo(canvas(cv::Rect(x, 0, line.cols, line.rows)));
+            packed.push_back((int)i);
+            packed.push_back(x);
+            packed.push_back(line.cols);
+            // next line starts at a step boundary after the gap
+            x = (x + line.cols + _rec_step - 1) / _rec_step * _rec_step + REC_PACK_GAP_STEPS * _rec_step;
         }
-        delete outputs;
+        flush();
     }
 
     void PP_OCR::_recognize(image::Image &img, const nn::OCR_Box &box, std::vector<int> &idx_list, std::vector<std::string> &char_list, std::vector<int> &char_pos, bool crop)
@@ -145,111 +266,10 @@ namespace maix::nn
         idx_list.clear();
         char_list.clear();
         cv::Mat img_src(img.height(), img.width(), CV_8UC3, img.data());
-        cv::Mat *std_img = &img_src;
-        cv::Mat img_dst;
-        cv::Mat srcCopy;
-        if(crop)
-        {
-            // crop and get std
-            cv::Point2f pts_std[4];
-            int img_crop_width = int(sqrt(pow(box.x1 - box.x2, 2) +
-                                    pow(box.y1 - box.y2, 2)));
-            int img_crop_height = int(sqrt(pow(box.x1 - box.x4, 2) +
-                                            pow(box.y1 - box.y4, 2)));
-            pts_std[0] = cv::Point2f(0., 0.);
-            pts_std[1] = cv::Point2f(img_crop_width, 0.);
-            pts_std[2] = cv::Point2f(img_crop_width, img_crop_height);
-            pts_std[3] = cv::Point2f(0.f, img_crop_height);
-            cv::Point2f pointsf[4];
-            pointsf[0] = cv::Point2f(box.x1, box.y1);
-            pointsf[1] = cv::Point2f(box.x2, box.y2);
-            pointsf[2] = cv::Point2f(box.x3, box.y3);
-            pointsf[3] = cv::Point2f(box.x4, box.y4);
-            cv::Mat M = cv::getPerspectiveTransform(pointsf, pts_std);
-            cv::warpPerspective(img_src, img_dst, M,
-                        cv::Size(img_crop_width, img_crop_height),
-                        cv::BORDER_REPLICATE);
-            std_img = &img_dst;
-            if (float(img_dst.rows) >= float(img_dst.cols) * 1.5) {
-                srcCopy = cv::Mat(img_dst.rows, img_dst.cols, img_dst.depth());
-                cv::transpose(img_dst, srcCopy);
-                cv::flip(srcCopy, srcCopy, 0);
-                std_img = &srcCopy;
-            }
-        }
-
-        // resize pad image to model input size(_rec_input_size) like 320x48
-        // keep ratio resize image's height to _rec_input_size.height(),
-        // if new image width > _rec_input_size.width()， resize new image width to _rec_input_size.width(), padding black color at bottom,
-        // else if new image width < _rec_input_size.width(), keep new image content at left, right padding black color.
-        // finally we got _rec_input_size image
-        float aspect_ratio = float(std_img->cols) / float(std_img->rows);
-        cv::Mat resized_img;
-        // Height is the limiting factor
-        cv::resize(*std_img, resized_img, cv::Size(static_cast<int>(_rec_input_size.height() * aspect_ratio),
-                    _rec_input_size.height()));
-        if (aspect_ratio > float(_rec_input_size.width()) / float(_rec_input_size.height())) {
-            // Width > input width
-            // slice and recognize
-            for(int i = 0; i < std::ceil((float)resized_img.cols / _rec_input_size.width()); ++i)
-            {
-                // crop
-                cv::Mat crop_img = resized_img(cv::Rect(i * _rec_input_size.width(), 0, std::min(_rec_input_size.width(), resized_img.cols - i * _rec_input_size.width()), resized_img.rows));
-                cv::Mat final_img;
-                if(crop_img.cols < _rec_input_size.width())
-                {
-                    cv::Mat padded_img(_rec_input_size.height(), _rec_input_size.width(), CV_8UC3, cv::Scalar(0, 0, 0));
-                    crop_img.copyTo(padded_img(cv::Rect(0, 0, crop_img.cols, crop_img.rows)));
-                    padded_img.copyTo(final_img);
-                }
-                else
-                {
-                    crop_img.copyTo(final_img);
-                }
-                // show image on left-top
-                image::Image std_img(final_img.cols, final_img.rows, image::Format::FMT_BGR888, final_img.data, -1, false);
-                // if(i == 0)
-                //     img.draw_image(0, 0, std_img);
-
-                std::vector<int> max_idxes(_max_ch_num);
-                _recognize_stdimg(_rec_model, std_img, this->rec_mean, this->rec_scale, max_idxes, _max_ch_num, _prob_num);
-
-                int last_idx = 0;
-                for(int j = 0; j < _max_ch_num; ++j)
-                {
-                    if((max_idxes[j] != last_idx) && (max_idxes[j] != 0))
-                    {
-                        idx_list.push_back(max_idxes[j] - 1);
-                        char_list.push_back(labels[max_idxes[j] - 1]);
-                        char_pos.push_back(j + i * _max_ch_num);
-                    }
-                    last_idx = max_idxes[j];
-                }
-            }
-        } else {
-            // pad
-            cv::Mat padded_img(_rec_input_size.height(), _rec_input_size.width(), CV_8UC3, cv::Scalar(0, 0, 0));
-            resized_img.copyTo(padded_img(cv::Rect(0, 0, resized_img.cols, resized_img.rows)));
-            image::Image pad_img(padded_img.cols, padded_img.rows, image::Format::FMT_BGR888, padded_img.data, -1, false);
-
-            // show image on left-top
-            // img.draw_image(0, 0, pad_img);
-
-            std::vector<int> max_idxes(_max_ch_num);
-            _recognize_stdimg(_rec_model, pad_img, this->rec_mean, this->rec_scale, max_idxes, _max_ch_num, _prob_num);
-
-            int last_idx = 0;
-            for(int i = 0; i < _max_ch_num; ++i)
-            {
-                if((max_idxes[i] != last_idx) && (max_idxes[i] != 0))
-                {
-                    idx_list.push_back(max_idxes[i] - 1);
-                    char_list.push_back(labels[max_idxes[i] - 1]);
-                    char_pos.push_back(i);
-                }
-                last_idx = max_idxes[i];
-            }
-        }
+        cv::Mat line;
+        _crop_text_line(img_src, box, crop, _rec_input_size.height(), line);
+        _recognize_line(_rec_model, line, this->rec_mean, this->rec_scale, labels, _max_idxes, _max_ch_num, _prob_num,
+                        _rec_input_size.width(), _rec_input_size.height(), idx_list, char_list, char_pos);
     }
 
     void PP_OCR::_correct_bbox(nn::OCR_Objects &objs, int img_w, int img_h, maix::image::Fit fit)
@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include "pp_ocr_postprocess_op.h"
+#include <cfloat>
 
 namespace PaddleOCR {
 
@@ -66,17 +67,49 @@ cv::RotatedRect DBPostProcessor::UnClip(std::vector<std::vector<float>> box,
   return res;
 }
 
-float **DBPostProcessor::Mat2Vec(cv::Mat mat) {
-  auto **array = new float *[mat.rows];
-  for (int i = 0; i < mat.rows; ++i)
-    array[i] = new float[mat.cols];
-  for (int i = 0; i < mat.rows; ++i) {
-    for (int j = 0; j < mat.cols; ++j) {
-      array[i][j] = mat.at<float>(i, j);
-    }
+void DBPostProcessor::GetContourArea(const float box[8], float unclip_ratio,
+                                     float &distance) {
+  float area = 0.0f;
+  float dist = 0.0f;
+  for (int i = 0; i < 4; i++) {
+    const float *p0 = box + i * 2;
+    const float *p1 = box + (i + 1) % 4 * 2;
+    area += p0[0] * p1[1] - p0[1] * p1[0];
+    dist += sqrtf((p0[0] - p1[0]) * (p0[0] - p1[0]) +
+                  (p0[1] - p1[1]) * (p0[1] - p1[1]));
   }
+  area = fabs(float(area / 2.0));
 
-  return array;
+  distance = area * unclip_ratio / dist;
+}
+
+cv::RotatedRect DBPostProcessor::UnClip(const float box[8],
+                                        float unclip_ratio) {
+  float distance = 1.0;
+
+  GetContourArea(box, unclip_ratio, distance);
+
+  Clipper2Lib::ClipperOffset offset;
+  Clipper2Lib::Path64 p;
+  for (int i = 0; i < 4; i++) {
+    p.push_back(Clipper2Lib::Point<int64_t>(int64_t(box[i * 2]),
+                                            int64_t(box[i * 2 + 1])));
+  }
+  offset.AddPath(p, Clipper2Lib::JoinType::Round, Clipper2Lib::EndType::Polygon);
+
+  Clipper2Lib::Paths64 soln;
+  offset.Execute(distance, soln);
+  std::vector<cv::Point2f> points;
+
+  for (size_t j = 0; j < soln.size(); j++) {
+    for (size_t i = 0; i < soln[soln.size() - 1].size(); i++) {
+      points.emplace_back(soln[j][i].x, soln[j][i].y);
+    }
+  }
+  if (points.size() <= 0) {
+    return cv::RotatedRect(cv::Point2f(0, 0), cv::Size2f(1, 1), 0);
+  }
+  return cv::minAreaRect(points);
 }
 
 std::vector<std::vector<int>>
@@ -112,13 +145,15 @@ std::vector<std::vector<float>> DBPostProcessor::Mat2Vector(cv::Mat mat) {
   return img_vec;
 }
 
-bool DBPostProcessor::XsortFp32(std::vector<float> a, std::vector<float> b) {
+bool DBPostProcessor::XsortFp32(const std::vector<float> &a,
+                                const std::vector<float> &b) {
   if (a[0] != b[0])
     return a[0] < b[0];
   return false;
 }
 
-bool DBPostProcessor::XsortInt(std::vector<int> a, std::vector<int> b) {
+bool DBPostProcessor::XsortInt(const std::vector<int> &a,
+                               const std::vector<int> &b) {
   if (a[0] != b[0])
     return a[0] < b[0];
   return false;
@@ -159,8 +194,44 @@ DBPostProcessor::GetMiniBoxes(cv::RotatedRect box, float &ssid) {
   return array;
 }
 
-float DBPostProcessor::PolygonScoreAcc(std::vector<cv::Point> contour,
-                                       cv::Mat pred) {
+void DBPostProcessor::GetMiniBoxes(const cv::RotatedRect &box, float &ssid,
+                                   float box_out[8]) {
+  ssid = std::max(box.size.width, box.size.height);
+
+  cv::Point2f pts[4];
+  box.points(pts);
+  std::sort(pts, pts + 4, [](const cv::Point2f &a, const cv::Point2f &b) {
+    return a.x < b.x;
+  });
+
+  cv::Point2f p1, p2, p3, p4;
+  if (pts[3].y <= pts[2].y) {
+    p2 = pts[3];
+    p3 = pts[2];
+  } else {
+    p2 = pts[2];
+    p3 = pts[3];
+  }
+  if (pts[1].y <= pts[0].y) {
+    p1 = pts[1];
+    p4 = pts[0];
+  } else {
+    p1 = pts[0];
+    p4 = pts[1];
+  }
+
+  box_out[0] = p1.x;
+  box_out[1] = p1.y;
+  box_out[2] = p2.x;
+  box_out[3] = p2.y;
+  box_out[4] = p3.x;
+  box_out[5] = p3.y;
+  box_out[6] = p4.x;
+  box_out[7] = p4.y;
+}
+
+float DBPostProcessor::PolygonScoreAcc(const std::vector<cv::Point> &contour,
+                                       const cv::Mat &pred) {
   int width = pred.cols;
   int height = pred.rows;
   std::vector<float> box_x;
@@ -243,82 +314,142 @@ float DBPostProcessor::BoxScoreFast(std::vector<std::vector<float>> box_array,
   return score;
 }
 
-std::vector<std::vector<std::vector<int>>> DBPostProcessor::BoxesFromBitmap(
-    const cv::Mat pred, const cv::Mat bitmap, const float &box_thresh,
-    const float &det_db_unclip_ratio, const std::string &det_db_score_mode, std::vector<float> &scores) {
+float DBPostProcessor::BoxScoreFast(const float box[8], const cv::Mat &pred) {
+  int width = pred.cols;
+  int height = pred.rows;
+
+  float box_x[4] = {box[0], box[2], box[4], box[6]};
+  float box_y[4] = {box[1], box[3], box[5], box[7]};
+
+  int xmin = clamp(int(std::floor(*(std::min_element(box_x, box_x + 4)))), 0,
+                   width - 1);
+  int xmax = clamp(int(std::ceil(*(std::max_element(box_x, box_x + 4)))), 0,
+                   width - 1);
+  int ymin = clamp(int(std::floor(*(std::min_element(box_y, box_y + 4)))), 0,
+                   height - 1);
+  int ymax = clamp(int(std::ceil(*(std::max_element(box_y, box_y + 4)))), 0,
+                   height - 1);
+
+  // vertices truncated to int like the mask version
+  int px[4], py[4];
+  for (int i = 0; i < 4; i++) {
+    px[i] = int(box_x[i]);
+    py[i] = int(box_y[i]);
+  }
+
+  // box is convex, every row inside is one span between its edges
+  double sum = 0;
+  int count = 0;
+  for (int y = ymin; y <= ymax; y++) {
+    float left = FLT_MAX, right = -FLT_MAX;
+    for (int i = 0; i < 4; i++) {
+      int x0 = px[i], y0 = py[i], x1 = px[(i + 1) % 4], y1 = py[(i + 1) % 4];
+      if ((y < y0 && y < y1) || (y > y0 && y > y1))
+        continue;
+      if (y0 == y1) {
+        left = std::min(left, float(std::min(x0, x1)));
+        right = std::max(right, float(std::max(x0, x1)));
+      } else {
+        float x = x0 + float(y - y0) * (x1 - x0) / (y1 - y0);
+        left = std::min(left, x);
+        right = std::max(right, x);
+      }
+    }
+    if (left > right)
+      continue;
+    int xl = std::max(xmin, int(lroundf(left)));
+    int xr = std::min(xmax, int(lroundf(right)));
+    if (xl > xr)
+      continue;
+    const float *row = pred.ptr<float>(y);
+    float row_sum = 0;
+    for (int x = xl; x <= xr; x++)
+      row_sum += row[x];
+    sum += row_sum;
+    count += xr - xl + 1;
+  }
+  return count > 0 ? float(sum / count) : 0.0f;
+}
+
+int DBPostProcessor::BoxesFromBitmap(const cv::Mat &pred, const cv::Mat &bitmap,
+                                     float box_thresh, float det_db_unclip_ratio,
+                                     const std::string &det_db_score_mode,
+                                     std::vector<int> &boxes,
+                                     std::vector<float> &scores) {
   const int min_size = 3;
-  const int max_candidates = 1000;
+  const size_t max_candidates = 1000;
 
   int width = bitmap.cols;
   int height = bitmap.rows;
 
-  std::vector<std::vector<cv::Point>> contours;
-  std::vector<cv::Vec4i> hierarchy;
-
+  boxes.clear();
   scores.clear();
 
-  cv::findContours(bitmap, contours, hierarchy, cv::RETR_LIST,
+  contours_.clear();
+  hierarchy_.clear();
+  cv::findContours(bitmap, contours_, hierarchy_, cv::RETR_LIST,
                    cv::CHAIN_APPROX_SIMPLE);
 
-  int num_contours =
-      contours.size() >= max_candidates ? max_candidates : contours.size();
-
-  std::vector<std::vector<std::vector<int>>> boxes;
+  size_t num_contours = std::min(contours_.size(), max_candidates);
+  bool slow = det_db_score_mode == "slow";
+  int dest_width = pred.cols;
+  int dest_height = pred.rows;
+  float array[8], cliparray[8];
 
-  for (int _i = 0; _i < num_contours; _i++) {
-    if (contours[_i].size() <= 2) {
+  for (size_t _i = 0; _i < num_contours; _i++) {
+    if (contours_[_i].size() <= 2) {
       continue;
     }
     float ssid;
-    cv::RotatedRect box = cv::minAreaRect(contours[_i]);
-    auto array = GetMiniBoxes(box, ssid);
-
-    auto box_for_unclip = array;
-    // end get_mini_box
-
+    GetMiniBoxes(cv::minAreaRect(contours_[_i]), ssid, array);
     if (ssid < min_size) {
       continue;
     }
+
     float score;
-    if (det_db_score_mode == "slow")
+    if (slow)
       /* compute using polygon*/
-      score = PolygonScoreAcc(contours[_i], pred);
+      score = PolygonScoreAcc(contours_[_i], pred);
     else
       score = BoxScoreFast(array, pred);
 
     if (score < box_thresh)
       continue;
 
-    // start for unclip
-    cv::RotatedRect points = UnClip(box_for_unclip, det_db_unclip_ratio);
+    cv::RotatedRect points = UnClip(array, det_db_unclip_ratio);
     if (points.size.height < 1.001 && points.size.width < 1.001) {
       continue;
     }
-    // end for unclip
-
-    cv::RotatedRect clipbox = points;
-    auto cliparray = GetMiniBoxes(clipbox, ssid);
 
+    GetMiniBoxes(points, ssid, cliparray);
     if (ssid < min_size + 2)
       continue;
 
-    int dest_width = pred.cols;
-    int dest_height = pred.rows;
-    std::vector<std::vector<int>> intcliparray;
-
     for (int num_pt = 0; num_pt < 4; num_pt++) {
-      std::vector<int> a{int(clampf(roundf(cliparray[num_pt][0] / float(width) *
-                                           float(dest_width)),
-                                    0, float(dest_width))),
-                         int(clampf(roundf(cliparray[num_pt][1] /
-                                           float(height) * float(dest_height)),
-                                    0, float(dest_height)))};
-      intcliparray.push_back(a);
+      boxes.push_back(int(clampf(roundf(cliparray[num_pt * 2] / float(width) *
+                                        float(dest_width)),
+                                 0, float(dest_width))));
+      boxes.push_back(int(clampf(roundf(cliparray[num_pt * 2 + 1] /
+                                        float(height) * float(dest_height)),
+                                 0, float(dest_height))));
     }
-    boxes.push_back(intcliparray);
     scores.push_back(score);
+  }
+  return scores.size();
+}
 
-  } // end for
+std::vector<std::vector<std::vector<int>>> DBPostProcessor::BoxesFromBitmap(
+    const cv::Mat pred, const cv::Mat bitmap, const float &box_thresh,
+    const float &det_db_unclip_ratio, const std::string &det_db_score_mode, std::vector<float> &scores) {
+  std::vector<int> flat_boxes;
+  int num = BoxesFromBitmap(pred, bitmap, box_thresh, det_db_unclip_ratio,
+                            det_db_score_mode, flat_boxes, scores);
+  std::vector<std::vector<std::vector<int>>> boxes(num);
+  for (int i = 0; i < num; i++) {
+    for (int j = 0; j < 4; j++) {
+      boxes[i].push_back({flat_boxes[i * 8 + j * 2], flat_boxes[i * 8 + j * 2 + 1]});
+    }
+  }
   return boxes;
 }
 
@@ -8,6 +8,8 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <functional>
 #include "maix_basic.hpp"
 
 namespace maix::peripheral::gpio
@@ -36,6 +38,60 @@ namespace maix::peripheral::gpio
         PULL_MAX
     };
 
+    /**
+     * @brief GPIO edge
+     * @maixpy maix.peripheral.gpio.Edge
+     */
+    enum Edge
+    {
+        EDGE_NONE    = 0x00,  // no edge detection
+        EDGE_RISING  = 0x01,  // rising edge
+        EDGE_FALLING = 0x02,  // falling edge
+        EDGE_BOTH    = 0x03,  // both rising and falling edge
+    };
+
+    /**
+     * GPIO edge event
+     * @maixpy maix.peripheral.gpio.Event
+     */
+    class Event
+    {
+    public:
+        /**
+         * @brief Event constructor
+         * @maixpy maix.peripheral.gpio.Event.__init__
+         * @maixcdk maix.peripheral.gpio.Event.Event
+         */
+        Event(gpio::Edge edge = gpio::Edge::EDGE_NONE, uint64_t timestamp_ns = 0, uint32_t seqno = 0, int offset = 0)
+            : edge(edge), timestamp_ns(timestamp_ns), seqno(seqno), offset(offset)
+        {
+        }
+
+        /**
+         * edge of this event, gpio.Edge.EDGE_RISING or gpio.Edge.EDGE_FALLING.
+         * @maixpy maix.peripheral.gpio.Event.edge
+         */
+        gpio::Edge edge;
+
+        /**
+         * kernel timestamp of this event in nanoseconds, CLOCK_MONOTONIC, the same clock as time.ticks_us().
+         * @maixpy maix.peripheral.gpio.Event.timestamp_ns
+         */
+        uint64_t timestamp_ns;
+
+        /**
+         * sequence number of this event on this line, starts from 1, a gap means events lost because kernel buffer overflow.
+         * @maixpy maix.peripheral.gpio.Event.seqno
+         */
+        uint32_t seqno;
+
+        /**
+         * line offset in gpiochip.
+         * @maixpy maix.peripheral.gpio.Event.offset
+         */
+        int offset;
+    };
+
     /**
      * Peripheral gpio class
      * @maixpy maix.peripheral.gpio.GPIO
@@ -111,13 +167,132 @@ namespace maix::peripheral::gpio
          */
         err::Err reset(gpio::Mode mode, gpio::Pull pull);
 
+        /**
+         * @brief Enable or disable edge detection, only for input mode.
+         * Edges are timestamped by kernel and buffered, read them by read_events() or receive them by on_edge callback,
+         * no need to poll value() any more.
+         * @param[in] edge gpio.Edge type, gpio.Edge.EDGE_NONE to disable edge detection.
+         * @param[in] debounce_us debounce period in microseconds, 0 means no debounce, only valid when hardware or kernel support.
+         * @return err::Err type
+         * @maixpy maix.peripheral.gpio.GPIO.set_edge
+         */
+        err::Err set_edge(gpio::Edge edge, int debounce_us = 0);
+
+        /**
+         * @brief Read edge events, need enable edge detection by set_edge first.
+         * @param[in] timeout_ms wait timeout in milliseconds when no event buffered, 0 means not wait, -1 means wait forever.
+         * @param[in] max_num max number of events to read once.
+         * @return edge events list, empty if timeout.
+         * @maixpy maix.peripheral.gpio.GPIO.read_events
+         */
+        std::vector<gpio::Event> read_events(int timeout_ms = -1, int max_num = 16);
+
+        /**
+         * @brief Read edge events into caller's buffer, no memory allocation.
+         * @param[out] events events buffer.
+         * @param[in] max_num events buffer size.
+         * @param[in] timeout_ms wait timeout in milliseconds when no event buffered, 0 means not wait, -1 means wait forever.
+         * @return events number read, 0 means timeout, negative value means error, value is -err::Err.
+         * @maixcdk maix.peripheral.gpio.GPIO.read_events
+         */
+        int read_events(gpio::Event *events, int max_num, int timeout_ms = -1);
+
+        /**
+         * @brief Set edge event callback, will enable edge detection.
+         * All GPIO objects share one event thread, callbacks are called in that thread,
+         * so keep it short and be careful when operate shared data.
+         * @param[in] callback callback function with arg gpio.Event, set to None(nullptr in C++) to remove callback.
+         * @param[in] edge which edge to trigger callback, gpio.Edge type.
+         * @param[in] debounce_us debounce period in microseconds, 0 means no debounce.
+         * @return err::Err type
+         * @maixpy maix.peripheral.gpio.GPIO.on_edge
+         */
+        err::Err on_edge(std::function<void(gpio::Event)> callback, gpio::Edge edge = gpio::Edge::EDGE_BOTH, int debounce_us = 0);
+
+        /**
+         * @brief get edge detection setting
+         * @return gpio::Edge type
+         * @maixpy maix.peripheral.gpio.GPIO.get_edge
+         */
+        gpio::Edge get_edge();
+
     private:
         std::string _pin;
         gpio::Mode  _mode;
         gpio::Pull  _pull;
+        gpio::Edge  _edge;
+        int         _debounce_us;
         int         _fd;
         int         _offset;
         int         _line;
         bool        _special;
+        std::function<void(gpio::Event)> _callback;
+    };
+
+    /**
+     * Multiple GPIO lines of one gpiochip, requested together so all of them are read or written by one ioctl.
+     * Bit i of values is pins[i].
+     * @maixpy maix.peripheral.gpio.GPIOBank
+     */
+    class GPIOBank
+    {
+    public:
+        /**
+         * @brief GPIOBank constructor
+         *
+         * @param[in] pins gpio pin names, the same format as GPIO class, all pins must belong to the same gpiochip, max 64 pins.
+         * @param[in] mode gpio mode for all pins. gpio.Mode type, default is gpio.Mode.IN (input) mode.
+         * @param[in] pull gpio pull for all pins. gpio.Pull type, default is gpio.Pull.PULL_NONE (pull none) mode.
+         * @throw err::Exception if args error or open gpio device failed.
+         * @maixpy maix.peripheral.gpio.GPIOBank.__init__
+         */
+        GPIOBank(const std::vector<std::string> &pins, gpio::Mode mode = gpio::Mode::IN, gpio::Pull pull = gpio::Pull::PULL_NONE);
+        ~GPIOBank();
+
+        /**
+         * @brief read all lines' value
+         * @return values list, the same order as pins, each value is 0 or 1, empty if read failed.
+         * @maixpy maix.peripheral.gpio.GPIOBank.values
+         */
+        std::vector<int> values();
+
+        /**
+         * @brief set lines' value
+         * @param[in] values values list, the same order as pins, can be shorter than pins, only set the first len(values) lines.
+         * @return err::Err type
+         * @maixpy maix.peripheral.gpio.GPIOBank.set_values
+         */
+        err::Err set_values(const std::vector<int> &values);
+
+        /**
+         * @brief read lines' value as bits
+         * @param[in] mask which lines to read, bit i is pins[i].
+         * @return bits of lines value, bit i is pins[i], lines not in mask are 0. Return 0 if read failed.
+         * @maixpy maix.peripheral.gpio.GPIOBank.get_bits
+         */
+        uint64_t get_bits(uint64_t mask = ~0ULL);
+
+        /**
+         * @brief set lines' value by bits
+         * @param[in] bits bit i is value of pins[i].
+         * @param[in] mask which lines to set, bit i is pins[i], lines not in mask keep unchanged.
+         * @return err::Err type
+         * @maixpy maix.peripheral.gpio.GPIOBank.set_bits
+         */
+        err::Err set_bits(uint64_t bits, uint64_t mask = ~0ULL);
+
+        /**
+         * @brief lines number
+         * @maixpy maix.peripheral.gpio.GPIOBank.size
+         */
+        int size();
+
+    private:
+        std::vector<std::string> _pins;
+        gpio::Mode _mode;
+        gpio::Pull _pull;
+        int        _fd;
+        int        _line;
+        uint64_t   _all_mask;
     };
 }; // namespace maix::peripheral::gpio
@@ -165,6 +165,19 @@ namespace maix::peripheral::i2c
          */
         Bytes* readfrom_mem(int addr, int mem_addr, int len, int mem_addr_size = 8, bool mem_addr_le = false);
 
+        /**
+         * @brief read data from i2c slave's memory address into caller's buffer in one transaction, no memory allocated.
+         * @param[in] addr i2c slave address, int type
+         * @param[in] mem_addr memory address want to read, int type.
+         * @param[out] data buffer to store data, at least len bytes.
+         * @param[in] len data length to read, int type
+         * @param[in] mem_addr_size memory address size, default is 8.
+         * @param[in] mem_addr_le memory address little endian, default is false, that is send high byte first.
+         * @return data length read if success, error occurred will return -err::Err.
+         * @maixcdk maix.peripheral.i2c.I2C.readfrom_mem
+         */
+        int readfrom_mem(int addr, int mem_addr, uint8_t *data, int len, int mem_addr_size = 8, bool mem_addr_le = false);
+
     private:
         int _fd;
         int _freq;
@@ -11,7 +11,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
-#include <linux/gpio.h>
+#include "maix_gpio_v2.hpp"
 #include <algorithm>
 #include <sys/ioctl.h>
 #include <errno.h>
@@ -37,40 +37,53 @@ namespace maix::peripheral::gpio
 		return -1;
 	}
 
-	GPIO::GPIO(std::string pin, gpio::Mode mode, gpio::Pull pull)
+	err::Err parse_pin(std::string pin, int &chip_id, int &offset)
 	{
-		this->_mode = mode;
-		this->_pull = pull;
-		this->_fd = 0;
-		this->_line = 0;
-
 		// to upper case first
 		// convert B14/GPIOB14 to chip_id and offset, B can be any letter
-		// if pin is number, throw not implemented error
-		int chip_id = 0;
-		int offset = 0;
+		// if pin is number, not implemented
 		std::transform(pin.begin(), pin.end(), pin.begin(), ::toupper);
 		if (pin.find("GPIO") != std::string::npos)
 		{
 			pin = pin.substr(4);
 		}
-		if (pin[0] >= 'A' && pin[0] <= 'Z')
+		if (pin.empty() || pin[0] < 'A' || pin[0] > 'Z')
 		{
-			chip_id = pin[0] - 'A';
-			try
-			{
-				offset = std::stoi(pin.substr(1));
-			}
-			catch (const std::exception &e)
-			{
-				throw err::Exception(err::Err::ERR_NOT_IMPL, "pin format error");
-			}
+			return err::Err::ERR_NOT_IMPL;
 		}
-		else
+		chip_id = pin[0] - 'A';
+		try
+		{
+			offset = std::stoi(pin.substr(1));
+		}
+		catch (const std::exception &e)
+		{
+			return err::Err::ERR_ARGS;
+		}
+		return err::ERR_NONE;
+	}
+
+	GPIO::GPIO(std::string pin, gpio::Mode mode, gpio::Pull pull)
+	{
+		this->_mode = mode;
+		this->_pull = pull;
+		this->_edge = gpio::Edge::EDGE_NONE;
+		this->_debounce_us = 0;
+		this->_fd = 0;
+		this->_line = 0;
+		this->_special = false;
+
+		int chip_id = 0;
+		_offset = 0;
+		err::Err e = parse_pin(pin, chip_id, _offset);
+		if (e == err::Err::ERR_NOT_IMPL)
 		{
 			throw err::Exception(err::Err::ERR_NOT_IMPL, "GPIO pin only number not implemented in this platform");
 		}
-		_special = false;
+		else if (e != err::ERR_NONE)
+		{
+			throw err::Exception(err::Err::ERR_NOT_IMPL, "pin format error");
+		}
 		// open gpiochip
 		std::string chip_path = "/dev/gpiochip" + std::to_string(chip_id);
 		int fd = open(chip_path.c_str(), O_RDWR);
@@ -79,26 +92,16 @@ namespace maix::peripheral::gpio
 			throw err::Exception(err::Err::ERR_IO, "open " + chip_path + " failed");
 		}
 		// get gpio line
-		struct gpiohandle_request req;
-		memset(&req, 0, sizeof(req));
-		req.lineoffsets[0] = offset;
-		req.lines = 1;
-		if (mode == gpio::Mode::IN)
-			req.flags = GPIOHANDLE_REQUEST_INPUT;
-		else if (mode == gpio::Mode::OUT)
-			req.flags = GPIOHANDLE_REQUEST_OUTPUT;
-		else if (mode == gpio::Mode::OUT_OD)
-			req.flags = GPIOHANDLE_REQUEST_OUTPUT | GPIOHANDLE_REQUEST_OPEN_DRAIN;
-		req.default_values[0] = pull == gpio::Pull::PULL_UP ? 1 : 0;
-		strncpy(req.consumer_label, "maix_gpio", sizeof(req.consumer_label));
-		if (ioctl(fd, GPIO_GET_LINEHANDLE_IOCTL, &req) < 0)
+		uint32_t offset = _offset;
+		int line = v2::request_lines(fd, &offset, 1, v2::line_flags(mode, pull), pull == gpio::Pull::PULL_UP ? 1 : 0, 0);
+		if (line < 0)
 		{
 			close(fd);
 			throw err::Exception(err::Err::ERR_IO, "get gpio line failed");
 		}
 		// save gpio line
 		this->_fd = fd;
-		this->_line = req.fd;
+		this->_line = line;
 	}
 
 	GPIO::~GPIO()
@@ -109,7 +112,10 @@ namespace maix::peripheral::gpio
 			return;
 		}
 		if (this->_line > 0)
+		{
+			v2::rm_listener(this->_line);
 			close(this->_line);
+		}
 		if (this->_fd > 0)
 			close(this->_fd);
 	}
@@ -125,22 +131,21 @@ namespace maix::peripheral::gpio
 			return value;
 		}
 
-		struct gpiohandle_data data;
-		memset(&data, 0, sizeof(data));
+		uint64_t bits = value > 0 ? 1 : 0;
 		if (value >= 0)
 		{
-			data.values[0] = value;
-			if (ioctl(this->_line, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data) < 0)
+			// output keeps what we set, save a read back ioctl
+			if (v2::set_values(this->_line, 1, bits) != err::ERR_NONE)
 			{
 				return (int)(-err::Err::ERR_IO);
 			}
+			return (int)bits;
 		}
-		memset(&data, 0, sizeof(data));
-		if (ioctl(this->_line, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data) < 0)
+		if (v2::get_values(this->_line, 1, bits) != err::ERR_NONE)
 		{
 			return (int)(-err::Err::ERR_IO);
 		}
-		return data.values[0];
+		return (int)bits;
 	}
 
 	void GPIO::high()
@@ -176,29 +181,28 @@ namespace maix::peripheral::gpio
 		if (mode == _mode && pull == _pull)
 			return err::ERR_NONE;
 
-		if (this->_line > 0) {
-			::close(this->_line);
-			this->_line = -1;
-		}
-
-		struct gpiohandle_request req;
-		::memset(&req, 0, sizeof(req));
-		req.lineoffsets[0] = _offset;
-		req.lines = 1;
-		if (mode == gpio::Mode::IN)
-			req.flags = GPIOHANDLE_REQUEST_INPUT;
-		else if (mode == gpio::Mode::OUT)
-			req.flags = GPIOHANDLE_REQUEST_OUTPUT;
-		else if (mode == gpio::Mode::OUT_OD)
-			req.flags = GPIOHANDLE_REQUEST_OUTPUT | GPIOHANDLE_REQUEST_OPEN_DRAIN;
-		req.default_values[0] = (pull == gpio::Pull::PULL_UP ? 1 : 0);
-		::strncpy(req.consumer_label, "maix_gpio", sizeof(req.consumer_label));
-		if (::ioctl(_fd, GPIO_GET_LINEHANDLE_IOCTL, &req) < 0) {
-			log::error("gpio set mode err: %s", ::strerror(errno));
-			return err::ERR_IO;
-		}
-
-		this->_line = req.fd;
+		if (_special)
+		{
+			_mode = mode;
+			_pull = pull;
+			return err::ERR_NONE;
+		}
+
+		// edge detection only valid for input
+		gpio::Edge edge = mode == gpio::Mode::IN ? _edge : gpio::Edge::EDGE_NONE;
+		err::Err e = v2::set_config(_line, 1, v2::line_flags(mode, pull, edge), pull == gpio::Pull::PULL_UP ? 1 : 0, _debounce_us);
+		if (e != err::ERR_NONE)
+		{
+			return e;
+		}
+		if (edge == gpio::Edge::EDGE_NONE)
+		{
+			// leave input mode, drop listener and callback so read_events and on_edge work again after back to input
+			v2::rm_listener(_line);
+			_callback = nullptr;
+			_edge = gpio::Edge::EDGE_NONE;
+		}
+
 		this->_mode = mode;
 		this->_pull = pull;
 		return err::ERR_NONE;
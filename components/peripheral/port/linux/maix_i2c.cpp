@@ -243,63 +243,55 @@ namespace maix::peripheral::i2c
         return writeto_mem(addr, mem_addr, data.data, (int)data.size(), mem_addr_size, mem_addr_le);
     }
 
-    Bytes* I2C::readfrom_mem(int addr, int mem_addr, int len, int mem_addr_size, bool mem_addr_le)
+    int I2C::readfrom_mem(int addr, int mem_addr, uint8_t *data, int len, int mem_addr_size, bool mem_addr_le)
     {
         // write mem_addr and restart to read
         if (_mode != i2c::Mode::MASTER)
         {
             log::error("Only for master mode");
-            return nullptr;
+            return (int)-err::Err::ERR_NOT_PERMIT;
         }
-        if(mem_addr_size % 8 != 0)
+        if(mem_addr_size % 8 != 0 || mem_addr_size > 32)
         {
             log::error("mem_addr_size must be multiple of 8");
-            return nullptr;
+            return (int)-err::Err::ERR_ARGS;
         }
 
         // write mem_addr first and restart to read
         if (0 != ioctl(_fd, I2C_SLAVE, addr))
         {
             log::error("set slave address failed");
-            return nullptr;
+            return (int)-err::Err::ERR_IO;
         }
 
-        std::vector<unsigned char> data_final;
-        if(mem_addr_size == 8)
+        unsigned char addr_buf[4];
+        int addr_len = mem_addr_size / 8;
+        if(mem_addr_le)
         {
-            data_final.push_back((unsigned char)mem_addr);
+            for(int i = 0; i < addr_len; i++)
+            {
+                addr_buf[i] = (unsigned char)(mem_addr & 0xff);
+                mem_addr >>= 8;
+            }
         }
         else
         {
-            if(mem_addr_le)
-            {
-                for(int i = 0; i < mem_addr_size / 8; i++)
-                {
-                    data_final.push_back((unsigned char)(mem_addr & 0xff));
-                    mem_addr >>= 8;
-                }
-            }
-            else
+            for(int i = 0; i < addr_len; i++)
             {
-
-                for(int i = 0; i < mem_addr_size / 8; i++)
-                {
-                    data_final.push_back((unsigned char)(mem_addr >> (8 * (mem_addr_size / 8 - i - 1))));
-                }
+                addr_buf[i] = (unsigned char)(mem_addr >> (8 * (addr_len - i - 1)));
             }
         }
         // write read with I2C_RDWR
         struct i2c_msg msgs[2];
         msgs[0].addr = addr;
         msgs[0].flags = 0;
-        msgs[0].len = data_final.size();
-        msgs[0].buf = data_final.data();
+        msgs[0].len = addr_len;
+        msgs[0].buf = addr_buf;
 
-        Bytes *data = new Bytes(nullptr, len);
         msgs[1].addr = addr;
         msgs[1].flags = I2C_M_RD;
         msgs[1].len = len;
-        msgs[1].buf = data->data;
+        msgs[1].buf = data;
 
         struct i2c_rdwr_ioctl_data msgset;
         msgset.msgs = msgs;
@@ -309,10 +301,20 @@ namespace maix::peripheral::i2c
         if (read_len != 2)
         {
             log::error("read failed");
+            return (int)-err::Err::ERR_IO;
+        }
+
+        return len;
+    }
+
+    Bytes* I2C::readfrom_mem(int addr, int mem_addr, int len, int mem_addr_size, bool mem_addr_le)
+    {
+        Bytes *data = new Bytes(nullptr, len);
+        if (readfrom_mem(addr, mem_addr, data->data, len, mem_addr_size, mem_addr_le) < 0)
+        {
             delete data;
             return nullptr;
         }
-
         return data;
     }
 }
@@ -0,0 +1,119 @@
+/**
+ * @author neucrack@sipeed
+ * @copyright Sipeed Ltd 2024-
+ * @license Apache 2.0
+ */
+
+#include "maix_gpio.hpp"
+#include "maix_gpio_v2.hpp"
+#include "maix_basic.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+
+namespace maix::peripheral::gpio
+{
+	GPIOBank::GPIOBank(const std::vector<std::string> &pins, gpio::Mode mode, gpio::Pull pull)
+	{
+		_pins = pins;
+		_mode = mode;
+		_pull = pull;
+		_fd = -1;
+		_line = -1;
+		if (pins.empty() || pins.size() > 64)
+		{
+			throw err::Exception(err::Err::ERR_ARGS, "pins number should be 1~64");
+		}
+		_all_mask = pins.size() == 64 ? ~0ULL : ((1ULL << pins.size()) - 1);
+
+		int chip_id = -1;
+		uint32_t offsets[64];
+		for (size_t i = 0; i < pins.size(); ++i)
+		{
+			int id = 0, offset = 0;
+			err::Err e = parse_pin(pins[i], id, offset);
+			if (e != err::ERR_NONE)
+			{
+				throw err::Exception(e, "pin " + pins[i] + " format error");
+			}
+			if (chip_id >= 0 && id != chip_id)
+			{
+				throw err::Exception(err::Err::ERR_ARGS, "all pins of GPIOBank should belong to the same gpiochip");
+			}
+			chip_id = id;
+			offsets[i] = offset;
+		}
+
+		std::string chip_path = "/dev/gpiochip" + std::to_string(chip_id);
+		_fd = open(chip_path.c_str(), O_RDWR | O_CLOEXEC);
+		if (_fd < 0)
+		{
+			throw err::Exception(err::Err::ERR_IO, "open " + chip_path + " failed");
+		}
+		uint64_t default_values = pull == gpio::Pull::PULL_UP ? _all_mask : 0;
+		_line = v2::request_lines(_fd, offsets, pins.size(), v2::line_flags(mode, pull), default_values, 0);
+		if (_line < 0)
+		{
+			close(_fd);
+			_fd = -1;
+			throw err::Exception(err::Err::ERR_IO, std::string("get gpio lines failed: ") + strerror(-_line));
+		}
+	}
+
+	GPIOBank::~GPIOBank()
+	{
+		if (_line >= 0)
+			close(_line);
+		if (_fd >= 0)
+			close(_fd);
+	}
+
+	std::vector<int> GPIOBank::values()
+	{
+		std::vector<int> res;
+		uint64_t bits = 0;
+		if (v2::get_values(_line, _all_mask, bits) != err::ERR_NONE)
+			return res;
+		res.resize(_pins.size());
+		for (size_t i = 0; i < _pins.size(); ++i)
+			res[i] = (bits >> i) & 1;
+		return res;
+	}
+
+	err::Err GPIOBank::set_values(const std::vector<int> &values)
+	{
+		if (values.size() > _pins.size())
+			return err::ERR_ARGS;
+		uint64_t bits = 0;
+		uint64_t mask = 0;
+		for (size_t i = 0; i < values.size(); ++i)
+		{
+			mask |= 1ULL << i;
+			if (values[i])
+				bits |= 1ULL << i;
+		}
+		return v2::set_values(_line, mask, bits);
+	}
+
+	uint64_t GPIOBank::get_bits(uint64_t mask)
+	{
+		uint64_t bits = 0;
+		mask &= _all_mask;
+		if (mask == 0 || v2::get_values(_line, mask, bits) != err::ERR_NONE)
+			return 0;
+		return bits;
+	}
+
+	err::Err GPIOBank::set_bits(uint64_t bits, uint64_t mask)
+	{
+		mask &= _all_mask;
+		if (mask == 0)
+			return err::ERR_NONE;
+		return v2::set_values(_line, mask, bits);
+	}
+
+	int GPIOBank::size()
+	{
+		return _pins.size();
+	}
+}; // namespace maix::peripheral::gpio
@@ -0,0 +1,114 @@
+/**
+ * GPIO edge event API of linux ports, based on GPIO character device v2 uAPI.
+ * @author neucrack@sipeed
+ * @copyright Sipeed Ltd 2024-
+ * @license Apache 2.0
+ */
+
+#include "maix_gpio_v2.hpp"
+#include "maix_basic.hpp"
+
+namespace maix::peripheral::gpio
+{
+	err::Err GPIO::set_edge(gpio::Edge edge, int debounce_us)
+	{
+		if (_special)
+		{
+			return err::ERR_NOT_IMPL;
+		}
+		if (edge != gpio::Edge::EDGE_NONE && _mode != gpio::Mode::IN)
+		{
+			log::error("gpio edge detection only support input mode");
+			return err::ERR_NOT_PERMIT;
+		}
+		if (debounce_us < 0)
+		{
+			return err::ERR_ARGS;
+		}
+		if (edge == _edge && debounce_us == _debounce_us)
+		{
+			if (edge == gpio::Edge::EDGE_NONE && _callback)
+			{
+				v2::rm_listener(_line);
+				_callback = nullptr;
+			}
+			return err::ERR_NONE;
+		}
+		err::Err e = v2::set_config(_line, 1, v2::line_flags(_mode, _pull, edge), _pull == gpio::Pull::PULL_UP ? 1 : 0, debounce_us);
+		if (e != err::ERR_NONE)
+		{
+			return e;
+		}
+		if (edge == gpio::Edge::EDGE_NONE)
+		{
+			v2::rm_listener(_line);
+			_callback = nullptr;
+		}
+		_edge = edge;
+		_debounce_us = debounce_us;
+		return err::ERR_NONE;
+	}
+
+	int GPIO::read_events(gpio::Event *events, int max_num, int timeout_ms)
+	{
+		if (_special)
+		{
+			return -err::ERR_NOT_IMPL;
+		}
+		if (_edge == gpio::Edge::EDGE_NONE)
+		{
+			log::error("gpio edge detection not enabled, call set_edge first");
+			return -err::ERR_NOT_READY;
+		}
+		if (_callback)
+		{
+			log::error("gpio events are consumed by on_edge callback");
+			return -err::ERR_BUSY;
+		}
+		return v2::read_events(_line, events, max_num, timeout_ms);
+	}
+
+	std::vector<gpio::Event> GPIO::read_events(int timeout_ms, int max_num)
+	{
+		std::vector<gpio::Event> events;
+		if (max_num <= 0)
+			return events;
+		events.resize(max_num);
+		int n = read_events(events.data(), max_num, timeout_ms);
+		events.resize(n > 0 ? n : 0);
+		return events;
+	}
+
+	err::Err GPIO::on_edge(std::function<void(gpio::Event)> callback, gpio::Edge edge, int debounce_us)
+	{
+		if (_special)
+		{
+			return err::ERR_NOT_IMPL;
+		}
+		if (!callback)
+		{
+			return set_edge(gpio::Edge::EDGE_NONE);
+		}
+		if (edge == gpio::Edge::EDGE_NONE)
+		{
+			return err::ERR_ARGS;
+		}
+		err::Err e = set_edge(edge, debounce_us);
+		if (e != err::ERR_NONE)
+		{
+			return e;
+		}
+		_callback = callback;
+		e = v2::add_listener(_line, callback);
+		if (e != err::ERR_NONE)
+		{
+			_callback = nullptr;
+		}
+		return e;
+	}
+
+	gpio::Edge GPIO::get_edge()
+	{
+		return _edge;
+	}
+}; // namespace maix::peripheral::gpio
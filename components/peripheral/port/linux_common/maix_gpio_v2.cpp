@@ -0,0 +1,372 @@
+/**
+ * GPIO character device v2 uAPI helpers shared by linux ports.
+ * @author neucrack@sipeed
+ * @copyright Sipeed Ltd 2024-
+ * @license Apache 2.0
+ */
+
+#include "maix_gpio_v2.hpp"
+#include "maix_basic.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <linux/gpio.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+#ifndef GPIO_V2_LINES_MAX
+#error "GPIO character device v2 uAPI is required, please use kernel headers >= 5.10"
+#endif
+
+namespace maix::peripheral::gpio::v2
+{
+    uint64_t line_flags(gpio::Mode mode, gpio::Pull pull, gpio::Edge edge)
+    {
+        uint64_t flags = 0;
+        if (mode == gpio::Mode::IN)
+        {
+            flags = GPIO_V2_LINE_FLAG_INPUT;
+            if (pull == gpio::Pull::PULL_UP)
+                flags |= GPIO_V2_LINE_FLAG_BIAS_PULL_UP;
+            else if (pull == gpio::Pull::PULL_DOWN)
+                flags |= GPIO_V2_LINE_FLAG_BIAS_PULL_DOWN;
+            if (edge & gpio::Edge::EDGE_RISING)
+                flags |= GPIO_V2_LINE_FLAG_EDGE_RISING;
+            if (edge & gpio::Edge::EDGE_FALLING)
+                flags |= GPIO_V2_LINE_FLAG_EDGE_FALLING;
+        }
+        else if (mode == gpio::Mode::OUT)
+            flags = GPIO_V2_LINE_FLAG_OUTPUT;
+        else if (mode == gpio::Mode::OUT_OD)
+            flags = GPIO_V2_LINE_FLAG_OUTPUT | GPIO_V2_LINE_FLAG_OPEN_DRAIN;
+        return flags;
+    }
+
+    static void _fill_config(struct gpio_v2_line_config &config, int num, uint64_t flags, uint64_t default_values, int debounce_us)
+    {
+        uint64_t all_mask = num >= 64 ? ~0ULL : ((1ULL << num) - 1);
+        memset(&config, 0, sizeof(config));
+        config.flags = flags;
+        if (flags & GPIO_V2_LINE_FLAG_OUTPUT)
+        {
+            config.attrs[config.num_attrs].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+            config.attrs[config.num_attrs].attr.values = default_values;
+            config.attrs[config.num_attrs].mask = all_mask;
+            config.num_attrs++;
+        }
+        if (debounce_us > 0)
+        {
+            config.attrs[config.num_attrs].attr.id = GPIO_V2_LINE_ATTR_ID_DEBOUNCE;
+            config.attrs[config.num_attrs].attr.debounce_period_us = debounce_us;
+            config.attrs[config.num_attrs].mask = all_mask;
+            config.num_attrs++;
+        }
+    }
+
+    int request_lines(int chip_fd, const uint32_t *offsets, int num, uint64_t flags, uint64_t default_values, int debounce_us)
+    {
+        if (num <= 0 || num > GPIO_V2_LINES_MAX)
+            return -EINVAL;
+        struct gpio_v2_line_request req;
+        memset(&req, 0, sizeof(req));
+        for (int i = 0; i < num; ++i)
+            req.offsets[i] = offsets[i];
+        req.num_lines = num;
+        strncpy(req.consumer, "maix_gpio", sizeof(req.consumer) - 1);
+        _fill_config(req.config, num, flags, default_values, debounce_us);
+        if (ioctl(chip_fd, GPIO_V2_GET_LINE_IOCTL, &req) < 0)
+            return -errno;
+        return req.fd;
+    }
+
+    err::Err set_config(int line_fd, int num, uint64_t flags, uint64_t default_values, int debounce_us)
+    {
+        struct gpio_v2_line_config config;
+        _fill_config(config, num, flags, default_values, debounce_us);
+        if (ioctl(line_fd, GPIO_V2_LINE_SET_CONFIG_IOCTL, &config) < 0)
+        {
+            log::error("gpio set config err: %s", strerror(errno));
+            return err::ERR_IO;
+        }
+        return err::ERR_NONE;
+    }
+
+    err::Err get_values(int line_fd, uint64_t mask, uint64_t &bits)
+    {
+        struct gpio_v2_line_values values;
+        values.bits = 0;
+        values.mask = mask;
+        if (ioctl(line_fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) < 0)
+            return err::ERR_IO;
+        bits = values.bits & mask;
+        return err::ERR_NONE;
+    }
+
+    err::Err set_values(int line_fd, uint64_t mask, uint64_t bits)
+    {
+        struct gpio_v2_line_values values;
+        values.bits = bits;
+        values.mask = mask;
+        if (ioctl(line_fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &values) < 0)
+            return err::ERR_IO;
+        return err::ERR_NONE;
+    }
+
+    int read_events(int line_fd, gpio::Event *events, int max_num, int timeout_ms)
+    {
+        if (max_num <= 0)
+            return -err::ERR_ARGS;
+        struct pollfd pfd;
+        pfd.fd = line_fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        int ret = poll(&pfd, 1, timeout_ms);
+        if (ret < 0)
+            return errno == EINTR ? 0 : -err::ERR_IO;
+        if (ret == 0)
+            return 0;
+        // drain what kernel buffered, up to max_num, 16 events per read syscall
+        struct gpio_v2_line_event buf[16];
+        int count = 0;
+        while (count < max_num)
+        {
+            int want = std::min(max_num - count, (int)(sizeof(buf) / sizeof(buf[0])));
+            ssize_t n = read(line_fd, buf, sizeof(buf[0]) * want);
+            if (n <= 0)
+                break;
+            int got = n / sizeof(buf[0]);
+            for (int i = 0; i < got; ++i)
+            {
+                gpio::Event &e = events[count++];
+                e.edge = buf[i].id == GPIO_V2_LINE_EVENT_RISING_EDGE ? gpio::Edge::EDGE_RISING : gpio::Edge::EDGE_FALLING;
+                e.timestamp_ns = buf[i].timestamp_ns;
+                e.seqno = buf[i].line_seqno;
+                e.offset = buf[i].offset;
+            }
+            if (got < want)
+                break;
+            // more may be buffered, check without blocking
+            pfd.revents = 0;
+            if (poll(&pfd, 1, 0) <= 0)
+                break;
+        }
+        return count;
+    }
+
+    /**
+     * One epoll thread for all GPIO edge callbacks of this process.
+     * Every listener polls its own dup of the line fd, so rm() never waits for a running callback:
+     * under MaixPy the caller of rm() may hold the GIL the callback is waiting for.
+     * The dup of a listener removed while its callback is running is closed by the loop thread after the callback returns.
+     */
+    class EventLoop
+    {
+    public:
+        static EventLoop &instance()
+        {
+            static EventLoop loop;
+            return loop;
+        }
+
+        err::Err add(int fd, std::function<void(gpio::Event)> callback)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_epoll_fd < 0)
+            {
+                err::Err e = _start();
+                if (e != err::ERR_NONE)
+                    return e;
+            }
+            auto cb = std::make_shared<std::function<void(gpio::Event)>>(std::move(callback));
+            auto it = _find(fd);
+            if (it != _listeners.end())
+            {
+                it->second.callback = cb;
+                return err::ERR_NONE;
+            }
+            int own_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+            if (own_fd < 0)
+            {
+                log::error("gpio dup line fd failed: %s", strerror(errno));
+                return err::ERR_IO;
+            }
+            struct epoll_event ev;
+            memset(&ev, 0, sizeof(ev));
+            ev.events = EPOLLIN;
+            ev.data.fd = own_fd;
+            if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, own_fd, &ev) < 0)
+            {
+                log::error("gpio epoll_ctl failed: %s", strerror(errno));
+                close(own_fd);
+                return err::ERR_IO;
+            }
+            _listeners[own_fd] = {fd, cb};
+            return err::ERR_NONE;
+        }
+
+        void rm(int fd)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto it = _find(fd);
+            if (it == _listeners.end())
+                return;
+            _remove(it);
+        }
+
+    private:
+        typedef struct
+        {
+            int line_fd;                                                // fd of caller
+            std::shared_ptr<std::function<void(gpio::Event)>> callback;
+        } listener_t;
+
+        EventLoop() : _epoll_fd(-1), _wake_fd(-1), _thread(nullptr), _exit(false), _dispatch_fd(-1), _dispatch_removed(false) {}
+
+        ~EventLoop()
+        {
+            if (_thread)
+            {
+                _exit = true;
+                uint64_t one = 1;
+                ssize_t n = write(_wake_fd, &one, sizeof(one));
+                (void)n;
+                _thread->join();
+                delete _thread;
+            }
+            for (auto &item : _listeners)
+                close(item.first);
+            if (_wake_fd >= 0)
+                close(_wake_fd);
+            if (_epoll_fd >= 0)
+                close(_epoll_fd);
+        }
+
+        std::map<int, listener_t>::iterator _find(int line_fd)
+        {
+            return std::find_if(_listeners.begin(), _listeners.end(),
+                                [line_fd](const std::pair<const int, listener_t> &item) { return item.second.line_fd == line_fd; });
+        }
+
+        // call with lock
+        void _remove(std::map<int, listener_t>::iterator it)
+        {
+            int own_fd = it->first;
+            epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, own_fd, nullptr);
+            _listeners.erase(it);
+            if (own_fd == _dispatch_fd)
+                _dispatch_removed = true;   // closed by loop thread after callback return
+            else
+                close(own_fd);
+        }
+
+        err::Err _start()
+        {
+            _epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+            if (_epoll_fd < 0)
+            {
+                log::error("create epoll failed: %s", strerror(errno));
+                return err::ERR_IO;
+            }
+            _wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+            struct epoll_event ev;
+            memset(&ev, 0, sizeof(ev));
+            ev.events = EPOLLIN;
+            ev.data.fd = _wake_fd;
+            if (_wake_fd < 0 || epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _wake_fd, &ev) < 0)
+            {
+                log::error("create gpio event wake fd failed: %s", strerror(errno));
+                if (_wake_fd >= 0)
+                    close(_wake_fd);
+                close(_epoll_fd);
+                _wake_fd = -1;
+                _epoll_fd = -1;
+                return err::ERR_IO;
+            }
+            _thread = new thread::Thread(_process, this);
+            return err::ERR_NONE;
+        }
+
+        static void _process(void *args)
+        {
+            EventLoop *loop = (EventLoop *)args;
+            struct epoll_event evs[8];
+            gpio::Event events[16];
+            while (!loop->_exit)
+            {
+                int nfds = epoll_wait(loop->_epoll_fd, evs, sizeof(evs) / sizeof(evs[0]), -1);
+                if (nfds < 0)
+                {
+                    if (errno == EINTR)
+                        continue;
+                    log::error("gpio event thread epoll_wait failed: %s", strerror(errno));
+                    break;
+                }
+                for (int i = 0; i < nfds; ++i)
+                {
+                    int fd = evs[i].data.fd;
+                    if (fd == loop->_wake_fd)
+                        continue;
+                    std::shared_ptr<std::function<void(gpio::Event)>> callback;
+                    {
+                        std::lock_guard<std::mutex> lock(loop->_mutex);
+                        auto it = loop->_listeners.find(fd);
+                        if (it == loop->_listeners.end())
+                            continue;
+                        // keep a reference and the fd open, callback may remove itself or be removed by other threads
+                        callback = it->second.callback;
+                        loop->_dispatch_fd = fd;
+                    }
+                    // call without lock, callbacks may call rm() or wait GIL held by thread calling rm()
+                    int n = read_events(fd, events, sizeof(events) / sizeof(events[0]), 0);
+                    for (int j = 0; j < n; ++j)
+                        (*callback)(events[j]);
+                    std::lock_guard<std::mutex> lock(loop->_mutex);
+                    if (n < 0 || (n == 0 && (evs[i].events & (EPOLLERR | EPOLLHUP))))
+                    {
+                        // fd stays ready in level triggered epoll, remove it or loop never sleeps
+                        auto it = loop->_listeners.find(fd);
+                        if (it != loop->_listeners.end())
+                        {
+                            log::error("gpio line fd %d read events failed, stop edge callback", it->second.line_fd);
+                            loop->_remove(it);
+                        }
+                    }
+                    loop->_dispatch_fd = -1;
+                    if (loop->_dispatch_removed)
+                    {
+                        loop->_dispatch_removed = false;
+                        close(fd);
+                    }
+                }
+            }
+        }
+
+        int _epoll_fd;
+        int _wake_fd;
+        thread::Thread *_thread;
+        std::atomic<bool> _exit;
+        std::mutex _mutex;
+        int _dispatch_fd;                           // fd whose callback is running
+        bool _dispatch_removed;                     // _dispatch_fd removed while running, close after callback
+        std::map<int, listener_t> _listeners;       // key is dup of line fd polled by loop
+    };
+
+    err::Err add_listener(int line_fd, std::function<void(gpio::Event)> callback)
+    {
+        return EventLoop::instance().add(line_fd, std::move(callback));
+    }
+
+    void rm_listener(int line_fd)
+    {
+        EventLoop::instance().rm(line_fd);
+    }
+} // namespace maix::peripheral::gpio::v2
@@ -0,0 +1,58 @@
+/**
+ * GPIO character device v2 uAPI helpers shared by linux ports.
+ * @author neucrack@sipeed
+ * @copyright Sipeed Ltd 2024-
+ * @license Apache 2.0
+ */
+
+#pragma once
+
+#include "maix_gpio.hpp"
+#include <stdint.h>
+#include <functional>
+
+namespace maix::peripheral::gpio
+{
+    /**
+     * Convert pin name to gpiochip id and line offset, implemented by each port.
+     */
+    err::Err parse_pin(std::string pin, int &chip_id, int &offset);
+
+    namespace v2
+    {
+        /**
+         * Line flags of mode, pull and edge.
+         * Input uses pull as bias, output uses pull only as default value.
+         */
+        uint64_t line_flags(gpio::Mode mode, gpio::Pull pull, gpio::Edge edge = gpio::Edge::EDGE_NONE);
+
+        /**
+         * Request lines of one gpiochip.
+         * @return line fd, or negative errno.
+         */
+        int request_lines(int chip_fd, const uint32_t *offsets, int num, uint64_t flags, uint64_t default_values, int debounce_us);
+
+        err::Err set_config(int line_fd, int num, uint64_t flags, uint64_t default_values, int debounce_us);
+
+        err::Err get_values(int line_fd, uint64_t mask, uint64_t &bits);
+
+        err::Err set_values(int line_fd, uint64_t mask, uint64_t bits);
+
+        /**
+         * Read buffered edge events, wait at most timeout_ms if none.
+         * @return events number, 0 if timeout, or -err::Err.
+         */
+        int read_events(int line_fd, gpio::Event *events, int max_num, int timeout_ms);
+
+        /**
+         * Add line fd to the shared event thread, callback is called in that thread for every event.
+         */
+        err::Err add_listener(int line_fd, std::function<void(gpio::Event)> callback);
+
+        /**
+         * Remove line fd from the shared event thread, never blocks, caller can close line_fd when return.
+         * The callback is not called again, except one call already running in the event thread finishes.
+         */
+        void rm_listener(int line_fd);
+    } // namespace v2
+} // namespace maix::peripheral::gpio
@@ -35,6 +35,15 @@ namespace maix::tracker
          */
         std::vector<tracker::Track> update(const std::vector<tracker::Object> &objs);
 
+        /**
+         * update tracks according to current detected objects, write results to tracks.
+         * tracks' memory is reused across calls, so keep the same vector for every frame to avoid allocation.
+         * @param objs detected objects of current frame.
+         * @param tracks output tracks, will be resized to the number of output tracks.
+         * @maixcdk maix.tracker.ByteTracker.update
+         */
+        void update(const std::vector<tracker::Object> &objs, std::vector<tracker::Track> &tracks);
+
     private:
         void *_data;
     };
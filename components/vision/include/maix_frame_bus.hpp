@@ -0,0 +1,131 @@
+/**
+ * @author neucrack@sipeed
+ * @copyright Sipeed Ltd 2024-
+ * @license Apache 2.0
+ * @update 2024.11.27: Add shared memory frame bus.
+ */
+
+#pragma once
+
+#include <string>
+#include "maix_err.hpp"
+#include "maix_image.hpp"
+
+namespace maix::image
+{
+    /**
+     * Metadata of one frame on FrameBus
+     * @maixcdk maix.image.FrameInfo
+     */
+    struct FrameInfo
+    {
+        uint64_t seq;           // sequence number, starts from 1, increase by 1 every published frame
+        uint64_t timestamp_us;  // time::ticks_us() when published, monotonic clock is shared by processes
+        int width;
+        int height;
+        image::Format format;
+        int data_size;
+        uint32_t dropped;       // frames published but skipped by this reader since last read
+    };
+
+    /**
+     * Shared memory frame bus, one writer process publishes frames to a ring of fixed size slots,
+     * any number of reader processes attach the slots as image::Image without copy.
+     * Slots live in POSIX shared memory /dev/shm/maix_fb_<name>, new frames are signaled by futex,
+     * every slot has a sequence lock and a reader pin count, writer never overwrites a slot pinned by readers,
+     * so a reader may hold up to slot_num - 2 frames at the same time while writer keeps running.
+     * @maixcdk maix.image.FrameBus
+     */
+    class FrameBus
+    {
+    public:
+        /**
+         * Construct a new FrameBus object
+         * @param name bus name, the same name connects writer and readers.
+         * @param create true to create bus as writer, existing bus with the same name is replaced,
+         *               false to open an existing bus as reader.
+         * @param slot_num slot number, writer only, at least 3, at most 64, default 4.
+         * @param slot_size max data size of one frame in bytes, writer only, e.g. width * height * 3 for RGB888.
+         * @throw err::Exception if create or open shared memory failed.
+         * @maixcdk maix.image.FrameBus.FrameBus
+         */
+        FrameBus(const std::string &name, bool create = false, int slot_num = 4, int slot_size = 0);
+        ~FrameBus();
+
+        /**
+         * Get a free slot to fill, writer only, zero copy, e.g. pass img->data() to camera::Camera::read.
+         * @param width image width.
+         * @param height image height.
+         * @param format image format, for compressed format data size is set by publish.
+         * @return image attached to slot, must be passed to publish() or cancel(), nullptr if no free slot or size too large.
+         * @maixcdk maix.image.FrameBus.acquire
+         */
+        image::Image *acquire(int width, int height, image::Format format);
+
+        /**
+         * Publish slot got by acquire(), and wake up readers, img is deleted.
+         * @param img image returned by acquire().
+         * @param data_size data size of compressed format, -1 means img->data_size().
+         * @return err::Err type
+         * @maixcdk maix.image.FrameBus.publish
+         */
+        err::Err publish(image::Image *img, int data_size = -1);
+
+        /**
+         * Give back slot got by acquire() without publishing, img is deleted.
+         * @maixcdk maix.image.FrameBus.cancel
+         */
+        void cancel(image::Image *img);
+
+        /**
+         * Copy image to a free slot and publish it, writer only.
+         * @return err::Err type, err::ERR_BUSY if all slots pinned by readers, the frame is dropped.
+         * @maixcdk maix.image.FrameBus.write
+         */
+        err::Err write(image::Image *img);
+
+        /**
+         * Read a frame, reader only, zero copy, the returned image points to shared memory.
+         * @param timeout_ms wait time for new frame, -1 means wait forever, 0 means no wait.
+         * @param latest true to get the newest frame and skip older ones, for detection;
+         *               false to get frames one by one in order, for recording, frames already overwritten are counted in info.dropped.
+         * @param info frame metadata output, can be nullptr.
+         * @return image pinned in slot, must be passed to release(), nullptr if timeout.
+         * @maixcdk maix.image.FrameBus.read
+         */
+        image::Image *read(int timeout_ms = -1, bool latest = true, image::FrameInfo *info = nullptr);
+
+        /**
+         * Unpin slot of image returned by read() so writer can reuse it, img is deleted.
+         * @maixcdk maix.image.FrameBus.release
+         */
+        void release(image::Image *img);
+
+        /**
+         * Sequence number of the newest published frame, 0 if none.
+         * @maixcdk maix.image.FrameBus.last_seq
+         */
+        uint64_t last_seq();
+
+        /**
+         * Frames dropped by writer because all slots were pinned.
+         * @maixcdk maix.image.FrameBus.writer_drops
+         */
+        uint64_t writer_drops();
+
+        /**
+         * Slot number
+         * @maixcdk maix.image.FrameBus.slot_num
+         */
+        int slot_num();
+
+        /**
+         * Max data size of one slot
+         * @maixcdk maix.image.FrameBus.slot_size
+         */
+        int slot_size();
+
+    private:
+        void *_data;
+    };
+} // namespace maix::image
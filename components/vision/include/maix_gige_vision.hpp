@@ -0,0 +1,116 @@
+/**
+ * @author neucrack@sipeed
+ * @copyright Sipeed Ltd 2024-
+ * @license Apache 2.0
+ * @update 2024.11.26: Add GigE Vision device.
+ */
+
+#pragma once
+
+#include <string>
+#include "maix_err.hpp"
+#include "maix_camera.hpp"
+#include "maix_image.hpp"
+#include "maix_basic.hpp"
+
+namespace maix::gige
+{
+    /**
+     * GigE Vision stream statistics
+     * @maixcdk maix.gige.StreamStats
+     */
+    struct StreamStats
+    {
+        uint64_t frames;        // frames sent
+        uint64_t packets;       // GVSP packets sent, including resent ones
+        uint64_t bytes;         // UDP payload bytes sent
+        uint32_t resend_requests;
+        uint32_t resent_packets;
+        uint32_t resend_missed; // requested block is no longer kept
+        uint32_t send_errors;
+    };
+
+    /**
+     * GigE Vision device, lets GigE Vision clients(Aravis, Halcon, Spinnaker etc.) ingest frames directly.
+     * GVCP control channel serves discovery, bootstrap registers, GenICam XML and heartbeat on UDP 3956,
+     * GVSP stream channel packetizes frames into UDP by GevSCPSPacketSize and GevSCPD,
+     * the last few frames are kept so PACKETRESEND requests can be served.
+     * Packet headers are prebuilt for the frame geometry and packets are sent by sendmmsg in batches.
+     * Supported pixel formats: Mono8(FMT_GRAYSCALE), RGB8(FMT_RGB888), BGR8(FMT_BGR888), Bayer 8 bits.
+     * @maixcdk maix.gige.GigEVision
+     */
+    class GigEVision
+    {
+    public:
+        /**
+         * Construct a new GigEVision object
+         * @param ip interface ip to serve, empty means the first up non loopback interface, loopback if none.
+         * @param model model name in discovery and bootstrap registers.
+         * @param serial serial number, empty means use MAC address.
+         * @param port GVCP port, default 3956, only change it for testing.
+         * @param resend_frames frames kept for resend requests, default 2.
+         * @maixcdk maix.gige.GigEVision.GigEVision
+         */
+        GigEVision(const std::string &ip = "", const std::string &model = "MaixCAM", const std::string &serial = "", int port = 3956, int resend_frames = 2);
+        ~GigEVision();
+
+        /**
+         * Start GVCP control channel, device can be discovered after start.
+         * @return err::Err type
+         * @maixcdk maix.gige.GigEVision.start
+         */
+        err::Err start();
+
+        /**
+         * Stop control and stream channel.
+         * @return err::Err type
+         * @maixcdk maix.gige.GigEVision.stop
+         */
+        err::Err stop();
+
+        /**
+         * Bind camera, frames are read from camera in a stream thread when client starts acquisition.
+         * Width, height and pixel format are taken from camera.
+         * @param camera camera object, must keep valid until stop.
+         * @return err::Err type, err::ERR_ARGS if camera format not supported.
+         * @maixcdk maix.gige.GigEVision.bind_camera
+         */
+        err::Err bind_camera(camera::Camera *camera);
+
+        /**
+         * Set frame geometry when push frames by write(), the geometry is reported to client by registers.
+         * @return err::Err type, err::ERR_ARGS if format not supported.
+         * @maixcdk maix.gige.GigEVision.set_format
+         */
+        err::Err set_format(int width, int height, image::Format format);
+
+        /**
+         * Send one frame, return immediately if client not acquiring.
+         * @param img image, geometry must be the same as set_format or bound camera.
+         * @return err::ERR_NONE if sent, err::ERR_NOT_READY if not acquiring, err::ERR_ARGS if geometry not match.
+         * @maixcdk maix.gige.GigEVision.write
+         */
+        err::Err write(image::Image *img);
+
+        /**
+         * Client is acquiring or not.
+         * @maixcdk maix.gige.GigEVision.acquiring
+         */
+        bool acquiring();
+
+        /**
+         * Client is controlling the device or not.
+         * @maixcdk maix.gige.GigEVision.connected
+         */
+        bool connected();
+
+        /**
+         * Get stream statistics
+         * @maixcdk maix.gige.GigEVision.stats
+         */
+        gige::StreamStats stats();
+
+    private:
+        void *_data;
+    };
+} // namespace maix::gige
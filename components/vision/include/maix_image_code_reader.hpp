@@ -0,0 +1,92 @@
+/**
+ * @author lxowalle@sipeed
+ * @copyright Sipeed Ltd 2023-
+ * @license Apache 2.0
+ * @update 2024.12.2: Add code reader for multiple code types.
+ */
+
+#pragma once
+
+#include "maix_image.hpp"
+#include <vector>
+
+namespace maix::image
+{
+    /**
+     * Code types of CodeReader, can be combined with |
+     * @maixcdk maix.image.CodeType
+     */
+    enum CodeType
+    {
+        CODE_QRCODE     = 1,
+        CODE_BARCODE    = 2,
+        CODE_DATAMATRIX = 4,
+        CODE_APRILTAG   = 8,
+    };
+
+    /**
+     * Codes found by CodeReader::read
+     * @maixcdk maix.image.CodeReaderResult
+     */
+    struct CodeReaderResult
+    {
+        std::vector<image::QRCode> qrcodes;
+        std::vector<image::BarCode> barcodes;
+        std::vector<image::DataMatrix> datamatrices;
+        std::vector<image::AprilTag> apriltags;
+    };
+
+    /**
+     * Read several code types in one pass.
+     * The frame is converted to grayscale once, then blocks with dense edges are grouped into candidate regions,
+     * and every (region, code type) pair is decoded on a thread pool with the same decoders as
+     * Image::find_qrcodes, find_barcodes, find_datamatrices and find_apriltags.
+     * Frames without edges dense enough are skipped without decoding.
+     * Optionally results of a region are reused while its content does not change, for codes that stay still.
+     * @maixcdk maix.image.CodeReader
+     */
+    class CodeReader
+    {
+    public:
+        /**
+         * Construct a new CodeReader object
+         * @param types code types to read, image::CodeType values combined with |.
+         * @param threads decoding threads, 0 means hardware concurrency.
+         * @param cache_frames reuse results of an unchanged region for at most this number of frames, 0 means no cache.
+         * @param min_edge_density min ratio of edge samples in a 32x32 block to be part of a candidate region, 0.0 ~ 1.0,
+         *                         0 means no candidate detection, the whole roi is decoded.
+         * @param qrcode_decoder decoder of QR code, the same as Image::find_qrcodes.
+         * @param families apriltag families, the same as Image::find_apriltags.
+         * @param datamatrix_effort effort of DataMatrix, the same as Image::find_datamatrices.
+         * @maixcdk maix.image.CodeReader.CodeReader
+         */
+        CodeReader(int types = image::CODE_QRCODE | image::CODE_BARCODE, int threads = 0, int cache_frames = 0, float min_edge_density = 0.06,
+                   image::QRCodeDecoderType qrcode_decoder = image::QRCodeDecoderType::QRCODE_DECODER_TYPE_ZBAR,
+                   image::ApriltagFamilies families = image::ApriltagFamilies::TAG36H11, int datamatrix_effort = 200);
+        ~CodeReader();
+
+        /**
+         * Read codes of image
+         * @param img image to read, any format supported by Image::to_format(FMT_GRAYSCALE), FMT_YVU420SP uses Y plane directly.
+         * @param roi region of interest, [x, y, w, h], empty means whole image.
+         * @return codes found, coordinates are of img.
+         * @maixcdk maix.image.CodeReader.read
+         */
+        image::CodeReaderResult read(image::Image &img, std::vector<int> roi = std::vector<int>());
+
+        /**
+         * Candidate regions of last read, [[x, y, w, h], ...], for debug and tuning min_edge_density.
+         * @maixcdk maix.image.CodeReader.regions
+         */
+        std::vector<std::vector<int>> regions();
+
+        /**
+         * Drop cached results
+         * @maixcdk maix.image.CodeReader.clear_cache
+         */
+        void clear_cache();
+
+    private:
+        void *_data;
+    };
+} // namespace maix::image
@@ -0,0 +1,63 @@
+/**
+ * @author lxowalle@sipeed
+ * @copyright Sipeed Ltd 2023-
+ * @license Apache 2.0
+ * @update 2024.11.30: Add line path tracker.
+ */
+
+#pragma once
+
+#include "maix_image.hpp"
+#include <vector>
+
+namespace maix::image
+{
+    /**
+     * Frame to frame line path tracker, incremental version of Image::search_line_path for high rate control loops.
+     * The first frame runs the full search, following frames only scan the grid blocks on and around the
+     * paths found last frame, points are assigned to the previous lines and refitted.
+     * Full search runs again when a line is lost, unknown points show up, or every full_search_interval frames.
+     * @maixcdk maix.image.LinePathTracker
+     */
+    class LinePathTracker
+    {
+    public:
+        /**
+         * Construct a new LinePathTracker object, parameters are the same as Image::search_line_path.
+         * @param thresholds thresholds of line, {{Lmin, Lmax}, ...}, compared with grayscale value.
+         * @param detect_pixel_size block size the image is divided into, also the width of band scanned around paths.
+         * @param point_merge_size Minimum distance between merged point sets. the unit is pixels.
+         * @param connection_max_size Minimum size allowed for connecting points to form a line. the unit is pixels.
+         * @param connection_max_distance Minimum distance allowed for point to line. the unit is pixels.
+         * @param connection_max_angle Minimum angle allowed for connecting points to form a line.
+         * @param full_search_interval run full search every this number of frames to find new lines, 0 means only when lost.
+         * @maixcdk maix.image.LinePathTracker.LinePathTracker
+         */
+        LinePathTracker(std::vector<std::vector<int>> thresholds, int detect_pixel_size = 30, int point_merge_size = 15, int connection_max_size = 51,
+                        int connection_max_distance = 20, int connection_max_angle = 20, int full_search_interval = 30);
+        ~LinePathTracker();
+
+        /**
+         * Search line path of a new frame
+         * @param img image, any format supported by Image::to_format(FMT_GRAYSCALE), frames must have the same size.
+         * @return line groups, the same as Image::search_line_path, group id is kept while tracking.
+         * @maixcdk maix.image.LinePathTracker.track
+         */
+        std::vector<image::LineGroup> track(image::Image &img);
+
+        /**
+         * Drop tracked paths, next track() runs full search
+         * @maixcdk maix.image.LinePathTracker.reset
+         */
+        void reset();
+
+        /**
+         * Whether last track() ran full search
+         * @maixcdk maix.image.LinePathTracker.full_searched
+         */
+        bool full_searched();
+
+    private:
+        void *_data;
+    };
+} // namespace maix::image
@@ -0,0 +1,100 @@
+/**
+ * @author lxowalle@sipeed
+ * @copyright Sipeed Ltd 2023-
+ * @license Apache 2.0
+ * @update 2024.11.29: Add template matcher with image pyramid.
+ */
+
+#pragma once
+
+#include "maix_image.hpp"
+#include <vector>
+
+namespace maix::image
+{
+    /**
+     * Template match result
+     * @maixcdk maix.image.TemplateMatchResult
+     */
+    struct TemplateMatchResult
+    {
+        int id;         // template id returned by TemplateMatcher::add
+        int x;
+        int y;
+        int w;
+        int h;
+        float score;    // normalized cross correlation, [-1, 1]
+    };
+
+    /**
+     * Template matching engine, searches several templates in one pass.
+     * Templates are converted to grayscale once and kept as pyramids with precomputed sums,
+     * frames are converted and downsampled once per match() and shared by all templates.
+     * The coarsest pyramid level is scanned densely, window sums come from integral images and
+     * rows are split into bands over threads, then the best candidates are refined level by level,
+     * so cost of a full VGA frame is close to scanning a 1/16 or 1/64 sized image.
+     * Scores are the exact normalized cross correlation computed at full resolution.
+     * @maixcdk maix.image.TemplateMatcher
+     */
+    class TemplateMatcher
+    {
+    public:
+        /**
+         * Construct a new TemplateMatcher object
+         * @param levels pyramid levels below full resolution, -1 means auto, chosen per template
+         *               so its coarsest level is still at least 8 pixels on the short side, at most 4.
+         *               0 means scan full resolution exhaustively.
+         * @param threads threads for dense scan, 0 means hardware concurrency.
+         * @maixcdk maix.image.TemplateMatcher.TemplateMatcher
+         */
+        TemplateMatcher(int levels = -1, int threads = 0);
+        ~TemplateMatcher();
+
+        /**
+         * Add a template, data is copied.
+         * @param template_image template image, any format supported by Image::to_format(FMT_GRAYSCALE).
+         * @return template id, >= 0.
+         * @throw err::Exception if template too small or flat(all pixels the same).
+         * @maixcdk maix.image.TemplateMatcher.add
+         */
+        int add(image::Image &template_image);
+
+        /**
+         * Remove a template
+         * @return err::ERR_ARGS if id not found.
+         * @maixcdk maix.image.TemplateMatcher.remove
+         */
+        err::Err remove(int id);
+
+        /**
+         * Remove all templates
+         * @maixcdk maix.image.TemplateMatcher.clear
+         */
+        void clear();
+
+        /**
+         * Templates number
+         * @maixcdk maix.image.TemplateMatcher.count
+         */
+        int count();
+
+        /**
+         * Search all templates in image.
+         * @param img image to search.
+         * @param threshold min score of result, 0.0~1.0.
+         * @param roi region of interest, [x, y, w, h], empty means whole image.
+         * @param max_per_template max results of each template, results of one template do not overlap more than half of template size.
+         * @param step position step of dense scan, only used when levels is 0, default 1.
+         * @return results sorted by score from high to low.
+         * @maixcdk maix.image.TemplateMatcher.match
+         */
+        std::vector<image::TemplateMatchResult> match(image::Image &img, float threshold, std::vector<int> roi = std::vector<int>(),
+                                                      int max_per_template = 1, int step = 1);
+
+    private:
+        int _levels;
+        int _threads;
+        int _next_id;
+        void *_data;
+    };
+} // namespace maix::image
@@ -3,20 +3,23 @@
 #include "ByteTrack/STrack.h"
 #include "ByteTrack/lapjv.h"
 #include "ByteTrack/Object.h"
+#include "ByteTrack/KalmanFilter.h"
 
 #include <cstddef>
-#include <limits>
-#include <map>
-#include <memory>
+#include <utility>
 #include <vector>
 
 namespace byte_track
 {
+/**
+ * ByteTrack multi object tracker.
+ * Tracks are kept in recycled slots, Kalman state is batched in one SoA filter,
+ * cost matrices and assignment scratch are flat buffers reused across frames,
+ * so a steady state update() does not allocate.
+ */
 class BYTETracker
 {
 public:
-    using STrackPtr = std::shared_ptr<STrack>;
-
     BYTETracker(const int& max_lost_buff_num = 60,
                 const float& track_thresh = 0.5,
                 const float& high_thresh = 0.6,
@@ -24,40 +27,45 @@ public:
                 const int& max_history = 20);
     ~BYTETracker();
 
-    std::vector<STrackPtr> update(const std::vector<Object>& objects);
+    /**
+     * Update tracks with detections of current frame.
+     * @return activated tracks, tracked ones first then lost ones,
+     *         the pointers and the vector are valid until next update call.
+     */
+    const std::vector<const STrack*>& update(const std::vector<Object>& objects);
 
 private:
-    std::vector<STrackPtr> jointStracks(const std::vector<STrackPtr> &a_tlist,
-                                        const std::vector<STrackPtr> &b_tlist) const;
-
-    std::vector<STrackPtr> subStracks(const std::vector<STrackPtr> &a_tlist,
-                                      const std::vector<STrackPtr> &b_tlist) const;
-
-    void removeDuplicateStracks(const std::vector<STrackPtr> &a_stracks,
-                                const std::vector<STrackPtr> &b_stracks,
-                                std::vector<STrackPtr> &a_res,
-                                std::vector<STrackPtr> &b_res) const;
-
-    void linearAssignment(const std::vector<std::vector<float>> &cost_matrix,
-                          const int &cost_matrix_size,
-                          const int &cost_matrix_size_size,
-                          const float &thresh,
-                          std::vector<std::vector<int>> &matches,
-                          std::vector<int> &b_unmatched,
-                          std::vector<int> &a_unmatched) const;
-
-    std::vector<std::vector<float>> calcIouDistance(const std::vector<STrackPtr> &a_tracks,
-                                                    const std::vector<STrackPtr> &b_tracks) const;
-
-    std::vector<std::vector<float>> calcIous(const std::vector<Rect<float>> &a_rect,
-                                             const std::vector<Rect<float>> &b_rect) const;
-
-    double execLapjv(const std::vector<std::vector<float> > &cost,
-                     std::vector<int> &rowsol,
-                     std::vector<int> &colsol,
-                     bool extend_cost = false,
-                     float cost_limit = std::numeric_limits<float>::max(),
-                     bool return_cost = true) const;
+    /**
+     * Top left, bottom right corners and area of boxes, struct-of-arrays for the IoU kernel.
+     */
+    struct Boxes
+    {
+        std::vector<float> x1, y1, x2, y2, area;
+
+        void clear();
+        void push_back(const Rect<float> &rect);
+        size_t size() const { return x1.size(); }
+    };
+
+    size_t allocSlot();
+    void gatherTrackBoxes(const std::vector<size_t> &slots, Boxes &boxes) const;
+    void gatherDetBoxes(const std::vector<size_t> &dets, Boxes &boxes) const;
+    void updateTrack(const size_t &slot, const size_t &det, const bool &reactivate);
+
+    void removeDuplicateStracks();
+
+    /**
+     * Compute 1 - IoU of each a, b pair into cost_ (row major, a.size() rows),
+     * also record the min cost of each row and column for gating.
+     */
+    void calcIouDistance(const Boxes &a, const Boxes &b);
+
+    /**
+     * Solve assignment on cost_ with lapjv, pairs cost more than thresh are never matched.
+     * Rows and columns without any pair under thresh are gated out before solving.
+     * Results are stored in matches_, a_unmatched_ and b_unmatched_, indices in ascending order.
+     */
+    void linearAssignment(const size_t &rows, const size_t &cols, const float &thresh);
 
 private:
     const float track_thresh_;
@@ -69,8 +77,32 @@ private:
     size_t frame_id_;
     size_t track_id_count_;
 
-    std::vector<STrackPtr> tracked_stracks_;
-    std::vector<STrackPtr> lost_stracks_;
-    std::vector<STrackPtr> removed_stracks_;
+    // track slots, strack_[i] and kalman_filter_ slot i are the same track
+    std::vector<STrack> stracks_;
+    std::vector<unsigned char> slot_used_;
+    std::vector<size_t> free_slots_;
+    KalmanFilter kalman_filter_;
+
+    std::vector<size_t> tracked_stracks_;
+    std::vector<size_t> lost_stracks_;
+
+    // detections of current frame
+    const std::vector<Object> *objects_;
+
+    // per frame scratch, kept to reuse capacity
+    std::vector<size_t> det_high_, det_low_, remain_det_;
+    std::vector<size_t> active_, non_active_, pool_;
+    std::vector<size_t> remain_tracked_, current_tracked_, refind_, current_lost_;
+    std::vector<unsigned char> predict_mask_, keep_;
+    Boxes a_boxes_, b_boxes_;
+    std::vector<float> cost_, row_min_, col_min_;
+    std::vector<size_t> gated_rows_, gated_cols_;
+    std::vector<double> lap_cost_;
+    std::vector<double *> lap_rows_;
+    std::vector<int> lap_x_, lap_y_, row_sol_, col_sol_;
+    LapjvWorkspace lap_workspace_;
+    std::vector<std::pair<size_t, size_t>> matches_;
+    std::vector<size_t> a_unmatched_, b_unmatched_;
+    std::vector<const STrack*> output_stracks_;
 };
-}
\ No newline at end of file
+}
@@ -1,39 +1,70 @@
 #pragma once
 
-#include "Eigen/Dense"
-
 #include "ByteTrack/Rect.h"
 
+#include <cstddef>
+#include <vector>
+
 namespace byte_track
 {
+/**
+ * Constant velocity Kalman filter over (x, y, a, h), batched over track slots.
+ *
+ * With the ByteTrack motion/observation model the four coordinates never
+ * correlate: initiate() starts with a diagonal covariance and the motion,
+ * process noise and measurement matrices are all block diagonal per
+ * coordinate. So the 8x8 covariance of a track is exactly four 2x2
+ * (position, velocity) blocks, and we store only their 3 distinct entries.
+ * State is kept as struct-of-arrays indexed by track slot, so predict() over
+ * all tracks is a straight loop the compiler can vectorize.
+ */
 class KalmanFilter
 {
 public:
     using DetectBox = Xyah<float>;
 
-    using StateMean = Eigen::Matrix<float, 1, 8, Eigen::RowMajor>;
-    using StateCov = Eigen::Matrix<float, 8, 8, Eigen::RowMajor>;
-
-    using StateHMean = Eigen::Matrix<float, 1, 4, Eigen::RowMajor>;
-    using StateHCov = Eigen::Matrix<float, 4, 4, Eigen::RowMajor>;
+    static constexpr size_t ndim = 4;
 
     KalmanFilter(const float& std_weight_position = 1. / 20,
                  const float& std_weight_velocity = 1. / 160);
 
-    void initiate(StateMean& mean, StateCov& covariance, const DetectBox& measurement);
+    /**
+     * Grow storage to hold at least n slots, never shrinks.
+     */
+    void resize(const size_t& n);
+    size_t size() const { return size_; }
+
+    void initiate(const size_t& slot, const DetectBox& measurement);
 
-    void predict(StateMean& mean, StateCov& covariance);
+    /**
+     * Predict all slots whose mask entry is not zero, mask has size() entries.
+     * Masked out slots are left untouched.
+     */
+    void predict(const unsigned char *mask);
 
-    void update(StateMean& mean, StateCov& covariance, const DetectBox& measurement);
+    void update(const size_t& slot, const DetectBox& measurement);
+
+    /**
+     * Clear the height velocity, ByteTrack does this for lost tracks before predict.
+     */
+    void clearHeightVelocity(const size_t& slot) { vel_[3][slot] = 0; }
+
+    float mean(const size_t& slot, const size_t& i) const
+    {
+        return i < ndim ? pos_[i][slot] : vel_[i - ndim][slot];
+    }
 
 private:
     float std_weight_position_;
     float std_weight_velocity_;
+    size_t size_;
 
-    Eigen::Matrix<float, 8, 8, Eigen::RowMajor> motion_mat_;
-    Eigen::Matrix<float, 4, 8, Eigen::RowMajor> update_mat_;
-
-    void project(StateHMean &projected_mean, StateHCov &projected_covariance,
-                 const StateMean& mean, const StateCov& covariance);
+    // mean, position and velocity part
+    std::vector<float> pos_[ndim];
+    std::vector<float> vel_[ndim];
+    // covariance blocks, [[pp, pv], [pv, vv]]
+    std::vector<float> cov_pp_[ndim];
+    std::vector<float> cov_pv_[ndim];
+    std::vector<float> cov_vv_[ndim];
 };
-}
\ No newline at end of file
+}
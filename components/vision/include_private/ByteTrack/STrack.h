@@ -2,10 +2,9 @@
 
 #include "ByteTrack/Rect.h"
 #include "ByteTrack/Object.h"
-#include "ByteTrack/KalmanFilter.h"
 
 #include <cstddef>
-#include <deque>
+#include <vector>
 
 namespace byte_track
 {
@@ -16,10 +15,16 @@ enum class STrackState {
     Removed = 3,
 };
 
+/**
+ * Per track bookkeeping, the Kalman state of a track lives in the tracker's
+ * KalmanFilter at the same slot index.
+ * STrack objects are owned and recycled by BYTETracker, the position history
+ * is a fixed size ring allocated once per slot.
+ */
 class STrack
 {
 public:
-    STrack(const Rect<float>& rect, const float& score, const int &label,const int& max_history);
+    STrack();
     ~STrack();
 
     const Rect<float>& getRect() const;
@@ -32,18 +37,37 @@ public:
     const size_t& getStartFrameId() const;
     const size_t& getTrackletLength() const;
 
-    void activate(const size_t& frame_id, const size_t& track_id);
-    void reActivate(const STrack &new_track, const size_t &frame_id, const int &new_track_id = -1);
+    /**
+     * Reset this slot for a new track started from a detection.
+     */
+    void reset(const Rect<float>& rect, const float& score, const int &label, const int& max_history);
 
-    void predict();
-    void update(const STrack &new_track, const size_t &frame_id);
+    void activate(const size_t& frame_id, const size_t& track_id);
+    void reActivate(const float &score, const size_t &frame_id);
+    void update(const float &score, const size_t &frame_id);
 
     void markAsLost();
     void markAsRemoved();
 
-    std::deque<Object> &get_rect_history()
+    /**
+     * Set rect from the Kalman mean (x, y, a, h) and append it to history.
+     */
+    void updateRect(const float &x, const float &y, const float &a, const float &h);
+
+    size_t historySize() const
+    {
+        return history_size_;
+    }
+
+    /**
+     * History item, 0 is the oldest one.
+     */
+    const Object &history(const size_t &i) const
     {
-        return rect_history_;
+        size_t idx = history_head_ + i;
+        if (idx >= history_.size())
+            idx -= history_.size();
+        return history_[idx];
     }
 
     bool getLost() const
@@ -57,24 +81,19 @@ public:
     }
 
 private:
-    KalmanFilter kalman_filter_;
-    KalmanFilter::StateMean mean_;
-    KalmanFilter::StateCov covariance_;
-
     Rect<float> rect_;
-    std::deque<Object> rect_history_;
+    std::vector<Object> history_;
+    size_t history_head_;
+    size_t history_size_;
     STrackState state_;
 
     bool is_activated_;
     float score_;
     int label_;
-    int max_history_;
     size_t track_id_;
     size_t frame_id_;
     size_t start_frame_id_;
     size_t tracklet_len_;
     bool lost_;
-
-    void updateRect();
 };
-}
\ No newline at end of file
+}
@@ -1,8 +1,39 @@
 #pragma once
 
 #include <cstddef>
+#include <memory>
+#include <vector>
 
 namespace byte_track
 {
+/**
+ * Scratch buffers of lapjv_internal, keep one instance alive across calls
+ * so solving a frame's assignment does not touch the heap once it has grown.
+ */
+struct LapjvWorkspace
+{
+    std::vector<int> free_rows;
+    std::vector<int> pred;
+    std::vector<int> cols;
+    std::vector<double> v;
+    std::vector<double> d;
+    std::unique_ptr<bool[]> unique;
+    size_t capacity = 0;
+
+    void reserve(const size_t n)
+    {
+        if (n <= capacity)
+            return;
+        free_rows.resize(n);
+        pred.resize(n);
+        cols.resize(n);
+        v.resize(n);
+        d.resize(n);
+        unique.reset(new bool[n]);
+        capacity = n;
+    }
+};
+
 int lapjv_internal(const size_t n, double *cost[], int *x, int *y);
-}
\ No newline at end of file
+int lapjv_internal(const size_t n, double *cost[], int *x, int *y, LapjvWorkspace &workspace);
+}
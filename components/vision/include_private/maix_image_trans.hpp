@@ -17,6 +17,7 @@ namespace maix
         err::Err set_format(image::Format fmt, int quality = 95);
         image::Format get_format() { return _fmt; }
         void set_quality(const int quality) { _quality = quality; }
+        int get_quality() { return _quality; }
 
     private:
         void *_handle;
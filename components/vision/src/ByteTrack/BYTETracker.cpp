@@ -1,9 +1,8 @@
 #include "ByteTrack/BYTETracker.h"
 
+#include <algorithm>
 #include <cstddef>
 #include <limits>
-#include <map>
-#include <memory>
 #include <stdexcept>
 #include <utility>
 #include <vector>
@@ -11,7 +10,7 @@
 byte_track::BYTETracker::BYTETracker(const int& max_lost_buff_num,
                                      const float& track_thresh,  // 持续跟踪
                                      const float& high_thresh,   // 增加新 id
-                                     const float& match_thresh,  // 
+                                     const float& match_thresh,  //
                                      const int& max_history) :
     track_thresh_(track_thresh),
     high_thresh_(high_thresh),
@@ -19,7 +18,9 @@ byte_track::BYTETracker::BYTETracker(const int& max_lost_buff_num,
     max_history_(max_history),
     max_time_lost_(static_cast<size_t>(max_lost_buff_num)),
     frame_id_(0),
-    track_id_count_(0)
+    track_id_count_(0),
+    kalman_filter_(),
+    objects_(nullptr)
 {
 }
 
@@ -27,571 +28,481 @@ byte_track::BYTETracker::~BYTETracker()
 {
 }
 
-std::vector<byte_track::BYTETracker::STrackPtr> byte_track::BYTETracker::update(const std::vector<Object>& objects)
+const std::vector<const byte_track::STrack*>& byte_track::BYTETracker::update(const std::vector<Object>& objects)
 {
     ////////////////// Step 1: Get detections //////////////////
     frame_id_++;
+    objects_ = &objects;
 
-    // Create new STracks using the result of object detection
-    std::vector<STrackPtr> det_stracks;
-    std::vector<STrackPtr> det_low_stracks;
-
-    for (const auto &object : objects)
+    // Split detections by score, only indices, new tracks are created from them in step 4
+    det_high_.clear();
+    det_low_.clear();
+    for (size_t i = 0; i < objects.size(); i++)
     {
-        const auto strack = std::make_shared<STrack>(object.rect, object.prob, object.label, max_history_);
-        if (object.prob >= track_thresh_)
+        if (objects[i].prob >= track_thresh_)
         {
-            det_stracks.push_back(strack);
+            det_high_.push_back(i);
         }
         else
         {
-            det_low_stracks.push_back(strack);
+            det_low_.push_back(i);
         }
     }
 
     // Create lists of existing STrack
-    std::vector<STrackPtr> active_stracks;
-    std::vector<STrackPtr> non_active_stracks;
-    std::vector<STrackPtr> strack_pool;
-
-    for (const auto& tracked_strack : tracked_stracks_)
+    active_.clear();
+    non_active_.clear();
+    for (const auto &slot : tracked_stracks_)
     {
-        if (!tracked_strack->isActivated())
+        if (!stracks_[slot].isActivated())
         {
-            non_active_stracks.push_back(tracked_strack);
+            non_active_.push_back(slot);
         }
         else
         {
-            active_stracks.push_back(tracked_strack);
+            active_.push_back(slot);
         }
     }
 
-    strack_pool = jointStracks(active_stracks, lost_stracks_);
+    // tracked and lost lists never share a track
+    pool_.assign(active_.begin(), active_.end());
+    pool_.insert(pool_.end(), lost_stracks_.begin(), lost_stracks_.end());
 
-    // Predict current pose by KF
-    for (auto &strack : strack_pool)
+    // Predict current pose by KF, all pool tracks in one pass
+    predict_mask_.assign(kalman_filter_.size(), 0);
+    for (const auto &slot : pool_)
     {
-        strack->predict();
-    }
-
-    ////////////////// Step 2: First association, with IoU //////////////////
-    std::vector<STrackPtr> current_tracked_stracks;
-    std::vector<STrackPtr> remain_tracked_stracks;
-    std::vector<STrackPtr> remain_det_stracks;
-    std::vector<STrackPtr> refind_stracks;
-
-    {
-        std::vector<std::vector<int>> matches_idx;
-        std::vector<int> unmatch_detection_idx, unmatch_track_idx;
-
-        const auto dists = calcIouDistance(strack_pool, det_stracks);
-        linearAssignment(dists, strack_pool.size(), det_stracks.size(), match_thresh_,
-                         matches_idx, unmatch_track_idx, unmatch_detection_idx);
-
-        for (const auto &match_idx : matches_idx)
-        {
-            const auto track = strack_pool[match_idx[0]];
-            const auto det = det_stracks[match_idx[1]];
-            if (track->getSTrackState() == STrackState::Tracked)
-            {
-                track->update(*det, frame_id_);
-                current_tracked_stracks.push_back(track);
-            }
-            else
-            {
-                track->reActivate(*det, frame_id_);
-                refind_stracks.push_back(track);
-            }
-        }
-
-        for (const auto &unmatch_idx : unmatch_detection_idx)
+        if (stracks_[slot].getSTrackState() != STrackState::Tracked)
         {
-            remain_det_stracks.push_back(det_stracks[unmatch_idx]);
-        }
-
-        for (const auto &unmatch_idx : unmatch_track_idx)
-        {
-            if (strack_pool[unmatch_idx]->getSTrackState() == STrackState::Tracked)
-            {
-                remain_tracked_stracks.push_back(strack_pool[unmatch_idx]);
-            }
+            kalman_filter_.clearHeightVelocity(slot);
         }
+        predict_mask_[slot] = 1;
     }
+    kalman_filter_.predict(predict_mask_.data());
 
-    ////////////////// Step 3: Second association, using low score dets //////////////////
-    std::vector<STrackPtr> current_lost_stracks;
-
-    {
-        std::vector<std::vector<int>> matches_idx;
-        std::vector<int> unmatch_track_idx, unmatch_detection_idx;
+    ////////////////// Step 2: First association, with IoU //////////////////
+    current_tracked_.clear();
+    remain_tracked_.clear();
+    remain_det_.clear();
+    refind_.clear();
 
-        const auto dists = calcIouDistance(remain_tracked_stracks, det_low_stracks);
-        linearAssignment(dists, remain_tracked_stracks.size(), det_low_stracks.size(), 0.5,
-                         matches_idx, unmatch_track_idx, unmatch_detection_idx);
+    gatherTrackBoxes(pool_, a_boxes_);
+    gatherDetBoxes(det_high_, b_boxes_);
+    calcIouDistance(a_boxes_, b_boxes_);
+    linearAssignment(pool_.size(), det_high_.size(), match_thresh_);
 
-        for (const auto &match_idx : matches_idx)
+    for (const auto &match : matches_)
+    {
+        const size_t slot = pool_[match.first];
+        if (stracks_[slot].getSTrackState() == STrackState::Tracked)
         {
-            const auto track = remain_tracked_stracks[match_idx[0]];
-            const auto det = det_low_stracks[match_idx[1]];
-            if (track->getSTrackState() == STrackState::Tracked)
-            {
-                track->update(*det, frame_id_);
-                current_tracked_stracks.push_back(track);
-            }
-            else
-            {
-                track->reActivate(*det, frame_id_);
-                refind_stracks.push_back(track);
-            }
+            updateTrack(slot, det_high_[match.second], false);
+            current_tracked_.push_back(slot);
         }
-
-        for (const auto &unmatch_track : unmatch_track_idx)
+        else
         {
-            const auto track = remain_tracked_stracks[unmatch_track];
-            if (track->getSTrackState() != STrackState::Lost)
-            {
-                track->markAsLost();
-                current_lost_stracks.push_back(track);
-            }
+            updateTrack(slot, det_high_[match.second], true);
+            refind_.push_back(slot);
         }
     }
 
-    ////////////////// Step 4: Init new stracks //////////////////
-    std::vector<STrackPtr> current_removed_stracks;
-
+    for (const auto &unmatch_idx : b_unmatched_)
     {
-        std::vector<int> unmatch_detection_idx;
-        std::vector<int> unmatch_unconfirmed_idx;
-        std::vector<std::vector<int>> matches_idx;
-
-        // Deal with unconfirmed tracks, usually tracks with only one beginning frame
-        const auto dists = calcIouDistance(non_active_stracks, remain_det_stracks);
-        linearAssignment(dists, non_active_stracks.size(), remain_det_stracks.size(), 0.7,
-                         matches_idx, unmatch_unconfirmed_idx, unmatch_detection_idx);
-
-        for (const auto &match_idx : matches_idx)
-        {
-            non_active_stracks[match_idx[0]]->update(*remain_det_stracks[match_idx[1]], frame_id_);
-            current_tracked_stracks.push_back(non_active_stracks[match_idx[0]]);
-        }
-
-        for (const auto &unmatch_idx : unmatch_unconfirmed_idx)
-        {
-            const auto track = non_active_stracks[unmatch_idx];
-            track->markAsRemoved();
-            current_removed_stracks.push_back(track);
-        }
-
-        // Add new stracks
-        for (const auto &unmatch_idx : unmatch_detection_idx)
-        {
-            const auto track = remain_det_stracks[unmatch_idx];
-            if (track->getScore() < high_thresh_)
-            {
-                continue;
-            }
-            track_id_count_++;
-            track->activate(frame_id_, track_id_count_);
-            current_tracked_stracks.push_back(track);
-        }
+        remain_det_.push_back(det_high_[unmatch_idx]);
     }
 
-    ////////////////// Step 5: Update state //////////////////
-    for (const auto &lost_strack : lost_stracks_)
+    for (const auto &unmatch_idx : a_unmatched_)
     {
-        if (frame_id_ - lost_strack->getFrameId() > max_time_lost_)
+        if (stracks_[pool_[unmatch_idx]].getSTrackState() == STrackState::Tracked)
         {
-            lost_strack->markAsRemoved();
-            current_removed_stracks.push_back(lost_strack);
+            remain_tracked_.push_back(pool_[unmatch_idx]);
         }
     }
 
-    tracked_stracks_ = jointStracks(current_tracked_stracks, refind_stracks);
-    lost_stracks_ = subStracks(jointStracks(subStracks(lost_stracks_, tracked_stracks_), current_lost_stracks), current_removed_stracks);
-    // lost_stracks_ = subStracks(jointStracks(subStracks(lost_stracks_, tracked_stracks_), current_lost_stracks), removed_stracks_);
-    // removed_stracks_ = jointStracks(removed_stracks_, current_removed_stracks);
+    ////////////////// Step 3: Second association, using low score dets //////////////////
+    current_lost_.clear();
 
-    std::vector<STrackPtr> tracked_stracks_out, lost_stracks_out;
-    removeDuplicateStracks(tracked_stracks_, lost_stracks_, tracked_stracks_out, lost_stracks_out);
-    tracked_stracks_ = tracked_stracks_out;
-    lost_stracks_ = lost_stracks_out;
+    gatherTrackBoxes(remain_tracked_, a_boxes_);
+    gatherDetBoxes(det_low_, b_boxes_);
+    calcIouDistance(a_boxes_, b_boxes_);
+    linearAssignment(remain_tracked_.size(), det_low_.size(), 0.5);
 
-    std::vector<STrackPtr> output_stracks;
-    for (const auto &track : tracked_stracks_)
-    {
-        if (track->isActivated())
-        {
-            track->setLost(false);
-            output_stracks.push_back(track);
-        }
-    }
-    for (const auto &track : lost_stracks_)
+    // remain tracks are all in Tracked state
+    for (const auto &match : matches_)
     {
-        if (track->isActivated())
-        {
-            track->setLost(true);
-            output_stracks.push_back(track);
-        }
-    }
-    return output_stracks;
-}
-std::vector<byte_track::BYTETracker::STrackPtr> byte_track::BYTETracker::jointStracks(const std::vector<STrackPtr> &a_tlist,
-                                                                                      const std::vector<STrackPtr> &b_tlist) const
-{
-    std::map<int, int> exists;
-    std::vector<STrackPtr> res;
-    for (size_t i = 0; i < a_tlist.size(); i++)
-    {
-        exists.emplace(a_tlist[i]->getTrackId(), 1);
-        res.push_back(a_tlist[i]);
-    }
-    for (size_t i = 0; i < b_tlist.size(); i++)
-    {
-        const int &tid = b_tlist[i]->getTrackId();
-        if (!exists[tid] || exists.count(tid) == 0)
-        {
-            exists[tid] = 1;
-            res.push_back(b_tlist[i]);
-        }
+        const size_t slot = remain_tracked_[match.first];
+        updateTrack(slot, det_low_[match.second], false);
+        current_tracked_.push_back(slot);
     }
-    return res;
-}
 
-std::vector<byte_track::BYTETracker::STrackPtr> byte_track::BYTETracker::subStracks(const std::vector<STrackPtr> &a_tlist,
-                                                                                    const std::vector<STrackPtr> &b_tlist) const
-{
-    std::map<int, STrackPtr> stracks;
-    for (size_t i = 0; i < a_tlist.size(); i++)
+    for (const auto &unmatch_idx : a_unmatched_)
     {
-        stracks.emplace(a_tlist[i]->getTrackId(), a_tlist[i]);
+        const size_t slot = remain_tracked_[unmatch_idx];
+        stracks_[slot].markAsLost();
+        current_lost_.push_back(slot);
     }
 
-    for (size_t i = 0; i < b_tlist.size(); i++)
+    ////////////////// Step 4: Init new stracks //////////////////
+    // Deal with unconfirmed tracks, usually tracks with only one beginning frame
+    gatherTrackBoxes(non_active_, a_boxes_);
+    gatherDetBoxes(remain_det_, b_boxes_);
+    calcIouDistance(a_boxes_, b_boxes_);
+    linearAssignment(non_active_.size(), remain_det_.size(), 0.7);
+
+    for (const auto &match : matches_)
     {
-        const int &tid = b_tlist[i]->getTrackId();
-        if (stracks.count(tid) != 0)
-        {
-            stracks.erase(tid);
-        }
+        const size_t slot = non_active_[match.first];
+        updateTrack(slot, remain_det_[match.second], false);
+        current_tracked_.push_back(slot);
     }
 
-    std::vector<STrackPtr> res;
-    std::map<int, STrackPtr>::iterator it;
-    for (it = stracks.begin(); it != stracks.end(); ++it)
+    for (const auto &unmatch_idx : a_unmatched_)
     {
-        res.push_back(it->second);
+        stracks_[non_active_[unmatch_idx]].markAsRemoved();
     }
 
-    return res;
-}
-
-void byte_track::BYTETracker::removeDuplicateStracks(const std::vector<STrackPtr> &a_stracks,
-                                                     const std::vector<STrackPtr> &b_stracks,
-                                                     std::vector<STrackPtr> &a_res,
-                                                     std::vector<STrackPtr> &b_res) const
-{
-    const auto ious = calcIouDistance(a_stracks, b_stracks);
-
-    std::vector<std::pair<size_t, size_t>> overlapping_combinations;
-    for (size_t i = 0; i < ious.size(); i++)
+    // Add new stracks
+    for (const auto &unmatch_idx : b_unmatched_)
     {
-        for (size_t j = 0; j < ious[i].size(); j++)
+        const Object &det = objects[remain_det_[unmatch_idx]];
+        if (det.prob < high_thresh_)
         {
-            if (ious[i][j] < 0.15)
-            {
-                overlapping_combinations.emplace_back(i, j);
-            }
+            continue;
         }
+        const size_t slot = allocSlot();
+        STrack &track = stracks_[slot];
+        track.reset(det.rect, det.prob, det.label, max_history_);
+        kalman_filter_.initiate(slot, det.rect.getXyah());
+        track.updateRect(kalman_filter_.mean(slot, 0), kalman_filter_.mean(slot, 1),
+                         kalman_filter_.mean(slot, 2), kalman_filter_.mean(slot, 3));
+        track_id_count_++;
+        track.activate(frame_id_, track_id_count_);
+        current_tracked_.push_back(slot);
     }
 
-    std::vector<bool> a_overlapping(a_stracks.size(), false), b_overlapping(b_stracks.size(), false);
-    for (const auto &[a_idx, b_idx] : overlapping_combinations)
+    ////////////////// Step 5: Update state //////////////////
+    for (const auto &slot : lost_stracks_)
     {
-        const int timep = a_stracks[a_idx]->getFrameId() - a_stracks[a_idx]->getStartFrameId();
-        const int timeq = b_stracks[b_idx]->getFrameId() - b_stracks[b_idx]->getStartFrameId();
-        if (timep > timeq)
-        {
-            b_overlapping[b_idx] = true;
-        }
-        else
+        STrack &track = stracks_[slot];
+        if (track.getSTrackState() == STrackState::Lost && frame_id_ - track.getFrameId() > max_time_lost_)
         {
-            a_overlapping[a_idx] = true;
+            track.markAsRemoved();
         }
     }
 
-    for (size_t ai = 0; ai < a_stracks.size(); ai++)
+    tracked_stracks_.assign(current_tracked_.begin(), current_tracked_.end());
+    tracked_stracks_.insert(tracked_stracks_.end(), refind_.begin(), refind_.end());
+
+    // Refound lost tracks are Tracked now and expired ones Removed, what is left stays lost.
+    // Lost list is ordered by track id.
+    size_t lost_num = 0;
+    for (const auto &slot : lost_stracks_)
     {
-        if (!a_overlapping[ai])
+        if (stracks_[slot].getSTrackState() == STrackState::Lost)
         {
-            a_res.push_back(a_stracks[ai]);
+            lost_stracks_[lost_num++] = slot;
         }
     }
+    lost_stracks_.resize(lost_num);
+    lost_stracks_.insert(lost_stracks_.end(), current_lost_.begin(), current_lost_.end());
+    std::sort(lost_stracks_.begin(), lost_stracks_.end(), [this](const size_t &a, const size_t &b) {
+        return stracks_[a].getTrackId() < stracks_[b].getTrackId();
+    });
 
-    for (size_t bi = 0; bi < b_stracks.size(); bi++)
+    removeDuplicateStracks();
+
+    // Recycle slots not referenced by any list any more
+    std::fill(slot_used_.begin(), slot_used_.end(), 0);
+    for (const auto &slot : tracked_stracks_)
     {
-        if (!b_overlapping[bi])
-        {
-            b_res.push_back(b_stracks[bi]);
-        }
+        slot_used_[slot] = 1;
     }
-}
-
-void byte_track::BYTETracker::linearAssignment(const std::vector<std::vector<float>> &cost_matrix,
-                                               const int &cost_matrix_size,
-                                               const int &cost_matrix_size_size,
-                                               const float &thresh,
-                                               std::vector<std::vector<int>> &matches,
-                                               std::vector<int> &a_unmatched,
-                                               std::vector<int> &b_unmatched) const
-{
-    if (cost_matrix.size() == 0)
+    for (const auto &slot : lost_stracks_)
     {
-        for (int i = 0; i < cost_matrix_size; i++)
-        {
-            a_unmatched.push_back(i);
-        }
-        for (int i = 0; i < cost_matrix_size_size; i++)
+        slot_used_[slot] = 1;
+    }
+    free_slots_.clear();
+    for (size_t slot = slot_used_.size(); slot > 0; slot--)
+    {
+        if (!slot_used_[slot - 1])
         {
-            b_unmatched.push_back(i);
+            free_slots_.push_back(slot - 1);
         }
-        return;
     }
 
-    std::vector<int> rowsol; std::vector<int> colsol;
-    execLapjv(cost_matrix, rowsol, colsol, true, thresh);
-    for (size_t i = 0; i < rowsol.size(); i++)
+    output_stracks_.clear();
+    for (const auto &slot : tracked_stracks_)
     {
-        if (rowsol[i] >= 0)
+        STrack &track = stracks_[slot];
+        if (track.isActivated())
         {
-            std::vector<int> match;
-            match.push_back(i);
-            match.push_back(rowsol[i]);
-            matches.push_back(match);
-        }
-        else
-        {
-            a_unmatched.push_back(i);
+            track.setLost(false);
+            output_stracks_.push_back(&track);
         }
     }
-
-    for (size_t i = 0; i < colsol.size(); i++)
+    for (const auto &slot : lost_stracks_)
     {
-        if (colsol[i] < 0)
+        STrack &track = stracks_[slot];
+        if (track.isActivated())
         {
-            b_unmatched.push_back(i);
+            track.setLost(true);
+            output_stracks_.push_back(&track);
         }
     }
+    objects_ = nullptr;
+    return output_stracks_;
 }
 
-std::vector<std::vector<float>> byte_track::BYTETracker::calcIous(const std::vector<Rect<float>> &a_rect,
-                                                                  const std::vector<Rect<float>> &b_rect) const
+size_t byte_track::BYTETracker::allocSlot()
 {
-    std::vector<std::vector<float>> ious;
-    if (a_rect.size() * b_rect.size() == 0)
-    {
-        return ious;
-    }
+    if (!free_slots_.empty())
+    {
+        const size_t slot = free_slots_.back();
+        free_slots_.pop_back();
+        slot_used_[slot] = 1;
+        return slot;
+    }
+    const size_t slot = stracks_.size();
+    stracks_.emplace_back();
+    slot_used_.push_back(1);
+    kalman_filter_.resize(slot + 1);
+    return slot;
+}
 
-    ious.resize(a_rect.size());
-    for (size_t i = 0; i < ious.size(); i++)
+void byte_track::BYTETracker::updateTrack(const size_t &slot, const size_t &det, const bool &reactivate)
+{
+    const Object &obj = (*objects_)[det];
+    STrack &track = stracks_[slot];
+    kalman_filter_.update(slot, obj.rect.getXyah());
+    // history records the score before this update, as the original implementation did
+    track.updateRect(kalman_filter_.mean(slot, 0), kalman_filter_.mean(slot, 1),
+                     kalman_filter_.mean(slot, 2), kalman_filter_.mean(slot, 3));
+    if (reactivate)
     {
-        ious[i].resize(b_rect.size());
+        track.reActivate(obj.prob, frame_id_);
     }
-
-    for (size_t bi = 0; bi < b_rect.size(); bi++)
+    else
     {
-        for (size_t ai = 0; ai < a_rect.size(); ai++)
-        {
-            ious[ai][bi] = b_rect[bi].calcIoU(a_rect[ai]);
-        }
+        track.update(obj.prob, frame_id_);
     }
-    return ious;
 }
 
-std::vector<std::vector<float> > byte_track::BYTETracker::calcIouDistance(const std::vector<STrackPtr> &a_tracks,
-                                                                          const std::vector<STrackPtr> &b_tracks) const
+void byte_track::BYTETracker::Boxes::clear()
 {
-    std::vector<byte_track::Rect<float>> a_rects, b_rects;
-    for (size_t i = 0; i < a_tracks.size(); i++)
-    {
-        a_rects.push_back(a_tracks[i]->getRect());
-    }
+    x1.clear();
+    y1.clear();
+    x2.clear();
+    y2.clear();
+    area.clear();
+}
+
+void byte_track::BYTETracker::Boxes::push_back(const Rect<float> &rect)
+{
+    x1.push_back(rect.tl_x());
+    y1.push_back(rect.tl_y());
+    x2.push_back(rect.br_x());
+    y2.push_back(rect.br_y());
+    area.push_back((rect.width() + 1) * (rect.height() + 1));
+}
 
-    for (size_t i = 0; i < b_tracks.size(); i++)
+void byte_track::BYTETracker::gatherTrackBoxes(const std::vector<size_t> &slots, Boxes &boxes) const
+{
+    boxes.clear();
+    for (const auto &slot : slots)
     {
-        b_rects.push_back(b_tracks[i]->getRect());
+        boxes.push_back(stracks_[slot].getRect());
     }
+}
 
-    const auto ious = calcIous(a_rects, b_rects);
-
-    std::vector<std::vector<float>> cost_matrix;
-    for (size_t i = 0; i < ious.size(); i++)
+void byte_track::BYTETracker::gatherDetBoxes(const std::vector<size_t> &dets, Boxes &boxes) const
+{
+    boxes.clear();
+    for (const auto &det : dets)
     {
-        std::vector<float> iou;
-        for (size_t j = 0; j < ious[i].size(); j++)
-        {
-            iou.push_back(1 - ious[i][j]);
-        }
-        cost_matrix.push_back(iou);
+        boxes.push_back((*objects_)[det].rect);
     }
-
-    return cost_matrix;
 }
 
-double byte_track::BYTETracker::execLapjv(const std::vector<std::vector<float>> &cost,
-                                          std::vector<int> &rowsol,
-                                          std::vector<int> &colsol,
-                                          bool extend_cost,
-                                          float cost_limit,
-                                          bool return_cost) const
+void byte_track::BYTETracker::removeDuplicateStracks()
 {
-    std::vector<std::vector<float> > cost_c;
-    cost_c.assign(cost.begin(), cost.end());
-
-    std::vector<std::vector<float> > cost_c_extended;
+    gatherTrackBoxes(tracked_stracks_, a_boxes_);
+    gatherTrackBoxes(lost_stracks_, b_boxes_);
+    calcIouDistance(a_boxes_, b_boxes_);
 
-    int n_rows = cost.size();
-    int n_cols = cost[0].size();
-    rowsol.resize(n_rows);
-    colsol.resize(n_cols);
-
-    int n = 0;
-    if (n_rows == n_cols)
-    {
-        n = n_rows;
-    }
-    else
+    const size_t a_num = tracked_stracks_.size();
+    const size_t b_num = lost_stracks_.size();
+    // keep_ holds a flags then b flags
+    keep_.assign(a_num + b_num, 1);
+    for (size_t i = 0; i < a_num; i++)
     {
-        if (!extend_cost)
+        if (row_min_[i] >= 0.15f)
         {
-            throw std::runtime_error("The `extend_cost` variable should set True");
+            continue;
         }
-    }
-
-    if (extend_cost || cost_limit < std::numeric_limits<float>::max())
-    {
-        n = n_rows + n_cols;
-        cost_c_extended.resize(n);
-        for (size_t i = 0; i < cost_c_extended.size(); i++)
-            cost_c_extended[i].resize(n);
-
-        if (cost_limit < std::numeric_limits<float>::max())
+        const float *row = cost_.data() + i * b_num;
+        for (size_t j = 0; j < b_num; j++)
         {
-            for (size_t i = 0; i < cost_c_extended.size(); i++)
+            if (row[j] < 0.15f)
             {
-                for (size_t j = 0; j < cost_c_extended[i].size(); j++)
+                const STrack &a = stracks_[tracked_stracks_[i]];
+                const STrack &b = stracks_[lost_stracks_[j]];
+                const int timep = a.getFrameId() - a.getStartFrameId();
+                const int timeq = b.getFrameId() - b.getStartFrameId();
+                if (timep > timeq)
                 {
-                    cost_c_extended[i][j] = cost_limit / 2.0;
+                    keep_[a_num + j] = 0;
                 }
-            }
-        }
-        else
-        {
-            float cost_max = -1;
-            for (size_t i = 0; i < cost_c.size(); i++)
-            {
-                for (size_t j = 0; j < cost_c[i].size(); j++)
+                else
                 {
-                    if (cost_c[i][j] > cost_max)
-                        cost_max = cost_c[i][j];
-                }
-            }
-            for (size_t i = 0; i < cost_c_extended.size(); i++)
-            {
-                for (size_t j = 0; j < cost_c_extended[i].size(); j++)
-                {
-                    cost_c_extended[i][j] = cost_max + 1;
+                    keep_[i] = 0;
                 }
             }
         }
+    }
 
-        for (size_t i = n_rows; i < cost_c_extended.size(); i++)
-        {
-            for (size_t j = n_cols; j < cost_c_extended[i].size(); j++)
-            {
-                cost_c_extended[i][j] = 0;
-            }
-        }
-        for (int i = 0; i < n_rows; i++)
+    size_t n = 0;
+    for (size_t i = 0; i < a_num; i++)
+    {
+        if (keep_[i])
         {
-            for (int j = 0; j < n_cols; j++)
-            {
-                cost_c_extended[i][j] = cost_c[i][j];
-            }
+            tracked_stracks_[n++] = tracked_stracks_[i];
         }
-
-        cost_c.clear();
-        cost_c.assign(cost_c_extended.begin(), cost_c_extended.end());
     }
-
-    double **cost_ptr;
-    cost_ptr = new double *[sizeof(double *) * n];
-    for (int i = 0; i < n; i++)
-        cost_ptr[i] = new double[sizeof(double) * n];
-
-    for (int i = 0; i < n; i++)
+    tracked_stracks_.resize(n);
+    n = 0;
+    for (size_t j = 0; j < b_num; j++)
     {
-        for (int j = 0; j < n; j++)
+        if (keep_[a_num + j])
         {
-            cost_ptr[i][j] = cost_c[i][j];
+            lost_stracks_[n++] = lost_stracks_[j];
         }
     }
+    lost_stracks_.resize(n);
+}
 
-    int* x_c = new int[sizeof(int) * n];
-    int *y_c = new int[sizeof(int) * n];
-
-    int ret = lapjv_internal(n, cost_ptr, x_c, y_c);
-    if (ret != 0)
-    {
-        throw std::runtime_error("The result of lapjv_internal() is invalid.");
+void byte_track::BYTETracker::calcIouDistance(const Boxes &a, const Boxes &b)
+{
+    const size_t rows = a.size();
+    const size_t cols = b.size();
+    cost_.resize(rows * cols);
+    row_min_.assign(rows, std::numeric_limits<float>::max());
+    col_min_.assign(cols, std::numeric_limits<float>::max());
+
+    const float *__restrict bx1 = b.x1.data();
+    const float *__restrict by1 = b.y1.data();
+    const float *__restrict bx2 = b.x2.data();
+    const float *__restrict by2 = b.y2.data();
+    const float *__restrict barea = b.area.data();
+    float *__restrict col_min = col_min_.data();
+    for (size_t i = 0; i < rows; i++)
+    {
+        const float ax1 = a.x1[i], ay1 = a.y1[i], ax2 = a.x2[i], ay2 = a.y2[i], aarea = a.area[i];
+        float *__restrict row = cost_.data() + i * cols;
+        float row_min = std::numeric_limits<float>::max();
+        // branch free so it vectorizes, boxes without overlap get zero intersection
+        for (size_t j = 0; j < cols; j++)
+        {
+            const float iw = std::max(std::min(ax2, bx2[j]) - std::max(ax1, bx1[j]) + 1, 0.f);
+            const float ih = std::max(std::min(ay2, by2[j]) - std::max(ay1, by1[j]) + 1, 0.f);
+            const float inter = iw * ih;
+            const float cost = 1 - inter / (aarea + barea[j] - inter);
+            row[j] = cost;
+            row_min = std::min(row_min, cost);
+            col_min[j] = std::min(col_min[j], cost);
+        }
+        row_min_[i] = row_min;
     }
+}
 
-    double opt = 0.0;
-
-    if (n != n_rows)
-    {
-        for (int i = 0; i < n; i++)
-        {
-            if (x_c[i] >= n_cols)
-                x_c[i] = -1;
-            if (y_c[i] >= n_rows)
-                y_c[i] = -1;
-        }
-        for (int i = 0; i < n_rows; i++)
-        {
-            rowsol[i] = x_c[i];
+void byte_track::BYTETracker::linearAssignment(const size_t &rows, const size_t &cols, const float &thresh)
+{
+    matches_.clear();
+    a_unmatched_.clear();
+    b_unmatched_.clear();
+    row_sol_.assign(rows, -1);
+    col_sol_.assign(cols, -1);
+
+    // Gating: a pair costs more than thresh is worse than leaving both unmatched,
+    // so rows or cols without any cheaper pair can not be matched, solve only the rest.
+    gated_rows_.clear();
+    gated_cols_.clear();
+    for (size_t i = 0; i < rows; i++)
+    {
+        if (row_min_[i] <= thresh)
+            gated_rows_.push_back(i);
+    }
+    for (size_t j = 0; j < cols; j++)
+    {
+        if (col_min_[j] <= thresh)
+            gated_cols_.push_back(j);
+    }
+
+    const size_t n_rows = gated_rows_.size();
+    const size_t n_cols = gated_cols_.size();
+    if (n_rows > 0 && n_cols > 0)
+    {
+        // Extend to square: real rows to dummy cols and dummy rows to real cols cost thresh / 2,
+        // dummy to dummy costs 0.
+        const size_t n = n_rows + n_cols;
+        lap_cost_.resize(n * n);
+        lap_rows_.resize(n);
+        lap_x_.resize(n);
+        lap_y_.resize(n);
+        const double half_limit = thresh / 2.0;
+        for (size_t i = 0; i < n; i++)
+        {
+            double *row = lap_cost_.data() + i * n;
+            lap_rows_[i] = row;
+            if (i < n_rows)
+            {
+                const float *cost_row = cost_.data() + gated_rows_[i] * cols;
+                for (size_t j = 0; j < n_cols; j++)
+                {
+                    row[j] = cost_row[gated_cols_[j]];
+                }
+                std::fill(row + n_cols, row + n, half_limit);
+            }
+            else
+            {
+                std::fill(row, row + n_cols, half_limit);
+                std::fill(row + n_cols, row + n, 0.0);
+            }
         }
-        for (int i = 0; i < n_cols; i++)
+
+        int ret = lapjv_internal(n, lap_rows_.data(), lap_x_.data(), lap_y_.data(), lap_workspace_);
+        if (ret != 0)
         {
-            colsol[i] = y_c[i];
+            throw std::runtime_error("The result of lapjv_internal() is invalid.");
         }
 
-        if (return_cost)
+        for (size_t i = 0; i < n_rows; i++)
         {
-            for (size_t i = 0; i < rowsol.size(); i++)
+            const int j = lap_x_[i];
+            if (j >= 0 && static_cast<size_t>(j) < n_cols)
             {
-                if (rowsol[i] != -1)
-                {
-                    opt += cost_ptr[i][rowsol[i]];
-                }
+                row_sol_[gated_rows_[i]] = gated_cols_[j];
+                col_sol_[gated_cols_[j]] = gated_rows_[i];
             }
         }
     }
-    else if (return_cost)
+
+    for (size_t i = 0; i < rows; i++)
     {
-        for (size_t i = 0; i < rowsol.size(); i++)
+        if (row_sol_[i] >= 0)
+        {
+            matches_.emplace_back(i, static_cast<size_t>(row_sol_[i]));
+        }
+        else
         {
-            opt += cost_ptr[i][rowsol[i]];
+            a_unmatched_.push_back(i);
         }
     }
 
-    for (int i = 0; i < n; i++)
+    for (size_t j = 0; j < cols; j++)
     {
-        delete[]cost_ptr[i];
+        if (col_sol_[j] < 0)
+        {
+            b_unmatched_.push_back(j);
+        }
     }
-    delete[]cost_ptr;
-    delete[]x_c;
-    delete[]y_c;
-
-    return opt;
 }
@@ -2,88 +2,128 @@
 
 #include <cstddef>
 
+namespace
+{
+// std of the aspect ratio does not scale with height
+constexpr float aspect_position_var = 1e-2f * 1e-2f;
+constexpr float aspect_velocity_var = 1e-5f * 1e-5f;
+constexpr float aspect_measure_var = 1e-1f * 1e-1f;
+constexpr size_t aspect_dim = 2;
+constexpr size_t height_dim = 3;
+}
+
 byte_track::KalmanFilter::KalmanFilter(const float& std_weight_position,
                                        const float& std_weight_velocity) :
     std_weight_position_(std_weight_position),
-    std_weight_velocity_(std_weight_velocity)
+    std_weight_velocity_(std_weight_velocity),
+    size_(0)
 {
-    constexpr size_t ndim = 4;
-    constexpr float dt = 1;
-
-    motion_mat_ = Eigen::MatrixXf::Identity(8, 8);
-    update_mat_ = Eigen::MatrixXf::Identity(4, 8);
+}
 
+void byte_track::KalmanFilter::resize(const size_t& n)
+{
+    if (n <= size_)
+    {
+        return;
+    }
     for (size_t i = 0; i < ndim; i++)
     {
-        motion_mat_(i, ndim + i) = dt;
+        pos_[i].resize(n, 0);
+        vel_[i].resize(n, 0);
+        cov_pp_[i].resize(n, 0);
+        cov_pv_[i].resize(n, 0);
+        cov_vv_[i].resize(n, 0);
     }
+    size_ = n;
 }
 
-void byte_track::KalmanFilter::initiate(StateMean &mean, StateCov &covariance, const DetectBox &measurement)
+void byte_track::KalmanFilter::initiate(const size_t& slot, const DetectBox& measurement)
 {
-    mean.block<1, 4>(0, 0) = measurement.block<1, 4>(0, 0);
-    mean.block<1, 4>(0, 4) = Eigen::Vector4f::Zero();
-
-    StateMean std;
-    std(0) = 2 * std_weight_position_ * measurement[3];
-    std(1) = 2 * std_weight_position_ * measurement[3];
-    std(2) = 1e-2;
-    std(3) = 2 * std_weight_position_ * measurement[3];
-    std(4) = 10 * std_weight_velocity_ * measurement[3];
-    std(5) = 10 * std_weight_velocity_ * measurement[3];
-    std(6) = 1e-5;
-    std(7) = 10 * std_weight_velocity_ * measurement[3];
-
-    StateMean tmp = std.array().square();
-    covariance = tmp.asDiagonal();
-}
-
-void byte_track::KalmanFilter::predict(StateMean &mean, StateCov &covariance)
-{
-    StateMean std;
-    std(0) = std_weight_position_ * mean(3);
-    std(1) = std_weight_position_ * mean(3);
-    std(2) = 1e-2;
-    std(3) = std_weight_position_ * mean(3);
-    std(4) = std_weight_velocity_ * mean(3);
-    std(5) = std_weight_velocity_ * mean(3);
-    std(6) = 1e-5;
-    std(7) = std_weight_velocity_ * mean(3);
-
-    StateMean tmp = std.array().square();
-    StateCov motion_cov = tmp.asDiagonal();
-
-    mean = motion_mat_ * mean.transpose();
-    covariance = motion_mat_ * covariance * (motion_mat_.transpose()) + motion_cov;
+    const float h = measurement[height_dim];
+    const float pos_std = 2 * std_weight_position_ * h;
+    const float vel_std = 10 * std_weight_velocity_ * h;
+    for (size_t i = 0; i < ndim; i++)
+    {
+        pos_[i][slot] = measurement[i];
+        vel_[i][slot] = 0;
+        cov_pp_[i][slot] = i == aspect_dim ? aspect_position_var : pos_std * pos_std;
+        cov_pv_[i][slot] = 0;
+        cov_vv_[i][slot] = i == aspect_dim ? aspect_velocity_var : vel_std * vel_std;
+    }
 }
 
-void byte_track::KalmanFilter::update(StateMean &mean, StateCov &covariance, const DetectBox &measurement)
+void byte_track::KalmanFilter::predict(const unsigned char *mask)
 {
-    StateHMean projected_mean;
-    StateHCov projected_cov;
-    project(projected_mean, projected_cov, mean, covariance);
-
-    Eigen::Matrix<float, 4, 8> B = (covariance * (update_mat_.transpose())).transpose();
-    Eigen::Matrix<float, 8, 4> kalman_gain = (projected_cov.llt().solve(B)).transpose();
-    Eigen::Matrix<float, 1, 4> innovation = measurement - projected_mean;
-
-    const auto tmp = innovation * (kalman_gain.transpose());
-    mean = (mean.array() + tmp.array()).matrix();
-    covariance = covariance - kalman_gain * projected_cov * (kalman_gain.transpose());
+    // x' = x + v, P' = F * P * F^T + Q with F = [[1, 1], [0, 1]] per coordinate.
+    // Height is read before its own update, so process noise uses the prior height like the matrix form did.
+    const size_t n = size_;
+    const float wp2 = std_weight_position_ * std_weight_position_;
+    const float wv2 = std_weight_velocity_ * std_weight_velocity_;
+    const float *height = pos_[height_dim].data();
+    for (size_t i = 0; i < ndim; i++)
+    {
+        float *__restrict p = pos_[i].data();
+        const float *__restrict v = vel_[i].data();
+        float *__restrict pp = cov_pp_[i].data();
+        float *__restrict pv = cov_pv_[i].data();
+        float *__restrict vv = cov_vv_[i].data();
+        if (i == aspect_dim)
+        {
+            for (size_t s = 0; s < n; s++)
+            {
+                const float m = mask[s] ? 1.f : 0.f;
+                p[s] += m * v[s];
+                pp[s] += m * (2 * pv[s] + vv[s] + aspect_position_var);
+                pv[s] += m * vv[s];
+                vv[s] += m * aspect_velocity_var;
+            }
+        }
+        else if (i != height_dim)
+        {
+            for (size_t s = 0; s < n; s++)
+            {
+                const float m = mask[s] ? 1.f : 0.f;
+                const float h2 = height[s] * height[s];
+                p[s] += m * v[s];
+                pp[s] += m * (2 * pv[s] + vv[s] + wp2 * h2);
+                pv[s] += m * vv[s];
+                vv[s] += m * wv2 * h2;
+            }
+        }
+        else
+        {
+            // p aliases height here, keep this loop free of the __restrict height pointer
+            float *hp = pos_[i].data();
+            for (size_t s = 0; s < n; s++)
+            {
+                const float m = mask[s] ? 1.f : 0.f;
+                const float h2 = hp[s] * hp[s];
+                hp[s] += m * v[s];
+                pp[s] += m * (2 * pv[s] + vv[s] + wp2 * h2);
+                pv[s] += m * vv[s];
+                vv[s] += m * wv2 * h2;
+            }
+        }
+    }
 }
 
-void byte_track::KalmanFilter::project(StateHMean &projected_mean, StateHCov &projected_covariance,
-                                       const StateMean& mean, const StateCov& covariance)
+void byte_track::KalmanFilter::update(const size_t& slot, const DetectBox& measurement)
 {
-    DetectBox std;
-    std << std_weight_position_ * mean(3),
-           std_weight_position_ * mean(3),
-           1e-1,
-           std_weight_position_ * mean(3);
-
-    projected_mean = update_mat_ * mean.transpose();
-    projected_covariance = update_mat_ * covariance * (update_mat_.transpose());
-
-    Eigen::Matrix<float, 4, 4> diag = std.asDiagonal();
-    projected_covariance += diag.array().square().matrix();
+    // H = [1, 0] per coordinate, so S = P_pp + R and K = [P_pp, P_pv] / S.
+    const float std_h = std_weight_position_ * pos_[height_dim][slot];
+    const float r = std_h * std_h;
+    for (size_t i = 0; i < ndim; i++)
+    {
+        const float pp = cov_pp_[i][slot];
+        const float pv = cov_pv_[i][slot];
+        const float s = pp + (i == aspect_dim ? aspect_measure_var : r);
+        const float kp = pp / s;
+        const float kv = pv / s;
+        const float innovation = measurement[i] - pos_[i][slot];
+        pos_[i][slot] += kp * innovation;
+        vel_[i][slot] += kv * innovation;
+        cov_pp_[i][slot] = pp - kp * pp;
+        cov_pv_[i][slot] = pv - kp * pv;
+        cov_vv_[i][slot] -= kv * pv;
+    }
 }
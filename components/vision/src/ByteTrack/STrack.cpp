@@ -2,20 +2,19 @@
 
 #include <cstddef>
 
-byte_track::STrack::STrack(const Rect<float>& rect, const float& score, const int &label, const int& max_history) :
-    kalman_filter_(),
-    mean_(),
-    covariance_(),
-    rect_(rect),
+byte_track::STrack::STrack() :
+    rect_(0, 0, 0, 0),
+    history_head_(0),
+    history_size_(0),
     state_(STrackState::New),
     is_activated_(false),
-    score_(score),
-    label_(label),
-    max_history_(max_history),
+    score_(0),
+    label_(0),
     track_id_(0),
     frame_id_(0),
     start_frame_id_(0),
-    tracklet_len_(0)
+    tracklet_len_(0),
+    lost_(false)
 {
 }
 
@@ -62,12 +61,29 @@ const size_t& byte_track::STrack::getTrackletLength() const
     return tracklet_len_;
 }
 
-void byte_track::STrack::activate(const size_t& frame_id, const size_t& track_id)
+void byte_track::STrack::reset(const Rect<float>& rect, const float& score, const int &label, const int& max_history)
 {
-    kalman_filter_.initiate(mean_, covariance_, rect_.getXyah());
-
-    updateRect();
+    const size_t history_len = max_history > 0 ? static_cast<size_t>(max_history) : 0;
+    if (history_.size() != history_len)
+    {
+        history_.assign(history_len, Object(rect, label, score));
+    }
+    history_head_ = 0;
+    history_size_ = 0;
+    rect_ = rect;
+    state_ = STrackState::New;
+    is_activated_ = false;
+    score_ = score;
+    label_ = label;
+    track_id_ = 0;
+    frame_id_ = 0;
+    start_frame_id_ = 0;
+    tracklet_len_ = 0;
+    lost_ = false;
+}
 
+void byte_track::STrack::activate(const size_t& frame_id, const size_t& track_id)
+{
     state_ = STrackState::Tracked;
     if (frame_id == 1)
     {
@@ -79,41 +95,20 @@ void byte_track::STrack::activate(const size_t& frame_id, const size_t& track_id
     tracklet_len_ = 0;
 }
 
-void byte_track::STrack::reActivate(const STrack &new_track, const size_t &frame_id, const int &new_track_id)
+void byte_track::STrack::reActivate(const float &score, const size_t &frame_id)
 {
-    kalman_filter_.update(mean_, covariance_, new_track.getRect().getXyah());
-
-    updateRect();
-
     state_ = STrackState::Tracked;
     is_activated_ = true;
-    score_ = new_track.getScore();
-    if (0 <= new_track_id)
-    {
-        track_id_ = new_track_id;
-    }
+    score_ = score;
     frame_id_ = frame_id;
     tracklet_len_ = 0;
 }
 
-void byte_track::STrack::predict()
+void byte_track::STrack::update(const float &score, const size_t &frame_id)
 {
-    if (state_ != STrackState::Tracked)
-    {
-        mean_[7] = 0;
-    }
-    kalman_filter_.predict(mean_, covariance_);
-}
-
-void byte_track::STrack::update(const STrack &new_track, const size_t &frame_id)
-{
-    kalman_filter_.update(mean_, covariance_, new_track.getRect().getXyah());
-
-    updateRect();
-
     state_ = STrackState::Tracked;
     is_activated_ = true;
-    score_ = new_track.getScore();
+    score_ = score;
     frame_id_ = frame_id;
     tracklet_len_++;
 }
@@ -128,16 +123,30 @@ void byte_track::STrack::markAsRemoved()
     state_ = STrackState::Removed;
 }
 
-void byte_track::STrack::updateRect()
+void byte_track::STrack::updateRect(const float &x, const float &y, const float &a, const float &h)
 {
-    rect_.width() = mean_[2] * mean_[3];
-    rect_.height() = mean_[3];
-    rect_.x() = mean_[0] - rect_.width() / 2;
-    rect_.y() = mean_[1] - rect_.height() / 2;
-    Object obj(rect_, label_, score_);
-    rect_history_.push_back(obj);
-    if(rect_history_.size() > (size_t)max_history_)
+    rect_.width() = a * h;
+    rect_.height() = h;
+    rect_.x() = x - rect_.width() / 2;
+    rect_.y() = y - rect_.height() / 2;
+    if (history_.empty())
+    {
+        return;
+    }
+    // history keeps the latest max_history items, overwrite the oldest one when full
+    size_t idx = history_head_ + history_size_;
+    if (idx >= history_.size())
+        idx -= history_.size();
+    Object &obj = history_[idx];
+    obj.rect = rect_;
+    obj.label = label_;
+    obj.prob = score_;
+    if (history_size_ < history_.size())
+    {
+        history_size_++;
+    }
+    else if (++history_head_ == history_.size())
     {
-        rect_history_.pop_front();
+        history_head_ = 0;
     }
 }
@@ -4,8 +4,6 @@
 #include <cstring>
 #include <stdexcept>
 
-#define LAPJV_CPP_NEW(x, t, n) if ((x = (t *)malloc(sizeof(t) * (n))) == 0) { return -1; }
-#define LAPJV_CPP_FREE(x) if (x != 0) { free(x); x = 0; }
 #define LAPJV_CPP_SWAP_INDICES(a, b) { int _temp_index = a; a = b; b = _temp_index; }
 
 namespace
@@ -21,10 +19,9 @@ enum class fp_t {
 /** Column-reduction and reduction transfer for a dense cost matrix.
 */
 int _ccrrt_dense(const size_t n, double *cost[],
-    int *free_rows, int *x, int *y, double *v)
+    int *free_rows, int *x, int *y, double *v, bool *unique)
 {
     int n_free_rows;
-    bool *unique;
 
     for (size_t i = 0; i < n; i++) {
         x[i] = -1;
@@ -40,7 +37,6 @@ int _ccrrt_dense(const size_t n, double *cost[],
             }
         }
     }
-    LAPJV_CPP_NEW(unique, bool, n);
     memset(unique, true, n);
     {
         int j = n;
@@ -76,7 +72,6 @@ int _ccrrt_dense(const size_t n, double *cost[],
             v[j] -= min;
         }
     }
-    LAPJV_CPP_FREE(unique);
     return n_free_rows;
 }
 
@@ -220,16 +215,11 @@ int find_path_dense(
     const size_t n, double *cost[],
     const int start_i,
     int *y, double *v,
-    int *pred)
+    int *pred, int *cols, double *d)
 {
     size_t lo = 0, hi = 0;
     int final_j = -1;
     size_t n_ready = 0;
-    int *cols;
-    double *d;
-
-    LAPJV_CPP_NEW(cols, int, n);
-    LAPJV_CPP_NEW(d, double, n);
 
     for (size_t i = 0; i < n; i++) {
         cols[i] = i;
@@ -263,9 +253,6 @@ int find_path_dense(
         }
     }
 
-    LAPJV_CPP_FREE(cols);
-    LAPJV_CPP_FREE(d);
-
     return final_j;
 }
 
@@ -275,17 +262,14 @@ int find_path_dense(
 int _ca_dense(
     const size_t n, double *cost[],
     const size_t n_free_rows,
-    int *free_rows, int *x, int *y, double *v)
+    int *free_rows, int *x, int *y, double *v,
+    int *pred, int *cols, double *d)
 {
-    int *pred;
-
-    LAPJV_CPP_NEW(pred, int, n);
-
     for (int *pfree_i = free_rows; pfree_i < free_rows + n_free_rows; pfree_i++) {
         int i = -1, j;
         size_t k = 0;
 
-        j = find_path_dense(n, cost, *pfree_i, y, v, pred);
+        j = find_path_dense(n, cost, *pfree_i, y, v, pred, cols, d);
         if (j < 0)
         {
             throw std::runtime_error("Error occured in _ca_dense(): j < 0");
@@ -304,7 +288,6 @@ int _ca_dense(
             }
         }
     }
-    LAPJV_CPP_FREE(pred);
     return 0;
 }
 }
@@ -313,27 +296,32 @@ int _ca_dense(
 int byte_track::lapjv_internal(
     const size_t n, double *cost[],
     int *x, int *y)
+{
+    LapjvWorkspace workspace;
+    return lapjv_internal(n, cost, x, y, workspace);
+}
+
+/** Solve dense sparse LAP, reusing the scratch buffers of workspace. */
+int byte_track::lapjv_internal(
+    const size_t n, double *cost[],
+    int *x, int *y, LapjvWorkspace &workspace)
 {
     int ret;
-    int *free_rows;
-    double *v;
+    workspace.reserve(n);
+    int *free_rows = workspace.free_rows.data();
+    double *v = workspace.v.data();
 
-    LAPJV_CPP_NEW(free_rows, int, n);
-    LAPJV_CPP_NEW(v, double, n);
-    ret = _ccrrt_dense(n, cost, free_rows, x, y, v);
+    ret = _ccrrt_dense(n, cost, free_rows, x, y, v, workspace.unique.get());
     int i = 0;
     while (ret > 0 && i < 2) {
         ret = _carr_dense(n, cost, ret, free_rows, x, y, v);
         i++;
     }
     if (ret > 0) {
-        ret = _ca_dense(n, cost, ret, free_rows, x, y, v);
+        ret = _ca_dense(n, cost, ret, free_rows, x, y, v,
+                        workspace.pred.data(), workspace.cols.data(), workspace.d.data());
     }
-    LAPJV_CPP_FREE(v);
-    LAPJV_CPP_FREE(free_rows);
     return ret;
 }
 
-#undef LAPJV_CPP_NEW
-#undef LAPJV_CPP_FREE
 #undef LAPJV_CPP_SWAP_INDICES
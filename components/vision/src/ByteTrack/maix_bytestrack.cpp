@@ -4,44 +4,71 @@
 
 namespace maix::tracker
 {
+    struct ByteTrackerData
+    {
+        byte_track::BYTETracker tracker;
+        std::vector<byte_track::Object> objs; // reused input buffer
+
+        ByteTrackerData(const int& max_lost_buff_num,
+                        const float& track_thresh,
+                        const float& high_thresh,
+                        const float& match_thresh,
+                        const int& max_history)
+            : tracker(max_lost_buff_num, track_thresh, high_thresh, match_thresh, max_history)
+        {
+        }
+    };
+
     ByteTracker::ByteTracker(const int& max_lost_buff_num,
                 const float& track_thresh,
                 const float& high_thresh,
                 const float& match_thresh,
                 const int& max_history)
     {
-        _data = new byte_track::BYTETracker(max_lost_buff_num, track_thresh, high_thresh, match_thresh, max_history);
+        _data = new ByteTrackerData(max_lost_buff_num, track_thresh, high_thresh, match_thresh, max_history);
         if(!_data)
             throw err::Exception(err::ERR_NO_MEM);
     }
 
     ByteTracker::~ByteTracker()
     {
-        delete (byte_track::BYTETracker*)_data;
+        delete (ByteTrackerData*)_data;
     }
 
     std::vector<tracker::Track> ByteTracker::update(const std::vector<tracker::Object> &objs)
     {
-        byte_track::BYTETracker *bytetracker = (byte_track::BYTETracker*)_data;
         std::vector<tracker::Track> res;
-        std::vector<byte_track::Object> objs2;
+        update(objs, res);
+        return res;
+    }
+
+    void ByteTracker::update(const std::vector<tracker::Object> &objs, std::vector<tracker::Track> &tracks)
+    {
+        ByteTrackerData *data = (ByteTrackerData*)_data;
+        data->objs.clear();
         for(const auto &obj : objs)
         {
             byte_track::Rect<float> rect(obj.x, obj.y, obj.w, obj.h);
-            objs2.push_back(byte_track::Object(rect, obj.class_id, obj.score));
+            data->objs.emplace_back(rect, obj.class_id, obj.score);
         }
-        const auto &res0 = bytetracker->update(objs2);
-        for (const auto &r : res0)
+        const auto &res0 = data->tracker.update(data->objs);
+        tracks.resize(res0.size());
+        for (size_t i = 0; i < res0.size(); ++i)
         {
-            res.push_back(tracker::Track(r->getTrackId(), r->getScore(), r->getLost(), r->getStartFrameId(), r->getFrameId()));
-            tracker::Track &track = res.back();
-            const std::deque<byte_track::Object> &history = r->get_rect_history();
-            for(const auto &i : history)
+            const byte_track::STrack *r = res0[i];
+            tracker::Track &track = tracks[i];
+            track.id = r->getTrackId();
+            track.score = r->getScore();
+            track.lost = r->getLost();
+            track.start_frame_id = r->getStartFrameId();
+            track.frame_id = r->getFrameId();
+            track.history.clear();
+            for(size_t j = 0; j < r->historySize(); ++j)
             {
-                track.history.push_back(tracker::Object(i.rect.x(), i.rect.y(), i.rect.width(), i.rect.height(), i.label, i.prob));
+                const byte_track::Object &h = r->history(j);
+                track.history.emplace_back(h.rect.x(), h.rect.y(), h.rect.width(), h.rect.height(), h.label, h.prob);
             }
         }
-        return res;
     }
 } // namespace maix::tracker
 
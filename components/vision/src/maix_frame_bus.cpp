@@ -0,0 +1,483 @@
+/**
+ * @author neucrack@sipeed
+ * @copyright Sipeed Ltd 2024-
+ * @license Apache 2.0
+ * @update 2024.11.27: Add shared memory frame bus.
+ */
+
+#include "maix_frame_bus.hpp"
+#include "maix_basic.hpp"
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+namespace maix::image
+{
+    static const uint32_t BUS_MAGIC = 0x4D414642; // "MAFB"
+    static const uint32_t BUS_VERSION = 1;
+    static const int BUS_MAX_SLOTS = 64;
+    static const size_t BUS_ALIGN = 4096;
+
+    // shared by processes, only lock free atomics and plain data
+    struct alignas(64) SlotMeta
+    {
+        std::atomic<uint32_t> state;    // sequence lock, odd while writer owns slot
+        std::atomic<uint32_t> pins;     // readers holding this slot
+        std::atomic<uint64_t> seq;      // 0 means never published
+        uint64_t timestamp_us;
+        int32_t width;
+        int32_t height;
+        int32_t format;
+        int32_t data_size;
+    };
+
+    struct BusHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t slot_num;
+        uint32_t slot_size;
+        uint64_t slot_stride;
+        uint64_t total_size;
+        std::atomic<uint32_t> futex;    // increased on every publish
+        std::atomic<uint32_t> waiters;
+        std::atomic<uint64_t> last_seq;
+        std::atomic<uint64_t> drops;
+        SlotMeta slots[BUS_MAX_SLOTS];
+    };
+
+    static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free,
+                  "frame bus needs lock free atomics in shared memory");
+
+    struct FrameBusData
+    {
+        std::string path;
+        bool writer;
+        BusHeader *header;
+        uint8_t *base;
+        size_t map_size;
+        uint64_t last_read;
+        std::mutex lock;
+        std::vector<std::pair<image::Image *, int>> held;   // images out of acquire() or read(), and their slots
+    };
+
+    static inline size_t _align(size_t v)
+    {
+        return (v + BUS_ALIGN - 1) & ~(BUS_ALIGN - 1);
+    }
+
+    static inline uint8_t *_slot_data(FrameBusData *d, int i)
+    {
+        return d->base + _align(sizeof(BusHeader)) + d->header->slot_stride * i;
+    }
+
+    static int _futex_wait(std::atomic<uint32_t> *addr, uint32_t value, int timeout_ms)
+    {
+        struct timespec ts, *pts = NULL;
+        if (timeout_ms >= 0)
+        {
+            ts.tv_sec = timeout_ms / 1000;
+            ts.tv_nsec = (long)(timeout_ms % 1000) * 1000000;
+            pts = &ts;
+        }
+        // not FUTEX_PRIVATE_FLAG, waiters and waker are in different processes
+        return syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAIT, value, pts, NULL, 0);
+    }
+
+    static void _futex_wake(std::atomic<uint32_t> *addr)
+    {
+        syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+    }
+
+    // pin slot i if it still holds the frame seen with state, return false if writer took it
+    static bool _pin(SlotMeta &m, uint32_t state)
+    {
+        m.pins.fetch_add(1);
+        if (m.state.load() != state)
+        {
+            m.pins.fetch_sub(1);
+            return false;
+        }
+        return true;
+    }
+
+    FrameBus::FrameBus(const std::string &name, bool create, int slot_num, int slot_size)
+    {
+        if (name.empty() || name.find('/') != std::string::npos)
+            throw err::Exception(err::ERR_ARGS, "invalid frame bus name: " + name);
+        FrameBusData *d = new FrameBusData();
+        d->path = "/maix_fb_" + name;
+        d->writer = create;
+        d->header = NULL;
+        d->base = NULL;
+        d->map_size = 0;
+        d->last_read = 0;
+
+        int fd = -1;
+        if (create)
+        {
+            if (slot_num < 3 || slot_num > BUS_MAX_SLOTS || slot_size <= 0)
+            {
+                delete d;
+                throw err::Exception(err::ERR_ARGS, "frame bus slot_num should in [3, 64] and slot_size > 0");
+            }
+            // replace stale bus left by a crashed writer, readers still mapping it keep the old one
+            shm_unlink(d->path.c_str());
+            fd = shm_open(d->path.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0666);
+            if (fd >= 0)
+            {
+                fchmod(fd, 0666);
+                d->map_size = _align(sizeof(BusHeader)) + _align(slot_size) * slot_num;
+                if (ftruncate(fd, d->map_size) < 0)
+                {
+                    close(fd);
+                    fd = -1;
+                    shm_unlink(d->path.c_str());
+                }
+            }
+        }
+        else
+        {
+            fd = shm_open(d->path.c_str(), O_RDWR | O_CLOEXEC, 0);
+            struct stat st;
+            if (fd >= 0 && (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(BusHeader)))
+            {
+                close(fd);
+                fd = -1;
+                errno = EINVAL;
+            }
+            if (fd >= 0)
+                d->map_size = st.st_size;
+        }
+        if (fd < 0)
+        {
+            std::string msg = "open frame bus " + d->path + " failed: " + strerror(errno);
+            delete d;
+            throw err::Exception(create ? err::ERR_IO : err::ERR_NOT_FOUND, msg);
+        }
+        void *p = mmap(NULL, d->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED)
+        {
+            if (create)
+                shm_unlink(d->path.c_str());
+            delete d;
+            throw err::Exception(err::ERR_NO_MEM, "mmap frame bus failed");
+        }
+        d->base = (uint8_t *)p;
+        d->header = (BusHeader *)p;
+
+        BusHeader *h = d->header;
+        if (create)
+        {
+            // ftruncate zero filled the memory, atomics are valid as zero
+            h->version = BUS_VERSION;
+            h->slot_num = slot_num;
+            h->slot_size = slot_size;
+            h->slot_stride = _align(slot_size);
+            h->total_size = d->map_size;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            h->magic = BUS_MAGIC;
+        }
+        else if (h->magic != BUS_MAGIC || h->version != BUS_VERSION || h->total_size != d->map_size)
+        {
+            munmap(p, d->map_size);
+            delete d;
+            throw err::Exception(err::ERR_NOT_READY, "frame bus not ready or version mismatch");
+        }
+        _data = d;
+    }
+
+    FrameBus::~FrameBus()
+    {
+        FrameBusData *d = (FrameBusData *)_data;
+        {
+            std::lock_guard<std::mutex> lock(d->lock);
+            for (auto &it : d->held)
+            {
+                SlotMeta &m = d->header->slots[it.second];
+                if (d->writer)
+                    m.state.fetch_add(1);
+                else
+                    m.pins.fetch_sub(1);
+                delete it.first;
+            }
+            d->held.clear();
+        }
+        munmap(d->base, d->map_size);
+        if (d->writer)
+            shm_unlink(d->path.c_str());
+        delete d;
+    }
+
+    image::Image *FrameBus::acquire(int width, int height, image::Format format)
+    {
+        FrameBusData *d = (FrameBusData *)_data;
+        BusHeader *h = d->header;
+        if (!d->writer)
+        {
+            log::error("frame bus opened as reader, can not acquire");
+            return nullptr;
+        }
+        bool compressed = format > image::Format::FMT_COMPRESSED_MIN;
+        int64_t size = compressed ? h->slot_size : (int64_t)width * height * image::fmt_size[format];
+        if (width <= 0 || height <= 0 || size > h->slot_size)
+        {
+            log::error("frame %dx%d %s too large for frame bus slot %u bytes", width, height, image::fmt_names[format].c_str(), h->slot_size);
+            return nullptr;
+        }
+
+        std::lock_guard<std::mutex> lock(d->lock);
+        // try slots from the oldest frame, the newest one is kept readable as long as possible
+        int order[BUS_MAX_SLOTS];
+        int n = h->slot_num;
+        for (int i = 0; i < n; ++i)
+            order[i] = i;
+        std::sort(order, order + n, [h](int a, int b) { return h->slots[a].seq.load() < h->slots[b].seq.load(); });
+        for (int k = 0; k < n; ++k)
+        {
+            SlotMeta &m = h->slots[order[k]];
+            if (m.state.load() & 1)
+                continue; // acquired already by this process
+            m.state.fetch_add(1);
+            if (m.pins.load() != 0)
+            {
+                // a reader got it first, state is restored so its pin stays valid
+                m.state.fetch_sub(1);
+                continue;
+            }
+            image::Image *img = new image::Image(width, height, format, _slot_data(d, order[k]), compressed ? size : -1, false);
+            d->held.push_back({img, order[k]});
+            return img;
+        }
+        h->drops.fetch_add(1);
+        return nullptr;
+    }
+
+    static int _take_held(FrameBusData *d, image::Image *img)
+    {
+        for (auto it = d->held.begin(); it != d->held.end(); ++it)
+        {
+            if (it->first == img)
+            {
+                int slot = it->second;
+                d->held.erase(it);
+                return slot;
+            }
+        }
+        return -1;
+    }
+
+    err::Err FrameBus::publish(image::Image *img, int data_size)
+    {
+        FrameBusData *d = (FrameBusData *)_data;
+        BusHeader *h = d->header;
+        int slot;
+        {
+            std::lock_guard<std::mutex> lock(d->lock);
+            slot = _take_held(d, img);
+        }
+        if (slot < 0 || !d->writer)
+            return err::ERR_ARGS;
+        SlotMeta &m = h->slots[slot];
+        if (data_size < 0)
+            data_size = img->data_size();
+        if (data_size > (int)h->slot_size)
+        {
+            m.state.fetch_add(1);
+            delete img;
+            return err::ERR_ARGS;
+        }
+        uint64_t seq = h->last_seq.load() + 1;
+        m.timestamp_us = time::ticks_us();
+        m.width = img->width();
+        m.height = img->height();
+        m.format = img->format();
+        m.data_size = data_size;
+        m.seq.store(seq);
+        m.state.fetch_add(1);
+        h->last_seq.store(seq);
+        h->futex.fetch_add(1);
+        if (h->waiters.load() != 0)
+            _futex_wake(&h->futex);
+        delete img;
+        return err::ERR_NONE;
+    }
+
+    void FrameBus::cancel(image::Image *img)
+    {
+        FrameBusData *d = (FrameBusData *)_data;
+        int slot;
+        {
+            std::lock_guard<std::mutex> lock(d->lock);
+            slot = _take_held(d, img);
+        }
+        if (slot < 0)
+            return;
+        // back to even, slot keeps its old seq, data may be partly overwritten so drop the old frame
+        SlotMeta &m = d->header->slots[slot];
+        m.seq.store(0);
+        m.state.fetch_add(1);
+        delete img;
+    }
+
+    err::Err FrameBus::write(image::Image *img)
+    {
+        image::Image *slot = acquire(img->width(), img->height(), img->format());
+        if (!slot)
+            return ((FrameBusData *)_data)->writer ? err::ERR_BUSY : err::ERR_NOT_PERMIT;
+        if ((uint32_t)img->data_size() > ((FrameBusData *)_data)->header->slot_size)
+        {
+            cancel(slot);
+            return err::ERR_ARGS;
+        }
+        memcpy(slot->data(), img->data(), img->data_size());
+        return publish(slot, img->data_size());
+    }
+
+    // find and pin frame to read, return slot index or -1
+    static int _find_frame(FrameBusData *d, bool latest, uint32_t &dropped)
+    {
+        BusHeader *h = d->header;
+        int n = h->slot_num;
+        for (int retry = 0; retry < 4; ++retry)
+        {
+            int best = -1;
+            uint64_t best_seq = 0;
+            uint32_t best_state = 0;
+            for (int i = 0; i < n; ++i)
+            {
+                SlotMeta &m = h->slots[i];
+                uint32_t state = m.state.load();
+                uint64_t seq = m.seq.load();
+                if ((state & 1) || seq <= d->last_read)
+                    continue;
+                // latest: max seq, in order: min seq
+                if (best < 0 || (latest ? seq > best_seq : seq < best_seq))
+                {
+                    best = i;
+                    best_seq = seq;
+                    best_state = state;
+                }
+            }
+            if (best < 0)
+                return -1;
+            if (!_pin(h->slots[best], best_state))
+                continue;
+            // seq can not change after pinned, check it was not rewritten between load and pin
+            if (h->slots[best].seq.load() != best_seq)
+            {
+                h->slots[best].pins.fetch_sub(1);
+                continue;
+            }
+            dropped = d->last_read ? best_seq - d->last_read - 1 : 0;
+            d->last_read = best_seq;
+            return best;
+        }
+        return -1;
+    }
+
+    image::Image *FrameBus::read(int timeout_ms, bool latest, image::FrameInfo *info)
+    {
+        FrameBusData *d = (FrameBusData *)_data;
+        BusHeader *h = d->header;
+        if (d->writer)
+        {
+            log::error("frame bus opened as writer, can not read");
+            return nullptr;
+        }
+        uint64_t deadline = timeout_ms < 0 ? 0 : time::ticks_ms() + timeout_ms;
+        while (true)
+        {
+            std::unique_lock<std::mutex> lock(d->lock);
+            uint32_t futex = h->futex.load();
+            uint32_t dropped = 0;
+            int slot = _find_frame(d, latest, dropped);
+            if (slot >= 0)
+            {
+                SlotMeta &m = h->slots[slot];
+                image::Image *img = nullptr;
+                try
+                {
+                    img = new image::Image(m.width, m.height, (image::Format)m.format, _slot_data(d, slot), m.data_size, false);
+                }
+                catch (std::exception &e)
+                {
+                    log::error("invalid frame on bus: %s", e.what());
+                    m.pins.fetch_sub(1);
+                    return nullptr;
+                }
+                if (info)
+                {
+                    info->seq = m.seq.load();
+                    info->timestamp_us = m.timestamp_us;
+                    info->width = m.width;
+                    info->height = m.height;
+                    info->format = (image::Format)m.format;
+                    info->data_size = m.data_size;
+                    info->dropped = dropped;
+                }
+                d->held.push_back({img, slot});
+                return img;
+            }
+            lock.unlock();
+            int wait_ms = -1;
+            if (timeout_ms >= 0)
+            {
+                uint64_t now = time::ticks_ms();
+                if (now >= deadline)
+                    return nullptr;
+                wait_ms = deadline - now;
+            }
+            h->waiters.fetch_add(1);
+            _futex_wait(&h->futex, futex, wait_ms);
+            h->waiters.fetch_sub(1);
+            if (app::need_exit())
+                return nullptr;
+        }
+    }
+
+    void FrameBus::release(image::Image *img)
+    {
+        FrameBusData *d = (FrameBusData *)_data;
+        int slot;
+        {
+            std::lock_guard<std::mutex> lock(d->lock);
+            slot = _take_held(d, img);
+        }
+        if (slot < 0 || d->writer)
+            return;
+        d->header->slots[slot].pins.fetch_sub(1);
+        delete img;
+    }
+
+    uint64_t FrameBus::last_seq()
+    {
+        return ((FrameBusData *)_data)->header->last_seq.load();
+    }
+
+    uint64_t FrameBus::writer_drops()
+    {
+        return ((FrameBusData *)_data)->header->drops.load();
+    }
+
+    int FrameBus::slot_num()
+    {
+        return ((FrameBusData *)_data)->header->slot_num;
+    }
+
+    int FrameBus::slot_size()
+    {
+        return ((FrameBusData *)_data)->header->slot_size;
+    }
+} // namespace maix::image
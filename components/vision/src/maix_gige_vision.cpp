@@ -0,0 +1,1145 @@
+/**
+ * @author neucrack@sipeed
+ * @copyright Sipeed Ltd 2024-
+ * @license Apache 2.0
+ * @update 2024.11.26: Add GigE Vision device.
+ */
+
+#include "maix_gige_vision.hpp"
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <poll.h>
+
+namespace maix::gige
+{
+    // GVCP protocol, GigE Vision 1.2
+    enum
+    {
+        GVCP_KEY = 0x42,
+        GVCP_FLAG_ACK = 0x01,
+
+        GVCP_DISCOVERY_CMD = 0x0002,
+        GVCP_DISCOVERY_ACK = 0x0003,
+        GVCP_PACKETRESEND_CMD = 0x0040,
+        GVCP_READREG_CMD = 0x0080,
+        GVCP_READREG_ACK = 0x0081,
+        GVCP_WRITEREG_CMD = 0x0082,
+        GVCP_WRITEREG_ACK = 0x0083,
+        GVCP_READMEM_CMD = 0x0084,
+        GVCP_READMEM_ACK = 0x0085,
+        GVCP_WRITEMEM_CMD = 0x0086,
+        GVCP_WRITEMEM_ACK = 0x0087,
+
+        GEV_STATUS_SUCCESS = 0x0000,
+        GEV_STATUS_NOT_IMPLEMENTED = 0x8001,
+        GEV_STATUS_INVALID_PARAMETER = 0x8002,
+        GEV_STATUS_INVALID_ADDRESS = 0x8003,
+        GEV_STATUS_WRITE_PROTECT = 0x8004,
+        GEV_STATUS_BAD_ALIGNMENT = 0x8005,
+        GEV_STATUS_ACCESS_DENIED = 0x8006,
+    };
+
+    // bootstrap registers
+    enum
+    {
+        REG_VERSION = 0x0000,
+        REG_DEVICE_MODE = 0x0004,
+        REG_MAC_HIGH = 0x0008,
+        REG_MAC_LOW = 0x000C,
+        REG_IP_CONFIG_OPTIONS = 0x0010,
+        REG_IP_CONFIG_CURRENT = 0x0014,
+        REG_CURRENT_IP = 0x0024,
+        REG_CURRENT_SUBNET = 0x0034,
+        REG_CURRENT_GATEWAY = 0x0044,
+        REG_MANUFACTURER_NAME = 0x0048,
+        REG_MODEL_NAME = 0x0068,
+        REG_DEVICE_VERSION = 0x0088,
+        REG_MANUFACTURER_INFO = 0x00A8,
+        REG_SERIAL_NUMBER = 0x00D8,
+        REG_USER_NAME = 0x00E8,
+        REG_FIRST_URL = 0x0200,
+        REG_SECOND_URL = 0x0400,
+        REG_NUM_INTERFACES = 0x0600,
+        REG_NUM_MESSAGE_CHANNELS = 0x0900,
+        REG_NUM_STREAM_CHANNELS = 0x0904,
+        REG_GVCP_CAPABILITY = 0x0934,
+        REG_HEARTBEAT_TIMEOUT = 0x0938,
+        REG_TICK_FREQ_HIGH = 0x093C,
+        REG_TICK_FREQ_LOW = 0x0940,
+        REG_TIMESTAMP_CONTROL = 0x0944,
+        REG_TIMESTAMP_HIGH = 0x0948,
+        REG_TIMESTAMP_LOW = 0x094C,
+        REG_CCP = 0x0A00,
+        REG_SCP0 = 0x0D00,
+        REG_SCPS0 = 0x0D04,
+        REG_SCPD0 = 0x0D08,
+        REG_SCDA0 = 0x0D18,
+        REG_SCSP0 = 0x0D1C,
+        BOOTSTRAP_SIZE = 0x1000,
+
+        // device specific registers described by GenICam XML
+        REG_ACQ_START = 0x10000,
+        REG_ACQ_STOP = 0x10004,
+        REG_ACQ_MODE = 0x10008,
+        REG_WIDTH = 0x1000C,
+        REG_HEIGHT = 0x10010,
+        REG_PIXEL_FORMAT = 0x10014,
+        REG_PAYLOAD_SIZE = 0x10018,
+        REG_TL_LOCKED = 0x1001C,
+        REG_ACQ_STATUS = 0x10020,
+
+        XML_ADDR = 0x20000,
+    };
+
+    // GVSP
+    enum
+    {
+        GVSP_FORMAT_LEADER = 1,
+        GVSP_FORMAT_TRAILER = 2,
+        GVSP_FORMAT_PAYLOAD = 3,
+        GVSP_PAYLOAD_IMAGE = 0x0001,
+        GVSP_HEADER_SIZE = 8,
+        GVSP_LEADER_SIZE = GVSP_HEADER_SIZE + 36,
+        GVSP_TRAILER_SIZE = GVSP_HEADER_SIZE + 8,
+        IP_UDP_HEADER_SIZE = 28,
+        PACKET_SIZE_MIN = 576,
+        PACKET_SIZE_MAX = 9000,
+        PACKET_SIZE_DEFAULT = 1500,
+        SEND_BATCH = 64,
+        TICK_FREQ = 1000000,    // timestamp in us
+    };
+
+    static inline void _put_u16(uint8_t *p, uint16_t v)
+    {
+        p[0] = v >> 8;
+        p[1] = v;
+    }
+
+    static inline void _put_u32(uint8_t *p, uint32_t v)
+    {
+        p[0] = v >> 24;
+        p[1] = v >> 16;
+        p[2] = v >> 8;
+        p[3] = v;
+    }
+
+    static inline uint16_t _get_u16(const uint8_t *p)
+    {
+        return ((uint16_t)p[0] << 8) | p[1];
+    }
+
+    static inline uint32_t _get_u32(const uint8_t *p)
+    {
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    }
+
+    // PFNC pixel format, 0 if not supported
+    static uint32_t _pixel_format(image::Format format)
+    {
+        switch (format)
+        {
+        case image::FMT_GRAYSCALE: return 0x01080001; // Mono8
+        case image::FMT_RGB888: return 0x02180014;    // RGB8
+        case image::FMT_BGR888: return 0x02180015;    // BGR8
+        case image::FMT_GRBG8: return 0x01080008;     // BayerGR8
+        case image::FMT_RGGB8: return 0x01080009;     // BayerRG8
+        case image::FMT_GBRG8: return 0x0108000A;     // BayerGB8
+        case image::FMT_BGGR8: return 0x0108000B;     // BayerBG8
+        default: return 0;
+        }
+    }
+
+    static const char *_xml_template = R"(<?xml version="1.0" encoding="utf-8"?>
+<RegisterDescription ModelName="%s" VendorName="Sipeed" ToolTip="MaixCDK GigE Vision device" StandardNameSpace="GEV"
+ SchemaMajorVersion="1" SchemaMinorVersion="1" SchemaSubMinorVersion="0" MajorVersion="1" MinorVersion="0" SubMinorVersion="0"
+ ProductGuid="9E3C1D6A-5B2F-4C8E-A1D7-3F6B2E8C4A10" VersionGuid="4B7E2A9C-1D3F-4E6A-8C5B-7A2D9F1E3C60"
+ xmlns="http://www.genicam.org/GenApi/Version_1_1" xmlns:xsi="http://www.w3.org/2001/XMLSchema-instance"
+ xsi:schemaLocation="http://www.genicam.org/GenApi/Version_1_1 http://www.genicam.org/GenApi/GenApiSchema_Version_1_1.xsd">
+  <Category Name="Root" NameSpace="Standard">
+    <pFeature>DeviceControl</pFeature>
+    <pFeature>ImageFormatControl</pFeature>
+    <pFeature>AcquisitionControl</pFeature>
+    <pFeature>TransportLayerControl</pFeature>
+  </Category>
+  <Category Name="DeviceControl" NameSpace="Standard">
+    <pFeature>DeviceVendorName</pFeature>
+    <pFeature>DeviceModelName</pFeature>
+    <pFeature>DeviceVersion</pFeature>
+    <pFeature>DeviceID</pFeature>
+    <pFeature>DeviceUserID</pFeature>
+  </Category>
+  <StringReg Name="DeviceVendorName" NameSpace="Standard"><Address>0x48</Address><Length>32</Length><AccessMode>RO</AccessMode><pPort>Device</pPort></StringReg>
+  <StringReg Name="DeviceModelName" NameSpace="Standard"><Address>0x68</Address><Length>32</Length><AccessMode>RO</AccessMode><pPort>Device</pPort></StringReg>
+  <StringReg Name="DeviceVersion" NameSpace="Standard"><Address>0x88</Address><Length>32</Length><AccessMode>RO</AccessMode><pPort>Device</pPort></StringReg>
+  <StringReg Name="DeviceID" NameSpace="Standard"><Address>0xd8</Address><Length>16</Length><AccessMode>RO</AccessMode><pPort>Device</pPort></StringReg>
+  <StringReg Name="DeviceUserID" NameSpace="Standard"><Address>0xe8</Address><Length>16</Length><AccessMode>RW</AccessMode><pPort>Device</pPort></StringReg>
+  <Category Name="ImageFormatControl" NameSpace="Standard">
+    <pFeature>Width</pFeature>
+    <pFeature>Height</pFeature>
+    <pFeature>OffsetX</pFeature>
+    <pFeature>OffsetY</pFeature>
+    <pFeature>PixelFormat</pFeature>
+  </Category>
+  <Integer Name="Width" NameSpace="Standard"><pValue>WidthReg</pValue></Integer>
+  <IntReg Name="WidthReg"><Address>0x1000c</Address><Length>4</Length><AccessMode>RO</AccessMode><pPort>Device</pPort><Sign>Unsigned</Sign><Endianess>BigEndian</Endianess></IntReg>
+  <Integer Name="Height" NameSpace="Standard"><pValue>HeightReg</pValue></Integer>
+  <IntReg Name="HeightReg"><Address>0x10010</Address><Length>4</Length><AccessMode>RO</AccessMode><pPort>Device</pPort><Sign>Unsigned</Sign><Endianess>BigEndian</Endianess></IntReg>
+  <Integer Name="OffsetX" NameSpace="Standard"><Value>0</Value><Min>0</Min><Max>0</Max></Integer>
+  <Integer Name="OffsetY" NameSpace="Standard"><Value>0</Value><Min>0</Min><Max>0</Max></Integer>
+  <Enumeration Name="PixelFormat" NameSpace="Standard">
+    <EnumEntry Name="Mono8" NameSpace="Standard"><Value>17301505</Value></EnumEntry>
+    <EnumEntry Name="RGB8" NameSpace="Standard"><Value>35127316</Value></EnumEntry>
+    <EnumEntry Name="BGR8" NameSpace="Standard"><Value>35127317</Value></EnumEntry>
+    <EnumEntry Name="BayerGR8" NameSpace="Standard"><Value>17301512</Value></EnumEntry>
+    <EnumEntry Name="BayerRG8" NameSpace="Standard"><Value>17301513</Value></EnumEntry>
+    <EnumEntry Name="BayerGB8" NameSpace="Standard"><Value>17301514</Value></EnumEntry>
+    <EnumEntry Name="BayerBG8" NameSpace="Standard"><Value>17301515</Value></EnumEntry>
+    <pValue>PixelFormatReg</pValue>
+  </Enumeration>
+  <IntReg Name="PixelFormatReg"><Address>0x10014</Address><Length>4</Length><AccessMode>RO</AccessMode><pPort>Device</pPort><Sign>Unsigned</Sign><Endianess>BigEndian</Endianess></IntReg>
+  <Category Name="AcquisitionControl" NameSpace="Standard">
+    <pFeature>AcquisitionMode</pFeature>
+    <pFeature>AcquisitionStart</pFeature>
+    <pFeature>AcquisitionStop</pFeature>
+  </Category>
+  <Enumeration Name="AcquisitionMode" NameSpace="Standard">
+    <EnumEntry Name="Continuous" NameSpace="Standard"><Value>0</Value></EnumEntry>
+    <pValue>AcquisitionModeReg</pValue>
+  </Enumeration>
+  <IntReg Name="AcquisitionModeReg"><Address>0x10008</Address><Length>4</Length><AccessMode>RW</AccessMode><pPort>Device</pPort><Sign>Unsigned</Sign><Endianess>BigEndian</Endianess></IntReg>
+  <Command Name="AcquisitionStart" NameSpace="Standard"><pValue>AcquisitionStartReg</pValue><CommandValue>1</CommandValue></Command>
+  <IntReg Name="AcquisitionStartReg"><Address>0x10000</Address><Length>4</Length><AccessMode>WO</AccessMode><pPort>Device</pPort><Sign>Unsigned</Sign><Endianess>BigEndian</Endianess></IntReg>
+  <Command Name="AcquisitionStop" NameSpace="Standard"><pValue>AcquisitionStopReg</pValue><CommandValue>1</CommandValue></Command>
+  <IntReg Name="AcquisitionStopReg"><Address>0x10004</Address><Length>4</Length><AccessMode>WO</AccessMode><pPort>Device</pPort><Sign>Unsigned</Sign><Endianess>BigEndian</Endianess></IntReg>
+  <Category Name="TransportLayerControl" NameSpace="Standard">
+    <pFeature>PayloadSize</pFeature>
+    <pFeature>TLParamsLocked</pFeature>
+    <pFeature>GevSCPSPacketSize</pFeature>
+    <pFeature>GevSCPD</pFeature>
+    <pFeature>GevTimestampTickFrequency</pFeature>
+    <pFeature>GevHeartbeatTimeout</pFeature>
+  </Category>
+  <Integer Name="PayloadSize" NameSpace="Standard"><pValue>PayloadSizeReg</pValue></Integer>
+  <IntReg Name="PayloadSizeReg"><Address>0x10018</Address><Length>4</Length><AccessMode>RO</AccessMode><pPort>Device</pPort><Sign>Unsigned</Sign><Endianess>BigEndian</Endianess></IntReg>
+  <Integer Name="TLParamsLocked" NameSpace="Standard"><pValue>TLParamsLockedReg</pValue><Min>0</Min><Max>1</Max></Integer>
+  <IntReg Name="TLParamsLockedReg"><Address>0x1001c</Address><Length>4</Length><AccessMode>RW</AccessMode><pPort>Device</pPort><Sign>Unsigned</Sign><Endianess>BigEndian</Endianess></IntReg>
+  <Integer Name="GevSCPSPacketSize" NameSpace="Standard"><pValue>GevSCPSPacketSizeReg</pValue><Min>576</Min><Max>9000</Max><Inc>4</Inc></Integer>
+  <MaskedIntReg Name="GevSCPSPacketSizeReg"><Address>0xd04</Address><Length>4</Length><AccessMode>RW</AccessMode><pPort>Device</pPort><LSB>31</LSB><MSB>16</MSB><Sign>Unsigned</Sign><Endianess>BigEndian</Endianess></MaskedIntReg>
+  <Integer Name="GevSCPD" NameSpace="Standard"><pValue>GevSCPDReg</pValue><Min>0</Min><Max>100000</Max></Integer>
+  <IntReg Name="GevSCPDReg"><Address>0xd08</Address><Length>4</Length><AccessMode>RW</AccessMode><pPort>Device</pPort><Sign>Unsigned</Sign><Endianess>BigEndian</Endianess></IntReg>
+  <Integer Name="GevTimestampTickFrequency" NameSpace="Standard"><Value>1000000</Value></Integer>
+  <Integer Name="GevHeartbeatTimeout" NameSpace="Standard"><pValue>GevHeartbeatTimeoutReg</pValue><Min>500</Min><Max>60000</Max></Integer>
+  <IntReg Name="GevHeartbeatTimeoutReg"><Address>0x938</Address><Length>4</Length><AccessMode>RW</AccessMode><pPort>Device</pPort><Sign>Unsigned</Sign><Endianess>BigEndian</Endianess></IntReg>
+  <Port Name="Device" NameSpace="Standard"/>
+</RegisterDescription>
+)";
+
+    /**
+     * Frame kept for sending and resending, owns its packet headers and sendmmsg descriptors,
+     * they are rebuilt only when geometry or packet size changes, per frame only block id and timestamp are patched.
+     */
+    struct FrameSlot
+    {
+        std::vector<uint8_t> data;
+        std::vector<uint8_t> headers;       // GVSP_LEADER_SIZE bytes per packet
+        std::vector<struct iovec> iov;      // 2 per packet, header and payload
+        std::vector<struct mmsghdr> msgs;
+        uint16_t block_id;
+        uint32_t packet_num;                // leader + payloads + trailer
+        int packet_size;                    // SCPS this slot was built for
+    };
+
+    struct GigEData
+    {
+        std::string model;
+        int port;
+        int gvcp_fd;
+        int gvsp_fd;
+        uint16_t gvsp_port;
+        thread::Thread *gvcp_thread;
+        thread::Thread *stream_thread;
+        std::atomic<bool> exit;
+        camera::Camera *camera;
+
+        // control state, protected by lock
+        std::mutex lock;
+        std::vector<uint8_t> bootstrap;     // static part of bootstrap registers
+        std::string xml;
+        uint32_t ccp;
+        struct sockaddr_in controller;
+        uint64_t last_heartbeat_us;
+        uint32_t heartbeat_timeout_ms;
+        uint64_t ts_base_us;
+        uint64_t ts_latched;
+        uint32_t scp_port;
+        uint32_t scda;
+        uint32_t scps;
+        uint32_t scpd;
+        uint32_t acq_mode;
+        uint32_t tl_locked;
+        int width;
+        int height;
+        image::Format format;
+        uint32_t pixel_format;
+        uint32_t payload_size;
+        std::atomic<bool> acquiring;
+        std::condition_variable acq_cond;
+
+        // stream state, protected by stream_lock
+        std::mutex stream_lock;
+        std::vector<FrameSlot> slots;
+        int slot_next;
+        uint16_t block_id;
+        uint32_t connected_addr;
+        uint16_t connected_port;
+        StreamStats stats;
+    };
+
+    static bool _get_netif(const std::string &ip, uint32_t &addr, uint32_t &mask, uint8_t mac[6])
+    {
+        struct ifaddrs *ifs = NULL;
+        if (getifaddrs(&ifs) < 0)
+            return false;
+        struct ifaddrs *found = NULL, *loopback = NULL;
+        for (struct ifaddrs *i = ifs; i; i = i->ifa_next)
+        {
+            if (!i->ifa_addr || i->ifa_addr->sa_family != AF_INET || !(i->ifa_flags & IFF_UP))
+                continue;
+            struct sockaddr_in *a = (struct sockaddr_in *)i->ifa_addr;
+            if (!ip.empty())
+            {
+                if (a->sin_addr.s_addr == inet_addr(ip.c_str()))
+                {
+                    found = i;
+                    break;
+                }
+                continue;
+            }
+            if (i->ifa_flags & IFF_LOOPBACK)
+            {
+                if (!loopback)
+                    loopback = i;
+                continue;
+            }
+            found = i;
+            break;
+        }
+        if (!found)
+            found = loopback;
+        bool ok = found != NULL;
+        if (ok)
+        {
+            addr = ntohl(((struct sockaddr_in *)found->ifa_addr)->sin_addr.s_addr);
+            mask = found->ifa_netmask ? ntohl(((struct sockaddr_in *)found->ifa_netmask)->sin_addr.s_addr) : 0;
+            memset(mac, 0, 6);
+            int fd = socket(AF_INET, SOCK_DGRAM, 0);
+            if (fd >= 0)
+            {
+                struct ifreq req;
+                memset(&req, 0, sizeof(req));
+                strncpy(req.ifr_name, found->ifa_name, IFNAMSIZ - 1);
+                if (ioctl(fd, SIOCGIFHWADDR, &req) == 0)
+                    memcpy(mac, req.ifr_hwaddr.sa_data, 6);
+                close(fd);
+            }
+        }
+        freeifaddrs(ifs);
+        return ok;
+    }
+
+    static void _put_str(std::vector<uint8_t> &mem, uint32_t addr, size_t max_len, const std::string &s)
+    {
+        memset(&mem[addr], 0, max_len);
+        memcpy(&mem[addr], s.c_str(), std::min(max_len - 1, s.size()));
+    }
+
+    static void _update_geometry(GigEData *d, int width, int height, image::Format format)
+    {
+        d->width = width;
+        d->height = height;
+        d->format = format;
+        d->pixel_format = _pixel_format(format);
+        d->payload_size = width * height * image::fmt_size[format];
+    }
+
+    static void _stop_acquisition(GigEData *d)
+    {
+        d->acquiring = false;
+        d->acq_cond.notify_all();
+    }
+
+    // release control if heartbeat timeout, call with lock held
+    static void _check_heartbeat(GigEData *d)
+    {
+        if (d->ccp == 0)
+            return;
+        if (time::ticks_us() - d->last_heartbeat_us > (uint64_t)d->heartbeat_timeout_ms * 1000)
+        {
+            log::warn("[gige] controller %s heartbeat timeout, release control", inet_ntoa(d->controller.sin_addr));
+            d->ccp = 0;
+            d->scp_port = 0;
+            d->scda = 0;
+            d->tl_locked = 0;
+            _stop_acquisition(d);
+        }
+    }
+
+    // read one 32 bits register, call with lock held
+    static bool _read_reg(GigEData *d, uint32_t addr, uint32_t &value)
+    {
+        switch (addr)
+        {
+        case REG_HEARTBEAT_TIMEOUT: value = d->heartbeat_timeout_ms; return true;
+        case REG_TICK_FREQ_HIGH: value = 0; return true;
+        case REG_TICK_FREQ_LOW: value = TICK_FREQ; return true;
+        case REG_TIMESTAMP_CONTROL: value = 0; return true;
+        case REG_TIMESTAMP_HIGH: value = d->ts_latched >> 32; return true;
+        case REG_TIMESTAMP_LOW: value = d->ts_latched; return true;
+        case REG_CCP: value = d->ccp; return true;
+        case REG_SCP0: value = d->scp_port; return true;
+        case REG_SCPS0: value = d->scps; return true;
+        case REG_SCPD0: value = d->scpd; return true;
+        case REG_SCDA0: value = d->scda; return true;
+        case REG_SCSP0: value = d->gvsp_port; return true;
+        case REG_ACQ_START:
+        case REG_ACQ_STOP: value = 0; return true;
+        case REG_ACQ_MODE: value = d->acq_mode; return true;
+        case REG_WIDTH: value = d->width; return true;
+        case REG_HEIGHT: value = d->height; return true;
+        case REG_PIXEL_FORMAT: value = d->pixel_format; return true;
+        case REG_PAYLOAD_SIZE: value = d->payload_size; return true;
+        case REG_TL_LOCKED: value = d->tl_locked; return true;
+        case REG_ACQ_STATUS: value = d->acquiring ? 1 : 0; return true;
+        default:
+            break;
+        }
+        if (addr + 4 <= BOOTSTRAP_SIZE)
+        {
+            value = _get_u32(&d->bootstrap[addr]);
+            return true;
+        }
+        if (addr >= XML_ADDR && addr < XML_ADDR + d->xml.size())
+        {
+            uint8_t b[4] = {0};
+            memcpy(b, d->xml.data() + addr - XML_ADDR, std::min<size_t>(4, XML_ADDR + d->xml.size() - addr));
+            value = _get_u32(b);
+            return true;
+        }
+        return false;
+    }
+
+    static void _send_test_packet(GigEData *d);
+
+    // write one 32 bits register, call with lock held
+    static uint16_t _write_reg(GigEData *d, uint32_t addr, uint32_t value)
+    {
+        switch (addr)
+        {
+        case REG_IP_CONFIG_CURRENT:
+            _put_u32(&d->bootstrap[addr], value);
+            return GEV_STATUS_SUCCESS;
+        case REG_HEARTBEAT_TIMEOUT:
+            d->heartbeat_timeout_ms = std::max<uint32_t>(value, 500);
+            return GEV_STATUS_SUCCESS;
+        case REG_TIMESTAMP_CONTROL:
+            if (value & 0x01)
+                d->ts_base_us = time::ticks_us();
+            if (value & 0x02)
+                d->ts_latched = time::ticks_us() - d->ts_base_us;
+            return GEV_STATUS_SUCCESS;
+        case REG_SCP0:
+            d->scp_port = value & 0xffff;
+            return GEV_STATUS_SUCCESS;
+        case REG_SCPS0:
+        {
+            uint32_t size = value & 0xffff;
+            size = std::min<uint32_t>(std::max<uint32_t>(size, PACKET_SIZE_MIN), PACKET_SIZE_MAX) & ~3u;
+            d->scps = (d->scps & 0x40000000) | (value & 0x40000000) | size;
+            if (value & 0x80000000)
+                _send_test_packet(d);
+            return GEV_STATUS_SUCCESS;
+        }
+        case REG_SCPD0:
+            d->scpd = value;
+            return GEV_STATUS_SUCCESS;
+        case REG_SCDA0:
+            d->scda = value;
+            return GEV_STATUS_SUCCESS;
+        case REG_ACQ_START:
+            if (value)
+            {
+                if (d->scp_port == 0 || d->scda == 0)
+                    log::warn("[gige] acquisition start without stream destination");
+                d->acquiring = true;
+                d->tl_locked = 1;
+                d->acq_cond.notify_all();
+            }
+            return GEV_STATUS_SUCCESS;
+        case REG_ACQ_STOP:
+            if (value)
+            {
+                _stop_acquisition(d);
+                d->tl_locked = 0;
+            }
+            return GEV_STATUS_SUCCESS;
+        case REG_ACQ_MODE:
+            if (value != 0)
+                return GEV_STATUS_INVALID_PARAMETER;
+            d->acq_mode = value;
+            return GEV_STATUS_SUCCESS;
+        case REG_TL_LOCKED:
+            d->tl_locked = value ? 1 : 0;
+            return GEV_STATUS_SUCCESS;
+        default:
+            break;
+        }
+        if (addr >= REG_USER_NAME && addr + 4 <= REG_USER_NAME + 16)
+        {
+            _put_u32(&d->bootstrap[addr], value);
+            return GEV_STATUS_SUCCESS;
+        }
+        uint32_t tmp;
+        return _read_reg(d, addr, tmp) ? GEV_STATUS_WRITE_PROTECT : GEV_STATUS_INVALID_ADDRESS;
+    }
+
+    static bool _is_controller(GigEData *d, const struct sockaddr_in &from)
+    {
+        return d->ccp != 0 && d->controller.sin_addr.s_addr == from.sin_addr.s_addr && d->controller.sin_port == from.sin_port;
+    }
+
+    // write CCP, grant control if nobody else holds it
+    static uint16_t _write_ccp(GigEData *d, uint32_t value, const struct sockaddr_in &from)
+    {
+        if (d->ccp != 0 && !_is_controller(d, from))
+            return GEV_STATUS_ACCESS_DENIED;
+        d->ccp = value & 0x3;
+        if (d->ccp)
+        {
+            d->controller = from;
+            d->last_heartbeat_us = time::ticks_us();
+            log::info("[gige] controlled by %s:%d", inet_ntoa(from.sin_addr), ntohs(from.sin_port));
+        }
+        else
+        {
+            d->tl_locked = 0;
+            _stop_acquisition(d);
+        }
+        return GEV_STATUS_SUCCESS;
+    }
+
+    static void _build_slot(FrameSlot &s, uint32_t payload_size, int packet_size, uint32_t pixel_format, int width, int height)
+    {
+        int data_per_packet = packet_size - IP_UDP_HEADER_SIZE - GVSP_HEADER_SIZE;
+        uint32_t payloads = (payload_size + data_per_packet - 1) / data_per_packet;
+        s.packet_num = payloads + 2;
+        s.packet_size = packet_size;
+        s.data.resize(payload_size);
+        s.headers.assign((size_t)s.packet_num * GVSP_LEADER_SIZE, 0);
+        s.iov.resize((size_t)s.packet_num * 2);
+        s.msgs.resize(s.packet_num);
+        for (uint32_t id = 0; id < s.packet_num; ++id)
+        {
+            uint8_t *h = &s.headers[(size_t)id * GVSP_LEADER_SIZE];
+            int format = id == 0 ? GVSP_FORMAT_LEADER : (id == s.packet_num - 1 ? GVSP_FORMAT_TRAILER : GVSP_FORMAT_PAYLOAD);
+            _put_u32(h + 4, ((uint32_t)format << 24) | id);
+            struct iovec *iov = &s.iov[(size_t)id * 2];
+            iov[0].iov_base = h;
+            iov[1].iov_base = NULL;
+            iov[1].iov_len = 0;
+            if (format == GVSP_FORMAT_LEADER)
+            {
+                _put_u16(h + 10, GVSP_PAYLOAD_IMAGE);
+                _put_u32(h + 20, pixel_format);
+                _put_u32(h + 24, width);
+                _put_u32(h + 28, height);
+                iov[0].iov_len = GVSP_LEADER_SIZE;
+            }
+            else if (format == GVSP_FORMAT_TRAILER)
+            {
+                _put_u16(h + 10, GVSP_PAYLOAD_IMAGE);
+                _put_u32(h + 12, height);
+                iov[0].iov_len = GVSP_TRAILER_SIZE;
+            }
+            else
+            {
+                size_t offset = (size_t)(id - 1) * data_per_packet;
+                iov[0].iov_len = GVSP_HEADER_SIZE;
+                iov[1].iov_base = s.data.data() + offset;
+                iov[1].iov_len = std::min<size_t>(data_per_packet, payload_size - offset);
+            }
+            struct mmsghdr &m = s.msgs[id];
+            memset(&m, 0, sizeof(m));
+            m.msg_hdr.msg_iov = iov;
+            m.msg_hdr.msg_iovlen = iov[1].iov_len ? 2 : 1;
+        }
+        s.block_id = 0;
+    }
+
+    static void _wait_us(uint64_t us)
+    {
+        // sleep is too coarse for small delays, spin instead
+        if (us >= 200)
+        {
+            time::sleep_us(us);
+            return;
+        }
+        uint64_t end = time::ticks_us() + us;
+        while (time::ticks_us() < end)
+            ;
+    }
+
+    // send packets [first, last] of slot, call with stream_lock held
+    static int _send_packets(GigEData *d, FrameSlot &s, uint32_t first, uint32_t last, uint32_t delay_us)
+    {
+        last = std::min(last, s.packet_num - 1);
+        int sent = 0;
+        // inter packet delay is applied per batch, batch is shortened so the wait stays small
+        uint32_t batch = delay_us ? std::max<uint32_t>(1, std::min<uint32_t>(SEND_BATCH, 1000 / delay_us)) : (uint32_t)SEND_BATCH;
+        for (uint32_t id = first; id <= last;)
+        {
+            uint32_t n = std::min(batch, last - id + 1);
+            int ret = sendmmsg(d->gvsp_fd, &s.msgs[id], n, 0);
+            if (ret < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                if (errno == EAGAIN || errno == ENOBUFS)
+                {
+                    // socket buffer full at line rate, let the NIC drain
+                    _wait_us(100);
+                    continue;
+                }
+                d->stats.send_errors++;
+                break;
+            }
+            for (int i = 0; i < ret; ++i)
+                d->stats.bytes += s.msgs[id + i].msg_len;
+            id += ret;
+            sent += ret;
+            if (delay_us && id <= last)
+                _wait_us((uint64_t)delay_us * ret);
+        }
+        d->stats.packets += sent;
+        return sent;
+    }
+
+    static void _connect_stream(GigEData *d, uint32_t addr, uint16_t port)
+    {
+        if (d->connected_addr == addr && d->connected_port == port)
+            return;
+        struct sockaddr_in dst;
+        memset(&dst, 0, sizeof(dst));
+        dst.sin_family = AF_INET;
+        dst.sin_addr.s_addr = htonl(addr);
+        dst.sin_port = htons(port);
+        if (connect(d->gvsp_fd, (struct sockaddr *)&dst, sizeof(dst)) < 0)
+        {
+            log::error("[gige] connect stream destination failed: %s", strerror(errno));
+            return;
+        }
+        d->connected_addr = addr;
+        d->connected_port = port;
+    }
+
+    static void _send_test_packet(GigEData *d)
+    {
+        if (d->scp_port == 0 || d->scda == 0)
+            return;
+        struct sockaddr_in dst;
+        memset(&dst, 0, sizeof(dst));
+        dst.sin_family = AF_INET;
+        dst.sin_addr.s_addr = htonl(d->scda);
+        dst.sin_port = htons(d->scp_port);
+        std::vector<uint8_t> buff((d->scps & 0xffff) - IP_UDP_HEADER_SIZE, 0);
+        // test packet carries incrementing bytes after header
+        for (size_t i = GVSP_HEADER_SIZE; i < buff.size(); ++i)
+            buff[i] = i;
+        sendto(d->gvsp_fd, buff.data(), buff.size(), 0, (struct sockaddr *)&dst, sizeof(dst));
+    }
+
+    static err::Err _send_frame(GigEData *d, image::Image *img)
+    {
+        uint32_t addr, size, delay, payload_size, pixel_format;
+        uint16_t port;
+        int width, height;
+        uint64_t ts;
+        {
+            std::lock_guard<std::mutex> lock(d->lock);
+            if (!d->acquiring)
+                return err::ERR_NOT_READY;
+            if (img->width() != d->width || img->height() != d->height || img->format() != d->format)
+                return err::ERR_ARGS;
+            addr = d->scda;
+            port = d->scp_port;
+            size = d->scps & 0xffff;
+            delay = (uint64_t)d->scpd * 1000000 / TICK_FREQ;
+            payload_size = d->payload_size;
+            pixel_format = d->pixel_format;
+            width = d->width;
+            height = d->height;
+            ts = time::ticks_us() - d->ts_base_us;
+        }
+        if (port == 0 || addr == 0)
+            return err::ERR_NOT_READY;
+
+        std::lock_guard<std::mutex> lock(d->stream_lock);
+        _connect_stream(d, addr, port);
+        FrameSlot &s = d->slots[d->slot_next];
+        d->slot_next = (d->slot_next + 1) % d->slots.size();
+        if (s.packet_size != (int)size || s.data.size() != payload_size || _get_u32(&s.headers[20]) != pixel_format
+            || _get_u32(&s.headers[24]) != (uint32_t)width)
+            _build_slot(s, payload_size, size, pixel_format, width, height);
+        memcpy(s.data.data(), img->data(), payload_size);
+        // block id 0 is reserved
+        if (++d->block_id == 0)
+            d->block_id = 1;
+        s.block_id = d->block_id;
+        for (uint32_t id = 0; id < s.packet_num; ++id)
+            _put_u16(&s.headers[(size_t)id * GVSP_LEADER_SIZE + 2], s.block_id);
+        _put_u32(&s.headers[12], ts >> 32);
+        _put_u32(&s.headers[16], ts);
+        _send_packets(d, s, 0, s.packet_num - 1, delay);
+        d->stats.frames++;
+        return err::ERR_NONE;
+    }
+
+    static void _resend(GigEData *d, uint16_t block_id, uint32_t first, uint32_t last)
+    {
+        uint32_t delay;
+        {
+            std::lock_guard<std::mutex> lock(d->lock);
+            delay = (uint64_t)d->scpd * 1000000 / TICK_FREQ;
+        }
+        std::lock_guard<std::mutex> lock(d->stream_lock);
+        d->stats.resend_requests++;
+        for (auto &s : d->slots)
+        {
+            if (s.packet_num == 0 || s.block_id != block_id)
+                continue;
+            if (first > last || first >= s.packet_num)
+                return;
+            d->stats.resent_packets += _send_packets(d, s, first, last, delay);
+            return;
+        }
+        d->stats.resend_missed++;
+    }
+
+    static void _gvcp_handle(GigEData *d, const uint8_t *req, int len, const struct sockaddr_in &from)
+    {
+        if (len < 8 || req[0] != GVCP_KEY)
+            return;
+        uint8_t flags = req[1];
+        uint16_t cmd = _get_u16(req + 2);
+        uint16_t payload_len = _get_u16(req + 4);
+        uint16_t req_id = _get_u16(req + 6);
+        const uint8_t *payload = req + 8;
+        if (payload_len > len - 8)
+            return;
+
+        uint8_t ack[8 + 540];
+        uint16_t status = GEV_STATUS_SUCCESS;
+        uint16_t ack_cmd = cmd + 1;
+        int ack_len = 0;
+        uint8_t *ap = ack + 8;
+
+        std::unique_lock<std::mutex> lock(d->lock);
+        if (_is_controller(d, from))
+            d->last_heartbeat_us = time::ticks_us();
+        bool writable = d->ccp == 0 || _is_controller(d, from);
+        switch (cmd)
+        {
+        case GVCP_DISCOVERY_CMD:
+            for (uint32_t a = 0; a < 0xF8; a += 4)
+            {
+                uint32_t v = 0;
+                _read_reg(d, a, v);
+                _put_u32(ap + a, v);
+            }
+            ack_len = 0xF8;
+            break;
+        case GVCP_READREG_CMD:
+            for (int i = 0; i + 4 <= payload_len && ack_len + 4 <= 536; i += 4)
+            {
+                uint32_t addr = _get_u32(payload + i), v = 0;
+                if (addr & 3)
+                {
+                    status = GEV_STATUS_BAD_ALIGNMENT;
+                    break;
+                }
+                if (!_read_reg(d, addr, v))
+                {
+                    status = GEV_STATUS_INVALID_ADDRESS;
+                    break;
+                }
+                _put_u32(ap + ack_len, v);
+                ack_len += 4;
+            }
+            break;
+        case GVCP_WRITEREG_CMD:
+        {
+            int i = 0;
+            for (; i + 8 <= payload_len; i += 8)
+            {
+                uint32_t addr = _get_u32(payload + i), v = _get_u32(payload + i + 4);
+                if (addr & 3)
+                    status = GEV_STATUS_BAD_ALIGNMENT;
+                else if (addr == REG_CCP)
+                    status = _write_ccp(d, v, from);
+                else if (!writable)
+                    status = GEV_STATUS_ACCESS_DENIED;
+                else
+                    status = _write_reg(d, addr, v);
+                if (status != GEV_STATUS_SUCCESS)
+                    break;
+            }
+            // index of the first failed write, or number of writes
+            _put_u16(ap, 0);
+            _put_u16(ap + 2, i / 8);
+            ack_len = 4;
+            break;
+        }
+        case GVCP_READMEM_CMD:
+        {
+            if (payload_len < 8)
+            {
+                status = GEV_STATUS_INVALID_PARAMETER;
+                break;
+            }
+            uint32_t addr = _get_u32(payload);
+            uint16_t count = _get_u16(payload + 6);
+            if ((addr & 3) || (count & 3) || count > 536)
+            {
+                status = count > 536 ? GEV_STATUS_INVALID_PARAMETER : GEV_STATUS_BAD_ALIGNMENT;
+                break;
+            }
+            _put_u32(ap, addr);
+            for (uint32_t a = 0; a < count; a += 4)
+            {
+                uint32_t v = 0;
+                if (!_read_reg(d, addr + a, v))
+                {
+                    status = GEV_STATUS_INVALID_ADDRESS;
+                    break;
+                }
+                _put_u32(ap + 4 + a, v);
+            }
+            ack_len = status == GEV_STATUS_SUCCESS ? 4 + count : 4;
+            break;
+        }
+        case GVCP_WRITEMEM_CMD:
+        {
+            uint32_t addr = payload_len >= 4 ? _get_u32(payload) : 0;
+            int count = payload_len - 4;
+            if (payload_len < 8 || (addr & 3) || (count & 3))
+                status = payload_len < 8 ? GEV_STATUS_INVALID_PARAMETER : GEV_STATUS_BAD_ALIGNMENT;
+            else if (!writable)
+                status = GEV_STATUS_ACCESS_DENIED;
+            for (int a = 0; status == GEV_STATUS_SUCCESS && a < count; a += 4)
+                status = addr + a == REG_CCP ? _write_ccp(d, _get_u32(payload + 4 + a), from) : _write_reg(d, addr + a, _get_u32(payload + 4 + a));
+            _put_u16(ap, 0);
+            _put_u16(ap + 2, status == GEV_STATUS_SUCCESS ? count : 0);
+            ack_len = 4;
+            break;
+        }
+        case GVCP_PACKETRESEND_CMD:
+            lock.unlock();
+            if (payload_len >= 12)
+            {
+                // stream channel index(16) block id(16), first packet id(24), last packet id(24)
+                uint16_t block_id = _get_u16(payload + 2);
+                uint32_t first = _get_u32(payload + 4) & 0xffffff;
+                uint32_t last = _get_u32(payload + 8) & 0xffffff;
+                _resend(d, block_id, first, last);
+            }
+            // no ack for resend
+            return;
+        default:
+            status = GEV_STATUS_NOT_IMPLEMENTED;
+            break;
+        }
+        lock.unlock();
+
+        if (!(flags & GVCP_FLAG_ACK) && cmd != GVCP_DISCOVERY_CMD)
+            return;
+        _put_u16(ack, status);
+        _put_u16(ack + 2, ack_cmd);
+        _put_u16(ack + 4, ack_len);
+        _put_u16(ack + 6, req_id);
+        sendto(d->gvcp_fd, ack, 8 + ack_len, 0, (struct sockaddr *)&from, sizeof(from));
+    }
+
+    static void _gvcp_process(void *args)
+    {
+        GigEData *d = (GigEData *)args;
+        uint8_t buff[1500];
+        while (!d->exit)
+        {
+            struct pollfd pfd = {d->gvcp_fd, POLLIN, 0};
+            int ret = poll(&pfd, 1, 100);
+            if (ret > 0)
+            {
+                struct sockaddr_in from;
+                socklen_t from_len = sizeof(from);
+                int len = recvfrom(d->gvcp_fd, buff, sizeof(buff), 0, (struct sockaddr *)&from, &from_len);
+                if (len > 0)
+                    _gvcp_handle(d, buff, len, from);
+            }
+            std::lock_guard<std::mutex> lock(d->lock);
+            _check_heartbeat(d);
+        }
+    }
+
+    static void _stream_process(void *args)
+    {
+        GigEData *d = (GigEData *)args;
+        while (!d->exit)
+        {
+            {
+                std::unique_lock<std::mutex> lock(d->lock);
+                d->acq_cond.wait_for(lock, std::chrono::milliseconds(100), [d]() { return d->acquiring.load() || d->exit.load(); });
+                if (!d->acquiring || d->exit)
+                    continue;
+            }
+            image::Image *img = d->camera->read();
+            if (!img)
+                continue;
+            err::Err e = _send_frame(d, img);
+            if (e == err::ERR_ARGS)
+                log::error("[gige] camera frame geometry changed, %dx%d", img->width(), img->height());
+            delete img;
+        }
+    }
+
+    GigEVision::GigEVision(const std::string &ip, const std::string &model, const std::string &serial, int port, int resend_frames)
+    {
+        GigEData *d = new GigEData();
+        d->model = model;
+        d->port = port;
+        d->gvcp_fd = -1;
+        d->gvsp_fd = -1;
+        d->gvsp_port = 0;
+        d->gvcp_thread = NULL;
+        d->stream_thread = NULL;
+        d->exit = false;
+        d->camera = NULL;
+        d->ccp = 0;
+        memset(&d->controller, 0, sizeof(d->controller));
+        d->last_heartbeat_us = 0;
+        d->heartbeat_timeout_ms = 3000;
+        d->ts_base_us = time::ticks_us();
+        d->ts_latched = 0;
+        d->scp_port = 0;
+        d->scda = 0;
+        d->scps = PACKET_SIZE_DEFAULT;
+        d->scpd = 0;
+        d->acq_mode = 0;
+        d->tl_locked = 0;
+        _update_geometry(d, 0, 0, image::FMT_GRAYSCALE);
+        d->acquiring = false;
+        d->slots.resize(std::max(resend_frames, 1));
+        for (auto &s : d->slots)
+        {
+            s.packet_num = 0;
+            s.packet_size = 0;
+            s.block_id = 0;
+        }
+        d->slot_next = 0;
+        d->block_id = 0;
+        d->connected_addr = 0;
+        d->connected_port = 0;
+        memset(&d->stats, 0, sizeof(d->stats));
+
+        uint32_t addr = 0, mask = 0;
+        uint8_t mac[6] = {0};
+        if (!_get_netif(ip, addr, mask, mac))
+        {
+            delete d;
+            throw err::Exception(err::ERR_ARGS, "network interface not found: " + ip);
+        }
+        char mac_str[16];
+        snprintf(mac_str, sizeof(mac_str), "%02X%02X%02X%02X%02X%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+
+        std::vector<uint8_t> &m = d->bootstrap;
+        m.assign(BOOTSTRAP_SIZE, 0);
+        _put_u32(&m[REG_VERSION], (1 << 16) | 2);
+        // big endian, transmitter, UTF8
+        _put_u32(&m[REG_DEVICE_MODE], 0x80000001);
+        _put_u32(&m[REG_MAC_HIGH], (mac[0] << 8) | mac[1]);
+        _put_u32(&m[REG_MAC_LOW], ((uint32_t)mac[2] << 24) | (mac[3] << 16) | (mac[4] << 8) | mac[5]);
+        // persistent, DHCP and LLA supported, current is the same
+        _put_u32(&m[REG_IP_CONFIG_OPTIONS], 0x00000007);
+        _put_u32(&m[REG_IP_CONFIG_CURRENT], 0x00000006);
+        _put_u32(&m[REG_CURRENT_IP], addr);
+        _put_u32(&m[REG_CURRENT_SUBNET], mask);
+        _put_u32(&m[REG_CURRENT_GATEWAY], 0);
+        _put_str(m, REG_MANUFACTURER_NAME, 32, "Sipeed");
+        _put_str(m, REG_MODEL_NAME, 32, model);
+        _put_str(m, REG_DEVICE_VERSION, 32, "1.0");
+        _put_str(m, REG_MANUFACTURER_INFO, 48, "MaixCDK GigE Vision");
+        _put_str(m, REG_SERIAL_NUMBER, 16, serial.empty() ? std::string(mac_str) : serial);
+        _put_str(m, REG_USER_NAME, 16, "");
+        _put_u32(&m[REG_NUM_INTERFACES], 1);
+        _put_u32(&m[REG_NUM_MESSAGE_CHANNELS], 0);
+        _put_u32(&m[REG_NUM_STREAM_CHANNELS], 1);
+        // user name, serial number, packet resend, WRITEMEM, concatenation
+        _put_u32(&m[REG_GVCP_CAPABILITY], 0xC0000007);
+
+        size_t xml_len = strlen(_xml_template) + model.size() + 1;
+        d->xml.resize(xml_len);
+        snprintf(&d->xml[0], xml_len, _xml_template, model.c_str());
+        d->xml.resize(strlen(d->xml.c_str()));
+        char url[128];
+        snprintf(url, sizeof(url), "Local:maixcam.xml;%x;%x", XML_ADDR, (unsigned)d->xml.size());
+        _put_str(m, REG_FIRST_URL, 512, url);
+        _put_str(m, REG_SECOND_URL, 512, url);
+        _data = d;
+    }
+
+    GigEVision::~GigEVision()
+    {
+        stop();
+        delete (GigEData *)_data;
+    }
+
+    err::Err GigEVision::start()
+    {
+        GigEData *d = (GigEData *)_data;
+        if (d->gvcp_thread)
+            return err::ERR_BUSY;
+        d->gvcp_fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        d->gvsp_fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if (d->gvcp_fd < 0 || d->gvsp_fd < 0)
+        {
+            stop();
+            return err::ERR_IO;
+        }
+        int on = 1;
+        setsockopt(d->gvcp_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        setsockopt(d->gvcp_fd, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on));
+        struct sockaddr_in a;
+        memset(&a, 0, sizeof(a));
+        a.sin_family = AF_INET;
+        a.sin_addr.s_addr = htonl(INADDR_ANY);
+        a.sin_port = htons(d->port);
+        if (bind(d->gvcp_fd, (struct sockaddr *)&a, sizeof(a)) < 0)
+        {
+            log::error("[gige] bind GVCP port %d failed: %s", d->port, strerror(errno));
+            stop();
+            return err::ERR_IO;
+        }
+        // large send buffer so a whole frame can be queued by sendmmsg
+        int sndbuf = 4 * 1024 * 1024;
+        setsockopt(d->gvsp_fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+        a.sin_port = 0;
+        socklen_t a_len = sizeof(a);
+        if (bind(d->gvsp_fd, (struct sockaddr *)&a, sizeof(a)) < 0 || getsockname(d->gvsp_fd, (struct sockaddr *)&a, &a_len) < 0)
+        {
+            stop();
+            return err::ERR_IO;
+        }
+        d->gvsp_port = ntohs(a.sin_port);
+        d->exit = false;
+        d->gvcp_thread = new thread::Thread(_gvcp_process, d);
+        if (d->camera)
+            d->stream_thread = new thread::Thread(_stream_process, d);
+        log::info("[gige] GigE Vision device started, GVCP port %d", d->port);
+        return err::ERR_NONE;
+    }
+
+    err::Err GigEVision::stop()
+    {
+        GigEData *d = (GigEData *)_data;
+        d->exit = true;
+        {
+            std::lock_guard<std::mutex> lock(d->lock);
+            _stop_acquisition(d);
+            d->ccp = 0;
+        }
+        if (d->gvcp_thread)
+        {
+            d->gvcp_thread->join();
+            delete d->gvcp_thread;
+            d->gvcp_thread = NULL;
+        }
+        if (d->stream_thread)
+        {
+            d->stream_thread->join();
+            delete d->stream_thread;
+            d->stream_thread = NULL;
+        }
+        if (d->gvcp_fd >= 0)
+            close(d->gvcp_fd);
+        if (d->gvsp_fd >= 0)
+            close(d->gvsp_fd);
+        d->gvcp_fd = -1;
+        d->gvsp_fd = -1;
+        d->connected_addr = 0;
+        d->connected_port = 0;
+        return err::ERR_NONE;
+    }
+
+    err::Err GigEVision::bind_camera(camera::Camera *camera)
+    {
+        GigEData *d = (GigEData *)_data;
+        if (d->gvcp_thread)
+            return err::ERR_BUSY;
+        err::Err e = set_format(camera->width(), camera->height(), camera->format());
+        if (e != err::ERR_NONE)
+            return e;
+        d->camera = camera;
+        return err::ERR_NONE;
+    }
+
+    err::Err GigEVision::set_format(int width, int height, image::Format format)
+    {
+        GigEData *d = (GigEData *)_data;
+        if (width <= 0 || height <= 0 || _pixel_format(format) == 0)
+        {
+            log::error("[gige] format %s not supported", image::fmt_names[format].c_str());
+            return err::ERR_ARGS;
+        }
+        std::lock_guard<std::mutex> lock(d->lock);
+        if (d->acquiring)
+            return err::ERR_BUSY;
+        _update_geometry(d, width, height, format);
+        return err::ERR_NONE;
+    }
+
+    err::Err GigEVision::write(image::Image *img)
+    {
+        GigEData *d = (GigEData *)_data;
+        if (!d->gvcp_thread)
+            return err::ERR_NOT_READY;
+        return _send_frame(d, img);
+    }
+
+    bool GigEVision::acquiring()
+    {
+        return ((GigEData *)_data)->acquiring;
+    }
+
+    bool GigEVision::connected()
+    {
+        GigEData *d = (GigEData *)_data;
+        std::lock_guard<std::mutex> lock(d->lock);
+        return d->ccp != 0;
+    }
+
+    gige::StreamStats GigEVision::stats()
+    {
+        GigEData *d = (GigEData *)_data;
+        std::lock_guard<std::mutex> lock(d->stream_lock);
+        return d->stats;
+    }
+} // namespace maix::gige
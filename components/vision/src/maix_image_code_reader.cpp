@@ -0,0 +1,464 @@
+/**
+ * @author lxowalle@sipeed
+ * @copyright Sipeed Ltd 2023-
+ * @license Apache 2.0
+ * @update 2024.12.2: Add code reader for multiple code types.
+ */
+
+#include "maix_image_code_reader.hpp"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+
+namespace maix::image
+{
+    static const int TILE_SIZE = 32;
+    static const int EDGE_THRESHOLD = 24;       // gray difference of two pixels 2 apart counted as edge
+    static const float WHOLE_ROI_RATIO = 0.5;   // decode whole roi if regions cover more than this
+    static const int SIG_GRID = 4;
+    static const int SIG_TOLERANCE = 3;         // max mean difference of signature cells of an unchanged region
+
+    struct CodeRegion
+    {
+        int x, y, w, h;
+        uint8_t sig[SIG_GRID * SIG_GRID];
+        int cache;      // index in cache of hit entry, -1 if decoding is needed
+    };
+
+    struct CodeCache
+    {
+        int x, y, w, h;
+        uint8_t sig[SIG_GRID * SIG_GRID];
+        int age;
+        image::CodeReaderResult result;
+    };
+
+    struct CodeTask
+    {
+        int region;
+        int type;
+        image::CodeReaderResult result;
+    };
+
+    struct CodeReaderData
+    {
+        int types;
+        int cache_frames;
+        float min_edge_density;
+        image::QRCodeDecoderType qrcode_decoder;
+        image::ApriltagFamilies families;
+        int datamatrix_effort;
+
+        std::vector<uint8_t> gray;
+        std::vector<uint8_t> tiles;     // 1 if tile has dense edges, set to 2 when visited
+        std::vector<int> stack;
+        std::vector<CodeRegion> regions;
+        std::vector<CodeTask> tasks;
+        std::vector<CodeCache> cache;
+        image::Image *frame;            // grayscale frame of current read, shared by workers
+
+        std::vector<std::thread> workers;
+        std::mutex lock;
+        std::condition_variable cond;
+        std::condition_variable done_cond;
+        uint64_t generation;
+        std::atomic<int> next;
+        int finished;
+        int active;
+        int acked;      // workers woken for current generation, tasks must not change until all woken
+        int expected;
+        bool exit;
+    };
+
+    static void _decode(CodeReaderData *d, CodeTask &task)
+    {
+        CodeRegion &r = d->regions[task.region];
+        std::vector<int> roi = {r.x, r.y, r.w, r.h};
+        switch (task.type)
+        {
+        case image::CODE_QRCODE:
+            task.result.qrcodes = d->frame->find_qrcodes(roi, d->qrcode_decoder);
+            break;
+        case image::CODE_BARCODE:
+            task.result.barcodes = d->frame->find_barcodes(roi);
+            break;
+        case image::CODE_DATAMATRIX:
+            task.result.datamatrices = d->frame->find_datamatrices(roi, d->datamatrix_effort);
+            break;
+        case image::CODE_APRILTAG:
+            task.result.apriltags = d->frame->find_apriltags(roi, d->families);
+            break;
+        default:
+            break;
+        }
+    }
+
+    static void _run_tasks(CodeReaderData *d)
+    {
+        int n = d->tasks.size();
+        int i;
+        while ((i = d->next++) < n)
+        {
+            try
+            {
+                _decode(d, d->tasks[i]);
+            }
+            catch (std::exception &e)
+            {
+                log::error("decode code type %d failed: %s", d->tasks[i].type, e.what());
+            }
+            std::lock_guard<std::mutex> lock(d->lock);
+            if (++d->finished == n)
+                d->done_cond.notify_all();
+        }
+    }
+
+    static void _worker(CodeReaderData *d)
+    {
+        uint64_t seen = 0;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(d->lock);
+                d->cond.wait(lock, [d, seen] { return d->exit || d->generation != seen; });
+                if (d->exit)
+                    return;
+                seen = d->generation;
+                d->acked++;
+                d->active++;
+            }
+            _run_tasks(d);
+            std::lock_guard<std::mutex> lock(d->lock);
+            if (--d->active == 0)
+                d->done_cond.notify_all();
+        }
+    }
+
+    // ratio of sampled pixel pairs with large difference in every tile, tiles dense enough are marked
+    static void _mark_tiles(CodeReaderData *d, const uint8_t *gray, int stride, int rx, int ry, int rw, int rh, int tiles_w, int tiles_h)
+    {
+        d->tiles.assign(tiles_w * tiles_h, 0);
+        for (int ty = 0; ty < tiles_h; ++ty)
+        {
+            for (int tx = 0; tx < tiles_w; ++tx)
+            {
+                int x0 = rx + tx * TILE_SIZE, x1 = std::min(x0 + TILE_SIZE, rx + rw) - 2;
+                int y0 = ry + ty * TILE_SIZE, y1 = std::min(y0 + TILE_SIZE, ry + rh) - 2;
+                int edges = 0, samples = 0;
+                for (int y = y0; y < y1; y += 2)
+                {
+                    const uint8_t *row = gray + y * stride;
+                    const uint8_t *below = row + 2 * stride;
+                    for (int x = x0; x < x1; x += 2)
+                    {
+                        edges += abs(row[x + 2] - row[x]) > EDGE_THRESHOLD;
+                        edges += abs(below[x] - row[x]) > EDGE_THRESHOLD;
+                    }
+                    samples += (x1 - x0 + 1) / 2 * 2;
+                }
+                if (samples > 0 && edges >= d->min_edge_density * samples)
+                    d->tiles[ty * tiles_w + tx] = 1;
+            }
+        }
+    }
+
+    static void _signature(const uint8_t *gray, int stride, CodeRegion &r)
+    {
+        for (int gy = 0; gy < SIG_GRID; ++gy)
+        {
+            for (int gx = 0; gx < SIG_GRID; ++gx)
+            {
+                int x0 = r.x + r.w * gx / SIG_GRID, x1 = r.x + r.w * (gx + 1) / SIG_GRID;
+                int y0 = r.y + r.h * gy / SIG_GRID, y1 = r.y + r.h * (gy + 1) / SIG_GRID;
+                uint32_t sum = 0, count = 0;
+                for (int y = y0; y < y1; y += 4)
+                {
+                    for (int x = x0; x < x1; x += 4)
+                    {
+                        sum += gray[y * stride + x];
+                        count++;
+                    }
+                }
+                r.sig[gy * SIG_GRID + gx] = count ? sum / count : 0;
+            }
+        }
+    }
+
+    // group marked tiles into 8-connected regions, extended by one tile for quiet zone and merged if overlapped
+    static void _find_regions(CodeReaderData *d, int rx, int ry, int rw, int rh, int tiles_w, int tiles_h)
+    {
+        d->regions.clear();
+        for (int i = 0; i < tiles_w * tiles_h; ++i)
+        {
+            if (d->tiles[i] != 1)
+                continue;
+            int min_x = tiles_w, min_y = tiles_h, max_x = 0, max_y = 0;
+            d->stack.clear();
+            d->stack.push_back(i);
+            d->tiles[i] = 2;
+            while (!d->stack.empty())
+            {
+                int t = d->stack.back();
+                d->stack.pop_back();
+                int tx = t % tiles_w, ty = t / tiles_w;
+                min_x = std::min(min_x, tx);
+                max_x = std::max(max_x, tx);
+                min_y = std::min(min_y, ty);
+                max_y = std::max(max_y, ty);
+                for (int y = std::max(ty - 1, 0); y <= std::min(ty + 1, tiles_h - 1); ++y)
+                {
+                    for (int x = std::max(tx - 1, 0); x <= std::min(tx + 1, tiles_w - 1); ++x)
+                    {
+                        if (d->tiles[y * tiles_w + x] == 1)
+                        {
+                            d->tiles[y * tiles_w + x] = 2;
+                            d->stack.push_back(y * tiles_w + x);
+                        }
+                    }
+                }
+            }
+            CodeRegion r;
+            r.x = rx + std::max(min_x - 1, 0) * TILE_SIZE;
+            r.y = ry + std::max(min_y - 1, 0) * TILE_SIZE;
+            r.w = std::min(rx + (max_x + 2) * TILE_SIZE, rx + rw) - r.x;
+            r.h = std::min(ry + (max_y + 2) * TILE_SIZE, ry + rh) - r.y;
+            r.cache = -1;
+            d->regions.push_back(r);
+        }
+
+        bool merged = true;
+        while (merged)
+        {
+            merged = false;
+            for (size_t i = 0; i < d->regions.size() && !merged; ++i)
+            {
+                for (size_t j = i + 1; j < d->regions.size(); ++j)
+                {
+                    CodeRegion &a = d->regions[i], &b = d->regions[j];
+                    if (a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h && b.y < a.y + a.h)
+                    {
+                        int x = std::min(a.x, b.x), y = std::min(a.y, b.y);
+                        a.w = std::max(a.x + a.w, b.x + b.w) - x;
+                        a.h = std::max(a.y + a.h, b.y + b.h) - y;
+                        a.x = x;
+                        a.y = y;
+                        d->regions.erase(d->regions.begin() + j);
+                        merged = true;
+                        break;
+                    }
+                }
+            }
+        }
+
+        int area = 0;
+        for (auto &r : d->regions)
+            area += r.w * r.h;
+        if (area > WHOLE_ROI_RATIO * rw * rh)
+        {
+            d->regions.resize(1);
+            d->regions[0].x = rx;
+            d->regions[0].y = ry;
+            d->regions[0].w = rw;
+            d->regions[0].h = rh;
+        }
+    }
+
+    static void _append(image::CodeReaderResult &out, const image::CodeReaderResult &in)
+    {
+        out.qrcodes.insert(out.qrcodes.end(), in.qrcodes.begin(), in.qrcodes.end());
+        out.barcodes.insert(out.barcodes.end(), in.barcodes.begin(), in.barcodes.end());
+        out.datamatrices.insert(out.datamatrices.end(), in.datamatrices.begin(), in.datamatrices.end());
+        out.apriltags.insert(out.apriltags.end(), in.apriltags.begin(), in.apriltags.end());
+    }
+
+    CodeReader::CodeReader(int types, int threads, int cache_frames, float min_edge_density, image::QRCodeDecoderType qrcode_decoder,
+                           image::ApriltagFamilies families, int datamatrix_effort)
+    {
+        CodeReaderData *d = new CodeReaderData();
+        d->types = types;
+        d->cache_frames = cache_frames;
+        d->min_edge_density = min_edge_density;
+        d->qrcode_decoder = qrcode_decoder;
+        d->families = families;
+        d->datamatrix_effort = datamatrix_effort;
+        d->frame = nullptr;
+        d->generation = 0;
+        d->next = 0;
+        d->finished = 0;
+        d->active = 0;
+        d->acked = 0;
+        d->expected = 0;
+        d->exit = false;
+        if (threads <= 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        // caller thread decodes too
+        for (int i = 0; i < threads - 1; ++i)
+            d->workers.emplace_back(_worker, d);
+        _data = d;
+    }
+
+    CodeReader::~CodeReader()
+    {
+        CodeReaderData *d = (CodeReaderData *)_data;
+        {
+            std::lock_guard<std::mutex> lock(d->lock);
+            d->exit = true;
+        }
+        d->cond.notify_all();
+        for (auto &th : d->workers)
+            th.join();
+        delete d;
+    }
+
+    image::CodeReaderResult CodeReader::read(image::Image &img, std::vector<int> roi)
+    {
+        CodeReaderData *d = (CodeReaderData *)_data;
+        image::CodeReaderResult result;
+        int width = img.width(), height = img.height();
+        int rx = 0, ry = 0, rw = width, rh = height;
+        if (roi.size() >= 4)
+        {
+            rx = std::max(0, roi[0]);
+            ry = std::max(0, roi[1]);
+            rw = std::min(roi[2], width - rx);
+            rh = std::min(roi[3], height - ry);
+        }
+        if (rw <= 2 || rh <= 2)
+            return result;
+
+        uint8_t *gray;
+        image::Format format = img.format();
+        if (format == image::FMT_GRAYSCALE || format == image::FMT_YVU420SP || format == image::FMT_YUV420SP || format == image::FMT_YUV420P)
+        {
+            // Y plane comes first
+            gray = (uint8_t *)img.data();
+        }
+        else
+        {
+            d->gray.resize(width * height);
+            delete img.to_format(image::FMT_GRAYSCALE, d->gray.data(), d->gray.size());
+            gray = d->gray.data();
+        }
+        image::Image frame(width, height, image::FMT_GRAYSCALE, gray, width * height, false);
+        d->frame = &frame;
+
+        if (d->min_edge_density > 0)
+        {
+            int tiles_w = (rw + TILE_SIZE - 1) / TILE_SIZE, tiles_h = (rh + TILE_SIZE - 1) / TILE_SIZE;
+            _mark_tiles(d, gray, width, rx, ry, rw, rh, tiles_w, tiles_h);
+            _find_regions(d, rx, ry, rw, rh, tiles_w, tiles_h);
+        }
+        else
+        {
+            d->regions.resize(1);
+            d->regions[0].x = rx;
+            d->regions[0].y = ry;
+            d->regions[0].w = rw;
+            d->regions[0].h = rh;
+            d->regions[0].cache = -1;
+        }
+
+        // unchanged regions reuse cached results
+        if (d->cache_frames > 0)
+        {
+            for (auto &r : d->regions)
+            {
+                _signature(gray, width, r);
+                r.cache = -1;
+                for (size_t i = 0; i < d->cache.size(); ++i)
+                {
+                    CodeCache &c = d->cache[i];
+                    if (c.x != r.x || c.y != r.y || c.w != r.w || c.h != r.h || c.age >= d->cache_frames)
+                        continue;
+                    int diff = 0;
+                    for (int k = 0; k < SIG_GRID * SIG_GRID; ++k)
+                        diff = std::max(diff, abs(c.sig[k] - r.sig[k]));
+                    if (diff <= SIG_TOLERANCE)
+                    {
+                        r.cache = i;
+                        break;
+                    }
+                }
+            }
+        }
+
+        d->tasks.clear();
+        for (size_t i = 0; i < d->regions.size(); ++i)
+        {
+            if (d->regions[i].cache >= 0)
+                continue;
+            for (int type = image::CODE_QRCODE; type <= image::CODE_APRILTAG; type <<= 1)
+            {
+                if (d->types & type)
+                    d->tasks.push_back({(int)i, type, image::CodeReaderResult()});
+            }
+        }
+
+        if (!d->tasks.empty())
+        {
+            {
+                std::lock_guard<std::mutex> lock(d->lock);
+                d->next = 0;
+                d->finished = 0;
+                d->acked = 0;
+                d->expected = 0;
+                if (d->tasks.size() > 1 && !d->workers.empty())
+                {
+                    d->expected = d->workers.size();
+                    d->generation++;
+                    d->cond.notify_all();
+                }
+            }
+            _run_tasks(d);
+            std::unique_lock<std::mutex> lock(d->lock);
+            d->done_cond.wait(lock, [d] { return d->finished == (int)d->tasks.size() && d->active == 0 && d->acked == d->expected; });
+        }
+        d->frame = nullptr;
+
+        std::vector<CodeCache> cache;
+        size_t t = 0;
+        for (size_t i = 0; i < d->regions.size(); ++i)
+        {
+            CodeRegion &r = d->regions[i];
+            if (r.cache >= 0)
+            {
+                CodeCache &c = d->cache[r.cache];
+                _append(result, c.result);
+                if (d->cache_frames > 0)
+                {
+                    cache.push_back(std::move(c));
+                    cache.back().age++;
+                }
+                continue;
+            }
+            image::CodeReaderResult region_result;
+            for (; t < d->tasks.size() && d->tasks[t].region == (int)i; ++t)
+                _append(region_result, d->tasks[t].result);
+            _append(result, region_result);
+            if (d->cache_frames > 0)
+            {
+                CodeCache c = {r.x, r.y, r.w, r.h, {0}, 0, std::move(region_result)};
+                memcpy(c.sig, r.sig, sizeof(c.sig));
+                cache.push_back(std::move(c));
+            }
+        }
+        d->cache = std::move(cache);
+        return result;
+    }
+
+    std::vector<std::vector<int>> CodeReader::regions()
+    {
+        CodeReaderData *d = (CodeReaderData *)_data;
+        std::vector<std::vector<int>> out;
+        for (auto &r : d->regions)
+            out.push_back({r.x, r.y, r.w, r.h});
+        return out;
+    }
+
+    void CodeReader::clear_cache()
+    {
+        ((CodeReaderData *)_data)->cache.clear();
+    }
+} // namespace maix::image
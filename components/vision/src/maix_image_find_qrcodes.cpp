@@ -46,8 +46,8 @@ namespace maix::image
                 convert_to_imlib_image(this, &src_img);
             } else {
                 if (image::FMT_YVU420SP == _format) {
-                    gray_img = new image::Image(_width, _height, image::FMT_GRAYSCALE);
-                    memcpy(gray_img->data(), _data, _width * _height);
+                    // Y plane comes first, attach without copy
+                    gray_img = new image::Image(_width, _height, image::FMT_GRAYSCALE, (uint8_t *)_data, _width * _height, false);
                 } else {
                     gray_img = this->to_format(image::FMT_GRAYSCALE);
                 }
@@ -117,23 +117,27 @@ namespace maix::image
                 gray_img = this;
             } else {
                 if (image::FMT_YVU420SP == _format) {
-                    gray_img = new image::Image(_width, _height, image::FMT_GRAYSCALE);
-                    memcpy(gray_img->data(), _data, _width * _height);
+                    // Y plane comes first, attach without copy
+                    gray_img = new image::Image(_width, _height, image::FMT_GRAYSCALE, (uint8_t *)_data, _width * _height, false);
                 } else {
                     gray_img = this->to_format(image::FMT_GRAYSCALE);
                 }
                 need_delete_gray_img = true;
             }
             image::Image *new_img = NULL;
-            if (avail_roi[0] != 0 || avail_roi[1] != 0 || avail_roi[2] != gray_img->width() || avail_roi[3] != gray_img->height()) {
+            uint8_t *scan_data = NULL;
+            if (avail_roi[0] != 0 || avail_roi[2] != gray_img->width()) {
                 new_img = gray_img->crop(avail_roi[0], avail_roi[1], avail_roi[2], avail_roi[3]);
                 need_delete_new_img = true;
+                scan_data = (uint8_t *)new_img->data();
             } else {
+                // roi of whole rows is contiguous, scan in place
                 new_img = gray_img;
+                scan_data = (uint8_t *)gray_img->data() + avail_roi[1] * gray_img->width();
             }
 
             zbar_qrcode_result_t result;
-            zbar_scan_qrcode_in_gray((uint8_t *)new_img->data(), new_img->width(), new_img->height(), &result);
+            zbar_scan_qrcode_in_gray(scan_data, avail_roi[2], avail_roi[3], &result);
             for (int i = 0; i < result.counter; i ++) {
                 for (size_t j = 0; j < result.corners[i].size(); j += 2) {
                     result.corners[i][j] += avail_roi[0];
@@ -7,12 +7,42 @@
 
 #include "maix_image.hpp"
 #include "maix_image_util.hpp"
+#include "maix_image_template.hpp"
 #include <omv.hpp>
 
 namespace maix::image
 {
     std::vector<int> Image::find_template(image::Image &template_image, float threshold, std::vector<int> roi, int step, TemplateMatch search)
     {
+        std::vector<int> avail_roi = _get_available_roi(roi);
+
+        // Make sure ROI is bigger than or equal to template size
+        if (avail_roi[2] < template_image.width() || avail_roi[3] < template_image.height()) {
+            throw std::runtime_error("ROI must be bigger than or equal to template size");
+        }
+
+        // Make sure ROI is smaller than or equal to image size
+        if ((avail_roi[0] + avail_roi[2]) > _width || (avail_roi[1] + avail_roi[3]) > _height) {
+            throw std::runtime_error("ROI must be smaller than or equal to image size");
+        }
+
+        if (search == SEARCH_EX) {
+            // exhaustive search with the same NCC as imlib_template_match_ex, but window sums from
+            // integral image, vectorizable dot product and rows split over threads
+            TemplateMatcher matcher(0, 0);
+            try {
+                matcher.add(template_image);
+            } catch (err::Exception &e) {
+                // flat template, correlation is undefined
+                return {};
+            }
+            std::vector<TemplateMatchResult> res = matcher.match(*this, threshold, avail_roi, 1, step);
+            if (!res.empty() && res[0].score > threshold) {
+                return {res[0].x, res[0].y, res[0].w, res[0].h};
+            }
+            return {};
+        }
+
         image_t src_img, template_img;
         Image *src_gray_img = NULL, *template_gray_img = NULL;
         if (_format == image::FMT_GRAYSCALE) {
@@ -29,30 +59,8 @@ namespace maix::image
             convert_to_imlib_image(template_gray_img, &template_img);
         }
 
-        rectangle_t roi_rect;
-        std::vector<int> avail_roi = _get_available_roi(roi);
-        roi_rect.x = avail_roi[0];
-        roi_rect.y = avail_roi[1];
-        roi_rect.w = avail_roi[2];
-        roi_rect.h = avail_roi[3];
-
-        // Make sure ROI is bigger than or equal to template size
-        if (roi_rect.w < template_img.w || roi_rect.h < template_img.h) {
-            throw std::runtime_error("ROI must be bigger than or equal to template size");
-        }
-
-        // Make sure ROI is smaller than or equal to image size
-        if ((roi_rect.x + roi_rect.w) > src_img.w || (roi_rect.y + roi_rect.h) > src_img.h) {
-            throw std::runtime_error("ROI must be smaller than or equal to image size");
-        }
-
         rectangle_t r;
-        float corr;
-        if (search == SEARCH_DS) {
-            corr = imlib_template_match_ds(&src_img, &template_img, &r);
-        } else {
-            corr = imlib_template_match_ex(&src_img, &template_img, &roi_rect, step, &r);
-        }
+        float corr = imlib_template_match_ds(&src_img, &template_img, &r);
 
         if (_format != image::FMT_GRAYSCALE) {
             delete src_gray_img;
@@ -1,6 +1,7 @@
 #include "maix_image.hpp"
 #include "maix_time.hpp"
 #include "maix_image_util.hpp"
+#include "maix_image_line_tracker.hpp"
 #include <vector>
 #include <list>
 
@@ -157,7 +158,8 @@ static std::vector<int> get_center_point(std::vector<std::vector<int>> points)
 }
 
 
-static point_t get_center_point2(std::list<point_t> points)
+template <typename T>
+static point_t get_center_point2(const T &points)
 {
     point_t out;
     auto points_size = points.size();
@@ -463,7 +465,8 @@ static void calculate_magnitude_theta_and_rho(point_t p1, point_t p2, int &magni
     DEBUG_PRT("magnitude %d theta:%d rho:%d", magnitude, theta, rho);
 }
 
-static image::Line points_to_line(std::list<point_t> points)
+template <typename T>
+static image::Line points_to_line(const T &points)
 {
     DEBUG_EN(0);
 
@@ -495,22 +498,21 @@ typedef struct {
     LinePoint points;
 } temp_line_t;
 
-static std::vector<temp_line_t>  sort_image_line_and_get_type(std::vector<temp_line_t> temp_lines, LineType &type)
+// lines must be sorted by magnitude
+static LineType get_lines_type(std::vector<image::Line> &lines)
 {
     DEBUG_EN(0);
-    std::sort(temp_lines.begin(), temp_lines.end(), [](temp_line_t line1, temp_line_t line2) {
-        return line1.line.magnitude() < line2.line.magnitude();
-    });
+    LineType type;
 
     #define CHECK_IS_PERPENDICULAR(theta_diff)  (theta_diff >= 75 && theta_diff <= 105)
     #define CHECK_IS_PARALLEL(theta_diff)       (theta_diff >= -15 && theta_diff <= 15)
 
-    DEBUG_PRT("calculate the type of lines(%ld)", temp_lines.size());
-    switch (temp_lines.size()) {
+    DEBUG_PRT("calculate the type of lines(%ld)", lines.size());
+    switch (lines.size()) {
     case 2:
     {
-        auto l1 = temp_lines[0].line;
-        auto l2 = temp_lines[1].line;
+        auto l1 = lines[0];
+        auto l2 = lines[1];
         auto theta1 = l1.theta();
         auto theta2 = l2.theta();
         auto theta_diff = abs(theta2 - theta1);
@@ -524,9 +526,9 @@ static std::vector<temp_line_t>  sort_image_line_and_get_type(std::vector<temp_l
     }
     case 3:
     {
-        auto l1 = temp_lines[0].line;
-        auto l2 = temp_lines[1].line;
-        auto l3 = temp_lines[2].line;
+        auto l1 = lines[0];
+        auto l2 = lines[1];
+        auto l3 = lines[2];
         auto theta1 = l1.theta();
         auto theta2 = l2.theta();
         auto theta3 = l3.theta();
@@ -555,10 +557,10 @@ static std::vector<temp_line_t>  sort_image_line_and_get_type(std::vector<temp_l
     }
     case 4:
     {
-        auto l1 = temp_lines[0].line;
-        auto l2 = temp_lines[1].line;
-        auto l3 = temp_lines[2].line;
-        auto l4 = temp_lines[2].line;
+        auto l1 = lines[0];
+        auto l2 = lines[1];
+        auto l3 = lines[2];
+        auto l4 = lines[2];
         auto theta1 = l1.theta();
         auto theta2 = l2.theta();
         auto theta3 = l3.theta();
@@ -585,23 +587,28 @@ static std::vector<temp_line_t>  sort_image_line_and_get_type(std::vector<temp_l
         break;
     }
 
+    return type;
+}
+
+static std::vector<temp_line_t>  sort_image_line_and_get_type(std::vector<temp_line_t> temp_lines, LineType &type)
+{
+    std::sort(temp_lines.begin(), temp_lines.end(), [](temp_line_t line1, temp_line_t line2) {
+        return line1.line.magnitude() < line2.line.magnitude();
+    });
+
+    std::vector<image::Line> lines;
+    for (auto &temp_line: temp_lines) {
+        lines.push_back(temp_line.line);
+    }
+    type = get_lines_type(lines);
     return temp_lines;
 }
 
-std::vector<image::LineGroup> Image::search_line_path(std::vector<std::vector<int>> thresholds, int detect_pixel_size, int point_merge_size, int connection_max_size, int connection_max_distance, int connection_max_angle)
+// search from scratch, key points are drawn on draw_img if not nullptr
+static std::vector<image::LineGroup> search_line_path_full(image::Image *gray_img, image::Image *draw_img, std::vector<std::vector<int>> &thresholds, int detect_pixel_size, int point_merge_size, int connection_max_size, int connection_max_distance, int connection_max_angle)
 {
     DEBUG_EN(0);
     std::vector<LineGroup> line_group;
-    auto gray_img = (image::Image *)nullptr;
-    auto need_free_gray_img = false;
-    if (format() != image::FMT_GRAYSCALE) {
-        gray_img = this->to_format(image::FMT_GRAYSCALE);
-        need_free_gray_img = true;
-    } else {
-        gray_img = this;
-        need_free_gray_img = false;
-    }
-
 #if __DEBUG
     uint64_t t = time::ticks_ms(), t2 = 0;
 #endif
@@ -648,11 +655,11 @@ std::vector<image::LineGroup> Image::search_line_path(std::vector<std::vector<in
     t2 = time::ticks_ms(), log::info("merge points use %lld ms", t2 - t);
 #endif
 
-#if 1
-    for (auto &p: merge_points_res) {
-        this->draw_cross(p[0], p[1], image::COLOR_GRAY, 5, 2);
+    if (draw_img) {
+        for (auto &p: merge_points_res) {
+            draw_img->draw_cross(p[0], p[1], image::COLOR_GRAY, 5, 2);
+        }
     }
-#endif
 #if __DEBUG
     if (DEBUG_IS_ENABLE()) {
         DEBUG_PRT("merge_points_res size:%ld", merge_points_res.size());
@@ -723,9 +730,295 @@ std::vector<image::LineGroup> Image::search_line_path(std::vector<std::vector<in
 #if __DEBUG
     t2 = time::ticks_ms(), log::info("create result use %lld ms", t2 - t), t = time::ticks_ms();
 #endif
+    return line_group;
+}
+
+std::vector<image::LineGroup> Image::search_line_path(std::vector<std::vector<int>> thresholds, int detect_pixel_size, int point_merge_size, int connection_max_size, int connection_max_distance, int connection_max_angle)
+{
+    auto gray_img = (image::Image *)nullptr;
+    auto need_free_gray_img = false;
+    if (format() != image::FMT_GRAYSCALE) {
+        gray_img = this->to_format(image::FMT_GRAYSCALE);
+        need_free_gray_img = true;
+    } else {
+        gray_img = this;
+        need_free_gray_img = false;
+    }
+
+    auto line_group = search_line_path_full(gray_img, this, thresholds, detect_pixel_size, point_merge_size, connection_max_size, connection_max_distance, connection_max_angle);
+
     if (need_free_gray_img) {
         delete gray_img;
     }
     return line_group;
 }
+
+typedef struct {
+    std::vector<point_t> points;    // sorted from first point
+} tracked_line_t;
+
+typedef struct {
+    int id;
+    std::vector<tracked_line_t> lines;
+} tracked_group_t;
+
+typedef struct {
+    std::vector<std::vector<int>> thresholds;
+    uint8_t lut[256];               // 1 if gray value matches any threshold
+    int detect_pixel_size;
+    int point_merge_size;
+    int connection_max_size;
+    int connection_max_distance;
+    int connection_max_angle;
+    int full_search_interval;
+    int frames_since_full;
+    bool full_searched;
+    std::vector<tracked_group_t> groups;
+    // buffers reused by every frame
+    std::vector<uint8_t> gray;
+    std::vector<uint8_t> band;      // grid blocks to scan
+    std::vector<point_t> points;
+    std::vector<int> owner;         // group index * 256 + line index of points, -1 if not assigned
+    std::vector<point_t> line_points;
+} line_tracker_t;
+
+static double point_to_segment_distance(point_t p, point_t a, point_t b)
+{
+    double dx = b.x - a.x, dy = b.y - a.y;
+    double len2 = dx * dx + dy * dy;
+    double t = len2 > 0 ? ((p.x - a.x) * dx + (p.y - a.y) * dy) / len2 : 0;
+    t = std::max(0.0, std::min(1.0, t));
+    double ex = a.x + t * dx - p.x, ey = a.y + t * dy - p.y;
+    return std::sqrt(ex * ex + ey * ey);
+}
+
+// merge points closer than distance into their center, in place
+static void merge_points_inplace(std::vector<point_t> &points, int distance)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < points.size(); i ++) {
+        int sum_x = points[i].x, sum_y = points[i].y, count = 1;
+        for (size_t j = i + 1; j < points.size(); j ++) {
+            if (get_points_distance2(points[i], points[j]) <= distance) {
+                sum_x += points[j].x;
+                sum_y += points[j].y;
+                count ++;
+                points[j] = points.back();
+                points.pop_back();
+                j --;
+            }
+        }
+        points[n ++] = {sum_x / count, sum_y / count};
+    }
+    points.resize(n);
+}
+
+static void line_tracker_save_groups(line_tracker_t *d, std::vector<image::LineGroup> &groups)
+{
+    d->groups.clear();
+    for (auto &group: groups) {
+        tracked_group_t g;
+        g.id = group.id();
+        for (auto &line_points: group.points()) {
+            tracked_line_t l;
+            l.points.reserve(line_points.size());
+            for (auto &p: line_points) {
+                l.points.push_back({p[0], p[1]});
+            }
+            g.lines.push_back(std::move(l));
+        }
+        d->groups.push_back(std::move(g));
+    }
+}
+
+// scan blocks on and around last paths, return false if paths lost and full search is needed
+static bool line_tracker_track(line_tracker_t *d, const uint8_t *gray, int width, int height, std::vector<image::LineGroup> &out)
+{
+    int size = d->detect_pixel_size;
+    int grid_w = (width + size - 1) / size, grid_h = (height + size - 1) / size;
+    d->band.assign(grid_w * grid_h, 0);
+    for (auto &g: d->groups) {
+        for (auto &l: g.lines) {
+            for (auto &p: l.points) {
+                int gx = std::min(std::max(p.x / size, 0), grid_w - 1), gy = std::min(std::max(p.y / size, 0), grid_h - 1);
+                for (int y = std::max(gy - 1, 0); y <= std::min(gy + 1, grid_h - 1); y ++) {
+                    for (int x = std::max(gx - 1, 0); x <= std::min(gx + 1, grid_w - 1); x ++) {
+                        d->band[y * grid_w + x] = 1;
+                    }
+                }
+            }
+        }
+    }
+
+    // one key point per block, the center of matched pixels
+    int pixels_threshold = size * size / 4;
+    d->points.clear();
+    for (int gy = 0; gy < grid_h; gy ++) {
+        for (int gx = 0; gx < grid_w; gx ++) {
+            if (!d->band[gy * grid_w + gx]) continue;
+            int x0 = gx * size, x1 = std::min(x0 + size, width);
+            int y0 = gy * size, y1 = std::min(y0 + size, height);
+            int count = 0, sum_x = 0, sum_y = 0;
+            for (int y = y0; y < y1; y ++) {
+                const uint8_t *row = gray + y * width;
+                int row_count = 0;
+                for (int x = x0; x < x1; x ++) {
+                    int hit = d->lut[row[x]];
+                    row_count += hit;
+                    sum_x += hit * x;
+                }
+                count += row_count;
+                sum_y += row_count * y;
+            }
+            if (count >= pixels_threshold) {
+                d->points.push_back({sum_x / count, sum_y / count});
+            }
+        }
+    }
+    merge_points_inplace(d->points, d->point_merge_size);
+
+    // assign points to the nearest last line
+    int unknown = 0;
+    d->owner.assign(d->points.size(), -1);
+    for (size_t i = 0; i < d->points.size(); i ++) {
+        double min_distance = size;
+        for (size_t gi = 0; gi < d->groups.size(); gi ++) {
+            auto &lines = d->groups[gi].lines;
+            for (size_t li = 0; li < lines.size(); li ++) {
+                auto distance = point_to_segment_distance(d->points[i], lines[li].points.front(), lines[li].points.back());
+                if (distance <= min_distance) {
+                    min_distance = distance;
+                    d->owner[i] = gi * 256 + li;
+                }
+            }
+        }
+        if (d->owner[i] < 0) {
+            unknown ++;
+        }
+    }
+    // a single outlier is noise, more means a new branch or line
+    if (unknown > 1) {
+        return false;
+    }
+
+    for (size_t gi = 0; gi < d->groups.size(); gi ++) {
+        auto &group = d->groups[gi];
+        std::vector<image::Line> lines;
+        std::vector<std::vector<std::vector<int>>> points;
+        for (size_t li = 0; li < group.lines.size(); li ++) {
+            auto &line = group.lines[li];
+            point_t first = line.points.front(), last = line.points.back();
+            d->line_points.clear();
+            for (size_t i = 0; i < d->points.size(); i ++) {
+                if (d->owner[i] == (int)(gi * 256 + li)) {
+                    d->line_points.push_back(d->points[i]);
+                }
+            }
+            if (d->line_points.size() < 3) {
+                return false;
+            }
+            // keep the direction of last frame
+            int dx = last.x - first.x, dy = last.y - first.y;
+            std::sort(d->line_points.begin(), d->line_points.end(), [first, dx, dy](point_t a, point_t b) {
+                return (a.x - first.x) * dx + (a.y - first.y) * dy < (b.x - first.x) * dx + (b.y - first.y) * dy;
+            });
+            line.points.assign(d->line_points.begin(), d->line_points.end());
+            lines.push_back(points_to_line(line.points));
+            std::vector<std::vector<int>> line_points;
+            for (auto &p: line.points) {
+                line_points.push_back({p.x, p.y});
+            }
+            points.push_back(line_points);
+        }
+
+        // the same order as full search
+        std::vector<size_t> order;
+        for (size_t i = 0; i < lines.size(); i ++) {
+            order.push_back(i);
+        }
+        std::sort(order.begin(), order.end(), [&lines](size_t a, size_t b) {
+            return lines[a].magnitude() < lines[b].magnitude();
+        });
+        std::vector<image::Line> sorted_lines;
+        std::vector<std::vector<std::vector<int>>> sorted_points;
+        for (auto i: order) {
+            sorted_lines.push_back(lines[i]);
+            sorted_points.push_back(points[i]);
+        }
+        auto type = get_lines_type(sorted_lines);
+        out.push_back(LineGroup(group.id, type, sorted_lines, sorted_points));
+    }
+    return true;
+}
+
+LinePathTracker::LinePathTracker(std::vector<std::vector<int>> thresholds, int detect_pixel_size, int point_merge_size, int connection_max_size,
+                                 int connection_max_distance, int connection_max_angle, int full_search_interval)
+{
+    err::check_bool_raise(thresholds.size() != 0, "You need to set thresholds");
+    err::check_bool_raise(detect_pixel_size > 0, "detect_pixel_size must be greater than 0");
+    line_tracker_t *d = new line_tracker_t();
+    d->thresholds = thresholds;
+    memset(d->lut, 0, sizeof(d->lut));
+    for (auto &threshold: thresholds) {
+        if (threshold.empty()) continue;
+        int l_min = std::max(0, std::min(255, threshold[0]));
+        int l_max = threshold.size() > 1 ? std::max(0, std::min(255, threshold[1])) : 255;
+        if (l_min > l_max) std::swap(l_min, l_max);
+        memset(d->lut + l_min, 1, l_max - l_min + 1);
+    }
+    d->detect_pixel_size = detect_pixel_size;
+    d->point_merge_size = point_merge_size;
+    d->connection_max_size = connection_max_size;
+    d->connection_max_distance = connection_max_distance;
+    d->connection_max_angle = connection_max_angle;
+    d->full_search_interval = full_search_interval;
+    d->frames_since_full = 0;
+    d->full_searched = false;
+    _data = d;
+}
+
+LinePathTracker::~LinePathTracker()
+{
+    delete (line_tracker_t *)_data;
+}
+
+std::vector<image::LineGroup> LinePathTracker::track(image::Image &img)
+{
+    line_tracker_t *d = (line_tracker_t *)_data;
+    int width = img.width(), height = img.height();
+    uint8_t *gray;
+    if (img.format() == image::FMT_GRAYSCALE) {
+        gray = (uint8_t *)img.data();
+    } else {
+        d->gray.resize(width * height);
+        delete img.to_format(image::FMT_GRAYSCALE, d->gray.data(), d->gray.size());
+        gray = d->gray.data();
+    }
+
+    std::vector<image::LineGroup> line_group;
+    d->frames_since_full ++;
+    bool need_full = d->groups.empty() || (d->full_search_interval > 0 && d->frames_since_full >= d->full_search_interval);
+    if (!need_full && line_tracker_track(d, gray, width, height, line_group)) {
+        d->full_searched = false;
+        return line_group;
+    }
+
+    image::Image gray_img(width, height, image::FMT_GRAYSCALE, gray, width * height, false);
+    line_group = search_line_path_full(&gray_img, nullptr, d->thresholds, d->detect_pixel_size, d->point_merge_size,
+                                       d->connection_max_size, d->connection_max_distance, d->connection_max_angle);
+    line_tracker_save_groups(d, line_group);
+    d->frames_since_full = 0;
+    d->full_searched = true;
+    return line_group;
+}
+
+void LinePathTracker::reset()
+{
+    ((line_tracker_t *)_data)->groups.clear();
+}
+
+bool LinePathTracker::full_searched()
+{
+    return ((line_tracker_t *)_data)->full_searched;
+}
 }
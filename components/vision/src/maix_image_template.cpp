@@ -0,0 +1,439 @@
+/**
+ * @author lxowalle@sipeed
+ * @copyright Sipeed Ltd 2023-
+ * @license Apache 2.0
+ * @update 2024.11.29: Add template matcher with image pyramid.
+ */
+
+#include "maix_image_template.hpp"
+#include <algorithm>
+#include <thread>
+#include <cmath>
+
+namespace maix::image
+{
+    static const int MAX_LEVELS = 4;
+    static const int MIN_COARSE_SIZE = 8;   // short side of template at its coarsest level, auto mode
+    static const int REFINE_RADIUS = 2;     // search radius around upsampled candidate at each finer level
+    static const int EXTRA_CANDIDATES = 4;  // coarse candidates kept besides max_per_template
+
+    // grayscale plane view
+    struct Plane
+    {
+        const uint8_t *data;
+        int w;
+        int h;
+        int stride;
+    };
+
+    struct TemplateLevel
+    {
+        int w;
+        int h;
+        std::vector<uint8_t> data;
+        double sum;
+        double den;     // sum of squares minus sum^2 / n, 0 means flat
+    };
+
+    struct Template
+    {
+        int id;
+        int coarsest;   // index of coarsest usable level
+        std::vector<TemplateLevel> levels;  // levels[0] is full resolution
+    };
+
+    struct Candidate
+    {
+        int x;
+        int y;
+        float score;
+    };
+
+    struct MatcherData
+    {
+        std::vector<Template> templates;
+        std::vector<uint8_t> gray;                  // frame converted to grayscale, reused
+        std::vector<std::vector<uint8_t>> pyramid;  // pyramid[l] for l >= 1, ROI only
+        std::vector<Plane> planes;                  // planes[0] points into frame at ROI
+        std::vector<std::vector<uint32_t>> isum;    // integral images of levels, (w + 1) * (h + 1)
+        std::vector<std::vector<uint64_t>> isq;
+        std::vector<bool> integral_ready;
+        std::vector<float> scores;                  // dense scan score map, reused
+    };
+
+    static void _downsample(const Plane &src, std::vector<uint8_t> &dst, Plane &out)
+    {
+        out.w = src.w / 2;
+        out.h = src.h / 2;
+        out.stride = out.w;
+        dst.resize((size_t)out.w * out.h);
+        for (int y = 0; y < out.h; ++y)
+        {
+            const uint8_t *r0 = src.data + (size_t)(2 * y) * src.stride;
+            const uint8_t *r1 = r0 + src.stride;
+            uint8_t *d = dst.data() + (size_t)y * out.w;
+            for (int x = 0; x < out.w; ++x)
+                d[x] = (r0[2 * x] + r0[2 * x + 1] + r1[2 * x] + r1[2 * x + 1] + 2) >> 2;
+        }
+        out.data = dst.data();
+    }
+
+    static void _level_stats(TemplateLevel &t)
+    {
+        double s = 0, sq = 0;
+        for (uint8_t v : t.data)
+        {
+            s += v;
+            sq += (double)v * v;
+        }
+        t.sum = s;
+        t.den = sq - s * s / ((double)t.w * t.h);
+        if (t.den < 1e-6)
+            t.den = 0;
+    }
+
+    // NCC = (dot - sum_f * sum_t / n) / sqrt(den_f * den_t), exact for integer pixels
+    static inline float _ncc(uint64_t dot, uint64_t sum, uint64_t sumsq, const TemplateLevel &t)
+    {
+        double n = (double)t.w * t.h;
+        double den_f = (double)sumsq - (double)sum * sum / n;
+        if (den_f <= 1e-6)
+            return 0;
+        return (float)(((double)dot - (double)sum * t.sum / n) / std::sqrt(den_f * t.den));
+    }
+
+    static inline uint64_t _dot(const Plane &p, const TemplateLevel &t, int x, int y)
+    {
+        uint64_t dot = 0;
+        for (int j = 0; j < t.h; ++j)
+        {
+            const uint8_t *f = p.data + (size_t)(y + j) * p.stride + x;
+            const uint8_t *tt = t.data.data() + (size_t)j * t.w;
+            // fits in 32 bits for rows shorter than 66000 pixels, lets compiler use widening multiply
+            uint32_t d = 0;
+            for (int i = 0; i < t.w; ++i)
+                d += (uint32_t)f[i] * tt[i];
+            dot += d;
+        }
+        return dot;
+    }
+
+    // window stats computed directly, used by refinement where only a few positions are visited
+    static float _ncc_at(const Plane &p, const TemplateLevel &t, int x, int y)
+    {
+        uint64_t dot = 0, sum = 0, sumsq = 0;
+        for (int j = 0; j < t.h; ++j)
+        {
+            const uint8_t *f = p.data + (size_t)(y + j) * p.stride + x;
+            const uint8_t *tt = t.data.data() + (size_t)j * t.w;
+            uint32_t d = 0, s = 0, q = 0;
+            for (int i = 0; i < t.w; ++i)
+            {
+                d += (uint32_t)f[i] * tt[i];
+                s += f[i];
+                q += (uint32_t)f[i] * f[i];
+            }
+            dot += d;
+            sum += s;
+            sumsq += q;
+        }
+        return _ncc(dot, sum, sumsq, t);
+    }
+
+    static void _build_integral(MatcherData *d, int level)
+    {
+        const Plane &p = d->planes[level];
+        int iw = p.w + 1;
+        std::vector<uint32_t> &s = d->isum[level];
+        std::vector<uint64_t> &q = d->isq[level];
+        s.assign((size_t)iw * (p.h + 1), 0);
+        q.assign((size_t)iw * (p.h + 1), 0);
+        for (int y = 0; y < p.h; ++y)
+        {
+            const uint8_t *row = p.data + (size_t)y * p.stride;
+            uint32_t rs = 0;
+            uint64_t rq = 0;
+            for (int x = 0; x < p.w; ++x)
+            {
+                rs += row[x];
+                rq += (uint32_t)row[x] * row[x];
+                s[(size_t)(y + 1) * iw + x + 1] = s[(size_t)y * iw + x + 1] + rs;
+                q[(size_t)(y + 1) * iw + x + 1] = q[(size_t)y * iw + x + 1] + rq;
+            }
+        }
+        d->integral_ready[level] = true;
+    }
+
+    // score map of all positions on step grid, rows [y0, y1) of the map
+    static void _scan_rows(MatcherData *d, int level, const TemplateLevel &t, int step, int map_w, int y0, int y1)
+    {
+        const Plane &p = d->planes[level];
+        int iw = p.w + 1;
+        const uint32_t *s = d->isum[level].data();
+        const uint64_t *q = d->isq[level].data();
+        for (int my = y0; my < y1; ++my)
+        {
+            int y = my * step;
+            float *out = d->scores.data() + (size_t)my * map_w;
+            for (int mx = 0; mx < map_w; ++mx)
+            {
+                int x = mx * step;
+                size_t a = (size_t)y * iw + x, b = a + t.w, c = a + (size_t)t.h * iw, e = c + t.w;
+                uint64_t sum = s[e] - s[b] - s[c] + s[a];
+                uint64_t sumsq = q[e] - q[b] - q[c] + q[a];
+                out[mx] = _ncc(_dot(p, t, x, y), sum, sumsq, t);
+            }
+        }
+    }
+
+    // pick up to n best positions of score map, neighbours within half template are suppressed
+    static void _pick(std::vector<float> &scores, int map_w, int map_h, int rx, int ry, int n, std::vector<Candidate> &out)
+    {
+        out.clear();
+        for (int k = 0; k < n; ++k)
+        {
+            size_t best = 0;
+            float best_score = -2;
+            for (size_t i = 0; i < (size_t)map_w * map_h; ++i)
+            {
+                if (scores[i] > best_score)
+                {
+                    best_score = scores[i];
+                    best = i;
+                }
+            }
+            if (best_score <= -2)
+                break;
+            int bx = best % map_w, by = best / map_w;
+            out.push_back({bx, by, best_score});
+            for (int y = std::max(0, by - ry); y <= std::min(map_h - 1, by + ry); ++y)
+                for (int x = std::max(0, bx - rx); x <= std::min(map_w - 1, bx + rx); ++x)
+                    scores[(size_t)y * map_w + x] = -2;
+        }
+    }
+
+    TemplateMatcher::TemplateMatcher(int levels, int threads)
+    {
+        _levels = std::min(levels, MAX_LEVELS);
+        _threads = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+        _next_id = 0;
+        _data = new MatcherData();
+    }
+
+    TemplateMatcher::~TemplateMatcher()
+    {
+        delete (MatcherData *)_data;
+    }
+
+    int TemplateMatcher::add(image::Image &template_image)
+    {
+        MatcherData *d = (MatcherData *)_data;
+        Template t;
+        t.id = _next_id;
+        t.levels.resize(1);
+        TemplateLevel &l0 = t.levels[0];
+        l0.w = template_image.width();
+        l0.h = template_image.height();
+        if (l0.w < 2 || l0.h < 2)
+            throw err::Exception(err::ERR_ARGS, "template too small");
+        if (template_image.format() == image::FMT_GRAYSCALE)
+        {
+            l0.data.assign((uint8_t *)template_image.data(), (uint8_t *)template_image.data() + (size_t)l0.w * l0.h);
+        }
+        else
+        {
+            l0.data.resize((size_t)l0.w * l0.h);
+            image::Image *gray = template_image.to_format(image::FMT_GRAYSCALE, l0.data.data(), l0.data.size());
+            delete gray;
+        }
+        _level_stats(l0);
+        if (l0.den == 0)
+            throw err::Exception(err::ERR_ARGS, "template is flat, all pixels are the same");
+
+        int max_levels = _levels < 0 ? MAX_LEVELS : _levels;
+        int min_size = _levels < 0 ? MIN_COARSE_SIZE : 4;
+        while ((int)t.levels.size() <= max_levels)
+        {
+            const TemplateLevel &prev = t.levels.back();
+            if (std::min(prev.w / 2, prev.h / 2) < min_size)
+                break;
+            TemplateLevel next;
+            Plane src = {prev.data.data(), prev.w, prev.h, prev.w}, out;
+            _downsample(src, next.data, out);
+            next.w = out.w;
+            next.h = out.h;
+            _level_stats(next);
+            // coarse level blurred to flat can not be matched, stop at the finer one
+            if (next.den == 0)
+                break;
+            t.levels.push_back(std::move(next));
+        }
+        t.coarsest = t.levels.size() - 1;
+        d->templates.push_back(std::move(t));
+        return _next_id++;
+    }
+
+    err::Err TemplateMatcher::remove(int id)
+    {
+        MatcherData *d = (MatcherData *)_data;
+        for (auto it = d->templates.begin(); it != d->templates.end(); ++it)
+        {
+            if (it->id == id)
+            {
+                d->templates.erase(it);
+                return err::ERR_NONE;
+            }
+        }
+        return err::ERR_ARGS;
+    }
+
+    void TemplateMatcher::clear()
+    {
+        ((MatcherData *)_data)->templates.clear();
+    }
+
+    int TemplateMatcher::count()
+    {
+        return ((MatcherData *)_data)->templates.size();
+    }
+
+    std::vector<image::TemplateMatchResult> TemplateMatcher::match(image::Image &img, float threshold, std::vector<int> roi, int max_per_template, int step)
+    {
+        MatcherData *d = (MatcherData *)_data;
+        std::vector<image::TemplateMatchResult> results;
+        if (d->templates.empty() || max_per_template <= 0)
+            return results;
+        step = std::max(step, 1);
+
+        int img_w = img.width(), img_h = img.height();
+        int rx = 0, ry = 0, rw = img_w, rh = img_h;
+        if (roi.size() >= 4)
+        {
+            rx = std::max(0, roi[0]);
+            ry = std::max(0, roi[1]);
+            rw = std::min(roi[2], img_w - rx);
+            rh = std::min(roi[3], img_h - ry);
+        }
+        if (rw <= 0 || rh <= 0)
+            return results;
+
+        const uint8_t *gray;
+        if (img.format() == image::FMT_GRAYSCALE)
+        {
+            gray = (const uint8_t *)img.data();
+        }
+        else
+        {
+            d->gray.resize((size_t)img_w * img_h);
+            image::Image *g = img.to_format(image::FMT_GRAYSCALE, d->gray.data(), d->gray.size());
+            delete g;
+            gray = d->gray.data();
+        }
+
+        int levels = 0;
+        for (auto &t : d->templates)
+            levels = std::max(levels, t.coarsest);
+        d->planes.resize(levels + 1);
+        d->pyramid.resize(levels + 1);
+        d->isum.resize(levels + 1);
+        d->isq.resize(levels + 1);
+        d->integral_ready.assign(levels + 1, false);
+        d->planes[0] = {gray + (size_t)ry * img_w + rx, rw, rh, img_w};
+        for (int l = 1; l <= levels; ++l)
+            _downsample(d->planes[l - 1], d->pyramid[l], d->planes[l]);
+
+        std::vector<Candidate> candidates;
+        for (auto &t : d->templates)
+        {
+            // image level may be smaller than template level after rounding, use a finer one
+            int level = t.coarsest;
+            while (level > 0 && (d->planes[level].w < t.levels[level].w || d->planes[level].h < t.levels[level].h))
+                --level;
+            const TemplateLevel &tl = t.levels[level];
+            const Plane &p = d->planes[level];
+            if (p.w < tl.w || p.h < tl.h)
+                continue;
+
+            // dense scan, step only applies when scanning full resolution
+            int s = level == 0 ? step : 1;
+            int map_w = (p.w - tl.w) / s + 1, map_h = (p.h - tl.h) / s + 1;
+            if (!d->integral_ready[level])
+                _build_integral(d, level);
+            d->scores.resize((size_t)map_w * map_h);
+            int threads = std::min(_threads, map_h);
+            if (threads > 1 && (size_t)map_w * map_h * tl.w * tl.h > 1000000)
+            {
+                std::vector<std::thread> ths;
+                int band = (map_h + threads - 1) / threads;
+                for (int i = 0; i < threads; ++i)
+                {
+                    int y0 = i * band, y1 = std::min(map_h, y0 + band);
+                    if (y0 < y1)
+                        ths.emplace_back(_scan_rows, d, level, std::cref(tl), s, map_w, y0, y1);
+                }
+                for (auto &th : ths)
+                    th.join();
+            }
+            else
+            {
+                _scan_rows(d, level, tl, s, map_w, 0, map_h);
+            }
+            _pick(d->scores, map_w, map_h, std::max(1, tl.w / 2 / s), std::max(1, tl.h / 2 / s),
+                  max_per_template + (level > 0 ? EXTRA_CANDIDATES : 0), candidates);
+
+            // refine candidates down to full resolution
+            std::vector<image::TemplateMatchResult> found;
+            for (auto &c : candidates)
+            {
+                int x = c.x * s, y = c.y * s;
+                float score = c.score;
+                for (int l = level - 1; l >= 0; --l)
+                {
+                    const TemplateLevel &fl = t.levels[l];
+                    const Plane &fp = d->planes[l];
+                    int cx = x * 2, cy = y * 2;
+                    score = -2;
+                    for (int yy = std::max(0, cy - REFINE_RADIUS); yy <= std::min(fp.h - fl.h, cy + REFINE_RADIUS); ++yy)
+                    {
+                        for (int xx = std::max(0, cx - REFINE_RADIUS); xx <= std::min(fp.w - fl.w, cx + REFINE_RADIUS); ++xx)
+                        {
+                            float v = _ncc_at(fp, fl, xx, yy);
+                            if (v > score)
+                            {
+                                score = v;
+                                x = xx;
+                                y = yy;
+                            }
+                        }
+                    }
+                }
+                if (score < threshold)
+                    continue;
+                // candidates may converge to the same place
+                bool dup = false;
+                for (auto &f : found)
+                {
+                    if (abs(f.x - (x + rx)) <= t.levels[0].w / 2 && abs(f.y - (y + ry)) <= t.levels[0].h / 2)
+                    {
+                        if (score > f.score)
+                        {
+                            f.x = x + rx;
+                            f.y = y + ry;
+                            f.score = score;
+                        }
+                        dup = true;
+                        break;
+                    }
+                }
+                if (!dup)
+                    found.push_back({t.id, x + rx, y + ry, t.levels[0].w, t.levels[0].h, score});
+            }
+            std::sort(found.begin(), found.end(), [](const image::TemplateMatchResult &a, const image::TemplateMatchResult &b) { return a.score > b.score; });
+            if ((int)found.size() > max_per_template)
+                found.resize(max_per_template);
+            results.insert(results.end(), found.begin(), found.end());
+        }
+        std::sort(results.begin(), results.end(), [](const image::TemplateMatchResult &a, const image::TemplateMatchResult &b) { return a.score > b.score; });
+        return results;
+    }
+} // namespace maix::image
@@ -3,6 +3,7 @@
  * @copyright Sipeed Ltd 2023-
  * @license Apache 2.0
  * @update 2023.9.8: Add framework, create this file.
+ * @update 2024.11.28: Skip unchanged frames, adapt quality and resolution to link throughput, latest frame mailbox.
  */
 
 
@@ -13,7 +14,8 @@
 #include <websocketpp/client.hpp>
 
 #include <iostream>
-#include <queue>
+#include <mutex>
+#include <condition_variable>
 
 typedef websocketpp::client<websocketpp::config::asio_client> client;
 // pull out the type of messages sent by our config
@@ -45,25 +47,20 @@ enum ImageTransFmt
 
 namespace maix
 {
-    struct QueueItem
-    {
-        image::Image *p_img;
-    };
-
-    template <typename T, int MaxLen, typename Container = std::deque<T>>
-    class FixedQueue : public std::queue<T, Container>
-    {
-    public:
-        void push(const T &value)
-        {
-            if (this->size() == MaxLen)
-            {
-                // just ignore
-                return;
-            }
-            std::queue<T, Container>::push(value);
-        }
-    };
+    // frames are compared on a grid of sampled block means, unchanged frames are not encoded and sent
+    static const int SIG_GRID_W = 16;
+    static const int SIG_GRID_H = 12;
+    static const int SIG_DIFF_THRESHOLD = 3;
+    static const int KEYFRAME_INTERVAL_MS = 1000;   // unchanged frame is still sent every interval
+
+    // quality first drops to QUALITY_MIN, then resolution is halved, up to SCALE_MAX
+    static const int QUALITY_MIN = 30;
+    static const int QUALITY_STEP = 10;
+    static const int SCALE_MAX = 4;
+    static const int GOOD_FRAMES_TO_RAISE = 5;
+    static const int MIN_FRAME_INTERVAL_MS = 33;
+    // small socket buffer, or kernel buffer hides the link throughput and frames queue up as lag
+    static const int SEND_BUFFER_SIZE = 64 * 1024;
 
     struct ClientHandle
     {
@@ -73,9 +70,25 @@ namespace maix
         bool conn_fail;
         bool th_exit;
         bool conn_connected;
-        FixedQueue<QueueItem, 4> img_queue;
-        std::vector<uint8_t> frame_buffer;
         ImageTrans *img_trans;
+
+        // latest frame wins mailbox, a newer encoded frame replaces the one not taken yet
+        std::mutex lock;
+        std::condition_variable cond;
+        image::Image *mailbox;
+        bool sending;               // sender is busy till websocket buffer drained, new frames are dropped before encoding
+
+        // change detection, only accessed by send_image caller
+        uint8_t sig[SIG_GRID_W * SIG_GRID_H];
+        bool sig_valid;
+        uint64_t last_send_ms;
+        uint64_t last_frame_ms;
+        float frame_interval_ms;
+
+        // rate control, updated by sender thread
+        int quality;
+        int scale;
+        int good_cnt;
     };
 
     inline uint8_t get_img_encode_id(image::Format fmt)
@@ -227,9 +240,103 @@ namespace maix
 
     }
 
-    void send_image_process(void *args)
+    // build message in place from header, image data and checksum, data is copied only once
+    static size_t send_frame(client::connection_ptr con, image::Image *img, websocketpp::lib::error_code &ec)
+    {
+        size_t data_size = img->data_size();
+        uint8_t header[11] = {0xAC, 0xBE, 0xCB, 0xCA, 0x00, 0x00, 0x00, 0x00, P_VERSION, MSG_ID_IMG, get_img_encode_id(img->format())};
+        ((uint32_t*)header)[1] = data_size + 4;
+        uint8_t sum = sum_uint8(header, sizeof(header)) + sum_uint8((uint8_t *)img->data(), data_size);
+        message_ptr msg = websocketpp::lib::make_shared<websocketpp::config::asio_client::message_type>(nullptr, websocketpp::frame::opcode::binary, data_size + 12);
+        msg->append_payload(header, sizeof(header));
+        msg->append_payload(img->data(), data_size);
+        msg->append_payload(&sum, 1);
+        ec = con->send(msg);
+        return data_size + 12;
+    }
+
+    // frame sent and drained in send_ms, lower quality or resolution if slower than app frame rate, raise if much faster
+    static void update_rate(ClientHandle *handle, size_t size, uint64_t send_ms)
+    {
+        float target = std::max<float>(handle->frame_interval_ms, MIN_FRAME_INTERVAL_MS);
+        int max_quality = handle->img_trans->get_quality();
+        std::lock_guard<std::mutex> lock(handle->lock);
+        handle->quality = std::min(handle->quality, max_quality);
+        if (send_ms > target * 1.5f)
+        {
+            handle->good_cnt = 0;
+            if (handle->quality > QUALITY_MIN)
+                handle->quality = std::max(QUALITY_MIN, handle->quality - QUALITY_STEP);
+            else if (handle->scale < SCALE_MAX)
+                handle->scale *= 2;
+            else
+                return;
+            log::debug("image trans slow, %d bytes in %d ms, quality %d, scale 1/%d\n", (int)size, (int)send_ms, handle->quality, handle->scale);
+        }
+        else if (send_ms < target * 0.5f)
+        {
+            if (++handle->good_cnt < GOOD_FRAMES_TO_RAISE)
+                return;
+            handle->good_cnt = 0;
+            // get resolution back once quality is acceptable
+            if (handle->scale > 1 && handle->quality >= (QUALITY_MIN + max_quality) / 2)
+                handle->scale /= 2;
+            else if (handle->quality < max_quality)
+                handle->quality = std::min(max_quality, handle->quality + QUALITY_STEP / 2);
+        }
+        else
+        {
+            handle->good_cnt = 0;
+        }
+    }
+
+    // sampled block means of raw image, return false if not supported
+    static bool frame_signature(image::Image &img, uint8_t *sig)
+    {
+        image::Format fmt = img.format();
+        if (fmt > image::FMT_COMPRESSED_MIN)
+            return false;
+        int w = img.width(), h = img.height();
+        float fmt_size = image::fmt_size[fmt];
+        // YUV420 images use luma plane only
+        int bpp = fmt_size == (int)fmt_size ? (int)fmt_size : 1;
+        if (bpp < 1 || w < SIG_GRID_W * 4 || h < SIG_GRID_H * 4)
+            return false;
+        const uint8_t *data = (const uint8_t *)img.data();
+        int bw = w / SIG_GRID_W, bh = h / SIG_GRID_H;
+        for (int by = 0; by < SIG_GRID_H; ++by)
+        {
+            for (int bx = 0; bx < SIG_GRID_W; ++bx)
+            {
+                uint32_t sum = 0;
+                for (int sy = 0; sy < 4; ++sy)
+                {
+                    const uint8_t *row = data + ((size_t)(by * bh + sy * bh / 4 + bh / 8) * w + bx * bw + bw / 8) * bpp;
+                    for (int sx = 0; sx < 4; ++sx)
+                    {
+                        const uint8_t *p = row + (size_t)(sx * bw / 4) * bpp;
+                        for (int i = 0; i < bpp; ++i)
+                            sum += p[i];
+                    }
+                }
+                sig[by * SIG_GRID_W + bx] = sum / (16 * bpp);
+            }
+        }
+        return true;
+    }
+
+    static bool frame_changed(const uint8_t *a, const uint8_t *b)
+    {
+        for (int i = 0; i < SIG_GRID_W * SIG_GRID_H; ++i)
+        {
+            if (abs((int)a[i] - (int)b[i]) > SIG_DIFF_THRESHOLD)
+                return true;
+        }
+        return false;
+    }
+
+    static void send_image_loop(ClientHandle *handle)
     {
-        ClientHandle *handle = (ClientHandle *)args;
         client *c = handle->c;
         websocketpp::connection_hdl hdl = handle->hdl;
         websocketpp::lib::error_code ec;
@@ -296,55 +403,52 @@ namespace maix
             }
         }
 
+        websocketpp::lib::error_code con_ec;
+        client::connection_ptr con = c->get_con_from_hdl(hdl, con_ec);
+        if (con_ec)
+        {
+            log::error("get connection failed: %s", con_ec.message().c_str());
+            handle->init = false;
+            return;
+        }
         while (handle->init)
         {
-            if (handle->img_queue.empty())
+            image::Image *img;
             {
-                time::sleep_ms(10);
-                continue;
+                std::unique_lock<std::mutex> lock(handle->lock);
+                handle->cond.wait_for(lock, std::chrono::milliseconds(100), [handle]() { return handle->mailbox || !handle->init; });
+                img = handle->mailbox;
+                if (!img)
+                    continue;
+                handle->mailbox = nullptr;
+                handle->sending = true;
             }
-            QueueItem &item = handle->img_queue.front();
-            if (!handle->init)
-                break;
-
-            image::Image *img = item.p_img;
-            // log::debug("send iamge, size: %ld", img.data_size());
 
-            if(handle->frame_buffer.size() < (size_t)img->data_size() + 12)
-            {
-                handle->frame_buffer.resize(img->data_size() + 12);
-                handle->frame_buffer[0] = 0xAC;
-                handle->frame_buffer[1] = 0xBE;
-                handle->frame_buffer[2] = 0xCB;
-                handle->frame_buffer[3] = 0xCA;
-                handle->frame_buffer[8] = P_VERSION;
-                handle->frame_buffer[9] = MSG_ID_IMG;
-            }
-            handle->frame_buffer[10] = get_img_encode_id(handle->img_trans->get_format());
-            memcpy(&handle->frame_buffer[11], img->data(), img->data_size());
-            ((uint32_t*)handle->frame_buffer.data())[1] = img->data_size() + 4;
-            uint8_t *p_sum = handle->frame_buffer.data() + img->data_size() + 11;
-            uint8_t *p = handle->frame_buffer.data();
-            *p_sum = 0;
-            for(int i=0; i<img->data_size() + 11; i++)
-            {
-                *p_sum += *p++;
-            }
-            c->send(hdl, handle->frame_buffer.data(), img->data_size() + 12, websocketpp::frame::opcode::binary, ec);
+            uint64_t t = time::ticks_ms();
+            size_t size = send_frame(con, img, ec);
+            delete img;
             if (ec)
             {
                 log::error("send failed because: %s", ec.message().c_str());
             }
-            delete img;
-            handle->img_queue.pop();
-        }
-        time::sleep_ms(20); // ensure ~ImageTrans's push(item) finish
-        while(!handle->img_queue.empty())
-        {
-            QueueItem &item = handle->img_queue.front();
-            delete item.p_img;
-            handle->img_queue.pop();
+            else
+            {
+                while (handle->init && con->get_buffered_amount() > 0 && time::ticks_ms() - t < 3000)
+                    time::sleep_ms(2);
+                update_rate(handle, size, time::ticks_ms() - t);
+            }
+            std::lock_guard<std::mutex> lock(handle->lock);
+            handle->sending = false;
         }
+        std::lock_guard<std::mutex> lock(handle->lock);
+        delete handle->mailbox;
+        handle->mailbox = nullptr;
+    }
+
+    void send_image_process(void *args)
+    {
+        ClientHandle *handle = (ClientHandle *)args;
+        send_image_loop(handle);
         handle->th_exit = true;
     }
 
@@ -354,6 +458,15 @@ namespace maix
         this->_handle = new ClientHandle();
         ClientHandle *handle = (ClientHandle*)this->_handle;
         handle->img_trans = this;
+        handle->mailbox = nullptr;
+        handle->sending = false;
+        handle->sig_valid = false;
+        handle->last_send_ms = 0;
+        handle->last_frame_ms = 0;
+        handle->frame_interval_ms = MIN_FRAME_INTERVAL_MS;
+        handle->quality = quality;
+        handle->scale = 1;
+        handle->good_cnt = 0;
         handle->c = new client();
         try
         {
@@ -370,6 +483,10 @@ namespace maix
             handle->c->set_open_handler(bind(&on_open, handle->c, ::_1, handle));
             // close handler
             handle->c->set_close_handler(bind(&on_close, handle->c, ::_1, handle));
+            handle->c->set_socket_init_handler([](websocketpp::connection_hdl, websocketpp::lib::asio::ip::tcp::socket &s) {
+                websocketpp::lib::asio::error_code ec;
+                s.set_option(websocketpp::lib::asio::socket_base::send_buffer_size(SEND_BUFFER_SIZE), ec);
+            });
 
             websocketpp::lib::error_code ec;
             client::connection_ptr con = handle->c->get_connection(WS_SERVER_URI, ec);
@@ -411,9 +528,7 @@ namespace maix
     {
         ClientHandle *handle = (ClientHandle *)this->_handle;
         handle->init = false;
-        QueueItem item;
-        item.p_img = new image::Image(10, 10);
-        handle->img_queue.push(item);
+        handle->cond.notify_all();
         while (!handle->th_exit)
         {
             time::sleep_ms(10);
@@ -445,35 +560,73 @@ namespace maix
                     return err::Err::ERR_NOT_READY;
             }
         }
-        image::Image *compressed = &img;
-        QueueItem item;
         if(_fmt == image::FMT_INVALID) // pause send mode
         {
             return err::Err::ERR_NONE;
         }
+        uint64_t now = time::ticks_ms();
+        if (handle->last_frame_ms)
+            handle->frame_interval_ms = handle->frame_interval_ms * 0.9f + (now - handle->last_frame_ms) * 0.1f;
+        handle->last_frame_ms = now;
+        int quality, scale;
+        {
+            std::lock_guard<std::mutex> lock(handle->lock);
+            // link busy, drop frame before encoding so the app does not pay for frames never sent
+            if (handle->sending)
+                return err::Err::ERR_NONE;
+            quality = std::min(handle->quality, this->_quality);
+            scale = handle->scale;
+        }
+        uint8_t sig[SIG_GRID_W * SIG_GRID_H];
+        bool has_sig = frame_signature(img, sig);
+        if (has_sig && handle->sig_valid && now - handle->last_send_ms < KEYFRAME_INTERVAL_MS && !frame_changed(sig, handle->sig))
+        {
+            return err::Err::ERR_NONE;
+        }
+
+        image::Image *src = &img;
+        image::Image *scaled = nullptr;
+        if (scale > 1 && img.format() < image::FMT_COMPRESSED_MIN && img.width() / scale >= 80 && img.height() / scale >= 60)
+        {
+            scaled = img.resize(img.width() / scale & ~1, img.height() / scale & ~1);
+            if (scaled)
+                src = scaled;
+        }
         // compress image to jpeg
-        if (img.format() != _fmt)
+        image::Image *compressed;
+        if (src->format() != _fmt)
         {
             if(_fmt == image::FMT_JPEG)
             {
-                compressed = img.to_jpeg(this->_quality);
+                compressed = src->to_jpeg(quality);
             }
             else
             {
-                compressed = img.to_format(_fmt);
-            }
-            if (compressed == nullptr)
-            {
-                log::error("compress image failed\n");
-                return err::Err::ERR_RUNTIME;
+                compressed = src->to_format(_fmt);
             }
         }
         else
         {
-            compressed = img.copy();
+            compressed = src->copy();
+        }
+        delete scaled;
+        if (compressed == nullptr)
+        {
+            log::error("compress image failed\n");
+            return err::Err::ERR_RUNTIME;
+        }
+        if (has_sig)
+        {
+            memcpy(handle->sig, sig, sizeof(sig));
+            handle->sig_valid = true;
+        }
+        handle->last_send_ms = now;
+        {
+            std::lock_guard<std::mutex> lock(handle->lock);
+            delete handle->mailbox;
+            handle->mailbox = compressed;
         }
-        item.p_img = compressed;
-        handle->img_queue.push(item);
+        handle->cond.notify_one();
         return err::Err::ERR_NONE;
     }
 
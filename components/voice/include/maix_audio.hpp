@@ -8,6 +8,7 @@
 #pragma once
 #include "maix_basic.hpp"
 #include <memory>
+#include <functional>
 
 /**
  * @brief maix.audio module
@@ -34,6 +35,151 @@ namespace maix::audio
         FMT_U32_BE,         // unsigned 32 bits, big endian
     };
 
+    /**
+     * Get bytes of one sample of format
+     * @param format audio::Format type
+     * @return bytes of one sample, 0 if format invalid
+     * @maixcdk maix.audio.format_bytes
+     */
+    int format_bytes(audio::Format format);
+
+    /**
+     * Audio stream direction
+     * @maixcdk maix.audio.Direction
+     */
+    enum Direction
+    {
+        DIR_CAPTURE = 0,    // record from device
+        DIR_PLAYBACK,       // play to device
+    };
+
+    /**
+     * A period of audio frames borrowed from stream, valid until release/commit or next callback.
+     * @maixcdk maix.audio.Span
+     */
+    struct Span
+    {
+        uint8_t *data;          // interleaved samples
+        int frames;             // frames number, one frame contains channel samples
+        int size;               // bytes of data
+        uint64_t timestamp_us;  // time.ticks_us() when this period was captured or handed out to fill
+    };
+
+    /**
+     * Audio stream statistics
+     * @maixcdk maix.audio.StreamStats
+     */
+    struct StreamStats
+    {
+        uint64_t frames;        // frames transferred with device
+        uint32_t xruns;         // device overrun(capture) or underrun(playback) times, recovered automatically
+        uint32_t overflows;     // capture periods dropped because ring buffer full, user reads too slow
+        uint32_t underflows;    // playback periods filled with silence because ring buffer empty, user writes too slow
+    };
+
+    /**
+     * Low latency period based audio stream.
+     * A background thread moves one period at a time between device and a lock free ring buffer of periods,
+     * user gets periods by callback or by pulling borrowed spans, no memory allocation after start.
+     * Device:
+     *   - ALSA PCM name, e.g. "default", "hw:0,0", "null", "plughw:Loopback,0". mmap access is used if supported.
+     *   - "wav:/path/to/file.wav", WAV file backend paced in real time, capture reads file, playback writes file.
+     * @maixcdk maix.audio.Stream
+     */
+    class Stream
+    {
+    public:
+        /**
+         * @brief Construct a new Stream object, device is opened here, call start() to run.
+         * @param dir audio::Direction, capture or playback.
+         * @param device device name, see class description.
+         * @param sample_rate sample rate, default 16000.
+         * @param format sample format, default audio::Format::FMT_S16_LE.
+         * @param channel channel number, default 1.
+         * @param period_frames frames of one period, 0 means 10ms of sample_rate.
+         * @param periods device buffer size in periods, default 4.
+         * @param ring_periods user ring buffer size in periods, default 8.
+         * @throw err::Exception if open device failed.
+         * @maixcdk maix.audio.Stream.Stream
+         */
+        Stream(audio::Direction dir, const std::string &device = "default", int sample_rate = 16000, audio::Format format = audio::Format::FMT_S16_LE,
+               int channel = 1, int period_frames = 0, int periods = 4, int ring_periods = 8);
+        ~Stream();
+
+        /**
+         * Start stream.
+         * @param callback optional, called in stream thread for every period, capture gets recorded data,
+         *                 playback should fill the span. If set, read/write API are not usable.
+         * @return err::Err type
+         * @maixcdk maix.audio.Stream.start
+         */
+        err::Err start(std::function<void(audio::Span &)> callback = nullptr);
+
+        /**
+         * Stop stream, playback will play data already written before stop.
+         * @maixcdk maix.audio.Stream.stop
+         */
+        void stop();
+
+        /**
+         * Capture: get next recorded period, must call release() after used.
+         * @param span output span.
+         * @param timeout_ms wait timeout, -1 means wait forever, 0 means no wait.
+         * @return err::ERR_NONE if got, err::ERR_TIMEOUT if timeout, err::ERR_CANCEL if stream stopped or wav file end.
+         * @maixcdk maix.audio.Stream.read
+         */
+        err::Err read(audio::Span &span, int timeout_ms = -1);
+
+        /**
+         * Capture: release period got by read().
+         * @maixcdk maix.audio.Stream.release
+         */
+        void release();
+
+        /**
+         * Playback: get next free period to fill, must call commit() after filled.
+         * @param span output span, the size is always one period.
+         * @param timeout_ms wait timeout, -1 means wait forever, 0 means no wait.
+         * @return err::ERR_NONE if got, err::ERR_TIMEOUT if timeout, err::ERR_CANCEL if stream stopped.
+         * @maixcdk maix.audio.Stream.write
+         */
+        err::Err write(audio::Span &span, int timeout_ms = -1);
+
+        /**
+         * Playback: commit period got by write(), frames can be less than one period.
+         * @param frames valid frames filled, -1 means the whole period.
+         * @maixcdk maix.audio.Stream.commit
+         */
+        void commit(int frames = -1);
+
+        /**
+         * Get statistics
+         * @maixcdk maix.audio.Stream.stats
+         */
+        audio::StreamStats stats();
+
+        /**
+         * Frames of one period.
+         * @maixcdk maix.audio.Stream.period_frames
+         */
+        int period_frames();
+
+        /**
+         * Bytes of one frame.
+         * @maixcdk maix.audio.Stream.frame_bytes
+         */
+        int frame_bytes();
+
+        /**
+         * Actual sample rate.
+         * @maixcdk maix.audio.Stream.sample_rate
+         */
+        int sample_rate();
+
+    private:
+        void *_data;
+    };
+
     /**
      * Recorder class
      * @maixpy maix.audio.Recorder
@@ -0,0 +1,246 @@
+/**
+ * @author lxowalle@sipeed
+ * @copyright Sipeed Ltd 2023-
+ * @license Apache 2.0
+ * @update 2024.11.25: Add streaming DSP: resampler, VAD and mel features.
+ */
+
+#pragma once
+#include "maix_basic.hpp"
+#include <vector>
+
+/**
+ * Streaming audio DSP, all classes process fixed size blocks,
+ * buffers are allocated in constructor and process() never allocates memory.
+ */
+namespace maix::audio
+{
+    /**
+     * Polyphase sample rate converter.
+     * Ratio is reduced to out/in = L/M, a windowed sinc low pass prototype is split into L phases,
+     * every output sample is one dot product of taps input samples, so cost is proportional to output rate.
+     * @maixcdk maix.audio.Resampler
+     */
+    class Resampler
+    {
+    public:
+        /**
+         * Construct a new Resampler object
+         * @param in_rate input sample rate.
+         * @param out_rate output sample rate.
+         * @param channel channel number, samples are interleaved.
+         * @param max_in_frames max input frames of one process() call, larger input is processed in several steps.
+         * @param taps taps of each phase, larger is sharper and slower, default 32.
+         * @throw err::Exception if args invalid.
+         * @maixcdk maix.audio.Resampler.Resampler
+         */
+        Resampler(int in_rate, int out_rate, int channel = 1, int max_in_frames = 1024, int taps = 32);
+
+        /**
+         * Max output frames of in_frames input frames.
+         * @maixcdk maix.audio.Resampler.max_output
+         */
+        int max_output(int in_frames);
+
+        /**
+         * Resample int16 samples.
+         * @param in input interleaved samples.
+         * @param in_frames input frames number.
+         * @param out output buffer, at least max_output(in_frames) frames.
+         * @return output frames number.
+         * @maixcdk maix.audio.Resampler.process
+         */
+        int process(const int16_t *in, int in_frames, int16_t *out);
+
+        /**
+         * Resample float samples, the same as int16 version.
+         * @maixcdk maix.audio.Resampler.process
+         */
+        int process(const float *in, int in_frames, float *out);
+
+        /**
+         * Clear history, call it when input is discontinuous.
+         * @maixcdk maix.audio.Resampler.reset
+         */
+        void reset();
+
+        /**
+         * Input sample rate
+         * @maixcdk maix.audio.Resampler.in_rate
+         */
+        int in_rate() { return _in_rate; }
+
+        /**
+         * Output sample rate
+         * @maixcdk maix.audio.Resampler.out_rate
+         */
+        int out_rate() { return _out_rate; }
+
+    private:
+        int _in_rate;
+        int _out_rate;
+        int _channel;
+        int _max_in;
+        int _taps;
+        int _up;            // L
+        int _down;          // M
+        uint64_t _pos;      // position of next output in upsampled domain, relative to _work start
+        std::vector<float> _coef;   // [L][taps]
+        std::vector<float> _work;   // [channel][taps - 1 + max_in], planar
+
+        template <typename T>
+        int _process(const T *in, int in_frames, T *out);
+    };
+
+    /**
+     * Voice activity detector, decide per frame by energy above adaptive noise floor
+     * and ratio of speech band(100~4000Hz) energy, with attack and hangover smoothing.
+     * Use it to gate downstream processing like feature extraction and ASR.
+     * @maixcdk maix.audio.VAD
+     */
+    class VAD
+    {
+    public:
+        /**
+         * Construct a new VAD object
+         * @param sample_rate sample rate.
+         * @param frame_ms frame length, process() accepts exactly frame_len() samples, default 10ms.
+         * @param threshold_db energy above noise floor to be treated as speech, default 9dB.
+         * @param hangover_ms keep speech state after energy drops, default 300ms.
+         * @param attack_frames continuous voiced frames needed to enter speech state, default 3.
+         * @maixcdk maix.audio.VAD.VAD
+         */
+        VAD(int sample_rate = 16000, int frame_ms = 10, float threshold_db = 9, int hangover_ms = 300, int attack_frames = 3);
+        ~VAD();
+
+        /**
+         * Samples of one frame, mono.
+         * @maixcdk maix.audio.VAD.frame_len
+         */
+        int frame_len() { return _frame_len; }
+
+        /**
+         * Process one frame.
+         * @param frame frame_len() mono samples.
+         * @return true if in speech state.
+         * @maixcdk maix.audio.VAD.process
+         */
+        bool process(const int16_t *frame);
+
+        /**
+         * Current state
+         * @maixcdk maix.audio.VAD.is_speech
+         */
+        bool is_speech() { return _speech; }
+
+        /**
+         * Energy of last frame, dBFS.
+         * @maixcdk maix.audio.VAD.energy_db
+         */
+        float energy_db() { return _energy_db; }
+
+        /**
+         * Estimated noise floor, dBFS.
+         * @maixcdk maix.audio.VAD.noise_db
+         */
+        float noise_db() { return _noise_db; }
+
+        /**
+         * Reset state and noise floor.
+         * @maixcdk maix.audio.VAD.reset
+         */
+        void reset();
+
+    private:
+        int _sample_rate;
+        int _frame_len;
+        float _threshold_db;
+        int _hangover;
+        int _attack;
+        void *_fft;
+        std::vector<float> _buff;
+        int _band_lo;
+        int _band_hi;
+        bool _speech;
+        int _voiced_cnt;
+        int _hang_cnt;
+        int _frames;
+        float _energy_db;
+        float _noise_db;
+    };
+
+    /**
+     * Streaming log-mel filterbank and MFCC extractor.
+     * Samples are pushed in blocks, every hop samples produce one feature row into the reused features() tensor.
+     * @maixcdk maix.audio.MelFeature
+     */
+    class MelFeature
+    {
+    public:
+        /**
+         * Construct a new MelFeature object
+         * @param sample_rate sample rate.
+         * @param n_mels mel filter number, default 40.
+         * @param n_mfcc MFCC coefficients number, 0 means output log-mel filterbank energies, default 0.
+         * @param win_len window length in samples, default 400(25ms at 16kHz).
+         * @param hop hop length in samples, not larger than win_len, default 160(10ms at 16kHz).
+         * @param n_fft FFT size, power of 2 and >= win_len, 0 means the smallest valid one.
+         * @param max_block max samples of one process() call, default 1600.
+         * @param fmin lowest frequency of mel filters, default 20.
+         * @param fmax highest frequency of mel filters, 0 means sample_rate / 2.
+         * @throw err::Exception if args invalid.
+         * @maixcdk maix.audio.MelFeature.MelFeature
+         */
+        MelFeature(int sample_rate = 16000, int n_mels = 40, int n_mfcc = 0, int win_len = 400, int hop = 160,
+                   int n_fft = 0, int max_block = 1600, float fmin = 20, float fmax = 0);
+        ~MelFeature();
+
+        /**
+         * Push samples and extract features.
+         * @param pcm mono samples, at most max_block samples.
+         * @param samples samples number.
+         * @return rows written to features(), row 0 is the oldest, -1 if samples more than max_block.
+         * @maixcdk maix.audio.MelFeature.process
+         */
+        int process(const int16_t *pcm, int samples);
+
+        /**
+         * Feature tensor, float32, shape [(win_len - 1 + max_block - win_len) / hop + 1, dim()], valid rows are returned by process().
+         * Owned by this object and overwritten by next process().
+         * @maixcdk maix.audio.MelFeature.features
+         */
+        tensor::Tensor *features() { return _features; }
+
+        /**
+         * Dimension of one feature row, n_mfcc if n_mfcc > 0 else n_mels.
+         * @maixcdk maix.audio.MelFeature.dim
+         */
+        int dim() { return _n_mfcc > 0 ? _n_mfcc : _n_mels; }
+
+        /**
+         * Clear buffered samples.
+         * @maixcdk maix.audio.MelFeature.reset
+         */
+        void reset();
+
+    private:
+        int _n_mels;
+        int _n_mfcc;
+        int _win_len;
+        int _hop;
+        int _n_fft;
+        int _max_block;
+        void *_fft;
+        std::vector<float> _window;
+        std::vector<float> _samples;    // pending samples, at most win_len - 1 + max_block
+        int _samples_num;
+        std::vector<float> _frame;      // n_fft
+        std::vector<float> _power;      // n_fft / 2 + 1
+        std::vector<int> _mel_start;    // first bin of each filter
+        std::vector<int> _mel_len;      // bins of each filter
+        std::vector<float> _mel_weight; // packed weights of all filters
+        std::vector<float> _log_mel;
+        std::vector<float> _dct;        // [n_mfcc][n_mels]
+        tensor::Tensor *_features;
+    };
+} // namespace maix::audio
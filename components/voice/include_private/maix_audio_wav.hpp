@@ -0,0 +1,125 @@
+/**
+ * WAV file header helpers, only PCM format supported.
+ * @author lxowalle@sipeed
+ * @copyright Sipeed Ltd 2023-
+ * @license Apache 2.0
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "maix_fs.hpp"
+
+namespace maix::audio::wav
+{
+    static inline void _put_u32(uint8_t *p, uint32_t v)
+    {
+        p[0] = v & 0xff;
+        p[1] = (v >> 8) & 0xff;
+        p[2] = (v >> 16) & 0xff;
+        p[3] = (v >> 24) & 0xff;
+    }
+
+    static inline uint32_t _get_u32(const uint8_t *p)
+    {
+        return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+    static inline uint16_t _get_u16(const uint8_t *p)
+    {
+        return (uint16_t)p[0] | ((uint16_t)p[1] << 8);
+    }
+
+    /**
+     * Write 44 bytes header at current position, sizes are 0 and updated by finish_header.
+     * @return 0 if success
+     */
+    static inline int write_header(FILE *fp, int sample_rate, int channel, int sample_bit)
+    {
+        uint8_t h[44];
+        memcpy(h, "RIFF", 4);
+        _put_u32(h + 4, 36);
+        memcpy(h + 8, "WAVEfmt ", 8);
+        _put_u32(h + 16, 16);
+        h[20] = 1; // PCM
+        h[21] = 0;
+        h[22] = channel & 0xff;
+        h[23] = 0;
+        _put_u32(h + 24, sample_rate);
+        _put_u32(h + 28, sample_rate * channel * sample_bit / 8);
+        h[32] = (channel * sample_bit / 8) & 0xff;
+        h[33] = 0;
+        h[34] = sample_bit & 0xff;
+        h[35] = 0;
+        memcpy(h + 36, "data", 4);
+        _put_u32(h + 40, 0);
+        return fwrite(h, 1, sizeof(h), fp) == sizeof(h) ? 0 : -1;
+    }
+
+    /**
+     * Update RIFF and data size of header written by write_header.
+     * @return 0 if success
+     */
+    static inline int finish_header(FILE *fp)
+    {
+        long file_size = ftell(fp);
+        if (file_size < 44)
+            return -1;
+        fseek(fp, 0, fs::SEEK_END);
+        file_size = ftell(fp);
+        uint8_t v[4];
+        _put_u32(v, file_size - 8);
+        fseek(fp, 4, fs::SEEK_SET);
+        if (fwrite(v, 1, 4, fp) != 4)
+            return -1;
+        _put_u32(v, file_size - 44);
+        fseek(fp, 40, fs::SEEK_SET);
+        if (fwrite(v, 1, 4, fp) != 4)
+            return -1;
+        fseek(fp, 0, fs::SEEK_END);
+        return 0;
+    }
+
+    /**
+     * Parse header and seek to the beginning of pcm data, chunks before data chunk are skipped.
+     * @return 0 if success
+     */
+    static inline int read_header(FILE *fp, int *sample_rate, int *channel, int *sample_bit, uint32_t *data_size)
+    {
+        uint8_t h[12];
+        if (fread(h, 1, 12, fp) != 12 || memcmp(h, "RIFF", 4) || memcmp(h + 8, "WAVE", 4))
+            return -1;
+        bool fmt_found = false;
+        while (fread(h, 1, 8, fp) == 8)
+        {
+            uint32_t size = _get_u32(h + 4);
+            if (!memcmp(h, "fmt ", 4))
+            {
+                uint8_t f[16];
+                if (size < 16 || fread(f, 1, 16, fp) != 16)
+                    return -1;
+                if (_get_u16(f) != 1)
+                    return -2; // not pcm
+                *channel = _get_u16(f + 2);
+                *sample_rate = _get_u32(f + 4);
+                *sample_bit = _get_u16(f + 14);
+                fmt_found = true;
+                fseek(fp, size - 16 + (size & 1), fs::SEEK_CUR);
+            }
+            else if (!memcmp(h, "data", 4))
+            {
+                if (!fmt_found)
+                    return -1;
+                *data_size = size;
+                return 0;
+            }
+            else
+            {
+                fseek(fp, size + (size & 1), fs::SEEK_CUR);
+            }
+        }
+        return -1;
+    }
+} // namespace maix::audio::wav
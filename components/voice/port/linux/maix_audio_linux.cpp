@@ -3,77 +3,320 @@
  * @copyright Sipeed Ltd 2023-
  * @license Apache 2.0
  * @update 2023.9.8: Add framework, create this file.
+ * @update 2024.11.22: Implement Recorder and Player by ALSA Stream.
  */
 
 #include <stdint.h>
+#include <alsa/asoundlib.h>
 #include "maix_basic.hpp"
 #include "maix_err.hpp"
 #include "maix_audio.hpp"
+#include "maix_audio_wav.hpp"
 
 using namespace maix;
 
 namespace maix::audio
 {
+    // recorder ring holds 500ms, record() without record_ms returns what's cached like driver buffer does
+    static const int RECORDER_RING_MS = 500;
+
+    static void _check_path(const std::string &path)
+    {
+        if (path.size() > 0) {
+            std::string ext = fs::splitext(path)[1];
+            if (ext != ".wav" && ext != ".pcm") {
+                err::check_raise(err::ERR_RUNTIME, "Only files with the `.pcm` and `.wav` extensions are supported.");
+            }
+        }
+    }
+
+    static audio::Format wav_sample_bit_to_format(int sample_bit)
+    {
+        switch (sample_bit) {
+            case 8: return audio::Format::FMT_U8;
+            case 16: return audio::Format::FMT_S16_LE;
+            case 32: return audio::Format::FMT_S32_LE;
+            default: return audio::Format::FMT_NONE;
+        }
+    }
+
+    /**
+     * Get or set simple mixer element of default card.
+     * @param volume percent to set, -1 means only get.
+     * @param sw capture switch to set, -1 means not set, 0 off(mute), 1 on.
+     * @param get_switch return switch state instead of volume.
+     * @return current volume percent or switch state, -1 if element not found.
+     */
+    static int _mixer_ctrl(const char *name, bool capture, int volume, int sw, bool get_switch = false)
+    {
+        snd_mixer_t *mixer = NULL;
+        if (snd_mixer_open(&mixer, 0) < 0)
+            return -1;
+        int ret = -1;
+        if (snd_mixer_attach(mixer, "default") < 0 || snd_mixer_selem_register(mixer, NULL, NULL) < 0 || snd_mixer_load(mixer) < 0) {
+            snd_mixer_close(mixer);
+            return -1;
+        }
+        snd_mixer_selem_id_t *sid;
+        snd_mixer_selem_id_alloca(&sid);
+        snd_mixer_selem_id_set_index(sid, 0);
+        snd_mixer_selem_id_set_name(sid, name);
+        snd_mixer_elem_t *elem = snd_mixer_find_selem(mixer, sid);
+        if (!elem) {
+            log::warn("mixer element %s not found\n", name);
+            snd_mixer_close(mixer);
+            return -1;
+        }
+        long min = 0, max = 0, value = 0;
+        if (capture) {
+            snd_mixer_selem_get_capture_volume_range(elem, &min, &max);
+            if (volume >= 0)
+                snd_mixer_selem_set_capture_volume_all(elem, min + (max - min) * volume / 100);
+            if (sw >= 0)
+                snd_mixer_selem_set_capture_switch_all(elem, sw);
+            if (get_switch) {
+                int v = 1;
+                snd_mixer_selem_get_capture_switch(elem, SND_MIXER_SCHN_FRONT_LEFT, &v);
+                ret = v;
+            } else {
+                snd_mixer_selem_get_capture_volume(elem, SND_MIXER_SCHN_FRONT_LEFT, &value);
+                ret = max > min ? (value - min) * 100 / (max - min) : 0;
+            }
+        } else {
+            snd_mixer_selem_get_playback_volume_range(elem, &min, &max);
+            if (volume >= 0)
+                snd_mixer_selem_set_playback_volume_all(elem, min + (max - min) * volume / 100);
+            snd_mixer_selem_get_playback_volume(elem, SND_MIXER_SCHN_FRONT_LEFT, &value);
+            ret = max > min ? (value - min) * 100 / (max - min) : 0;
+        }
+        snd_mixer_close(mixer);
+        return ret;
+    }
+
     Recorder::Recorder(std::string path, int sample_rate, audio::Format format, int channel) {
+        _path = path;
+        _sample_rate = sample_rate;
+        _format = format;
+        _channel = channel;
+        _file = NULL;
+        _buffer = NULL;
+        _buffer_size = 0;
+        _check_path(path);
 
-        err::check_raise(err::ERR_NOT_IMPL, "not support this function");
+        int period = sample_rate / 100;
+        Stream *stream = new Stream(DIR_CAPTURE, "default", sample_rate, format, channel, period, 4, RECORDER_RING_MS / 10);
+        _sample_rate = stream->sample_rate();
+        _period_size = stream->period_frames();
+        if (stream->start() != err::ERR_NONE) {
+            delete stream;
+            err::check_raise(err::ERR_RUNTIME, "start capture failed");
+        }
+        _handle = stream;
     }
 
     Recorder::~Recorder() {
-        err::check_raise(err::ERR_NOT_IMPL, "not support this function");
+        finish();
+        delete (Stream *)_handle;
+        _handle = NULL;
     }
 
     int Recorder::volume(int value) {
-        (void)value;
-        err::check_raise(err::ERR_NOT_IMPL, "not support this function");
-        return 0;
+        value = value > 100 ? 100 : value;
+        return _mixer_ctrl("Capture", true, value, -1);
+    }
+
+    bool Recorder::mute(int data) {
+        int on = _mixer_ctrl("Capture", true, -1, data < 0 ? -1 : !data, true);
+        return on == 0;
+    }
+
+    static void _recorder_open_file(const std::string &path, FILE **file, int sample_rate, int channel, audio::Format format)
+    {
+        if (*file != NULL || path.size() == 0)
+            return;
+        *file = fopen(path.c_str(), "w+");
+        err::check_null_raise(*file, "Open file failed!");
+        if (fs::splitext(path)[1] == ".wav") {
+            if (0 != wav::write_header(*file, sample_rate, channel, format_bytes(format) * 8)) {
+                err::check_raise(err::ERR_RUNTIME, "write wav header failed!");
+            }
+        }
+    }
+
+    // read periods into data and file until got size bytes, size < 0 means all cached periods
+    static size_t _recorder_read(Stream *stream, FILE *file, std::vector<uint8_t> *data, int64_t size)
+    {
+        size_t got = 0;
+        audio::Span span;
+        while (size < 0 || (int64_t)got < size) {
+            err::Err e = stream->read(span, size < 0 ? 0 : 1000);
+            if (e != err::ERR_NONE) {
+                if (e != err::ERR_TIMEOUT || size < 0)
+                    break;
+                continue;
+            }
+            if (data)
+                data->insert(data->end(), span.data, span.data + span.size);
+            if (file)
+                fwrite(span.data, 1, span.size, file);
+            got += span.size;
+            stream->release();
+        }
+        return got;
     }
 
     maix::Bytes *Recorder::record(int record_ms) {
-        (void)record_ms;
-        err::check_raise(err::ERR_NOT_IMPL, "not support this function");
-        return NULL;
+        Stream *stream = (Stream *)_handle;
+        _recorder_open_file(_path, &_file, _sample_rate, _channel, _format);
+
+        if (record_ms > 0) {
+            if (_path.size() <= 0) {
+                log::error("If you pass in the record_ms parameter, you must also set the correct path in audio::Audio()\r\n");
+                return new Bytes();
+            }
+            int64_t size = (int64_t)record_ms * _sample_rate / 1000 * stream->frame_bytes();
+            _recorder_read(stream, _file, NULL, size);
+            return new Bytes();
+        }
+
+        std::vector<uint8_t> data;
+        _recorder_read(stream, _file, &data, -1);
+        if (data.size() > 0) {
+            return new Bytes(data.data(), data.size(), true, true);
+        }
+        return new Bytes();
     }
 
     maix::Bytes *Recorder::record_bytes(int record_size) {
-        (void)record_size;
-        err::check_raise(err::ERR_NOT_IMPL, "not support this function");
-        return NULL;
-    }
+        Stream *stream = (Stream *)_handle;
+        _recorder_open_file(_path, &_file, _sample_rate, _channel, _format);
 
-    bool Recorder::mute(int data) {
-        (void)data;
-        err::check_raise(err::ERR_NOT_IMPL, "not support this function");
-        return false;
+        std::vector<uint8_t> data;
+        _recorder_read(stream, _file, &data, record_size > 0 ? record_size : -1);
+        if (data.size() > 0) {
+            return new Bytes(data.data(), data.size(), true, true);
+        }
+        return new Bytes();
     }
 
     err::Err Recorder::finish() {
-        err::check_raise(err::ERR_NOT_IMPL, "not support this function");
-        return err::ERR_NOT_IMPL;
+        if (_file) {
+            if (fs::splitext(_path)[1] == ".wav") {
+                if (0 != wav::finish_header(_file)) {
+                    err::check_raise(err::ERR_RUNTIME, "write wav header failed!");
+                }
+            }
+
+            fflush(_file);
+            fclose(_file);
+            _file = NULL;
+        }
+
+        return err::ERR_NONE;
     }
 
     maix::Bytes *Player::NoneBytes = new maix::Bytes();
 
     Player::Player(std::string path, int sample_rate, audio::Format format, int channel) {
-        (void)path;
-        (void)sample_rate;
-        (void)format;
-        (void)channel;
-        err::check_raise(err::ERR_NOT_IMPL, "not support this function");
+        _path = path;
+        _sample_rate = sample_rate;
+        _format = format;
+        _channel = channel;
+        _file = NULL;
+        _buffer = NULL;
+        _buffer_size = 0;
+        _check_path(path);
+
+        if (_path.size() > 0) {
+            _file = fopen(_path.c_str(), "rb");
+            err::check_null_raise(_file, "Open file failed!");
+
+            if (fs::splitext(_path)[1] == ".wav") {
+                int sample_bit = 0;
+                uint32_t data_size = 0;
+                if (0 != wav::read_header(_file, &_sample_rate, &_channel, &sample_bit, &data_size)) {
+                    fclose(_file);
+                    err::check_raise(err::ERR_RUNTIME, "parse wav header failed!");
+                }
+                _format = wav_sample_bit_to_format(sample_bit);
+            }
+        }
+
+        Stream *stream = NULL;
+        try {
+            stream = new Stream(DIR_PLAYBACK, "default", _sample_rate, _format, _channel);
+        } catch (...) {
+            if (_file)
+                fclose(_file);
+            throw;
+        }
+        _sample_rate = stream->sample_rate();
+        _period_size = stream->period_frames();
+        if (stream->start() != err::ERR_NONE) {
+            delete stream;
+            if (_file)
+                fclose(_file);
+            err::check_raise(err::ERR_RUNTIME, "start playback failed");
+        }
+        _handle = stream;
     }
 
     Player::~Player() {
-        err::check_raise(err::ERR_NOT_IMPL, "not support this function");
+        // stop plays all data written
+        delete (Stream *)_handle;
+        _handle = NULL;
+
+        if (_file) {
+            fclose(_file);
+            _file = NULL;
+        }
     }
 
     int Player::volume(int value) {
-        (void)value;
-        err::check_raise(err::ERR_NOT_IMPL, "not support this function");
-        return 0;
+        value = value > 100 ? 100 : value;
+        return _mixer_ctrl("Master", false, value, -1);
     }
 
     err::Err Player::play(maix::Bytes *data) {
-        err::check_raise(err::ERR_NOT_IMPL, "not support this function");
-        return err::ERR_NOT_IMPL;
+        Stream *stream = (Stream *)_handle;
+        audio::Span span;
+        int frame_bytes = stream->frame_bytes();
+
+        if (!data || !data->data || !data->size()) {
+            if (!_file) {
+                log::error("no data to play\r\n");
+                return err::ERR_ARGS;
+            }
+            // play from the beginning every time
+            fseek(_file, 0, fs::SEEK_SET);
+            if (fs::splitext(_path)[1] == ".wav") {
+                int sample_rate, channel, sample_bit;
+                uint32_t data_size;
+                wav::read_header(_file, &sample_rate, &channel, &sample_bit, &data_size);
+            }
+            while (true) {
+                err::Err e = stream->write(span, -1);
+                if (e != err::ERR_NONE)
+                    return e;
+                size_t n = fread(span.data, frame_bytes, span.frames, _file);
+                stream->commit(n);
+                if (n < (size_t)span.frames)
+                    break;
+            }
+            return err::ERR_NONE;
+        }
+
+        size_t offset = 0;
+        size_t total = data->data_len / frame_bytes * frame_bytes;
+        while (offset < total) {
+            err::Err e = stream->write(span, -1);
+            if (e != err::ERR_NONE)
+                return e;
+            size_t n = std::min((size_t)span.size, total - offset);
+            memcpy(span.data, data->data + offset, n);
+            stream->commit(n / frame_bytes);
+            offset += n;
+        }
+        return err::ERR_NONE;
     }
-} // namespace maix::audio
\ No newline at end of file
+} // namespace maix::audio
@@ -0,0 +1,454 @@
+/**
+ * @author lxowalle@sipeed
+ * @copyright Sipeed Ltd 2023-
+ * @license Apache 2.0
+ * @update 2024.11.25: Add streaming DSP: resampler, VAD and mel features.
+ */
+
+#include <math.h>
+#include <numeric>
+#include "maix_audio_dsp.hpp"
+
+namespace maix::audio
+{
+    /**
+     * Real input FFT of power of 2 size, computed as a complex FFT of half size.
+     * Real and imaginary parts are kept in separate arrays so butterflies of one stage
+     * are plain float loops the compiler vectorizes(NEON/RVV/SSE).
+     */
+    class RealFFT
+    {
+    public:
+        RealFFT(int n) : _n(n), _half(n / 2)
+        {
+            _re.resize(_half);
+            _im.resize(_half);
+            _cos.resize(_half / 2 > 0 ? _half / 2 : 1);
+            _sin.resize(_cos.size());
+            for (size_t i = 0; i < _cos.size(); ++i)
+            {
+                _cos[i] = cosf(2 * M_PI * i / _half);
+                _sin[i] = -sinf(2 * M_PI * i / _half);
+            }
+            _post_cos.resize(_half + 1);
+            _post_sin.resize(_half + 1);
+            for (int k = 0; k <= _half; ++k)
+            {
+                _post_cos[k] = cosf(2 * M_PI * k / _n);
+                _post_sin[k] = -sinf(2 * M_PI * k / _n);
+            }
+            _rev.resize(_half);
+            int bits = 0;
+            while ((1 << bits) < _half)
+                ++bits;
+            for (int i = 0; i < _half; ++i)
+            {
+                int r = 0;
+                for (int b = 0; b < bits; ++b)
+                    r |= ((i >> b) & 1) << (bits - 1 - b);
+                _rev[i] = r;
+            }
+        }
+
+        /**
+         * Power spectrum |X[k]|^2, k = 0 ~ n/2.
+         */
+        void power(const float *in, float *out)
+        {
+            float *__restrict re = _re.data();
+            float *__restrict im = _im.data();
+            for (int i = 0; i < _half; ++i)
+            {
+                re[_rev[i]] = in[2 * i];
+                im[_rev[i]] = in[2 * i + 1];
+            }
+            for (int len = 2; len <= _half; len <<= 1)
+            {
+                int h = len / 2;
+                int step = _half / len;
+                for (int i = 0; i < _half; i += len)
+                {
+                    float *__restrict ar = re + i, *__restrict ai = im + i;
+                    float *__restrict br = re + i + h, *__restrict bi = im + i + h;
+                    for (int j = 0; j < h; ++j)
+                    {
+                        float wr = _cos[j * step], wi = _sin[j * step];
+                        float tr = br[j] * wr - bi[j] * wi;
+                        float ti = br[j] * wi + bi[j] * wr;
+                        br[j] = ar[j] - tr;
+                        bi[j] = ai[j] - ti;
+                        ar[j] += tr;
+                        ai[j] += ti;
+                    }
+                }
+            }
+            // split half size complex spectrum Z into real spectrum X
+            out[0] = (re[0] + im[0]) * (re[0] + im[0]);
+            out[_half] = (re[0] - im[0]) * (re[0] - im[0]);
+            for (int k = 1; k < _half; ++k)
+            {
+                float zr = re[k], zi = im[k];
+                float cr = re[_half - k], ci = -im[_half - k];
+                float er = (zr + cr) * 0.5f, ei = (zi + ci) * 0.5f;
+                float dr = (zr - cr) * 0.5f, di = (zi - ci) * 0.5f;
+                // X = E - i * W^k * D
+                float wr = _post_cos[k], wi = _post_sin[k];
+                float tr = dr * wr - di * wi;
+                float ti = dr * wi + di * wr;
+                float xr = er + ti;
+                float xi = ei - tr;
+                out[k] = xr * xr + xi * xi;
+            }
+        }
+
+    private:
+        int _n;
+        int _half;
+        std::vector<float> _re, _im;
+        std::vector<float> _cos, _sin;
+        std::vector<float> _post_cos, _post_sin;
+        std::vector<int> _rev;
+    };
+
+    static int _next_pow2(int n)
+    {
+        int r = 2;
+        while (r < n)
+            r <<= 1;
+        return r;
+    }
+
+    static inline float _dot(const float *__restrict a, const float *__restrict b, int n)
+    {
+        float s = 0;
+        for (int i = 0; i < n; ++i)
+            s += a[i] * b[i];
+        return s;
+    }
+
+    static inline void _to_float(const int16_t *in, float *out) { *out = *in; }
+    static inline void _to_float(const float *in, float *out) { *out = *in; }
+    static inline void _from_float(float in, int16_t *out)
+    {
+        in = roundf(in);
+        *out = in > 32767.f ? 32767 : (in < -32768.f ? -32768 : (int16_t)in);
+    }
+    static inline void _from_float(float in, float *out) { *out = in; }
+
+    Resampler::Resampler(int in_rate, int out_rate, int channel, int max_in_frames, int taps)
+        : _in_rate(in_rate), _out_rate(out_rate), _channel(channel), _max_in(max_in_frames), _taps(taps)
+    {
+        if (in_rate <= 0 || out_rate <= 0 || channel <= 0 || max_in_frames <= 0 || taps < 2)
+            throw err::Exception(err::ERR_ARGS, "invalid resampler args");
+        int g = std::gcd(in_rate, out_rate);
+        _up = out_rate / g;
+        _down = in_rate / g;
+        if (_up > 4096)
+            throw err::Exception(err::ERR_ARGS, "resample ratio too complex");
+
+        // prototype low pass at upsampled rate, Kaiser window beta 8 gives about 80dB stopband,
+        // transition band is about 5 / taps of the lower rate, place it just below the lower nyquist
+        int n = _up * taps;
+        float fc = std::max(0.5f - 2.6f / taps, 0.25f) / std::max(_up, _down);
+        const double beta = 8;
+        std::vector<double> h(n);
+        double sum = 0;
+        for (int j = 0; j < n; ++j)
+        {
+            double t = j - (n - 1) / 2.0;
+            double x = 2 * fc * t;
+            double sinc = fabs(x) < 1e-9 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+            double r = 2.0 * t / n;
+            double w = std::cyl_bessel_i(0.0, beta * sqrt(std::max(0.0, 1 - r * r))) / std::cyl_bessel_i(0.0, beta);
+            h[j] = 2 * fc * sinc * w;
+            sum += h[j];
+        }
+        // phase p tap k multiplies the k-th oldest..newest sample of the window, gain L restores amplitude after zero stuffing
+        _coef.resize((size_t)_up * taps);
+        for (int p = 0; p < _up; ++p)
+            for (int k = 0; k < taps; ++k)
+                _coef[(size_t)p * taps + k] = h[p + (taps - 1 - k) * _up] / sum * _up;
+
+        _work.assign((size_t)_channel * (taps - 1 + max_in_frames), 0);
+        reset();
+    }
+
+    int Resampler::max_output(int in_frames)
+    {
+        return (int)(((uint64_t)in_frames * _up + _down - 1) / _down) + 1;
+    }
+
+    void Resampler::reset()
+    {
+        std::fill(_work.begin(), _work.end(), 0);
+        _pos = (uint64_t)(_taps - 1) * _up;
+    }
+
+    template <typename T>
+    int Resampler::_process(const T *in, int in_frames, T *out)
+    {
+        int out_frames = 0;
+        int stride = _taps - 1 + _max_in;
+        while (in_frames > 0)
+        {
+            int n = std::min(in_frames, _max_in);
+            for (int c = 0; c < _channel; ++c)
+            {
+                float *w = &_work[(size_t)c * stride + _taps - 1];
+                for (int i = 0; i < n; ++i)
+                    _to_float(&in[i * _channel + c], &w[i]);
+            }
+            int avail = _taps - 1 + n;
+            while (true)
+            {
+                uint64_t q = _pos / _up;
+                if (q >= (uint64_t)avail)
+                    break;
+                const float *coef = &_coef[(size_t)(_pos % _up) * _taps];
+                int base = q - (_taps - 1);
+                for (int c = 0; c < _channel; ++c)
+                    _from_float(_dot(coef, &_work[(size_t)c * stride + base], _taps), &out[out_frames * _channel + c]);
+                ++out_frames;
+                _pos += _down;
+            }
+            // keep last taps - 1 samples as history of next block
+            int shift = avail - (_taps - 1);
+            for (int c = 0; c < _channel; ++c)
+            {
+                float *w = &_work[(size_t)c * stride];
+                memmove(w, w + shift, (_taps - 1) * sizeof(float));
+            }
+            _pos -= (uint64_t)shift * _up;
+            in += n * _channel;
+            in_frames -= n;
+        }
+        return out_frames;
+    }
+
+    int Resampler::process(const int16_t *in, int in_frames, int16_t *out)
+    {
+        return _process(in, in_frames, out);
+    }
+
+    int Resampler::process(const float *in, int in_frames, float *out)
+    {
+        return _process(in, in_frames, out);
+    }
+
+    VAD::VAD(int sample_rate, int frame_ms, float threshold_db, int hangover_ms, int attack_frames)
+        : _sample_rate(sample_rate), _threshold_db(threshold_db), _attack(attack_frames)
+    {
+        if (sample_rate <= 0 || frame_ms <= 0)
+            throw err::Exception(err::ERR_ARGS, "invalid vad args");
+        _frame_len = sample_rate * frame_ms / 1000;
+        _hangover = hangover_ms / frame_ms;
+        int n_fft = _next_pow2(_frame_len);
+        _fft = new RealFFT(n_fft);
+        // frame | power spectrum | hann window
+        _buff.assign(n_fft + n_fft / 2 + 1 + _frame_len, 0);
+        float *win = _buff.data() + n_fft + n_fft / 2 + 1;
+        for (int i = 0; i < _frame_len; ++i)
+            win[i] = 0.5f - 0.5f * cosf(2 * M_PI * i / _frame_len);
+        _band_lo = std::max(1, (100 * n_fft + sample_rate - 1) / sample_rate);
+        _band_hi = std::min(n_fft / 2, 4000 * n_fft / sample_rate);
+        reset();
+    }
+
+    VAD::~VAD()
+    {
+        delete (RealFFT *)_fft;
+    }
+
+    void VAD::reset()
+    {
+        _speech = false;
+        _voiced_cnt = 0;
+        _hang_cnt = 0;
+        _frames = 0;
+        _energy_db = -100;
+        _noise_db = -100;
+    }
+
+    bool VAD::process(const int16_t *frame)
+    {
+        int n_fft = _next_pow2(_frame_len);
+        float *x = _buff.data();
+        float *power = x + n_fft;
+        const float *win = power + n_fft / 2 + 1;
+        float sum = 0;
+        for (int i = 0; i < _frame_len; ++i)
+        {
+            float v = frame[i] * (1.0f / 32768);
+            sum += v * v;
+            x[i] = v * win[i];
+        }
+        _energy_db = 10 * log10f(sum / _frame_len + 1e-10f);
+
+        // speech band(100~4000Hz) ratio, rejects low rumble and hiss which have high energy but little voice band content
+        ((RealFFT *)_fft)->power(x, power);
+        float total = 1e-20f, band = 0;
+        for (int k = 1; k <= n_fft / 2; ++k)
+        {
+            total += power[k];
+            if (k >= _band_lo && k <= _band_hi)
+                band += power[k];
+        }
+        bool voiced = false;
+        // the first frames only learn noise floor
+        if (_frames < 10)
+        {
+            _noise_db = _frames == 0 ? _energy_db : std::min(_noise_db, _energy_db);
+            ++_frames;
+        }
+        else
+        {
+            voiced = _energy_db > _noise_db + _threshold_db && _energy_db > -70 && band / total > 0.5f;
+            // floor follows quickly downwards, slowly upwards, almost frozen while talking
+            float alpha = _energy_db < _noise_db ? 0.2f : (voiced || _speech ? 0.001f : 0.02f);
+            _noise_db += alpha * (_energy_db - _noise_db);
+        }
+
+        _voiced_cnt = voiced ? _voiced_cnt + 1 : 0;
+        if (_voiced_cnt >= _attack || (_speech && voiced))
+        {
+            _speech = true;
+            _hang_cnt = _hangover;
+        }
+        else if (_speech && --_hang_cnt <= 0)
+        {
+            _speech = false;
+        }
+        return _speech;
+    }
+
+    static float _hz_to_mel(float hz) { return 2595 * log10f(1 + hz / 700); }
+    static float _mel_to_hz(float mel) { return 700 * (powf(10, mel / 2595) - 1); }
+
+    MelFeature::MelFeature(int sample_rate, int n_mels, int n_mfcc, int win_len, int hop, int n_fft, int max_block, float fmin, float fmax)
+        : _n_mels(n_mels), _n_mfcc(n_mfcc), _win_len(win_len), _hop(hop), _max_block(max_block)
+    {
+        if (n_fft == 0)
+            n_fft = _next_pow2(win_len);
+        if (fmax <= 0)
+            fmax = sample_rate / 2.0f;
+        if (sample_rate <= 0 || n_mels <= 0 || n_mfcc < 0 || n_mfcc > n_mels || win_len <= 0 || hop <= 0 || hop > win_len || max_block <= 0
+            || n_fft < win_len || (n_fft & (n_fft - 1)) || fmin < 0 || fmin >= fmax)
+            throw err::Exception(err::ERR_ARGS, "invalid mel feature args");
+        _n_fft = n_fft;
+        _fft = new RealFFT(n_fft);
+
+        // periodic hann window
+        _window.resize(win_len);
+        for (int i = 0; i < win_len; ++i)
+            _window[i] = 0.5f - 0.5f * cosf(2 * M_PI * i / win_len);
+
+        int bins = n_fft / 2 + 1;
+        float mel_lo = _hz_to_mel(fmin), mel_hi = _hz_to_mel(fmax);
+        std::vector<float> edges(n_mels + 2);
+        for (int i = 0; i < n_mels + 2; ++i)
+            edges[i] = _mel_to_hz(mel_lo + (mel_hi - mel_lo) * i / (n_mels + 1));
+        // triangle filters stored sparse, only the non zero bins
+        for (int m = 0; m < n_mels; ++m)
+        {
+            int start = -1, len = 0;
+            for (int k = 0; k < bins; ++k)
+            {
+                float f = (float)k * sample_rate / n_fft;
+                float w = std::min((f - edges[m]) / (edges[m + 1] - edges[m]), (edges[m + 2] - f) / (edges[m + 2] - edges[m + 1]));
+                if (w <= 0)
+                {
+                    if (start >= 0)
+                        break;
+                    continue;
+                }
+                if (start < 0)
+                    start = k;
+                _mel_weight.push_back(w);
+                ++len;
+            }
+            _mel_start.push_back(start < 0 ? 0 : start);
+            _mel_len.push_back(len);
+        }
+
+        if (n_mfcc > 0)
+        {
+            // orthonormal DCT-II
+            _dct.resize((size_t)n_mfcc * n_mels);
+            for (int i = 0; i < n_mfcc; ++i)
+            {
+                float scale = sqrtf((i == 0 ? 1.0f : 2.0f) / n_mels);
+                for (int j = 0; j < n_mels; ++j)
+                    _dct[(size_t)i * n_mels + j] = scale * cosf(M_PI * i * (j + 0.5f) / n_mels);
+            }
+        }
+
+        int keep = win_len - 1;
+        _samples.assign(keep + max_block, 0);
+        _samples_num = 0;
+        _frame.assign(n_fft, 0);
+        _power.assign(bins, 0);
+        _log_mel.assign(n_mels, 0);
+        int rows = (keep + max_block - win_len) / hop + 1;
+        _features = new tensor::Tensor({rows, dim()}, tensor::DType::FLOAT32);
+    }
+
+    MelFeature::~MelFeature()
+    {
+        delete (RealFFT *)_fft;
+        delete _features;
+    }
+
+    void MelFeature::reset()
+    {
+        _samples_num = 0;
+    }
+
+    int MelFeature::process(const int16_t *pcm, int samples)
+    {
+        if (samples > _max_block)
+            return -1;
+        float *s = _samples.data();
+        for (int i = 0; i < samples; ++i)
+            s[_samples_num + i] = pcm[i] * (1.0f / 32768);
+        _samples_num += samples;
+
+        float *out = (float *)_features->data();
+        int dim = this->dim();
+        int rows = 0;
+        int pos = 0;
+        while (_samples_num - pos >= _win_len)
+        {
+            float *__restrict frame = _frame.data();
+            const float *__restrict win = _window.data();
+            for (int i = 0; i < _win_len; ++i)
+                frame[i] = s[pos + i] * win[i];
+            ((RealFFT *)_fft)->power(frame, _power.data());
+
+            const float *w = _mel_weight.data();
+            for (int m = 0; m < _n_mels; ++m)
+            {
+                float e = _dot(w, &_power[_mel_start[m]], _mel_len[m]);
+                w += _mel_len[m];
+                _log_mel[m] = logf(std::max(e, 1e-10f));
+            }
+            float *row = out + (size_t)rows * dim;
+            if (_n_mfcc > 0)
+            {
+                for (int i = 0; i < _n_mfcc; ++i)
+                    row[i] = _dot(&_dct[(size_t)i * _n_mels], _log_mel.data(), _n_mels);
+            }
+            else
+            {
+                memcpy(row, _log_mel.data(), _n_mels * sizeof(float));
+            }
+            ++rows;
+            pos += _hop;
+        }
+        if (pos > 0)
+        {
+            memmove(s, s + pos, (_samples_num - pos) * sizeof(float));
+            _samples_num -= pos;
+        }
+        return rows;
+    }
+} // namespace maix::audio
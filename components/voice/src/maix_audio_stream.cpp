@@ -0,0 +1,779 @@
+/**
+ * @author lxowalle@sipeed
+ * @copyright Sipeed Ltd 2023-
+ * @license Apache 2.0
+ * @update 2024.11.22: Add period based low latency Stream.
+ */
+
+#include <stdint.h>
+#include <errno.h>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <alsa/asoundlib.h>
+#include "maix_basic.hpp"
+#include "maix_audio.hpp"
+#include "maix_audio_wav.hpp"
+
+namespace maix::audio
+{
+    int format_bytes(audio::Format format)
+    {
+        switch (format)
+        {
+        case audio::Format::FMT_S8:
+        case audio::Format::FMT_U8:
+            return 1;
+        case audio::Format::FMT_S16_LE:
+        case audio::Format::FMT_S16_BE:
+        case audio::Format::FMT_U16_LE:
+        case audio::Format::FMT_U16_BE:
+            return 2;
+        case audio::Format::FMT_S32_LE:
+        case audio::Format::FMT_S32_BE:
+        case audio::Format::FMT_U32_LE:
+        case audio::Format::FMT_U32_BE:
+            return 4;
+        default:
+            return 0;
+        }
+    }
+
+    static snd_pcm_format_t _alsa_format(audio::Format format)
+    {
+        switch (format)
+        {
+        case audio::Format::FMT_S8: return SND_PCM_FORMAT_S8;
+        case audio::Format::FMT_U8: return SND_PCM_FORMAT_U8;
+        case audio::Format::FMT_S16_LE: return SND_PCM_FORMAT_S16_LE;
+        case audio::Format::FMT_S32_LE: return SND_PCM_FORMAT_S32_LE;
+        case audio::Format::FMT_S16_BE: return SND_PCM_FORMAT_S16_BE;
+        case audio::Format::FMT_S32_BE: return SND_PCM_FORMAT_S32_BE;
+        case audio::Format::FMT_U16_LE: return SND_PCM_FORMAT_U16_LE;
+        case audio::Format::FMT_U32_LE: return SND_PCM_FORMAT_U32_LE;
+        case audio::Format::FMT_U16_BE: return SND_PCM_FORMAT_U16_BE;
+        case audio::Format::FMT_U32_BE: return SND_PCM_FORMAT_U32_BE;
+        default: return SND_PCM_FORMAT_UNKNOWN;
+        }
+    }
+
+    // fill silence, unsigned formats' silence is the middle value
+    static void _fill_silence(audio::Format format, uint8_t *data, int frames, int channel)
+    {
+        int bytes = format_bytes(format);
+        int samples = frames * channel;
+        switch (format)
+        {
+        case audio::Format::FMT_U8:
+            memset(data, 0x80, samples);
+            break;
+        case audio::Format::FMT_U16_LE:
+        case audio::Format::FMT_U32_LE:
+        case audio::Format::FMT_U16_BE:
+        case audio::Format::FMT_U32_BE:
+        {
+            bool le = format == audio::Format::FMT_U16_LE || format == audio::Format::FMT_U32_LE;
+            memset(data, 0, samples * bytes);
+            for (int i = 0; i < samples; ++i)
+                data[i * bytes + (le ? bytes - 1 : 0)] = 0x80;
+            break;
+        }
+        default:
+            memset(data, 0, samples * bytes);
+            break;
+        }
+    }
+
+    /**
+     * Single producer single consumer ring of periods.
+     * Indexes are free running, slot = index % num, no lock on the data path,
+     * mutex and condition variable are only touched when the other side is waiting.
+     */
+    class PeriodRing
+    {
+    public:
+        void init(int num, int period_bytes)
+        {
+            _num = num;
+            _period_bytes = period_bytes;
+            _buff.assign((size_t)num * period_bytes, 0);
+            _frames.assign(num, 0);
+            _timestamp.assign(num, 0);
+            _w = 0;
+            _r = 0;
+            _closed = false;
+        }
+
+        // producer side
+
+        uint8_t *write_slot()
+        {
+            uint32_t w = _w.load(std::memory_order_relaxed);
+            if (w - _r.load(std::memory_order_acquire) >= (uint32_t)_num)
+                return nullptr;
+            return &_buff[(size_t)(w % _num) * _period_bytes];
+        }
+
+        void produce(int frames, uint64_t timestamp_us)
+        {
+            uint32_t w = _w.load(std::memory_order_relaxed);
+            _frames[w % _num] = frames;
+            _timestamp[w % _num] = timestamp_us;
+            _w.store(w + 1, std::memory_order_seq_cst);
+            _notify();
+        }
+
+        // consumer side
+
+        uint8_t *read_slot(int &frames, uint64_t &timestamp_us)
+        {
+            uint32_t r = _r.load(std::memory_order_relaxed);
+            if (_w.load(std::memory_order_acquire) == r)
+                return nullptr;
+            frames = _frames[r % _num];
+            timestamp_us = _timestamp[r % _num];
+            return &_buff[(size_t)(r % _num) * _period_bytes];
+        }
+
+        void consume()
+        {
+            _r.store(_r.load(std::memory_order_relaxed) + 1, std::memory_order_seq_cst);
+            _notify();
+        }
+
+        bool empty() const
+        {
+            return _w.load(std::memory_order_acquire) == _r.load(std::memory_order_acquire);
+        }
+
+        /**
+         * Wait until readable(for_read) or writable.
+         * @return true if ready, false if timeout or closed.
+         */
+        bool wait(bool for_read, int timeout_ms)
+        {
+            auto ready = [&]() {
+                uint32_t n = _w.load(std::memory_order_seq_cst) - _r.load(std::memory_order_seq_cst);
+                return for_read ? n > 0 : n < (uint32_t)_num;
+            };
+            if (ready())
+                return true;
+            if (timeout_ms == 0)
+                return false;
+            std::unique_lock<std::mutex> lock(_lock);
+            _waiters.fetch_add(1, std::memory_order_seq_cst);
+            auto pred = [&]() { return ready() || _closed.load(); };
+            if (timeout_ms < 0)
+                _cond.wait(lock, pred);
+            else
+                _cond.wait_for(lock, std::chrono::milliseconds(timeout_ms), pred);
+            _waiters.fetch_sub(1, std::memory_order_seq_cst);
+            return ready();
+        }
+
+        void close(bool closed = true)
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            _closed = closed;
+            _cond.notify_all();
+        }
+
+        bool closed() const { return _closed.load(); }
+
+    private:
+        int _num = 0;
+        int _period_bytes = 0;
+        std::vector<uint8_t> _buff;
+        std::vector<int> _frames;
+        std::vector<uint64_t> _timestamp;
+        std::atomic<uint32_t> _w{0};
+        std::atomic<uint32_t> _r{0};
+        std::atomic<int> _waiters{0};
+        std::atomic<bool> _closed{false};
+        std::mutex _lock;
+        std::condition_variable _cond;
+
+        void _notify()
+        {
+            if (_waiters.load(std::memory_order_seq_cst) > 0)
+            {
+                std::lock_guard<std::mutex> lock(_lock);
+                _cond.notify_all();
+            }
+        }
+    };
+
+    /**
+     * Device backend, transfer one period in stream thread.
+     * transfer returns frames transferred, 0 if nothing transferred(timeout or exit), -1 if end or fatal error.
+     */
+    class Backend
+    {
+    public:
+        std::atomic<uint32_t> xruns{0};
+        virtual ~Backend() {}
+        virtual err::Err start() = 0;
+        virtual void stop(bool drain) = 0;
+        virtual int transfer(uint8_t *data, int frames, const std::atomic<bool> &exit) = 0;
+    };
+
+    class AlsaBackend : public Backend
+    {
+    public:
+        AlsaBackend(audio::Direction dir, const std::string &device, int &sample_rate, audio::Format format, int channel, int &period_frames, int periods)
+            : _dir(dir), _pcm(nullptr), _mmap(false)
+        {
+            _frame_bytes = format_bytes(format) * channel;
+            snd_pcm_stream_t stream = dir == DIR_CAPTURE ? SND_PCM_STREAM_CAPTURE : SND_PCM_STREAM_PLAYBACK;
+            int ret = snd_pcm_open(&_pcm, device.c_str(), stream, 0);
+            if (ret < 0)
+                throw err::Exception(err::ERR_NOT_FOUND, "open pcm " + device + " failed: " + snd_strerror(ret));
+            try
+            {
+                _set_params(sample_rate, format, channel, period_frames, periods);
+            }
+            catch (...)
+            {
+                snd_pcm_close(_pcm);
+                _pcm = nullptr;
+                throw;
+            }
+        }
+
+        ~AlsaBackend()
+        {
+            if (_pcm)
+                snd_pcm_close(_pcm);
+        }
+
+        err::Err start() override
+        {
+            int ret = snd_pcm_prepare(_pcm);
+            // playback is started by start_threshold when data is written
+            if (ret >= 0 && _dir == DIR_CAPTURE)
+                ret = snd_pcm_start(_pcm);
+            if (ret < 0)
+            {
+                log::error("start pcm failed: %s\n", snd_strerror(ret));
+                return err::ERR_RUNTIME;
+            }
+            return err::ERR_NONE;
+        }
+
+        void stop(bool drain) override
+        {
+            if (drain)
+                snd_pcm_drain(_pcm);
+            else
+                snd_pcm_drop(_pcm);
+        }
+
+        int transfer(uint8_t *data, int frames, const std::atomic<bool> &exit) override
+        {
+            int done = 0;
+            while (done < frames && !exit.load(std::memory_order_relaxed))
+            {
+                snd_pcm_sframes_t n;
+                if (_mmap)
+                {
+                    n = _mmap_transfer(data + done * _frame_bytes, frames - done);
+                }
+                else
+                {
+                    // wait first so exit flag is checked at least every 100ms
+                    n = snd_pcm_wait(_pcm, 100);
+                    if (n == 0)
+                        continue;
+                    if (n > 0)
+                        n = _dir == DIR_CAPTURE ? snd_pcm_readi(_pcm, data + done * _frame_bytes, frames - done)
+                                                : snd_pcm_writei(_pcm, data + done * _frame_bytes, frames - done);
+                }
+                if (n == -EAGAIN)
+                    continue;
+                if (n < 0)
+                {
+                    if (_recover(n) < 0)
+                        return done > 0 ? done : -1;
+                    continue;
+                }
+                done += n;
+            }
+            return done;
+        }
+
+    private:
+        audio::Direction _dir;
+        snd_pcm_t *_pcm;
+        bool _mmap;
+        int _frame_bytes;
+        snd_pcm_uframes_t _period;
+
+        void _set_params(int &sample_rate, audio::Format format, int channel, int &period_frames, int periods)
+        {
+            snd_pcm_hw_params_t *hw;
+            snd_pcm_hw_params_alloca(&hw);
+            snd_pcm_hw_params_any(_pcm, hw);
+            // mmap avoids one copy in alsa-lib and lets us wait on exact period boundary
+            _mmap = snd_pcm_hw_params_set_access(_pcm, hw, SND_PCM_ACCESS_MMAP_INTERLEAVED) >= 0;
+            if (!_mmap && snd_pcm_hw_params_set_access(_pcm, hw, SND_PCM_ACCESS_RW_INTERLEAVED) < 0)
+                throw err::Exception(err::ERR_ARGS, "pcm access not supported");
+            if (snd_pcm_hw_params_set_format(_pcm, hw, _alsa_format(format)) < 0)
+                throw err::Exception(err::ERR_ARGS, "pcm format not supported");
+            if (snd_pcm_hw_params_set_channels(_pcm, hw, channel) < 0)
+                throw err::Exception(err::ERR_ARGS, "pcm channel not supported");
+            unsigned int rate = sample_rate;
+            if (snd_pcm_hw_params_set_rate_near(_pcm, hw, &rate, nullptr) < 0)
+                throw err::Exception(err::ERR_ARGS, "pcm sample rate not supported");
+            sample_rate = rate;
+            _period = period_frames > 0 ? period_frames : rate / 100;
+            snd_pcm_hw_params_set_period_size_near(_pcm, hw, &_period, nullptr);
+            snd_pcm_uframes_t buffer_size = _period * periods;
+            snd_pcm_hw_params_set_buffer_size_near(_pcm, hw, &buffer_size);
+            int ret = snd_pcm_hw_params(_pcm, hw);
+            if (ret < 0)
+                throw err::Exception(err::ERR_ARGS, std::string("set pcm hw params failed: ") + snd_strerror(ret));
+            snd_pcm_hw_params_get_period_size(hw, &_period, nullptr);
+            snd_pcm_hw_params_get_buffer_size(hw, &buffer_size);
+            period_frames = _period;
+
+            snd_pcm_sw_params_t *sw;
+            snd_pcm_sw_params_alloca(&sw);
+            snd_pcm_sw_params_current(_pcm, sw);
+            snd_pcm_sw_params_set_avail_min(_pcm, sw, _period);
+            // playback starts after two periods queued, enough to ride over one late wakeup
+            snd_pcm_sw_params_set_start_threshold(_pcm, sw, _dir == DIR_CAPTURE ? 1 : std::min(buffer_size, _period * 2));
+            ret = snd_pcm_sw_params(_pcm, sw);
+            if (ret < 0)
+                throw err::Exception(err::ERR_ARGS, std::string("set pcm sw params failed: ") + snd_strerror(ret));
+            log::debug("pcm opened, rate %u, period %lu, buffer %lu, mmap %d\n", rate, _period, buffer_size, _mmap);
+        }
+
+        snd_pcm_sframes_t _mmap_transfer(uint8_t *data, int frames)
+        {
+            snd_pcm_sframes_t avail = snd_pcm_avail_update(_pcm);
+            if (avail < 0)
+                return avail;
+            // capture waits for a whole period, playback fills whatever space is free
+            if (avail == 0 || (_dir == DIR_CAPTURE && avail < (snd_pcm_sframes_t)frames))
+            {
+                int ret = snd_pcm_wait(_pcm, 100);
+                return ret < 0 ? ret : 0;
+            }
+            const snd_pcm_channel_area_t *areas;
+            snd_pcm_uframes_t offset;
+            snd_pcm_uframes_t n = frames;
+            int ret = snd_pcm_mmap_begin(_pcm, &areas, &offset, &n);
+            if (ret < 0)
+                return ret;
+            uint8_t *dev = (uint8_t *)areas[0].addr + areas[0].first / 8 + offset * areas[0].step / 8;
+            if (_dir == DIR_CAPTURE)
+                memcpy(data, dev, n * _frame_bytes);
+            else
+                memcpy(dev, data, n * _frame_bytes);
+            snd_pcm_sframes_t committed = snd_pcm_mmap_commit(_pcm, offset, n);
+            if (committed >= 0 && (snd_pcm_uframes_t)committed != n)
+                return -EPIPE;
+            return committed;
+        }
+
+        int _recover(int err)
+        {
+            if (err == -EPIPE || err == -ESTRPIPE)
+                xruns.fetch_add(1, std::memory_order_relaxed);
+            int ret = snd_pcm_recover(_pcm, err, 1);
+            if (ret < 0)
+            {
+                log::error("pcm recover failed: %s\n", snd_strerror(ret));
+                return ret;
+            }
+            // after recover capture is prepared state and mmap access won't auto start
+            if (_dir == DIR_CAPTURE && snd_pcm_state(_pcm) == SND_PCM_STATE_PREPARED)
+                snd_pcm_start(_pcm);
+            return 0;
+        }
+    };
+
+    /**
+     * WAV file as device, paced by clock so the stream behaves like real hardware.
+     */
+    class WavBackend : public Backend
+    {
+    public:
+        WavBackend(audio::Direction dir, const std::string &path, int &sample_rate, audio::Format format, int &channel)
+            : _dir(dir), _sample_rate(sample_rate), _next_us(0)
+        {
+            int sample_bit = format_bytes(format) * 8;
+            if (dir == DIR_CAPTURE)
+            {
+                _fp = fopen(path.c_str(), "rb");
+                if (!_fp)
+                    throw err::Exception(err::ERR_NOT_FOUND, "open " + path + " failed");
+                int bits = 0;
+                uint32_t data_size = 0;
+                if (wav::read_header(_fp, &sample_rate, &channel, &bits, &data_size) != 0 || bits != sample_bit)
+                {
+                    fclose(_fp);
+                    throw err::Exception(err::ERR_ARGS, "invalid wav or sample bits not match format: " + path);
+                }
+                _sample_rate = sample_rate;
+                _remain = data_size;
+            }
+            else
+            {
+                _fp = fopen(path.c_str(), "wb");
+                if (!_fp)
+                    throw err::Exception(err::ERR_NOT_PERMIT, "create " + path + " failed");
+                if (wav::write_header(_fp, sample_rate, channel, sample_bit) != 0)
+                {
+                    fclose(_fp);
+                    throw err::Exception(err::ERR_IO, "write wav header failed");
+                }
+                _remain = 0;
+            }
+            _frame_bytes = format_bytes(format) * channel;
+        }
+
+        ~WavBackend()
+        {
+            if (_dir == DIR_PLAYBACK)
+                wav::finish_header(_fp);
+            fclose(_fp);
+        }
+
+        err::Err start() override
+        {
+            _next_us = time::ticks_us();
+            return err::ERR_NONE;
+        }
+
+        void stop(bool drain) override
+        {
+            (void)drain;
+            if (_dir == DIR_PLAYBACK)
+            {
+                wav::finish_header(_fp);
+                fflush(_fp);
+            }
+        }
+
+        int transfer(uint8_t *data, int frames, const std::atomic<bool> &exit) override
+        {
+            // device delivers a period when its last frame is due
+            _next_us += (uint64_t)frames * 1000000 / _sample_rate;
+            while (!exit.load(std::memory_order_relaxed))
+            {
+                uint64_t now = time::ticks_us();
+                if (now >= _next_us)
+                    break;
+                time::sleep_us(std::min<uint64_t>(_next_us - now, 100000));
+            }
+            if (exit.load(std::memory_order_relaxed))
+                return 0;
+            if (_dir == DIR_CAPTURE)
+            {
+                size_t want = std::min<size_t>((size_t)frames * _frame_bytes, _remain);
+                size_t n = fread(data, 1, want, _fp) / _frame_bytes;
+                _remain -= n * _frame_bytes;
+                return n > 0 ? (int)n : -1;
+            }
+            return fwrite(data, _frame_bytes, frames, _fp) == (size_t)frames ? frames : -1;
+        }
+
+    private:
+        audio::Direction _dir;
+        FILE *_fp;
+        int _sample_rate;
+        int _frame_bytes;
+        size_t _remain;
+        uint64_t _next_us;
+    };
+
+    struct StreamData
+    {
+        audio::Direction dir;
+        audio::Format format;
+        int sample_rate;
+        int channel;
+        int period_frames;
+        int frame_bytes;
+        Backend *backend;
+        PeriodRing ring;
+        std::vector<uint8_t> scratch;   // callback mode and dropped/silence periods
+        std::function<void(audio::Span &)> callback;
+        thread::Thread *thread;
+        std::atomic<bool> exit;
+        std::atomic<bool> running;
+        std::atomic<uint64_t> frames;
+        std::atomic<uint32_t> overflows;
+        std::atomic<uint32_t> underflows;
+        bool primed;                    // playback got data at least once, silence before that isn't underflow
+        // borrowed slot of pull API
+        uint8_t *user_slot;
+    };
+
+    static void _capture_loop(StreamData *d)
+    {
+        while (!d->exit.load(std::memory_order_relaxed))
+        {
+            uint8_t *slot = d->callback ? nullptr : d->ring.write_slot();
+            uint8_t *buff = slot ? slot : d->scratch.data();
+            int n = d->backend->transfer(buff, d->period_frames, d->exit);
+            if (n < 0)
+                break;
+            if (n == 0)
+                continue;
+            uint64_t ts = time::ticks_us() - (uint64_t)n * 1000000 / d->sample_rate;
+            d->frames.fetch_add(n, std::memory_order_relaxed);
+            if (d->callback)
+            {
+                audio::Span span{buff, n, n * d->frame_bytes, ts};
+                d->callback(span);
+            }
+            else if (slot)
+                d->ring.produce(n, ts);
+            else
+                d->overflows.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    static void _playback_loop(StreamData *d)
+    {
+        while (true)
+        {
+            bool exit = d->exit.load(std::memory_order_acquire);
+            uint8_t *buff;
+            int frames = d->period_frames;
+            uint64_t ts = 0;
+            uint8_t *slot = nullptr;
+            if (d->callback)
+            {
+                if (exit)
+                    break;
+                buff = d->scratch.data();
+                _fill_silence(d->format, buff, frames, d->channel);
+                audio::Span span{buff, frames, frames * d->frame_bytes, time::ticks_us()};
+                d->callback(span);
+                frames = std::min(std::max(span.frames, 0), d->period_frames);
+            }
+            else
+            {
+                slot = d->ring.read_slot(frames, ts);
+                if (!slot)
+                {
+                    // stop() drains queued periods, then exit
+                    if (exit)
+                        break;
+                    if (!d->primed)
+                    {
+                        d->ring.wait(true, 100);
+                        continue;
+                    }
+                    d->underflows.fetch_add(1, std::memory_order_relaxed);
+                    buff = d->scratch.data();
+                    frames = d->period_frames;
+                    _fill_silence(d->format, buff, frames, d->channel);
+                }
+                else
+                {
+                    d->primed = true;
+                    buff = slot;
+                }
+            }
+            // playback never aborts a transfer, stop() plays all committed data
+            static const std::atomic<bool> no_exit{false};
+            int n = frames > 0 ? d->backend->transfer(buff, frames, no_exit) : 0;
+            if (slot)
+                d->ring.consume();
+            if (n < 0)
+                break;
+            d->frames.fetch_add(n, std::memory_order_relaxed);
+        }
+    }
+
+    static void _stream_process(void *args)
+    {
+        StreamData *d = (StreamData *)args;
+        if (d->dir == DIR_CAPTURE)
+            _capture_loop(d);
+        else
+            _playback_loop(d);
+        d->backend->stop(d->dir == DIR_PLAYBACK);
+        d->running = false;
+        // wake up blocked read/write
+        d->ring.close();
+    }
+
+    Stream::Stream(audio::Direction dir, const std::string &device, int sample_rate, audio::Format format,
+                   int channel, int period_frames, int periods, int ring_periods)
+    {
+        if (format_bytes(format) == 0 || channel <= 0 || sample_rate <= 0 || periods < 2 || ring_periods < 2)
+            throw err::Exception(err::ERR_ARGS, "invalid stream args");
+        StreamData *d = new StreamData();
+        d->dir = dir;
+        d->format = format;
+        d->channel = channel;
+        try
+        {
+            if (device.compare(0, 4, "wav:") == 0)
+            {
+                d->backend = new WavBackend(dir, device.substr(4), sample_rate, format, channel);
+                d->channel = channel;
+                if (period_frames <= 0)
+                    period_frames = sample_rate / 100;
+            }
+            else
+                d->backend = new AlsaBackend(dir, device, sample_rate, format, channel, period_frames, periods);
+        }
+        catch (...)
+        {
+            delete d;
+            throw;
+        }
+        d->sample_rate = sample_rate;
+        d->period_frames = period_frames;
+        d->frame_bytes = format_bytes(format) * d->channel;
+        d->ring.init(ring_periods, d->period_frames * d->frame_bytes);
+        d->scratch.resize(d->period_frames * d->frame_bytes);
+        d->thread = nullptr;
+        d->exit = false;
+        d->running = false;
+        d->frames = 0;
+        d->overflows = 0;
+        d->underflows = 0;
+        d->primed = false;
+        d->user_slot = nullptr;
+        _data = d;
+    }
+
+    Stream::~Stream()
+    {
+        StreamData *d = (StreamData *)_data;
+        stop();
+        delete d->backend;
+        delete d;
+    }
+
+    err::Err Stream::start(std::function<void(audio::Span &)> callback)
+    {
+        StreamData *d = (StreamData *)_data;
+        if (d->thread)
+            return err::ERR_BUSY;
+        d->callback = callback;
+        d->exit = false;
+        d->primed = false;
+        d->ring.close(false);
+        err::Err e = d->backend->start();
+        if (e != err::ERR_NONE)
+            return e;
+        d->running = true;
+        d->thread = new thread::Thread(_stream_process, d);
+        return err::ERR_NONE;
+    }
+
+    void Stream::stop()
+    {
+        StreamData *d = (StreamData *)_data;
+        if (!d->thread)
+            return;
+        d->exit.store(true, std::memory_order_release);
+        // wake up playback thread waiting for first data
+        d->ring.close();
+        d->thread->join();
+        delete d->thread;
+        d->thread = nullptr;
+        d->user_slot = nullptr;
+    }
+
+    err::Err Stream::read(audio::Span &span, int timeout_ms)
+    {
+        StreamData *d = (StreamData *)_data;
+        if (d->dir != DIR_CAPTURE || d->callback)
+            return err::ERR_NOT_PERMIT;
+        uint8_t *slot = d->ring.read_slot(span.frames, span.timestamp_us);
+        if (!slot)
+        {
+            if (!d->running.load())
+                return err::ERR_CANCEL;
+            d->ring.wait(true, timeout_ms);
+            slot = d->ring.read_slot(span.frames, span.timestamp_us);
+            if (!slot)
+                return d->running.load() ? err::ERR_TIMEOUT : err::ERR_CANCEL;
+        }
+        span.data = slot;
+        span.size = span.frames * d->frame_bytes;
+        d->user_slot = slot;
+        return err::ERR_NONE;
+    }
+
+    void Stream::release()
+    {
+        StreamData *d = (StreamData *)_data;
+        if (d->dir != DIR_CAPTURE || !d->user_slot)
+            return;
+        d->user_slot = nullptr;
+        d->ring.consume();
+    }
+
+    err::Err Stream::write(audio::Span &span, int timeout_ms)
+    {
+        StreamData *d = (StreamData *)_data;
+        if (d->dir != DIR_PLAYBACK || d->callback)
+            return err::ERR_NOT_PERMIT;
+        if (!d->running.load() || d->exit.load())
+            return err::ERR_CANCEL;
+        uint8_t *slot = d->ring.write_slot();
+        if (!slot)
+        {
+            d->ring.wait(false, timeout_ms);
+            if (!d->running.load() || d->exit.load())
+                return err::ERR_CANCEL;
+            slot = d->ring.write_slot();
+            if (!slot)
+                return err::ERR_TIMEOUT;
+        }
+        span.data = slot;
+        span.frames = d->period_frames;
+        span.size = d->period_frames * d->frame_bytes;
+        span.timestamp_us = time::ticks_us();
+        d->user_slot = slot;
+        return err::ERR_NONE;
+    }
+
+    void Stream::commit(int frames)
+    {
+        StreamData *d = (StreamData *)_data;
+        if (d->dir != DIR_PLAYBACK || !d->user_slot)
+            return;
+        if (frames < 0 || frames > d->period_frames)
+            frames = d->period_frames;
+        d->user_slot = nullptr;
+        d->ring.produce(frames, time::ticks_us());
+    }
+
+    audio::StreamStats Stream::stats()
+    {
+        StreamData *d = (StreamData *)_data;
+        audio::StreamStats s;
+        s.frames = d->frames.load(std::memory_order_relaxed);
+        s.xruns = d->backend->xruns.load(std::memory_order_relaxed);
+        s.overflows = d->overflows.load(std::memory_order_relaxed);
+        s.underflows = d->underflows.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    int Stream::period_frames()
+    {
+        return ((StreamData *)_data)->period_frames;
+    }
+
+    int Stream::frame_bytes()
+    {
+        return ((StreamData *)_data)->frame_bytes;
+    }
+
+    int Stream::sample_rate()
+    {
+        return ((StreamData *)_data)->sample_rate;
+    }
+} // namespace maix::audio
@@ -14,10 +14,14 @@ int _main(int argc, char* argv[])
 
     auto mlx = MLX90640Celsius(5, FPS::FPS_32, Cmap::IRONBOW, 5, 50);
 
-    while (true) {
-        auto img = mlx.image();
-        disp.show(*img);
-        delete img;
+    // render bilinear upscaled to display size, reuse the image
+    image::Image img(disp.width(), disp.height(), image::FMT_RGB888);
+
+    while (!app::need_exit()) {
+        if (mlx.update() != err::ERR_NONE)
+            continue;
+        mlx.image_to(img);
+        disp.show(img);
 
         auto [max_x, max_y, max] = mlx.max_temp_point();
         log::info("max temp %0.2f in (%d, %d)", max, max_x, max_y);
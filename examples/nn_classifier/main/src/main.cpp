@@ -52,18 +52,18 @@ int _main(int argc, char* argv[])
         camera::Camera cam = camera::Camera(input_size.width(), input_size.height(), classifier.input_format());
         log::info("open camera success");
         display::Display disp = display::Display();
+        std::vector<std::pair<int, float>> result;
         while(!app::need_exit())
         {
             uint64_t t = time::ticks_ms();
             image::Image *img = cam.read();
             err::check_null_raise(img, "read camera failed");
-            std::vector<std::pair<int, float>> * result = classifier.classify(*img);
-            int max_idx = result->at(0).first;
-            float max_score = result->at(0).second;
+            classifier.classify(*img, result, 1);
+            int max_idx = result[0].first;
+            float max_score = result[0].second;
             snprintf(msg, sizeof(msg), "%5.2f: %s", max_score, classifier.labels[max_idx].c_str());
             img->draw_string(10, 10, msg, image::COLOR_RED);
             disp.show(*img);
-            delete result;
             delete img;
             log::info("time: %d ms", time::ticks_ms() - t);
         }